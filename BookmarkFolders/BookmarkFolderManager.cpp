@@ -208,6 +208,12 @@ bool BookmarkFolderManager::CalculateAbsolutePaths()
     return true;
 }
 
+QStringList BookmarkFolderManager::CreateIndexQueries()
+{
+    return QStringList()
+        << "CREATE INDEX IF NOT EXISTS IX_BookmarkFolder_ParentFOID ON BookmarkFolder(ParentFOID)";
+}
+
 void BookmarkFolderManager::CreateTables()
 {
     QSqlQuery query(db);
@@ -219,6 +225,9 @@ void BookmarkFolderManager::CreateTables()
                "  Name TEXT, Desc TEXT, DefFileArchive TEXT, "
                "  FOREIGN KEY(ParentFOID) REFERENCES BookmarkFolder(FOID) ON DELETE RESTRICT )");
 
+    foreach (const QString& createIndexQuery, CreateIndexQueries())
+        query.exec(createIndexQuery);
+
     //Insert the first Folder.
     query.prepare("INSERT INTO BookmarkFolder(FOID, ParentFOID, Name, Desc, DefFileArchive) VALUES (?, ?, ?, ?, ?);");
     query.addBindValue(0); //Force first PK to be 0.
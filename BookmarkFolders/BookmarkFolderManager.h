@@ -106,6 +106,9 @@ public:
 private:
     bool CalculateAbsolutePaths();
 
+public:
+    static QStringList CreateIndexQueries();
+
 protected:
     // ISubManager interface
     void CreateTables();
@@ -2,17 +2,39 @@
 
 #include "BookmarksBusinessLogic.h"
 #include "Config.h"
+#include "Util/FileHasher.h"
 #include "Util/Util.h"
 
+#include <QDateTime>
 #include <QDebug>
-#include <QDir>
-#include <QFile>
 #include <QFileInfo>
-#include <QStandardPaths>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QUrl>
+#include <QVector>
+
+class BookmarkImporter::AnalysisShardTask : public QRunnable
+{
+private:
+    AnalysisPhase m_phase;
+    AnalysisData& m_data;
+    int m_begin;
+    int m_end;
+
+public:
+    AnalysisShardTask(AnalysisPhase phase, AnalysisData& data, int begin, int end)
+        : m_phase(phase), m_data(data), m_begin(begin), m_end(end)
+    {
+    }
+
+    void run()
+    {
+        m_phase(m_data, m_begin, m_end);
+    }
+};
 
 BookmarkImporter::BookmarkImporter(DatabaseManager* dbm, QWidget* dialogParent)
-    : dbm(dbm), m_dialogParent(dialogParent)
+    : dbm(dbm), m_dialogParent(dialogParent), m_importBatchSize(1), m_pendingDataSize(0)
 {
 
 }
@@ -45,48 +67,66 @@ bool BookmarkImporter::Initialize()
     return true;
 }
 
-bool BookmarkImporter::Analyze(ImportedEntityList& elist)
+bool BookmarkImporter::Analyze(ImportedEntityList& elist, bool parallel)
 {
     //First initialize the data we will need during the conversion.
+    folderItemsIndexInArray.clear();
+    folderItemsIndexInArray.reserve(elist.ibflist.size());
     for (int i = 0; i < elist.ibflist.size(); i++)
         folderItemsIndexInArray[elist.ibflist[i].intId] = i;
 
-    //Tag all the bookmarks
-    QString tagByParentFolder;
+    //Tag all the bookmarks. The tag only depends on the parent folder, so it is found once per folder.
+    QHash<int, QString> tagsByParentFolderId;
     for (int index = 0; index < elist.iblist.size(); index++)
     {
-        elist.iblist[index].Ex_additionalTags = QStringList();
-        tagByParentFolder = bookmarkTagAccordingToParentFolders(elist, index);
-        if (!tagByParentFolder.isEmpty())
-            elist.iblist[index].Ex_additionalTags.append(tagByParentFolder);
+        ImportedBookmark& ib = elist.iblist[index];
+        QHash<int, QString>::const_iterator tagIt = tagsByParentFolderId.constFind(ib.parentId);
+        if (tagIt == tagsByParentFolderId.constEnd())
+            tagIt = tagsByParentFolderId.insert(ib.parentId, bookmarkTagAccordingToParentFolders(elist, index));
+
+        ib.Ex_additionalTags = QStringList();
+        if (!tagIt.value().isEmpty())
+            ib.Ex_additionalTags.append(tagIt.value());
     }
 
     //Find URLs of the TO-BE-IMPORTED bookmarks that EXACTLY match.
     //  This is done to merge firefox bookmarks with different tags into one bookmark.
-    //Insert everything into a multihash
-    QMultiHash<QString, int> exactURLIndices;
-    for (int i = 0; i < elist.iblist.size(); i++)
-        exactURLIndices.insertMulti(elist.iblist[i].uri, i);
-
-    //Find those keys who have more than one bookmark.
-    QStringList duplicateExactURLs;
-    foreach (const QString& exactURL, exactURLIndices.uniqueKeys())
-        if (exactURLIndices.count(exactURL) > 1)
-            duplicateExactURLs.append(exactURL);
+    //Bookmarks with the same URL are chained: `previousIndexWithSameURL` links each one to the
+    //  previous one, and `lastIndexForURL` holds the head of each chain.
+    const int bookmarksCount = elist.iblist.size();
+    QHash<QString, int> lastIndexForURL;
+    lastIndexForURL.reserve(bookmarksCount);
+    QVector<int> previousIndexWithSameURL(bookmarksCount, -1);
+    for (int i = 0; i < bookmarksCount; i++)
+    {
+        QHash<QString, int>::iterator it = lastIndexForURL.find(elist.iblist[i].uri);
+        if (it == lastIndexForURL.end())
+        {
+            lastIndexForURL.insert(elist.iblist[i].uri, i);
+        }
+        else
+        {
+            previousIndexWithSameURL[i] = it.value();
+            it.value() = i;
+        }
+    }
 
     //Collect all descriptions and titles for each duplicate url; mark one of them as 'original' and remove the rest.
     //I saw that usually among the tagged duplicate bookmarks, just one of them contains title and description
     //  and the rest are without title and description. But anyway we use a join operation to be safe.
-    QList<int> indicesToDelete;
-    foreach (const QString& duplicateURL, duplicateExactURLs)
+    //Chains are walked from the last bookmark to the first; so the first bookmark having a title or
+    //  description becomes the original, and titles are joined from the last to the first.
+    QVector<bool> keepBookmark(bookmarksCount, true);
+    for (int last = 0; last < bookmarksCount; last++)
     {
-        const QList<int>& indicesForURL = exactURLIndices.values(duplicateURL);
+        if (previousIndexWithSameURL[last] == -1 || lastIndexForURL.value(elist.iblist[last].uri) != last)
+            continue; //Not a duplicate URL, or not the head of the chain.
 
-        int originalIndex = indicesForURL[0]; //The one with title and/or description.
+        int originalIndex = last; //The one with title and/or description.
         QStringList titles;
         QStringList descriptions;
         QStringList tags;
-        foreach (int index, indicesForURL)
+        for (int index = last; index != -1; index = previousIndexWithSameURL[index])
         {
             const ImportedBookmark& ib = elist.iblist[index];
             if (!ib.title.isEmpty() || !ib.description.isEmpty())
@@ -98,124 +138,136 @@ bool BookmarkImporter::Analyze(ImportedEntityList& elist)
             foreach (const QString& tag, ib.Ex_additionalTags)
                 if (!tags.contains(tag, Qt::CaseSensitive))
                     tags.append(tag);
+
+            //Remove all except the one with the most information (at originalIndex).
+            keepBookmark[index] = false;
         }
+        keepBookmark[originalIndex] = true;
 
         //Apply the new title, descriptions, tags to the only bookmark that is going to remain.
         elist.iblist[originalIndex].title = titles.join(" -- ");
         elist.iblist[originalIndex].description = descriptions.join("\n\n");
         elist.iblist[originalIndex].Ex_additionalTags = tags;
-
-        //Add those we eant to remove all except the one with the most information (at originalIndex).
-        //We can't just remove them here, it will change the indexes of bookmarks in the next iterations.
-        indicesToDelete.append(indicesForURL);
-        indicesToDelete.removeOne(originalIndex);
     }
 
-    qSort(indicesToDelete);
-    for (int i = indicesToDelete.size() - 1; i >= 0; i--)
-        elist.iblist.removeAt(indicesToDelete[i]);
-
-    //Convert text in brackets in titles to descriptions, like I write them.
-    //  Do this before doing the similarity check below.
-    QString brTitle, brDesc;
-    for (int i = 0; i < elist.iblist.size(); i++)
+    //Remove them all at once, keeping the order of the remaining ones.
+    //  QList::swap only swaps the item pointers.
+    int keptCount = 0;
+    for (int i = 0; i < bookmarksCount; i++)
     {
-        //By reference.
-        ImportedBookmark& ib = elist.iblist[i];
-        BreakTitleBracketedDescription(ib.title, brTitle, brDesc);
-        if (!brTitle.isEmpty() || !brDesc.isEmpty())
-        {
-            ib.title = brTitle;
-            if (ib.description.isEmpty())
-                ib.description = brDesc;
-            else
-                ib.description += "\n" + brDesc;
-        }
+        if (!keepBookmark[i])
+            continue;
+        if (i != keptCount)
+            elist.iblist.swap(i, keptCount);
+        keptCount++;
     }
-
-    //Now check the urls for duplicates among EXISTING bookmarks.
+    elist.iblist.erase(elist.iblist.begin() + keptCount, elist.iblist.end());
+
+    //The following per-bookmark work is independent for each bookmark, so it is done in shards on
+    //  all cores. Each shard only writes the bookmarks and AnalysisData items of its own indexes,
+    //  so the result doesn't depend on the scheduling and is the same as doing it serially.
+    AnalysisData data;
+    data.existentBookmarksForUrl = &existentBookmarksForUrl;
+    data.bookmarks.reserve(elist.iblist.size());
     for (int i = 0; i < elist.iblist.size(); i++)
-    //foreach (ImportedBookmark& ib, elist.iblist)
-    {
-        //By reference.
-        ImportedBookmark& ib = elist.iblist[i];
+        data.bookmarks.append(&elist.iblist[i]); //Detaches the list here, not in the threads.
+    data.almostExactURLs.resize(data.bookmarks.size());
+    data.almostDuplicateBIDs.resize(data.bookmarks.size());
 
-        QString fastDuplCheckURL = GetURLForFastComparison(ib.uri);
-        if (existentBookmarksForUrl.contains(fastDuplCheckURL))
+    //Convert text in brackets in titles to descriptions, and find existing bookmarks with similar URLs.
+    RunAnalysisPhase(&BookmarkImporter::AnalyzeTitlesAndURLs, data, parallel);
+
+    //Database can only be used in this thread. Retrieve all the existing bookmarks that will be
+    //  compared once.
+    for (int i = 0; i < data.almostDuplicateBIDs.size(); i++)
+    {
+        foreach (long long existentBID, data.almostDuplicateBIDs[i])
         {
-            //Whoops, we found a similar match until now. Check if it's fully similar or just partially.
-            QList<long long> existentAlmostDuplicateBIDs = existentBookmarksForUrl.values(fastDuplCheckURL);
+            if (data.existentBookmarks.contains(existentBID))
+                continue;
 
-            bool foundSimilar;
-            bool foundExact;
-            long long duplicateBID;
-            bool duplicateFindSuccess = FindDuplicate(ib, existentAlmostDuplicateBIDs,
-                                                      foundSimilar, foundExact, duplicateBID);
-            if (!duplicateFindSuccess)
+            BookmarkManager::BookmarkData bdata;
+            if (!dbm->bms.RetrieveBookmark(existentBID, bdata))
                 return false;
 
-            if (foundSimilar || foundExact)
-            {
-                if (foundExact)
-                    ib.Ex_status = ImportedBookmark::S_AnalyzedExactExistent;
-                else //if (foundSimilar
-                    ib.Ex_status = ImportedBookmark::S_AnalyzedSimilarExistent;
-
-                ib.Ex_AlmostDuplicateExistentBIDs = existentBookmarksForUrl.values(fastDuplCheckURL);
-                ib.Ex_DuplicateExistentComparedBID = duplicateBID;
-
-                continue; //These `if`s don't have `else`s, don't reach the parts after them that set them to ImportOK.
-            }
+            ExistentBookmark eb;
+            eb.name = bdata.Name.trimmed();
+            eb.desc = bdata.Desc.trimmed();
+            eb.urls = Util::RemoveEmptyLinesAndTrim(bdata.URLs).split('\n');
+            foreach (const QString& existingURL, eb.urls)
+                eb.almostExactURLs.append(GetURLForAlmostExactComparison(existingURL));
+            data.existentBookmarks.insert(existentBID, eb);
         }
-
-        //If urls are not similar
-        ib.Ex_status = ImportedBookmark::S_AnalyzedImportOK;
     }
 
+    //Now check the urls for duplicates among EXISTING bookmarks.
+    RunAnalysisPhase(&BookmarkImporter::AnalyzeExistentDuplicates, data, parallel);
+
     //Bookmarks imported; delete folders without bookmarks or folders in them until nothing remains to be deleted.
     //Note: There is a 'Tags' folder which should automatically be deleted because it just contains bookmarks
     //  without titles or anything but just tags. However in case of corrupt files or user manipulation, its
     //  bookmarks will end up as a bunch of [title-less bookmarks] which we will handle without a problem.
-    QSet<int> usedFolderIds;
-    while (true)
+    //Child folders always come after their parents (see FirefoxBookmarkJSONFileParser), so going
+    //  backwards, all children of a folder are decided before the folder itself; one pass is enough.
+    const int foldersCount = elist.ibflist.size();
+    QVector<int> childrenCount(foldersCount, 0);
+    foreach (const ImportedBookmark& ib, elist.iblist)
     {
-        usedFolderIds.clear();
-        foreach (const ImportedBookmark& ib, elist.iblist)
-            usedFolderIds.insert(ib.parentId);
-        foreach (const ImportedBookmarkFolder& ibf, elist.ibflist)
-            usedFolderIds.insert(ibf.parentId);
-
-        indicesToDelete.clear();
-        for (int i = 0; i < elist.ibflist.size(); i++)
-            if (!usedFolderIds.contains(elist.ibflist[i].intId))
-                indicesToDelete.append(i);
-
-        if (indicesToDelete.isEmpty())
-            break;
+        int parentIndex = folderItemsIndexInArray.value(ib.parentId, -1);
+        if (parentIndex != -1)
+            childrenCount[parentIndex]++;
+    }
+    foreach (const ImportedBookmarkFolder& ibf, elist.ibflist)
+    {
+        int parentIndex = folderItemsIndexInArray.value(ibf.parentId, -1);
+        if (parentIndex != -1)
+            childrenCount[parentIndex]++;
+    }
 
-        qSort(indicesToDelete);
-        for (int i = indicesToDelete.size() - 1; i >= 0; i--)
-            elist.ibflist.removeAt(indicesToDelete[i]);
+    QVector<bool> keepFolder(foldersCount, true);
+    for (int i = foldersCount - 1; i >= 0; i--)
+    {
+        if (childrenCount[i] > 0)
+            continue;
+
+        keepFolder[i] = false;
+        int parentIndex = folderItemsIndexInArray.value(elist.ibflist[i].parentId, -1);
+        if (parentIndex != -1)
+            childrenCount[parentIndex]--;
     }
 
+    keptCount = 0;
+    for (int i = 0; i < foldersCount; i++)
+    {
+        if (!keepFolder[i])
+            continue;
+        if (i != keptCount)
+            elist.ibflist.swap(i, keptCount);
+        keptCount++;
+    }
+    elist.ibflist.erase(elist.ibflist.begin() + keptCount, elist.ibflist.end());
+
+    //Indices have changed; but they're only needed for tagging which is done.
+    folderItemsIndexInArray.clear();
+
     return true;
 }
 
 bool BookmarkImporter::Import(ImportedEntityList& elist, QList<long long>& addedBIDs,
                               QSet<long long>& allAssociatedTIDs,
-                              QList<ImportedBookmark*>& failedProcessOrImports)
+                              QList<ImportedBookmark*>& failedProcessOrImports, int batchSize)
 {
     //Do it for caller
     addedBIDs.clear();
     allAssociatedTIDs.clear();
     failedProcessOrImports.clear();
 
-    if (!InitializeImport())
+    if (!InitializeImport(batchSize))
         return false;
 
-    foreach (const ImportedBookmark& ib, elist.iblist)
+    for (int i = 0; i < elist.iblist.size(); i++)
     {
-        if (!ImportOne(ib, &elist))
+        if (!ImportOne(elist.iblist[i], &elist))
             continue; //Actually never return. Import all the bookmarks.
     }
 
@@ -224,102 +276,62 @@ bool BookmarkImporter::Import(ImportedEntityList& elist, QList<long long>& added
     return true;
 }
 
-bool BookmarkImporter::InitializeImport()
+bool BookmarkImporter::InitializeImport(int batchSize)
 {
     m_addedBIDs.clear();
     m_allAssociatedTIDs.clear();
     m_failedProcessOrImports.clear();
-
-    m_tempPath = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/BMTemp";
-    if (!QDir().mkpath(m_tempPath))
-    {
-        QMessageBox::critical(
-                    m_dialogParent, "Error",
-                    QString("Could not create the temp directory \"%1\". No bookmark was imported.")
-                    .arg(m_tempPath));
-        return false;
-    }
-    if (!Util::RemoveDirectoryRecursively(m_tempPath, false /* don't remove the directory itself */))
-    {
-        QMessageBox::critical(
-                    m_dialogParent, "Error",
-                    QString("Could not empty the temp directory \"%1\". No bookmark was imported.")
-                    .arg(m_tempPath));
-        return false;
-    }
+    m_pendingImports.clear();
+    m_pendingDataSize = 0;
+    m_importBatchSize = qMax(1, batchSize);
 
     return true;
 }
 
-bool BookmarkImporter::ImportOne(const ImportedBookmark& ib, ImportedEntityList* elist)
+bool BookmarkImporter::ImportOne(ImportedBookmark& ib, ImportedEntityList* elist)
 {
     if (!ib.Ex_finalImport)
         //Marked by user to not import.
         return true;
 
-    //Important: We don't want to put the attached file in recycle bin. So we will manually
-    //  delete it instead of using BookmarkFile::Ex_RemoveAfterAttach.
-    QString mhtFilePathName;
     QList<FileManager::BookmarkFile> bookmarkFiles;
-    if ((elist->importSource == ImportedEntityList::Source_Urls || elist->importSource == ImportedEntityList::Source_Firefox)
+    if ((elist->importSource == ImportedEntityList::Source_Urls || elist->importSource == ImportedEntityList::Source_Firefox ||
+         elist->importSource == ImportedEntityList::Source_Chromium)
         && ib.ExPr_attachedFileError.isEmpty())
     {
         bool FsTransformUnicode = dbm->sets.GetSetting("FsTransformUnicode", dbm->conf->defaultFsTransformUnicode);
         QString safeFileName = Util::SafeAndShortFSName(ib.ExPr_attachedFileName, true, FsTransformUnicode);
-        mhtFilePathName = m_tempPath + "/" + safeFileName;
-        QFile mhtfile(mhtFilePathName);
-        if (!mhtfile.open(QIODevice::WriteOnly))
-        {
-            QMessageBox::warning(
-                        m_dialogParent, "Error",
-                        QString("Could not create the temp file \"%1\" for bookmark \"%2\" (\"%3\").\nError: %4 %5")
-                        .arg(mhtFilePathName, ib.title, ib.uri, QString::number(mhtfile.error()), mhtfile.errorString()));
-            return false;
-        }
-        if (-1 == mhtfile.write(ib.ExPr_attachedFileData))
-        {
-            QMessageBox::warning(
-                        m_dialogParent, "Error",
-                        QString("Could not write data to the temp file \"%1\" for bookmark \"%2\" (\"%3\").\nError: %4 %5")
-                        .arg(mhtFilePathName, ib.title, ib.uri, QString::number(mhtfile.error()), mhtfile.errorString()));
-            mhtfile.close();
-
-            RemoveTempFileIfExists(mhtFilePathName);
-            return false;
-        }
-        if (!mhtfile.flush())
-        {
-            QMessageBox::warning(
-                        m_dialogParent, "Error",
-                        QString("Could not flush data to the temp file \"%1\" for bookmark \"%2\" (\"%3\").\nError: %4 %5")
-                        .arg(mhtFilePathName, ib.title, ib.uri, QString::number(mhtfile.error()), mhtfile.errorString()));
-            mhtfile.close();
-
-            RemoveTempFileIfExists(mhtFilePathName);
-            return false;
-        }
-        mhtfile.close();
 
-        //Same logic exists in BookmarkEditDialog::accept and its [File Attaching] functions.
-        QFileInfo fileInfo(mhtFilePathName);
+        //The page is written straight from memory to the archive, which also calculates its size
+        //  and MD5 hash; there is no temp file to write and read again.
         FileManager::BookmarkFile bf;
         bf.BFID         = -1; //Leave to FileManager.
         bf.BID          = -1; //Not added yet; Not important.
         bf.FID          = -1; //Leave to FileManager.
-        bf.OriginalName = mhtFilePathName;
+        bf.OriginalName = safeFileName;
         bf.ArchiveURL   = ""; //Leave to FileManager.
-        bf.ModifyDate   = fileInfo.lastModified();
-        bf.Size         = fileInfo.size();
-        bf.MD5          = Util::GetMD5HashForFile(mhtFilePathName);
+        bf.ModifyDate   = QDateTime::currentDateTime();
+        bf.Size         = ib.ExPr_attachedFileData.size(); //Will be set again by FileManager.
+        bf.MD5          = QByteArray(); //Leave to FileManager.
         bf.Ex_IsDefaultFileForEditedBookmark = true; //Not important.
-        bf.Ex_RemoveAfterAttach = false; //We don't want to put it in recycle bin. Will manually delete.
+        bf.Ex_RemoveAfterAttach = false;
+        bf.Ex_FileData  = ib.ExPr_attachedFileData;
+        //Don't keep a second reference; the data is freed as soon as it is in the archive.
+        ib.ExPr_attachedFileData = QByteArray();
+        if (bf.Ex_FileData.isNull())
+            bf.Ex_FileData = QByteArray(""); //Not null, so that an empty page is still added from memory.
 
         bookmarkFiles.append(bf);
     }
     else if (elist->importSource == ImportedEntityList::Source_Files)
     {
         //Same logic exists in BookmarkEditDialog::accept and its [File Attaching] functions.
+        //  An unreadable file gets an MD5 of zeros, like from Util::GetMD5HashForFile; it fails
+        //  later when it is copied.
         QFileInfo fileInfo(ib.ExMd_importedFilePath);
+        FileHasher::Result hashResult;
+        FileHasher::HashFile(ib.ExMd_importedFilePath, FileHasher::HT_MD5 | FileHasher::HT_Strong,
+                             hashResult);
         FileManager::BookmarkFile bf;
         bf.BFID         = -1; //Leave to FileManager.
         bf.BID          = -1; //Not added yet; Not important.
@@ -328,20 +340,18 @@ bool BookmarkImporter::ImportOne(const ImportedBookmark& ib, ImportedEntityList*
         bf.ArchiveURL   = ""; //Leave to FileManager.
         bf.ModifyDate   = fileInfo.lastModified();
         bf.Size         = fileInfo.size();
-        bf.MD5          = Util::GetMD5HashForFile(ib.ExMd_importedFilePath);
+        bf.MD5          = (hashResult.success ? hashResult.md5 : QByteArray(16, '\0'));
         bf.Ex_IsDefaultFileForEditedBookmark = true; //Not important.
         bf.Ex_RemoveAfterAttach = elist->removeImportedFiles; //If ordered, we'll put the file in recycle bin.
+        bf.Ex_ContentHash = hashResult.strongHash; //Empty if it could not be read.
 
         bookmarkFiles.append(bf);
     }
 
     if (ib.Ex_status == ImportedBookmark::S_AnalyzedImportOK)
     {
-        //[KeepDefaultFile-1].Generalization: Any bookmark MUST have a default file if it has files.
-        //  (If it doesn't have files just pass -1, otherwise you may crash AddOrEditBookmark.)
-        int defaultFileIndex = (bookmarkFiles.empty() ? -1 : 0);
-
-        BookmarkManager::BookmarkData bdata;
+        BookmarksBusinessLogic::NewBookmark nb;
+        BookmarkManager::BookmarkData& bdata = nb.bdata;
         bdata.BID = -1; //Not important.
         bdata.FOID = elist->importFOID;
         bdata.Name = ib.title.trimmed(); //[title-less bookmarks] are not possible after processing.
@@ -350,33 +360,29 @@ bool BookmarkImporter::ImportOne(const ImportedBookmark& ib, ImportedEntityList*
         bdata.DefBFID = -1; //[KeepDefaultFile-1] We always set this to -1.
                             //bbLogic will set the correct defbfid later.
         bdata.Rating = 0; //For all.
+        nb.extraInfos = ib.ExPr_ExtraInfosList;
+        nb.tagsList = ib.Ex_finalTags;
+        nb.filesList = bookmarkFiles;
 
-        long long addedBID = -1; //Must set to -1 to show adding.
-        QList<long long> associatedTIDs;
-        //We just need an empty thing for 'updating' functions. No need to initialize, especially:
-        //  do NOT initialize `Ex_ExtraInfosModel` by calling `GetEmptyExtraInfosModel`.
-        BookmarkManager::BookmarkData editOriginalBData;
+        if (m_importBatchSize > 1)
+        {
+            PendingImport pending;
+            pending.ib = &ib;
+            pending.nb = nb;
+            m_pendingImports.append(pending);
 
-        BookmarksBusinessLogic bbLogic(dbm, m_dialogParent);
-        bbLogic.BeginActionTransaction();
+            //Pages of queued bookmarks stay in memory until their batch is added; limit that too.
+            foreach (const FileManager::BookmarkFile& bf, bookmarkFiles)
+                m_pendingDataSize += bf.Ex_FileData.size();
 
-        bool success = bbLogic.AddOrEditBookmark(
-                    addedBID, bdata, -1, editOriginalBData, QList<long long>(), ib.ExPr_ExtraInfosList,
-                    ib.Ex_finalTags, associatedTIDs, bookmarkFiles, defaultFileIndex);
-        if (!success)
-        {
-            //A messagebox must have already been displayed.
-            bbLogic.RollBackActionTransaction();
+            if (m_pendingImports.size() >= m_importBatchSize || m_pendingDataSize >= MaxPendingImportDataSize)
+                ImportPendingBatch();
 
-            RemoveTempFileIfExists(mhtFilePathName);
-            return false;
+            return true;
         }
 
-        bbLogic.CommitActionTransaction();
-
-        //Success!
-        m_addedBIDs.append(addedBID);
-        m_allAssociatedTIDs.unite(QSet<long long>::fromList(associatedTIDs));
+        if (!ImportSingle(nb))
+            return false;
     }
     else if (ib.Ex_status == ImportedBookmark::S_AnalyzedExactExistent)
     {
@@ -409,11 +415,6 @@ bool BookmarkImporter::ImportOne(const ImportedBookmark& ib, ImportedEntityList*
                     .arg(QString::number((int)ib.Ex_status), ib.title, ib.uri));
     }
 
-    //There are `return false`s in the code. Everything here must be repeated before them.
-    //We always need to remove this file, because we create it regardless of import type.
-    //We don't check its return value.
-    RemoveTempFileIfExists(mhtFilePathName);
-
     return true;
 }
 
@@ -425,11 +426,94 @@ void BookmarkImporter::MarkAsFailed(ImportedBookmark* ib)
 void BookmarkImporter::FinalizeImport(QList<long long>& addedBIDs, QSet<long long>& allAssociatedTIDs,
                                       QList<ImportedBookmark*>& failedProcessOrImports)
 {
+    ImportPendingBatch();
+
     addedBIDs = m_addedBIDs;
     allAssociatedTIDs = m_allAssociatedTIDs;
     failedProcessOrImports = m_failedProcessOrImports.toList();
 }
 
+bool BookmarkImporter::ImportSingle(BookmarksBusinessLogic::NewBookmark& nb)
+{
+    //[KeepDefaultFile-1].Generalization: Any bookmark MUST have a default file if it has files.
+    //  (If it doesn't have files just pass -1, otherwise you may crash AddOrEditBookmark.)
+    int defaultFileIndex = (nb.filesList.empty() ? -1 : 0);
+
+    long long addedBID = -1; //Must set to -1 to show adding.
+    QList<long long> associatedTIDs;
+    //We just need an empty thing for 'updating' functions. No need to initialize, especially:
+    //  do NOT initialize `Ex_ExtraInfosModel` by calling `GetEmptyExtraInfosModel`.
+    BookmarkManager::BookmarkData editOriginalBData;
+
+    BookmarksBusinessLogic bbLogic(dbm, m_dialogParent);
+    bbLogic.BeginActionTransaction();
+
+    bool success = bbLogic.AddOrEditBookmark(
+                addedBID, nb.bdata, -1, editOriginalBData, QList<long long>(), nb.extraInfos,
+                nb.tagsList, associatedTIDs, nb.filesList, defaultFileIndex);
+    if (!success)
+    {
+        //A messagebox must have already been displayed.
+        bbLogic.RollBackActionTransaction();
+        return false;
+    }
+
+    bbLogic.CommitActionTransaction();
+
+    //Success!
+    m_addedBIDs.append(addedBID);
+    m_allAssociatedTIDs.unite(QSet<long long>::fromList(associatedTIDs));
+    return true;
+}
+
+void BookmarkImporter::ImportPendingBatch()
+{
+    if (m_pendingImports.isEmpty())
+        return;
+
+    QList<BookmarksBusinessLogic::NewBookmark> newBookmarks;
+    foreach (const PendingImport& pending, m_pendingImports)
+        newBookmarks.append(pending.nb);
+
+    //One transaction, and so one sync of the database and file system, for the whole batch.
+    QList<long long> addedBIDs;
+    QList<long long> associatedTIDs;
+    BookmarksBusinessLogic bbLogic(dbm, m_dialogParent);
+    bbLogic.BeginActionTransaction();
+
+    bool success = bbLogic.AddBookmarksBatch(newBookmarks, addedBIDs, associatedTIDs);
+    if (success)
+    {
+        bbLogic.CommitActionTransaction();
+
+        m_addedBIDs.append(addedBIDs);
+        m_allAssociatedTIDs.unite(QSet<long long>::fromList(associatedTIDs));
+    }
+    else
+    {
+        //A messagebox must have already been displayed. Nothing of the batch remains; add its
+        //  bookmarks one by one so that only the failing ones are not imported.
+        bbLogic.RollBackActionTransaction();
+    }
+
+    for (int i = 0; i < m_pendingImports.size(); i++)
+    {
+        PendingImport& pending = m_pendingImports[i];
+        if (!success && !ImportSingle(pending.nb))
+        {
+            //Same as ImportedBookmarkProcessor::Import.
+            if (!pending.ib->ExIm_finalError.isEmpty())
+                pending.ib->ExIm_finalError += "\n";
+            pending.ib->ExIm_finalError += "Importer Error.";
+            MarkAsFailed(pending.ib);
+        }
+
+    }
+
+    m_pendingImports.clear();
+    m_pendingDataSize = 0;
+}
+
 QString BookmarkImporter::bookmarkTagAccordingToParentFolders(ImportedEntityList& elist, int bookmarkIndex)
 {
     const ImportedBookmark& ib = elist.iblist[bookmarkIndex];
@@ -437,7 +521,7 @@ QString BookmarkImporter::bookmarkTagAccordingToParentFolders(ImportedEntityList
 
     QString tag = QString();
     while (folderItemsIndexInArray.contains(parentId) &&
-           elist.ibflist[folderItemsIndexInArray[parentId]].root.isEmpty()) //This `root` checking is for Source_Firefox.
+           elist.ibflist[folderItemsIndexInArray[parentId]].root.isEmpty()) //This `root` checking is for Source_Firefox and Source_Chromium.
     {
         tag = elist.ibflist[folderItemsIndexInArray[parentId]].title + (tag.isEmpty() ? "" : "/") + tag;
         parentId = elist.ibflist[folderItemsIndexInArray[parentId]].parentId;
@@ -492,29 +576,102 @@ void BookmarkImporter::BreakTitleBracketedDescription(const QString& titleDesc,
     }
 }
 
-bool BookmarkImporter::FindDuplicate(const ImportedBookmark& ib, const QList<long long>& almostDuplicateBIDs,
+void BookmarkImporter::RunAnalysisPhase(AnalysisPhase phase, AnalysisData& data, bool parallel)
+{
+    const int count = data.bookmarks.size();
+    if (!parallel || count <= AnalysisShardSize)
+    {
+        phase(data, 0, count);
+        return;
+    }
+
+    //Shards are small enough that idle threads pick up the remaining ones if some shards take
+    //  longer, e.g because their bookmarks have existing duplicates.
+    QThreadPool pool;
+    for (int begin = 0; begin < count; begin += AnalysisShardSize)
+        pool.start(new AnalysisShardTask(phase, data, begin, qMin(begin + AnalysisShardSize, count)));
+    pool.waitForDone();
+}
+
+void BookmarkImporter::AnalyzeTitlesAndURLs(AnalysisData& data, int begin, int end)
+{
+    QString brTitle, brDesc;
+    for (int i = begin; i < end; i++)
+    {
+        ImportedBookmark& ib = *data.bookmarks[i];
+
+        //Convert text in brackets in titles to descriptions, like I write them.
+        //  Do this before doing the similarity check.
+        BreakTitleBracketedDescription(ib.title, brTitle, brDesc);
+        if (!brTitle.isEmpty() || !brDesc.isEmpty())
+        {
+            ib.title = brTitle;
+            if (ib.description.isEmpty())
+                ib.description = brDesc;
+            else
+                ib.description += "\n" + brDesc;
+        }
+
+        QString fastDuplCheckURL = GetURLForFastComparison(ib.uri);
+        data.almostDuplicateBIDs[i] = data.existentBookmarksForUrl->values(fastDuplCheckURL);
+        if (!data.almostDuplicateBIDs[i].isEmpty())
+            data.almostExactURLs[i] = GetURLForAlmostExactComparison(ib.uri);
+    }
+}
+
+void BookmarkImporter::AnalyzeExistentDuplicates(AnalysisData& data, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        ImportedBookmark& ib = *data.bookmarks[i];
+        const QList<long long>& existentAlmostDuplicateBIDs = data.almostDuplicateBIDs[i];
+        if (!existentAlmostDuplicateBIDs.isEmpty())
+        {
+            //Whoops, we found a similar match until now. Check if it's fully similar or just partially.
+            bool foundSimilar;
+            bool foundExact;
+            long long duplicateBID;
+            FindDuplicate(ib, data.almostExactURLs[i], existentAlmostDuplicateBIDs, data.existentBookmarks,
+                          foundSimilar, foundExact, duplicateBID);
+
+            if (foundSimilar || foundExact)
+            {
+                if (foundExact)
+                    ib.Ex_status = ImportedBookmark::S_AnalyzedExactExistent;
+                else //if (foundSimilar
+                    ib.Ex_status = ImportedBookmark::S_AnalyzedSimilarExistent;
+
+                ib.Ex_AlmostDuplicateExistentBIDs = existentAlmostDuplicateBIDs;
+                ib.Ex_DuplicateExistentComparedBID = duplicateBID;
+
+                continue; //These `if`s don't have `else`s, don't reach the parts after them that set them to ImportOK.
+            }
+        }
+
+        //If urls are not similar
+        ib.Ex_status = ImportedBookmark::S_AnalyzedImportOK;
+    }
+}
+
+void BookmarkImporter::FindDuplicate(const ImportedBookmark& ib, const QString& newAlmostExactDuplCheckURL,
+                                     const QList<long long>& almostDuplicateBIDs,
+                                     const QHash<long long, ExistentBookmark>& existentBookmarks,
                                      bool& foundSimilar, bool& foundExact, long long& duplicateBID)
 {
     foundSimilar = false;
     foundExact = false;
     duplicateBID = -1;
 
-    BookmarkManager::BookmarkData bdata;
-
     foreach (long long existentBID, almostDuplicateBIDs)
     {
-        bool retrieveSuccess = dbm->bms.RetrieveBookmark(existentBID, bdata);
-        if (!retrieveSuccess)
-            return false;
+        const ExistentBookmark& eb = existentBookmarks[existentBID];
 
         bool detailsMatch = false;
-        QStringList urls = Util::RemoveEmptyLinesAndTrim(bdata.URLs).split('\n');
-        QString newAlmostExactDuplCheckURL = GetURLForAlmostExactComparison(ib.uri);
-        foreach (const QString& existingURL, urls)
+        for (int u = 0; u < eb.urls.size(); u++)
         {
+            const QString& existingURL = eb.urls[u];
             detailsMatch = false; //If we get out of the inner loop without result, don't exit the outer loop.
-            QString existentAlmostExactDuplCheckURL = GetURLForAlmostExactComparison(existingURL);
-            if (newAlmostExactDuplCheckURL != existentAlmostExactDuplCheckURL)
+            if (newAlmostExactDuplCheckURL != eb.almostExactURLs[u])
                 continue; //Not even close, check the next URL.
 
             //Otherwise test for exactness:
@@ -531,7 +688,7 @@ bool BookmarkImporter::FindDuplicate(const ImportedBookmark& ib, const QList<lon
             //  assigned.
             //`.trimmed()` is necesessary, at least for `ib`.
             if (!ib.title.trimmed().isEmpty())
-                detailsMatch = detailsMatch && (ib.title.trimmed() == bdata.Name.trimmed());
+                detailsMatch = detailsMatch && (ib.title.trimmed() == eb.name);
 
             //Note: To generalize the code below, at least one of the guids of e.g Tagged bookmarks
             //  must match. Probably can't check with single-line if's.
@@ -546,7 +703,7 @@ bool BookmarkImporter::FindDuplicate(const ImportedBookmark& ib, const QList<lon
             //The isEmpty check makes sure we don't unnecessarily nag on a bookmark where user has
             //  added desctiptions themselves after previous import.
             if (!ib.description.trimmed().isEmpty())
-                detailsMatch = detailsMatch && (ib.description.trimmed() == bdata.Desc.trimmed());
+                detailsMatch = detailsMatch && (ib.description.trimmed() == eb.desc);
 
             detailsMatch = detailsMatch && (ib.uri == existingURL);
 
@@ -562,8 +719,6 @@ bool BookmarkImporter::FindDuplicate(const ImportedBookmark& ib, const QList<lon
         if (detailsMatch)
             break;
     }
-
-    return true;
 }
 
 QString BookmarkImporter::GetURLForFastComparison(const QString& originalUrl)
@@ -587,23 +742,3 @@ QString BookmarkImporter::extraInfoField(const QString& fieldName, const QList<B
             return exInfo.Value;
     return QString();
 }
-
-void BookmarkImporter::RemoveTempFileIfExists(const QString& filePathName)
-{
-    if (filePathName.isEmpty())
-        return;
-
-    QFile f(filePathName);
-    //`exists` return false if file is an existing symlink to a nonexisting file
-    if (!f.exists() && f.symLinkTarget().isEmpty())
-        return;
-
-    if (!f.remove())
-    {
-        QMessageBox::warning(
-                    m_dialogParent, "Error",
-                    QString("Could not remove the temporary saved page file \"%1\". "
-                            "Future errors might happen because of this.\nError: %2 %3")
-                    .arg(filePathName, QString::number(f.error()), f.errorString()));
-    }
-}
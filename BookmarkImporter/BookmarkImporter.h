@@ -1,11 +1,14 @@
 #pragma once
 #include "BookmarkImporter/ImportedEntity.h"
 #include "Database/DatabaseManager.h"
+#include "BookmarksBusinessLogic.h"
 
 #include <QString>
 #include <QHash>
 #include <QMultiHash>
 #include <QList>
+#include <QStringList>
+#include <QVector>
 
 /// This class first needs to initialized, then it should analyze the to-be-imported bookmarks
 ///     before really importing them. It should be re-initialized each time an import is going to
@@ -24,33 +27,72 @@
 class BookmarkImporter
 {
 private:
+    /// What is compared of an existing bookmark that has a similar URL to an imported one.
+    struct ExistentBookmark
+    {
+        QString name; //Trimmed
+        QString desc; //Trimmed
+        QStringList urls;
+        QStringList almostExactURLs;
+    };
+
+    /// Shared by the phases of `Analyze` that run in parallel. Items are by bookmark index.
+    struct AnalysisData
+    {
+        QVector<ImportedBookmark*> bookmarks;
+        QVector<QString> almostExactURLs; //Only for those having almost duplicates.
+        QVector<QList<long long> > almostDuplicateBIDs;
+        const QMultiHash<QString, long long>* existentBookmarksForUrl;
+        QHash<long long, ExistentBookmark> existentBookmarks; //Read-only while phases run.
+    };
+
+    typedef void (*AnalysisPhase)(AnalysisData& data, int begin, int end);
+    class AnalysisShardTask;
+    static const int AnalysisShardSize = 2048;
+    /// A batch is added earlier if the pages of its bookmarks take more memory than this.
+    static const qint64 MaxPendingImportDataSize = 64 * 1024 * 1024;
+
+    /// A bookmark whose adding is deferred until its batch is added.
+    struct PendingImport
+    {
+        ImportedBookmark* ib;
+        BookmarksBusinessLogic::NewBookmark nb;
+    };
+
     DatabaseManager* dbm;
     QWidget* m_dialogParent;
     QMultiHash<QString, long long> existentBookmarksForUrl;
-    QMap<int, int> folderItemsIndexInArray;
+    QHash<int, int> folderItemsIndexInArray;
 
     QList<long long> m_addedBIDs;
     QSet<long long> m_allAssociatedTIDs;
     QSet<ImportedBookmark*> m_failedProcessOrImports;
-    QString m_tempPath;
+    int m_importBatchSize;
+    QList<PendingImport> m_pendingImports;
+    qint64 m_pendingDataSize;
 
 public:
     BookmarkImporter(DatabaseManager* dbm, QWidget* dialogParent);
 
     //Initial init and analyzing functions.
     bool Initialize();
-    bool Analyze(ImportedEntityList& elist);
+    /// If `parallel` is true, the per-bookmark work is done on all cores; the result is the same.
+    bool Analyze(ImportedEntityList& elist, bool parallel = true);
 
     //Cumulative import function. Doesn't mark anything as failed.
     bool Import(ImportedEntityList& elist, QList<long long>& addedBIDs,
                 QSet<long long>& allAssociatedTIDs,
-                QList<ImportedBookmark*>& failedProcessOrImports);
+                QList<ImportedBookmark*>& failedProcessOrImports, int batchSize = 1);
 
     //Controlled one-by-one import functions. Use these.
     //Note: Marking an import as failed does not mean the bookmark was not imported. Maybe only its
     //  file saving was not successful. Calling MarkAsFailed twice on the same bookmark is safe.
-    bool InitializeImport();
-    bool ImportOne(const ImportedBookmark& ib, ImportedEntityList* elist);
+    /// If `batchSize` is more than 1, ImportOne only queues the bookmarks, and every `batchSize` of
+    ///   them are added together in a single transaction; FinalizeImport adds the remaining ones.
+    ///   If adding a batch fails, it is rolled back and its bookmarks are added one by one, and
+    ///   those that fail again are marked as failed.
+    bool InitializeImport(int batchSize = 1);
+    bool ImportOne(ImportedBookmark& ib, ImportedEntityList* elist);
     void MarkAsFailed(ImportedBookmark* ib);
     void FinalizeImport(QList<long long>& addedBIDs, QSet<long long>& allAssociatedTIDs,
                         QList<ImportedBookmark*>& failedProcessOrImports);
@@ -58,17 +100,27 @@ public:
 private:
     QString bookmarkTagAccordingToParentFolders(ImportedEntityList& elist, int bookmarkIndex);
 
+    /// Adds the bookmark in its own transaction.
+    bool ImportSingle(BookmarksBusinessLogic::NewBookmark& nb);
+    void ImportPendingBatch();
+
+    /// Runs `phase` over all bookmarks in `data`, in shards on a thread pool if `parallel` is true.
+    static void RunAnalysisPhase(AnalysisPhase phase, AnalysisData& data, bool parallel);
+    static void AnalyzeTitlesAndURLs(AnalysisData& data, int begin, int end);
+    static void AnalyzeExistentDuplicates(AnalysisData& data, int begin, int end);
+
     /// Both `title` and `desc` will be empty if there is no bracketed description in the title.
     /// Don't check for emptyness of just one of them, it might simply be an empty title with a
     ///   non-empty description, or vice versa!
-    void BreakTitleBracketedDescription(const QString& titleDesc, QString& title, QString& desc);
+    static void BreakTitleBracketedDescription(const QString& titleDesc, QString& title, QString& desc);
     /// Terminology: A 'duplicate' bookmark can be 'similar' or 'exact' duplicate of the imported bm.
-    bool FindDuplicate(const ImportedBookmark& ib, const QList<long long>& almostDuplicateBIDs,
-                       bool& foundSimilar, bool& foundExact, long long& duplicateBID);
-    QString GetURLForFastComparison(const QString& originalUrl);
-    QString GetURLForAlmostExactComparison(const QString& originalUrl);
+    /// All of `almostDuplicateBIDs` must be in `existentBookmarks`.
+    static void FindDuplicate(const ImportedBookmark& ib, const QString& newAlmostExactDuplCheckURL,
+                              const QList<long long>& almostDuplicateBIDs,
+                              const QHash<long long, ExistentBookmark>& existentBookmarks,
+                              bool& foundSimilar, bool& foundExact, long long& duplicateBID);
+    static QString GetURLForFastComparison(const QString& originalUrl);
+    static QString GetURLForAlmostExactComparison(const QString& originalUrl);
     /// Returns a null QString if extra infos don't contain the field.
     QString extraInfoField(const QString& fieldName, const QList<BookmarkManager::BookmarkExtraInfoData>& extraInfos);
-
-    void RemoveTempFileIfExists(const QString& filePathName);
 };
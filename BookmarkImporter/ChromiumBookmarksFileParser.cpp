@@ -0,0 +1,249 @@
+#include "ChromiumBookmarksFileParser.h"
+
+#include "Util/Util.h"
+
+#include <QFile>
+
+ChromiumBookmarksFileParser::ChromiumBookmarksFileParser(QWidget* dialogParent, Config* conf)
+    : IManager(dialogParent, conf), m_nextFolderId(0), m_nextBookmarkId(0)
+{
+
+}
+
+bool ChromiumBookmarksFileParser::ParseFile(const QString& bookmarksFilePath, ImportedEntityList& elist)
+{
+    QFile bookmarksFile(bookmarksFilePath);
+    if (!bookmarksFile.exists())
+        return Error("The specified file does not exist:\n" + bookmarksFilePath);
+
+    if (!bookmarksFile.open(QIODevice::ReadOnly))
+        return Error("Could not open the specified file:\n" + bookmarksFilePath + "\nThe error is:" +
+                     bookmarksFile.errorString());
+
+    //Same as FirefoxBookmarkJSONFileParser.
+    const qint64 fileSize = bookmarksFile.size();
+    QByteArray readData;
+    uchar* mappedData = (fileSize > 0 ? bookmarksFile.map(0, fileSize) : NULL);
+    if (mappedData != NULL)
+    {
+        m_jsonData = QByteArray::fromRawData((const char*)mappedData, fileSize);
+    }
+    else
+    {
+        readData = bookmarksFile.readAll();
+        m_jsonData = readData;
+    }
+
+    //Do it for caller.
+    elist.iblist.clear();
+    elist.ibflist.clear();
+
+    ImportedBookmarkFolder rootFolder;
+    rootFolder.title = "";
+    rootFolder.intId = 0;
+    rootFolder.intIndex = 0;
+    rootFolder.parentId = -1;
+    elist.ibflist.append(rootFolder);
+
+    m_nextFolderId = 1;
+    m_nextBookmarkId = 0;
+
+    JsonStreamReader reader(m_jsonData.constData(), m_jsonData.size());
+    bool success = true;
+    JsonStreamReader::TokenType token = reader.readNext();
+    if (token == JsonStreamReader::Invalid)
+        success = JsonError(reader);
+    else if (token != JsonStreamReader::StartObject)
+        success = Error("File format error: Root element is not an object.");
+
+    while (success)
+    {
+        token = reader.readNext();
+        if (token == JsonStreamReader::EndObject)
+            break;
+        if (token != JsonStreamReader::Name)
+        {
+            success = JsonError(reader);
+            break;
+        }
+
+        const QString memberName = reader.stringValue();
+        token = reader.readNext();
+        if (memberName == "roots" && token == JsonStreamReader::StartObject)
+            success = processRoots(reader, elist);
+        else if (!reader.skipCurrentValue()) //e.g checksum and version.
+            success = JsonError(reader);
+    }
+
+    if (success && reader.readNext() != JsonStreamReader::EndDocument)
+        success = JsonError(reader);
+
+    m_jsonData.clear(); //Before unmapping.
+    if (mappedData != NULL)
+        bookmarksFile.unmap(mappedData);
+    bookmarksFile.close();
+
+    return success;
+}
+
+bool ChromiumBookmarksFileParser::processRoots(JsonStreamReader& reader, ImportedEntityList& elist)
+{
+    int rootIndex = 0;
+    forever
+    {
+        JsonStreamReader::TokenType token = reader.readNext();
+        if (token == JsonStreamReader::EndObject)
+            return true;
+        if (token != JsonStreamReader::Name)
+            return JsonError(reader);
+
+        const QString rootName = reader.stringValue();
+        token = reader.readNext();
+        if (token == JsonStreamReader::StartObject)
+        {
+            if (!processNode(reader, elist, 0, rootIndex++, rootName))
+                return false;
+        }
+        else if (!reader.skipCurrentValue()) //Older versions had e.g sync_transaction_version here.
+        {
+            return JsonError(reader);
+        }
+    }
+}
+
+bool ChromiumBookmarksFileParser::processNode(JsonStreamReader& reader, ImportedEntityList& elist,
+                                              int parentId, int index, const QString& rootName)
+{
+    QString type, name, url, guid, dateAdded, dateModified;
+    int folderIndex = -1;
+    int folderId = -1;
+    const int iblistSizeBefore = elist.iblist.size();
+
+    forever
+    {
+        JsonStreamReader::TokenType token = reader.readNext();
+        if (token == JsonStreamReader::EndObject)
+            break;
+        if (token != JsonStreamReader::Name)
+            return JsonError(reader);
+
+        const QString memberName = reader.stringValue();
+        token = reader.readNext();
+        if (token == JsonStreamReader::String)
+        {
+            const QString& value = reader.stringValue();
+            if (memberName == "type")
+                type = value;
+            else if (memberName == "name")
+                name = value;
+            else if (memberName == "url")
+                url = value;
+            else if (memberName == "guid")
+                guid = value;
+            else if (memberName == "date_added")
+                dateAdded = value;
+            else if (memberName == "date_modified")
+                dateModified = value;
+        }
+        else if (token == JsonStreamReader::StartArray && memberName == "children" && folderIndex == -1)
+        {
+            //'children' comes before 'type' and the other members; reserve the folder's place
+            //  before its children, see the comments on the class.
+            folderIndex = elist.ibflist.size();
+            folderId = m_nextFolderId++;
+            elist.ibflist.append(ImportedBookmarkFolder());
+
+            for (int childIndex = 0; ; childIndex++)
+            {
+                token = reader.readNext();
+                if (token == JsonStreamReader::EndArray)
+                    break;
+                if (token == JsonStreamReader::Invalid)
+                    return JsonError(reader);
+                if (token != JsonStreamReader::StartObject)
+                    return Error(QString("File format error: children[%1] entry of a folder is not an object.")
+                                 .arg(childIndex));
+
+                if (!processNode(reader, elist, folderId, childIndex, QString()))
+                    return false;
+            }
+        }
+        else if (!reader.skipCurrentValue()) //e.g meta_info, or id which we don't use.
+        {
+            return JsonError(reader);
+        }
+    }
+
+    if (type == "folder")
+    {
+        if (folderIndex == -1)
+        {
+            folderIndex = elist.ibflist.size();
+            folderId = m_nextFolderId++;
+            elist.ibflist.append(ImportedBookmarkFolder());
+        }
+
+        ImportedBookmarkFolder& ibf = elist.ibflist[folderIndex];
+        ibf.title      = name;
+        ibf.guid       = guid;
+        ibf.root       = rootName;
+        ibf.intId      = folderId;
+        ibf.intIndex   = index;
+        ibf.parentId   = parentId;
+        ibf.dtAdded    = ChromiumTimeToDateTime(dateAdded);
+        ibf.dtModified = ChromiumTimeToDateTime(dateModified);
+        return true;
+    }
+
+    //Only folders have children; drop anything read from a 'children' attribute of other nodes.
+    if (folderIndex != -1)
+    {
+        while (elist.ibflist.size() > folderIndex)
+            elist.ibflist.removeLast();
+        while (elist.iblist.size() > iblistSizeBefore)
+            elist.iblist.removeLast();
+    }
+
+    if (type == "url")
+    {
+        ImportedBookmark ib;
+        ib.title      = name;
+        ib.uri        = url;
+        ib.guid       = guid;
+        ib.intId      = m_nextBookmarkId++;
+        ib.intIndex   = index;
+        ib.parentId   = parentId;
+        ib.dtAdded    = ChromiumTimeToDateTime(dateAdded);
+        ib.dtModified = ChromiumTimeToDateTime(dateModified);
+        elist.iblist.append(ib);
+    }
+    else
+    {
+        qDebug() << QString("Unknown bookmark node type '%1' for '%2'.").arg(type, name);
+    }
+
+    return true;
+}
+
+bool ChromiumBookmarksFileParser::JsonError(const JsonStreamReader& reader)
+{
+    if (!reader.hasError())
+        return false; //Error has already been shown.
+
+    const qint64 offset = reader.errorOffset();
+    int line, col;
+    Util::FindLineColumnForOffset(m_jsonData, offset, line, col);
+    return Error("Error while parsing JSON: " + reader.errorString() +
+                 QString("\nOffset %1, Line %2, Column %3").arg(offset).arg(line).arg(col));
+}
+
+QDateTime ChromiumBookmarksFileParser::ChromiumTimeToDateTime(const QString& chromiumTime)
+{
+    bool ok;
+    const long long microSecs = chromiumTime.toLongLong(&ok);
+    if (!ok || microSecs == 0)
+        return QDateTime();
+
+    const long long msecsFrom1601To1970 = 11644473600000LL;
+    return QDateTime::fromMSecsSinceEpoch(microSecs / 1000 - msecsFrom1601To1970, Qt::UTC);
+}
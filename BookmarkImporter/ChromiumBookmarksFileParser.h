@@ -0,0 +1,37 @@
+#pragma once
+#include "Database/IManager.h"
+#include "BookmarkImporter/ImportedEntity.h"
+#include "BookmarkImporter/JsonStreamReader.h"
+
+#include <QByteArray>
+
+/// Reads the `Bookmarks` file of a Chrome or Chromium profile. Like FirefoxBookmarkJSONFileParser
+///   the file is memory-mapped and read in one pass with a JsonStreamReader.
+/// A root folder with intId 0 is added first, like for imported URLs; Chromium's roots (bookmarks
+///   bar, other bookmarks, ...) are its children with their `root` set. Chromium's ids are not
+///   used; folders and bookmarks are numbered in the order they are read, and child folders come
+///   after their parents in `ibflist`.
+class ChromiumBookmarksFileParser : public IManager
+{
+private:
+    /// The mapped file, without copying. Used for finding error line and columns.
+    QByteArray m_jsonData;
+    int m_nextFolderId;
+    int m_nextBookmarkId;
+
+public:
+    ChromiumBookmarksFileParser(QWidget* dialogParent, Config* conf);
+
+    bool ParseFile(const QString& bookmarksFilePath, ImportedEntityList& elist);
+
+private:
+    bool processRoots(JsonStreamReader& reader, ImportedEntityList& elist);
+    /// The StartObject token must have been read; reads until its EndObject. `rootName` is only
+    ///   given for the roots.
+    bool processNode(JsonStreamReader& reader, ImportedEntityList& elist, int parentId,
+                     int index, const QString& rootName);
+
+    bool JsonError(const JsonStreamReader& reader);
+    /// Chromium stores times as strings of microseconds since 1601-01-01 UTC.
+    static QDateTime ChromiumTimeToDateTime(const QString& chromiumTime);
+};
@@ -4,14 +4,10 @@
 
 #include <QFile>
 #include <QFileInfo>
-
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
-#include <QJsonValue>
+#include <QProgressDialog>
 
 FirefoxBookmarkJSONFileParser::FirefoxBookmarkJSONFileParser(QWidget* dialogParent, Config* conf)
-    : IManager(dialogParent, conf)
+    : IManager(dialogParent, conf), m_progressDialog(NULL), m_objectsRead(0)
 {
 
 }
@@ -26,50 +22,126 @@ bool FirefoxBookmarkJSONFileParser::ParseFile(const QString& jsonFilePath, Impor
         return Error("Could not open the specified file:\n" + jsonFilePath + "\nThe error is:" +
                      jsonFile.errorString());
 
-    QByteArray jsonByteArray = jsonFile.readAll();
-    jsonFile.close();
-
-    QJsonParseError jsonParseError;
-    QJsonDocument doc = QJsonDocument::fromJson(jsonByteArray, &jsonParseError);
-
-    if (jsonParseError.error != QJsonParseError::NoError)
+    //Map the file instead of reading it all into memory; the OS pages it in as we go.
+    //  Mapping fails e.g for empty files; then just read it.
+    const qint64 fileSize = jsonFile.size();
+    QByteArray readData;
+    uchar* mappedData = (fileSize > 0 ? jsonFile.map(0, fileSize) : NULL);
+    if (mappedData != NULL)
     {
-        const int offset = jsonParseError.offset;
-        int line, col;
-        Util::FindLineColumnForOffset(jsonByteArray, offset, line, col);
-        return Error("Error while parsing JSON: " + jsonParseError.errorString() +
-                     QString("\nOffset %1, Line %2, Column %3").arg(offset).arg(line).arg(col));
+        m_jsonData = QByteArray::fromRawData((const char*)mappedData, fileSize);
+    }
+    else
+    {
+        readData = jsonFile.readAll();
+        m_jsonData = readData;
     }
-
-    if (!doc.isObject())
-        return Error("File format error: Root element is not an object.");
 
     //Do it for caller.
     elist.iblist.clear();
     elist.ibflist.clear();
 
-    bool success = processObject(doc.object(), elist);
+    //Only big files take long enough to need a progress dialog; it is shown after a few seconds.
+    QProgressDialog progressDialog("Reading bookmarks, please wait...", "Cancel",
+                                   0, int(m_jsonData.size() / 1024), dialogParent);
+    progressDialog.setWindowTitle("Importing Bookmarks");
+    progressDialog.setWindowModality(Qt::WindowModal);
+    m_progressDialog = &progressDialog;
+    m_objectsRead = 0;
+
+    JsonStreamReader reader(m_jsonData.constData(), m_jsonData.size());
+    bool success;
+    JsonStreamReader::TokenType token = reader.readNext();
+    if (token == JsonStreamReader::Invalid)
+        success = JsonError(reader);
+    else if (token != JsonStreamReader::StartObject)
+        success = Error("File format error: Root element is not an object.");
+    else
+        success = processObject(reader, elist);
+
+    if (success && reader.readNext() != JsonStreamReader::EndDocument)
+        success = JsonError(reader);
+
+    m_progressDialog = NULL;
+    m_jsonData.clear(); //Before unmapping.
+    if (mappedData != NULL)
+        jsonFile.unmap(mappedData);
+    jsonFile.close();
+
     return success;
 }
 
-bool FirefoxBookmarkJSONFileParser::processObject(const QJsonObject& obj, ImportedEntityList& elist)
+bool FirefoxBookmarkJSONFileParser::processObject(JsonStreamReader& reader, ImportedEntityList& elist)
 {
-    if (!obj.keys().contains("type"))
+    ParsedObject obj;
+    obj.nonObjectAnnoIndex = -1;
+    obj.folderIndex = -1;
+    const int iblistSizeBefore = elist.iblist.size();
+
+    forever
+    {
+        JsonStreamReader::TokenType token = reader.readNext();
+        if (token == JsonStreamReader::EndObject)
+            break;
+        if (token != JsonStreamReader::Name)
+            return JsonError(reader);
+
+        JsonField field;
+        field.name = reader.stringValue();
+        field.number = 0;
+        field.type = reader.readNext();
+
+        if (field.type == JsonStreamReader::StartArray && field.name == "children")
+        {
+            if (obj.folderIndex != -1)
+                return Error(QString("Duplicate children attribute for folder with id %1.")
+                             .arg(quickIdOf(obj.fields)));
+            if (!readChildren(reader, obj, elist))
+                return false;
+        }
+        else if (field.type == JsonStreamReader::StartArray && field.name == "annos")
+        {
+            //If repeated, the last one wins like other keys; see `findField`.
+            obj.annos.clear();
+            obj.nonObjectAnnoIndex = -1;
+            if (!readAnnos(reader, obj))
+                return false;
+        }
+        else if (!readFieldValue(reader, field))
+        {
+            return false;
+        }
+
+        obj.fields.append(field);
+    }
+
+    if (!UpdateProgress(reader))
+        return false;
+
+    const JsonField* typeField = findField(obj.fields, QLatin1String("type"));
+    if (typeField == NULL)
         return Error("File format error: Object does not have a 'type' key.");
 
-    QJsonValue typeValue = obj["type"];
-    if (!typeValue.isString())
+    if (typeField->type != JsonStreamReader::String)
         return Error("File format error: Object type is not a string.");
 
-    QString type = typeValue.toString();
+    const QString& type = typeField->string;
 
-    if (type == "text/x-moz-place")
+    if (type == "text/x-moz-place-container")
+        return processFolder(obj, elist);
+
+    //Only folders have children; drop anything read from a 'children' attribute of other objects.
+    if (obj.folderIndex != -1)
     {
-        return processBookmark(obj, elist);
+        while (elist.ibflist.size() > obj.folderIndex)
+            elist.ibflist.removeLast();
+        while (elist.iblist.size() > iblistSizeBefore)
+            elist.iblist.removeLast();
     }
-    else if (type == "text/x-moz-place-container")
+
+    if (type == "text/x-moz-place")
     {
-        return processFolder(obj, elist);
+        return processBookmark(obj, elist);
     }
     else if (type == "text/x-moz-place-separator")
     {
@@ -83,27 +155,119 @@ bool FirefoxBookmarkJSONFileParser::processObject(const QJsonObject& obj, Import
     return true;
 }
 
+bool FirefoxBookmarkJSONFileParser::readChildren(JsonStreamReader& reader, ParsedObject& obj,
+                                                 ImportedEntityList& elist)
+{
+    //Reserve the folder's place before its children, see the comments on the class.
+    obj.folderIndex = elist.ibflist.size();
+    elist.ibflist.append(ImportedBookmarkFolder());
+
+    for (int i = 0; ; i++)
+    {
+        JsonStreamReader::TokenType token = reader.readNext();
+        if (token == JsonStreamReader::EndArray)
+            return true;
+        if (token == JsonStreamReader::Invalid)
+            return JsonError(reader);
+
+        if (token != JsonStreamReader::StartObject)
+            return Error(QString("children[%1] entry for folder with id %2 is not an object.")
+                         .arg(QString::number(i), quickIdOf(obj.fields)));
+
+        if (!processObject(reader, elist))
+            return false;
+    }
+}
+
+bool FirefoxBookmarkJSONFileParser::readAnnos(JsonStreamReader& reader, ParsedObject& obj)
+{
+    for (int i = 0; ; i++)
+    {
+        JsonStreamReader::TokenType token = reader.readNext();
+        if (token == JsonStreamReader::EndArray)
+            return true;
+        if (token == JsonStreamReader::Invalid)
+            return JsonError(reader);
+
+        if (token == JsonStreamReader::StartObject)
+        {
+            JsonFields anno;
+            if (!readFields(reader, anno))
+                return false;
+            obj.annos.append(anno);
+        }
+        else
+        {
+            if (obj.nonObjectAnnoIndex == -1)
+                obj.nonObjectAnnoIndex = i;
+            if (!reader.skipCurrentValue())
+                return JsonError(reader);
+        }
+    }
+}
+
+bool FirefoxBookmarkJSONFileParser::readFields(JsonStreamReader& reader, JsonFields& fields)
+{
+    forever
+    {
+        JsonStreamReader::TokenType token = reader.readNext();
+        if (token == JsonStreamReader::EndObject)
+            return true;
+        if (token != JsonStreamReader::Name)
+            return JsonError(reader);
+
+        JsonField field;
+        field.name = reader.stringValue();
+        field.number = 0;
+        field.type = reader.readNext();
+        if (!readFieldValue(reader, field))
+            return false;
+
+        fields.append(field);
+    }
+}
+
+bool FirefoxBookmarkJSONFileParser::readFieldValue(JsonStreamReader& reader, JsonField& field)
+{
+    switch (field.type)
+    {
+    case JsonStreamReader::String:
+        field.string = reader.stringValue();
+        return true;
+    case JsonStreamReader::Number:
+        field.number = reader.numberValue();
+        return true;
+    case JsonStreamReader::Invalid:
+        return JsonError(reader);
+    default:
+        //Objects and arrays that we don't expect are skipped.
+        if (!reader.skipCurrentValue())
+            return JsonError(reader);
+        return true;
+    }
+}
+
 #define CHECK_AND_STORE_INTEGER(VARNAME,KEY) \
-    value = obj[KEY]; \
-    if (!value.isDouble()) \
+    field = findField(fields, QLatin1String(KEY)); \
+    if (field == NULL || field->type != JsonStreamReader::Number) \
         return Error(QString("Error in bookmark %1: Value of %2 field is not a number.") \
                      .arg(quickId, KEY)); \
-    VARNAME = value.toInt();
+    VARNAME = static_cast<int>(field->number);
 
 #define CHECK_AND_STORE_STRING(VARNAME,KEY) \
-    value = obj[KEY]; \
-    if (!value.isString()) \
+    field = findField(fields, QLatin1String(KEY)); \
+    if (field == NULL || field->type != JsonStreamReader::String) \
         return Error(QString("Error in bookmark %1: Value of %2 field is not a string.") \
                      .arg(quickId, KEY)); \
-    VARNAME = value.toString();
+    VARNAME = field->string;
 
 #define CHECK_AND_STORE_DTSTAMP(VARNAME,KEY) \
-    value = obj[KEY]; \
-    if (!value.isDouble()) \
+    field = findField(fields, QLatin1String(KEY)); \
+    if (field == NULL || field->type != JsonStreamReader::Number) \
         return Error(QString("Error in bookmark %1: Value of %2 field is not a number/date.") \
                      .arg(quickId, KEY)); \
-    /* We avoid integer overflow; we don't use value.toInt(); should use this way. */ \
-    VARNAME = QDateTime::fromMSecsSinceEpoch(static_cast<long long>(value.toDouble()));
+    /* We avoid integer overflow; we don't convert to int; should use this way. */ \
+    VARNAME = QDateTime::fromMSecsSinceEpoch(static_cast<long long>(field->number));
 
 #define STORE_IF_EXISTS_INTEGER(VARNAME, KEY, DEFVALUE) \
     if (keys.contains(KEY)) { CHECK_AND_STORE_INTEGER(VARNAME,KEY); } else VARNAME = DEFVALUE;
@@ -115,18 +279,20 @@ bool FirefoxBookmarkJSONFileParser::processObject(const QJsonObject& obj, Import
     if (keys.contains(KEY)) { CHECK_AND_STORE_DTSTAMP(VARNAME,KEY); } else VARNAME = DEFVALUE;
 
 
-bool FirefoxBookmarkJSONFileParser::processBookmark(const QJsonObject& obj, ImportedEntityList& elist)
+bool FirefoxBookmarkJSONFileParser::processBookmark(const ParsedObject& obj, ImportedEntityList& elist)
 {
+    const JsonFields& fields = obj.fields; //Required for the macros.
+
     QStringList requiredBookmarkKeys, otherBookmarkKeys;
     requiredBookmarkKeys << "title" << "id" << "parent" << "type" << "uri";
     otherBookmarkKeys << "index" << "guid" << "dateAdded" << "lastModified" << "annos" << "charset";
 
     //Case sensitive compare
-    QStringList keys = obj.keys();
+    QStringList keys = fieldNames(fields);
     UtilT::ListDifference(requiredBookmarkKeys, keys);
     UtilT::ListDifference(otherBookmarkKeys, keys); //To remove otherKeys entries from keys.
 
-    QString quickId = obj["id"].toString(); /* may not be empty */
+    QString quickId = quickIdOf(fields); /* may not be empty */
     if (requiredBookmarkKeys.length() > 0)
         return Error(QString("Required attributes don't exist for bookmark %1: %2")
                      .arg(quickId, requiredBookmarkKeys.join(", ")));
@@ -136,8 +302,8 @@ bool FirefoxBookmarkJSONFileParser::processBookmark(const QJsonObject& obj, Impo
         qDebug() << QString("Extra unknown attributes for bookmark %1: %2")
                     .arg(quickId, keys.join(", "));
 
-    QJsonValue value;
-    keys = obj.keys(); //Required for the macros.
+    const JsonField* field;
+    keys = fieldNames(fields); //Required for the macros.
 
     ImportedBookmark ib;
     CHECK_AND_STORE_STRING (ib.title     , "title"       );
@@ -153,18 +319,16 @@ bool FirefoxBookmarkJSONFileParser::processBookmark(const QJsonObject& obj, Impo
 
     if (keys.contains("annos"))
     {
-        if (!obj["annos"].isArray())
+        if (findField(fields, QLatin1String("annos"))->type != JsonStreamReader::StartArray)
             return Error(QString("'Annos' for bookmark with id %1 is not an array.").arg(quickId));
 
+        if (obj.nonObjectAnnoIndex != -1)
+            return Error(QString("An 'annos' entry for bookmark with id %1 is not an object.").arg(quickId));
+
         QString annoName, annoValue;
-        QJsonArray annos = obj["annos"].toArray();
-        for (int i = 0; i < annos.size(); i++)
+        for (int i = 0; i < obj.annos.size(); i++)
         {
-            if (!annos[i].isObject())
-                return Error(QString("An 'annos' entry for bookmark with id %1 is not an object.").arg(quickId));
-
-            const QJsonObject anno = annos[i].toObject();
-            if (!processAnno(anno, i, quickId, annoName, annoValue))
+            if (!processAnno(obj.annos[i], i, quickId, annoName, annoValue))
                 return false;
 
             if (annoName == "bookmarkProperties/description")
@@ -194,19 +358,21 @@ bool FirefoxBookmarkJSONFileParser::processBookmark(const QJsonObject& obj, Impo
     return true;
 }
 
-bool FirefoxBookmarkJSONFileParser::processFolder(const QJsonObject& obj, ImportedEntityList& elist)
+bool FirefoxBookmarkJSONFileParser::processFolder(const ParsedObject& obj, ImportedEntityList& elist)
 {
+    const JsonFields& fields = obj.fields; //Required for the macros.
+
     QStringList requiredFolderKeys, otherFolderKeys;
     requiredFolderKeys << "title" << "id" << "type" << "children";
     otherFolderKeys << "index" << "guid" << "parent" << "dateAdded" << "lastModified" << "annos"
                     << "root" << "livemark";
 
     //Case sensitive compare
-    QStringList keys = obj.keys();
+    QStringList keys = fieldNames(fields);
     UtilT::ListDifference(requiredFolderKeys, keys);
     UtilT::ListDifference(otherFolderKeys, keys); //To remove otherKeys entries from keys.
 
-    QString quickId = obj["id"].toString(); /* may not be empty */
+    QString quickId = quickIdOf(fields); /* may not be empty */
     if (requiredFolderKeys.length() > 0)
         return Error(QString("Required attributes don't exist for folder with id %1: %2")
                      .arg(quickId, requiredFolderKeys.join(", ")));
@@ -216,10 +382,14 @@ bool FirefoxBookmarkJSONFileParser::processFolder(const QJsonObject& obj, Import
         qDebug() << QString("Extra unknown attributes for folder with id %1: %2")
                     .arg(quickId, keys.join(", "));
 
-    QJsonValue value;
-    keys = obj.keys(); //Required for the macros.
+    //The children have already been read into elist; their folder's place was reserved before them.
+    if (obj.folderIndex == -1)
+        return Error(QString("Children attribute for folder with id %1 is not an array.").arg(quickId));
+
+    const JsonField* field;
+    keys = fieldNames(fields); //Required for the macros.
 
-    ImportedBookmarkFolder ibf;
+    ImportedBookmarkFolder& ibf = elist.ibflist[obj.folderIndex];
     CHECK_AND_STORE_STRING (ibf.title     , "title"       );
     CHECK_AND_STORE_INTEGER(ibf.intId     , "id"          );
 
@@ -232,19 +402,17 @@ bool FirefoxBookmarkJSONFileParser::processFolder(const QJsonObject& obj, Import
 
     if (keys.contains("annos"))
     {
-        if (!obj["annos"].isArray())
+        if (findField(fields, QLatin1String("annos"))->type != JsonStreamReader::StartArray)
             return Error(QString("'Annos' for folder with id %1 is not an array.").arg(quickId));
 
+        if (obj.nonObjectAnnoIndex != -1)
+            return Error(QString("annos[%1] entry for folder with id %2 is not an object.")
+                         .arg(QString::number(obj.nonObjectAnnoIndex), quickId));
+
         QString annoName, annoValue;
-        QJsonArray annos = obj["annos"].toArray();
-        for (int i = 0; i < annos.size(); i++)
+        for (int i = 0; i < obj.annos.size(); i++)
         {
-            if (!annos[i].isObject())
-                return Error(QString("annos[%1] entry for folder with id %2 is not an object.")
-                             .arg(QString::number(i), quickId));
-
-            const QJsonObject anno = annos[i].toObject();
-            if (!processAnno(anno, i, quickId, annoName, annoValue))
+            if (!processAnno(obj.annos[i], i, quickId, annoName, annoValue))
                 return false;
 
             if (annoName == "bookmarkProperties/description")
@@ -265,28 +433,11 @@ bool FirefoxBookmarkJSONFileParser::processFolder(const QJsonObject& obj, Import
         }
     }
 
-    elist.ibflist.append(ibf);
-
-    if (!obj["children"].isArray())
-        return Error(QString("Children attribute for folder with id %1 is not an array.").arg(quickId));
-
-    QJsonArray childrenArray = obj["children"].toArray();
-    for (int i = 0; i < childrenArray.size(); i++)
-    {
-        if (!childrenArray[i].isObject())
-            return Error(QString("children[%1] entry for folder with id %2 is not an object.")
-                         .arg(QString::number(i), quickId));
-
-        const QJsonObject child = childrenArray[i].toObject();
-        if (!processObject(child, elist))
-            return false;
-    }
-
     //qDebug() << "Encountered folder " << ibf.title;
     return true;
 }
 
-bool FirefoxBookmarkJSONFileParser::processAnno(const QJsonObject& obj, int annoIndex, const QString& quickId,
+bool FirefoxBookmarkJSONFileParser::processAnno(const JsonFields& fields, int annoIndex, const QString& quickId,
                                                 QString& annoName, QString& annoValue)
 {
     QStringList requiredAnnosKeys, otherAnnosKeys;
@@ -294,7 +445,7 @@ bool FirefoxBookmarkJSONFileParser::processAnno(const QJsonObject& obj, int anno
     otherAnnosKeys    << "flags" << "expires" << "mimeType" << "type";
 
     //Case sensitive compare.
-    QStringList keys = obj.keys();
+    QStringList keys = fieldNames(fields);
     UtilT::ListDifference(requiredAnnosKeys, keys);
     UtilT::ListDifference(otherAnnosKeys, keys);
 
@@ -307,14 +458,66 @@ bool FirefoxBookmarkJSONFileParser::processAnno(const QJsonObject& obj, int anno
         qDebug() << QString("Extra unknown attributes for annos[%1] of bookmark/folder with id %2: %3")
                     .arg(QString::number(annoIndex), quickId, keys.join(", "));
 
-    QJsonValue value;
+    const JsonField* field;
     CHECK_AND_STORE_STRING(annoName , "name" );
 
-    value = obj["value"];
-    if (value.isDouble())
-        annoValue = QString::number(value.toDouble(), 'g', 20);
+    field = findField(fields, QLatin1String("value"));
+    if (field->type == JsonStreamReader::Number)
+        annoValue = QString::number(field->number, 'g', 20);
     else
-        annoValue = value.toString();
+        annoValue = field->string; //Empty for non-strings.
 
     return true;
 }
+
+bool FirefoxBookmarkJSONFileParser::JsonError(const JsonStreamReader& reader)
+{
+    if (!reader.hasError())
+        return false; //Error has already been shown, or user cancelled.
+
+    const qint64 offset = reader.errorOffset();
+    int line, col;
+    Util::FindLineColumnForOffset(m_jsonData, offset, line, col);
+    return Error("Error while parsing JSON: " + reader.errorString() +
+                 QString("\nOffset %1, Line %2, Column %3").arg(offset).arg(line).arg(col));
+}
+
+bool FirefoxBookmarkJSONFileParser::UpdateProgress(const JsonStreamReader& reader)
+{
+    //Setting the value of a modal progress dialog processes events; don't do it for every object.
+    m_objectsRead++;
+    if (m_objectsRead % 512 != 0)
+        return true;
+
+    m_progressDialog->setValue(int(reader.tokenOffset() / 1024));
+    return !m_progressDialog->wasCanceled();
+}
+
+const FirefoxBookmarkJSONFileParser::JsonField*
+FirefoxBookmarkJSONFileParser::findField(const JsonFields& fields, QLatin1String name)
+{
+    //Objects have about 10 members, a linear search is fastest.
+    //Searched from the end, so that if a key is repeated the last one wins, like in QJsonDocument.
+    for (int i = fields.size() - 1; i >= 0; i--)
+        if (fields[i].name == name)
+            return &fields[i];
+    return NULL;
+}
+
+QStringList FirefoxBookmarkJSONFileParser::fieldNames(const JsonFields& fields)
+{
+    QStringList names;
+    foreach (const JsonField& field, fields)
+        names.append(field.name);
+    return names;
+}
+
+QString FirefoxBookmarkJSONFileParser::quickIdOf(const JsonFields& fields)
+{
+    const JsonField* idField = findField(fields, QLatin1String("id"));
+    if (idField == NULL)
+        return QString();
+    if (idField->type == JsonStreamReader::Number)
+        return QString::number(static_cast<long long>(idField->number));
+    return idField->string;
+}
@@ -1,29 +1,80 @@
 #pragma once
 #include "Database/IManager.h"
 #include "BookmarkImporter/ImportedEntity.h"
+#include "BookmarkImporter/JsonStreamReader.h"
 
+#include <QByteArray>
 #include <QList>
+#include <QVector>
 
-class QJsonObject;
+class QProgressDialog;
 
 /// IMPORTANT: The ARRAY INDEX of the child folders that this class generates is always BIGGER THAN
 ///   the array index of their parent folders. This is CRUCIAL for working of the other parts, which
 ///   ALWAYS simply use NESTED `for` loops for parent-child folder operations instead of recursive
 ///   functions.
+/// The file is memory-mapped and read in one pass with a JsonStreamReader; bookmarks and folders
+///   are appended to the entity list as soon as their objects end, so no DOM of the file is built.
 class FirefoxBookmarkJSONFileParser : public IManager
 {
+private:
+    /// A member of a JSON object. Only strings and numbers keep their values; for the others only
+    ///   the type is kept.
+    struct JsonField
+    {
+        QString name;
+        JsonStreamReader::TokenType type;
+        QString string;
+        double number;
+    };
+    typedef QVector<JsonField> JsonFields;
+
+    /// What is kept of a bookmark or folder object while reading it. Its children are not kept;
+    ///   they are added to the entity list while they are read.
+    struct ParsedObject
+    {
+        JsonFields fields;
+        QList<JsonFields> annos;
+        /// Index of the first 'annos' entry that is not an object, or -1.
+        int nonObjectAnnoIndex;
+        /// The folder's place in `ibflist`, reserved before reading its children so that it comes
+        ///   before them. -1 if the object had no 'children' array.
+        int folderIndex;
+    };
+
+    /// The mapped file, without copying. Used for finding error line and columns.
+    QByteArray m_jsonData;
+    QProgressDialog* m_progressDialog;
+    int m_objectsRead;
+
 public:
     FirefoxBookmarkJSONFileParser(QWidget* dialogParent, Config* conf);
 
+    /// Shows a progress dialog for big files. Returns false without showing an error if the user
+    ///   cancels it.
     bool ParseFile(const QString& jsonFilePath, ImportedEntityList& elist);
 
 private:
-    bool processObject(const QJsonObject& obj, ImportedEntityList& elist);
+    /// The StartObject token must have been read; reads until its EndObject.
+    bool processObject(JsonStreamReader& reader, ImportedEntityList& elist);
+    bool readChildren(JsonStreamReader& reader, ParsedObject& obj, ImportedEntityList& elist);
+    bool readAnnos(JsonStreamReader& reader, ParsedObject& obj);
+    bool readFields(JsonStreamReader& reader, JsonFields& fields);
+    /// The first token of the value must have been read.
+    bool readFieldValue(JsonStreamReader& reader, JsonField& field);
 
     /// We must be sure of `type` value before calling the following two functions.
-    bool processBookmark(const QJsonObject& obj, ImportedEntityList& elist);
-    bool processFolder(const QJsonObject& obj, ImportedEntityList& elist);
+    bool processBookmark(const ParsedObject& obj, ImportedEntityList& elist);
+    bool processFolder(const ParsedObject& obj, ImportedEntityList& elist);
 
-    bool processAnno(const QJsonObject& obj, int annoIndex, const QString& quickId,
+    bool processAnno(const JsonFields& fields, int annoIndex, const QString& quickId,
                      QString& annoName, QString& annoValue);
+
+    bool JsonError(const JsonStreamReader& reader);
+    /// Returns false if user cancelled.
+    bool UpdateProgress(const JsonStreamReader& reader);
+
+    static const JsonField* findField(const JsonFields& fields, QLatin1String name);
+    static QStringList fieldNames(const JsonFields& fields);
+    static QString quickIdOf(const JsonFields& fields);
 };
@@ -0,0 +1,187 @@
+#include "FirefoxPlacesFileParser.h"
+
+#include <QSet>
+#include <QUrl>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+
+FirefoxPlacesFileParser::FirefoxPlacesFileParser(QWidget* dialogParent, Config* conf)
+    : IManager(dialogParent, conf)
+{
+
+}
+
+bool FirefoxPlacesFileParser::ParseFile(const QString& placesFilePath, ImportedEntityList& elist)
+{
+    //Do it for caller.
+    elist.iblist.clear();
+    elist.ibflist.clear();
+
+    const QString connectionName = "FirefoxPlacesFileParser";
+    bool success;
+    {
+        QSqlDatabase placesDb = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        placesDb.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_OPEN_URI");
+        placesDb.setDatabaseName(QUrl::fromLocalFile(placesFilePath).toString(QUrl::FullyEncoded)
+                                 + "?immutable=1");
+
+        if (!placesDb.open())
+        {
+            success = Error("Could not open the Firefox bookmarks database:\n" + placesFilePath,
+                            placesDb.lastError());
+        }
+        else
+        {
+            success = ReadPlaces(placesDb, elist);
+            placesDb.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return success;
+}
+
+bool FirefoxPlacesFileParser::ReadPlaces(QSqlDatabase& placesDb, ImportedEntityList& elist)
+{
+    QHash<int, QString> itemDescriptions;
+    if (!ReadAnnotations(placesDb, "moz_items_annos", "item_id", "bookmarkProperties/description",
+                         itemDescriptions))
+        return false;
+
+    if (!ReadFolders(placesDb, itemDescriptions, elist))
+        return false;
+
+    return ReadBookmarks(placesDb, itemDescriptions, elist);
+}
+
+bool FirefoxPlacesFileParser::ReadFolders(QSqlDatabase& placesDb, const QHash<int, QString>& itemDescriptions,
+                                          ImportedEntityList& elist)
+{
+    //Same names as the `root` attributes of the JSON backups.
+    QHash<QString, QString> rootNamesByGuid;
+    rootNamesByGuid["root________"] = "placesRoot";
+    rootNamesByGuid["menu________"] = "bookmarksMenuFolder";
+    rootNamesByGuid["toolbar_____"] = "toolbarFolder";
+    rootNamesByGuid["tags________"] = "tagsFolder";
+    rootNamesByGuid["unfiled_____"] = "unfiledBookmarksFolder";
+    rootNamesByGuid["mobile______"] = "mobileFolder";
+
+    //type 2 is TYPE_FOLDER.
+    QSqlQuery query(placesDb);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT id, parent, position, title, guid, dateAdded, lastModified "
+                    "FROM moz_bookmarks WHERE type = 2 ORDER BY parent, position"))
+        return Error("Could not read folders from the Firefox bookmarks database.", query.lastError());
+
+    QList<ImportedBookmarkFolder> folders;
+    QHash<int, QList<int> > childFolderIndexes; //Indexes into `folders`, by parent id.
+    QSet<int> folderIds;
+    while (query.next())
+    {
+        ImportedBookmarkFolder ibf;
+        ibf.intId      = query.value(0).toInt();
+        ibf.parentId   = query.value(1).toInt();
+        ibf.intIndex   = query.value(2).toInt();
+        ibf.title      = query.value(3).toString();
+        ibf.guid       = query.value(4).toString();
+        //Same as the JSON parser, which stores these PRTime values as is.
+        ibf.dtAdded    = QDateTime::fromMSecsSinceEpoch(query.value(5).toLongLong());
+        ibf.dtModified = QDateTime::fromMSecsSinceEpoch(query.value(6).toLongLong());
+        ibf.root       = rootNamesByGuid.value(ibf.guid);
+        ibf.description = itemDescriptions.value(ibf.intId);
+
+        childFolderIndexes[ibf.parentId].append(folders.size());
+        folderIds.insert(ibf.intId);
+        folders.append(ibf);
+    }
+
+    //Add the folders breadth-first from the root, so that child folders come after their parents.
+    //  The root's parent is 0. Folders whose parent is missing are added as roots too, rather
+    //  than losing them and their bookmarks.
+    QList<int> queue;
+    for (int i = 0; i < folders.size(); i++)
+        if (!folderIds.contains(folders[i].parentId))
+            queue.append(i);
+
+    for (int q = 0; q < queue.size(); q++)
+    {
+        const ImportedBookmarkFolder& ibf = folders[queue[q]];
+        elist.ibflist.append(ibf);
+        queue.append(childFolderIndexes.value(ibf.intId));
+    }
+
+    return true;
+}
+
+bool FirefoxPlacesFileParser::ReadBookmarks(QSqlDatabase& placesDb, const QHash<int, QString>& itemDescriptions,
+                                            ImportedEntityList& elist)
+{
+    QHash<int, QString> pageCharsets;
+    if (!ReadAnnotations(placesDb, "moz_annos", "place_id", "URIProperties/characterSet", pageCharsets))
+        return false;
+
+    QSet<int> importedFolderIds;
+    foreach (const ImportedBookmarkFolder& ibf, elist.ibflist)
+        importedFolderIds.insert(ibf.intId);
+
+    //type 1 is TYPE_BOOKMARK.
+    QSqlQuery query(placesDb);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT b.id, b.parent, b.position, b.title, b.guid, b.dateAdded, b.lastModified, "
+                    "p.id, p.url FROM moz_bookmarks b JOIN moz_places p ON p.id = b.fk "
+                    "WHERE b.type = 1 ORDER BY b.parent, b.position"))
+        return Error("Could not read bookmarks from the Firefox bookmarks database.", query.lastError());
+
+    while (query.next())
+    {
+        ImportedBookmark ib;
+        ib.intId      = query.value(0).toInt();
+        ib.parentId   = query.value(1).toInt();
+        ib.intIndex   = query.value(2).toInt();
+        ib.title      = query.value(3).toString();
+        ib.guid       = query.value(4).toString();
+        ib.dtAdded    = QDateTime::fromMSecsSinceEpoch(query.value(5).toLongLong());
+        ib.dtModified = QDateTime::fromMSecsSinceEpoch(query.value(6).toLongLong());
+        ib.charset    = pageCharsets.value(query.value(7).toInt());
+        ib.uri        = query.value(8).toString();
+        ib.description = itemDescriptions.value(ib.intId);
+
+        if (!importedFolderIds.contains(ib.parentId))
+            continue;
+
+        //Don't import firefox's special bookmarks
+        const QString uriLeft = ib.uri.left(6);
+        if (uriLeft == "place:" || uriLeft == "about:")
+            continue;
+
+        elist.iblist.append(ib);
+    }
+
+    return true;
+}
+
+bool FirefoxPlacesFileParser::ReadAnnotations(QSqlDatabase& placesDb, const QString& annosTable,
+                                              const QString& idColumn, const QString& name,
+                                              QHash<int, QString>& annotations)
+{
+    //Do it for caller.
+    annotations.clear();
+
+    if (!placesDb.tables().contains(annosTable))
+        return true;
+
+    QSqlQuery query(placesDb);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT a.%1, a.content FROM %2 a "
+                          "JOIN moz_anno_attributes n ON n.id = a.anno_attribute_id WHERE n.name = ?")
+                  .arg(idColumn, annosTable));
+    query.addBindValue(name);
+
+    if (!query.exec())
+        return Error("Could not read annotations from the Firefox bookmarks database.", query.lastError());
+
+    while (query.next())
+        annotations[query.value(0).toInt()] = query.value(1).toString();
+
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Database/IManager.h"
+#include "BookmarkImporter/ImportedEntity.h"
+
+#include <QHash>
+
+class QSqlDatabase;
+
+/// Reads bookmarks directly from a Firefox profile's `places.sqlite`, so the user doesn't need to
+///   export a JSON backup first. Produces the same entities as FirefoxBookmarkJSONFileParser, with
+///   the same guarantee that child folders come after their parents in `ibflist`.
+/// The database is opened read-only with `immutable=1`, so it can be read while Firefox has it
+///   open and locked. In that case changes that Firefox has not checkpointed from its WAL file yet
+///   are not seen; closing Firefox first gives a complete import.
+class FirefoxPlacesFileParser : public IManager
+{
+public:
+    FirefoxPlacesFileParser(QWidget* dialogParent, Config* conf);
+
+    bool ParseFile(const QString& placesFilePath, ImportedEntityList& elist);
+
+private:
+    bool ReadPlaces(QSqlDatabase& placesDb, ImportedEntityList& elist);
+    bool ReadFolders(QSqlDatabase& placesDb, const QHash<int, QString>& itemDescriptions,
+                     ImportedEntityList& elist);
+    bool ReadBookmarks(QSqlDatabase& placesDb, const QHash<int, QString>& itemDescriptions,
+                       ImportedEntityList& elist);
+    /// Returns `name`d annotations of items or pages, keyed by their id. Newer Firefox versions
+    ///   don't have the annotation tables anymore, then it returns an empty hash.
+    bool ReadAnnotations(QSqlDatabase& placesDb, const QString& annosTable, const QString& idColumn,
+                         const QString& name, QHash<int, QString>& annotations);
+};
@@ -9,11 +9,15 @@
 #include <QMetaMethod>
 
 ImportedBookmarkProcessor::ImportedBookmarkProcessor(BookmarkImporter* bmim, ImportedEntityList* elist,
-                                                     QObject *parent)
+                                                     PageFetchScheduler* fetchScheduler,
+                                                     ResourceCache* resourceCache, QObject *parent)
     : QObject(parent), m_isProcessing(false), m_bmim(bmim), m_elist(elist), m_ib(NULL)
 {
     m_mhtSaver = new MHTSaver(this);
     m_mhtSaver->setOverallTimeoutTime(300); //5 minutes
+    if (fetchScheduler != NULL)
+        m_mhtSaver->setFetchScheduler(fetchScheduler);
+    m_mhtSaver->setResourceCache(resourceCache);
     connect(m_mhtSaver, SIGNAL(MHTDataReady(QByteArray,MHTSaver::Status)),
             this, SLOT(PageRetrieved(QByteArray,MHTSaver::Status)));
 }
@@ -61,7 +65,8 @@ void ImportedBookmarkProcessor::BeginProcess()
 {
     AddMetaData();
 
-    if (m_elist->importSource == ImportedEntityList::Source_Urls || m_elist->importSource == ImportedEntityList::Source_Firefox)
+    if (m_elist->importSource == ImportedEntityList::Source_Urls || m_elist->importSource == ImportedEntityList::Source_Firefox ||
+        m_elist->importSource == ImportedEntityList::Source_Chromium)
         RetrievePage();
     else if (m_elist->importSource == ImportedEntityList::Source_Files)
         Import(); //SetBookmarkTitle() is not needed in this case, title is already a non-empty string
@@ -154,6 +159,37 @@ void ImportedBookmarkProcessor::AddMetaData()
         exInfo.Value = QString::number(m_ib->dtModified.toMSecsSinceEpoch());
         m_ib->ExPr_ExtraInfosList.append(exInfo);
     }
+    else if (m_elist->importSource == ImportedEntityList::Source_Chromium)
+    {
+        exInfo.Name = "bm: imported from";
+        exInfo.Type = ExInfoData::Type_Text;
+        exInfo.Value = "chromium";
+        m_ib->ExPr_ExtraInfosList.append(exInfo);
+
+        if (!m_elist->importSourceProfile.isEmpty())
+        {
+            exInfo.Name = "chromium: profile name";
+            exInfo.Type = ExInfoData::Type_Text;
+            exInfo.Value = m_elist->importSourceProfile;
+            m_ib->ExPr_ExtraInfosList.append(exInfo);
+        }
+
+        if (!m_ib->guid.isEmpty())
+        {
+            exInfo.Name = "chromium: guid";
+            exInfo.Type = ExInfoData::Type_Text;
+            exInfo.Value = m_ib->guid;
+            m_ib->ExPr_ExtraInfosList.append(exInfo);
+        }
+
+        if (m_ib->dtAdded.isValid())
+        {
+            exInfo.Name = "chromium: date added";
+            exInfo.Type = ExInfoData::Type_Number;
+            exInfo.Value = QString::number(m_ib->dtAdded.toMSecsSinceEpoch());
+            m_ib->ExPr_ExtraInfosList.append(exInfo);
+        }
+    }
 }
 
 void ImportedBookmarkProcessor::RetrievePage()
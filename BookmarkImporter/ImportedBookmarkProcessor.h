@@ -6,6 +6,8 @@
 #include <QElapsedTimer>
 
 class BookmarkImporter;
+class PageFetchScheduler;
+class ResourceCache;
 struct ImportedBookmark;
 struct ImportedEntityList;
 
@@ -25,7 +27,9 @@ private:
     QElapsedTimer m_elapsedTimer;
 
 public:
+    /// `fetchScheduler` and `resourceCache` are shared by all processors of an import; they can be NULL.
     explicit ImportedBookmarkProcessor(BookmarkImporter* bmim, ImportedEntityList* elist,
+                                       PageFetchScheduler* fetchScheduler, ResourceCache* resourceCache,
                                        QObject *parent = 0);
     ~ImportedBookmarkProcessor();
 
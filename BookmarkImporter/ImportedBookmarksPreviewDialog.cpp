@@ -39,7 +39,7 @@ ImportedBookmarksPreviewDialog::ImportedBookmarksPreviewDialog(DatabaseManager*
     connect(ui->chkImportBookmark, SIGNAL(toggled(bool)), ui->leTagsForBookmark, SLOT(setEnabled(bool)));
     connect(ui->chkImportFolder  , SIGNAL(toggled(bool)), ui->leTagsForFolder  , SLOT(setEnabled(bool)));
 
-    m_bookmarksProcessor = new ImportedBookmarksProcessor(dbm->conf->concurrentBookmarkProcessings, bmim, this, this);
+    m_bookmarksProcessor = new ImportedBookmarksProcessor(dbm->conf, bmim, this, this);
     connect(m_bookmarksProcessor, SIGNAL(ProcessingDone()), this, SLOT(ProcessingDone()));
     connect(m_bookmarksProcessor, SIGNAL(ProcessingCanceled()), this, SLOT(ProcessingCanceled()));
     connect(m_bookmarksProcessor, SIGNAL(ImportedBookmarkProcessed(ImportedBookmark*,bool)),
@@ -400,8 +400,9 @@ void ImportedBookmarksPreviewDialog::AddItems()
         folderItems[ibf.intId] = twi;
         index++;
 
-        //On Firefox, files and Urls, don't add or show the root folder.
+        //On Firefox, Chromium, files and Urls, don't add or show the root folder.
         if (ibf.intId == rootFolderIntId && (elist->importSource == ImportedEntityList::Source_Firefox ||
+                                             elist->importSource == ImportedEntityList::Source_Chromium ||
                                              elist->importSource == ImportedEntityList::Source_Files ||
                                              elist->importSource == ImportedEntityList::Source_Urls))
             continue;
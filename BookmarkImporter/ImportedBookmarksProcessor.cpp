@@ -2,14 +2,23 @@
 
 #include "ImportedBookmarkProcessor.h"
 #include "BookmarkImporter/ImportedEntity.h"
+#include "Config.h"
+#include "PageFetchScheduler.h"
+#include "ResourceCache.h"
+#include "Util/Util.h"
 
+#include <QDebug>
 #include <QProgressDialog>
+#include <QStandardPaths>
 
-ImportedBookmarksProcessor::ImportedBookmarksProcessor(int processorCount, BookmarkImporter* bmim,
+ImportedBookmarksProcessor::ImportedBookmarksProcessor(Config* conf, BookmarkImporter* bmim,
                                                        QWidget* dialogParent, QObject *parent)
-    : QObject(parent), m_processorCount(processorCount), m_dialogParent(dialogParent), m_bmim(bmim)
+    : QObject(parent), conf(conf), m_processorCount(conf->concurrentBookmarkProcessings)
+    , m_dialogParent(dialogParent), m_bmim(bmim)
 {
     m_isProcessing = false;
+    m_fetchScheduler = NULL;
+    m_resourceCache = NULL;
 }
 
 bool ImportedBookmarksProcessor::BeginProcessing(ImportedEntityList* elist)
@@ -30,9 +39,15 @@ bool ImportedBookmarksProcessor::BeginProcessing(ImportedEntityList* elist)
     m_progressDialog->show();
     connect(m_progressDialog, SIGNAL(canceled()), this, SLOT(Cancel()));
 
+    m_fetchScheduler = new PageFetchScheduler(conf->maxConcurrentPageFetches, conf->maxPageFetchesPerHost, this);
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                       + "/" + conf->resourceCacheDirName;
+    m_resourceCache = new ResourceCache(cacheDir, conf->resourceCacheMaxMemoryMB,
+                                        conf->resourceCacheMaxDiskMB, this);
     for (int i = 0; i < m_processorCount; i++)
     {
-        ImportedBookmarkProcessor* bookmarkProcessor = new ImportedBookmarkProcessor(m_bmim, m_elist, this);
+        ImportedBookmarkProcessor* bookmarkProcessor = new ImportedBookmarkProcessor(
+                    m_bmim, m_elist, m_fetchScheduler, m_resourceCache, this);
         connect(bookmarkProcessor, SIGNAL(ImportedBookmarkProcessed(int,bool)),
                 this, SLOT(BookmarkProcessed(int,bool)));
         m_bookmarkProcessors.append(bookmarkProcessor);
@@ -74,8 +89,12 @@ void ImportedBookmarksProcessor::BookmarkProcessed(int id, bool successful)
     m_processedCount += 1;
     ImportedBookmark* lastProcessedIB = m_bookmarkProcessors[id]->lastProcessedImportedBookmark();
     QString resultStr = (successful ? "Imported" : "Import was not successful");
-    m_progressDialog->setLabelText(QString("%1:<br/>\n<strong>%2</strong><br/>\n(%3)")
-                                   .arg(resultStr, lastProcessedIB->title, lastProcessedIB->uri));
+    PageFetchScheduler::Stats fetchStats = m_fetchScheduler->stats();
+    QString fetchStatsStr = QString("Downloading %1 files (%2 waiting) at %3/s")
+                            .arg(fetchStats.activeFetches).arg(fetchStats.queuedFetches)
+                            .arg(Util::UserReadableFileSize((long long)fetchStats.bytesPerSecond));
+    m_progressDialog->setLabelText(QString("%1:<br/>\n<strong>%2</strong><br/>\n(%3)<br/>\n%4")
+                                   .arg(resultStr, lastProcessedIB->title, lastProcessedIB->uri, fetchStatsStr));
     m_progressDialog->setValue(m_processedCount);
     emit ImportedBookmarkProcessed(lastProcessedIB, successful);
 
@@ -134,4 +153,19 @@ void ImportedBookmarksProcessor::CleanUp()
     for (int i = 0; i < m_processorCount; i++)
         m_bookmarkProcessors[i]->deleteLater();
     m_bookmarkProcessors.clear();
+
+    //Deferred deletes happen in order, so the processors' fetches are gone before the scheduler.
+    PageFetchScheduler::Stats fetchStats = m_fetchScheduler->stats();
+    qDebug() << "Page fetches:" << fetchStats.finishedFetches << "finished," << fetchStats.failedFetches
+             << "failed," << fetchStats.timedOutFetches << "timed out," << fetchStats.maxActiveFetches
+             << "at most at once.";
+    m_fetchScheduler->deleteLater();
+    m_fetchScheduler = NULL;
+
+    ResourceCache::Stats cacheStats = m_resourceCache->stats();
+    qDebug() << "Resource cache:" << cacheStats.hits << "hits," << cacheStats.revalidations
+             << "revalidated," << cacheStats.stores << "stored (" << cacheStats.sharedContents
+             << "with shared contents )," << Util::UserReadableFileSize(cacheStats.bytesSaved) << "saved.";
+    m_resourceCache->deleteLater(); //Writes its index.
+    m_resourceCache = NULL;
 }
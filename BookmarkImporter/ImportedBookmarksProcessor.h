@@ -2,10 +2,13 @@
 #include <QObject>
 
 class QProgressDialog;
+class Config;
 class BookmarkImporter;
 struct ImportedBookmark;
 struct ImportedEntityList;
 class ImportedBookmarkProcessor;
+class PageFetchScheduler;
+class ResourceCache;
 
 class ImportedBookmarksProcessor : public QObject
 {
@@ -13,6 +16,7 @@ class ImportedBookmarksProcessor : public QObject
 
 private:
     bool m_isProcessing;
+    Config* conf;
     const int m_processorCount;
     QWidget* m_dialogParent;
 
@@ -23,10 +27,14 @@ private:
     int m_nextProcessIndex;
 
     QList<ImportedBookmarkProcessor*> m_bookmarkProcessors;
+    PageFetchScheduler* m_fetchScheduler;
+    ResourceCache* m_resourceCache;
     QProgressDialog* m_progressDialog;
 
 public:
-    explicit ImportedBookmarksProcessor(int processorCount, BookmarkImporter* bmim,
+    /// The pages of all the processors are fetched through one PageFetchScheduler and share one
+    ///   ResourceCache, configured by `conf`.
+    explicit ImportedBookmarksProcessor(Config* conf, BookmarkImporter* bmim,
                                         QWidget* dialogParent, QObject *parent = 0);
 
 public slots:
@@ -17,7 +17,8 @@ struct ImportedBookmark
     }
 
     //== Data directly from import ============================================
-    //  Inserted by e.g FirefoxBookmarkJSONFileParser
+    //  Inserted by e.g FirefoxBookmarkJSONFileParser, FirefoxPlacesFileParser and
+    //  ChromiumBookmarksFileParser
 
     QString title;
     QString guid;
@@ -105,7 +106,7 @@ struct ImportedEntityList
 
     long long importFOID;
 
-    enum ImportSource { Source_Urls, Source_Files, Source_Firefox };
+    enum ImportSource { Source_Urls, Source_Files, Source_Firefox, Source_Chromium };
     ImportSource importSource;
     QString importSourceProfile;
     QString importSourceFileName;
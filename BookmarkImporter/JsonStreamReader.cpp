@@ -0,0 +1,375 @@
+#include "JsonStreamReader.h"
+
+#include <QByteArray>
+
+#include <cstring>
+
+JsonStreamReader::JsonStreamReader(const char* data, qint64 size)
+    : m_begin(data), m_end(data + size), m_pos(data), m_state(S_ExpectValue)
+    , m_tokenType(NoToken), m_tokenStart(data), m_number(0), m_bool(false), m_errorPos(data)
+{
+    //Skip UTF-8 BOM if present.
+    if (size >= 3 && (uchar)data[0] == 0xEF && (uchar)data[1] == 0xBB && (uchar)data[2] == 0xBF)
+        m_pos += 3;
+}
+
+JsonStreamReader::TokenType JsonStreamReader::readNext()
+{
+    if (m_tokenType == Invalid || m_tokenType == EndDocument)
+        return m_tokenType;
+
+    SkipWhitespace();
+    const bool inObject = (!m_containerStack.isEmpty() && m_containerStack.last());
+
+    if (m_state == S_ExpectCommaOrClose && m_pos < m_end && *m_pos == ',')
+    {
+        m_pos++;
+        m_state = (inObject ? S_ExpectName : S_ExpectValue);
+        SkipWhitespace();
+    }
+
+    m_tokenStart = m_pos;
+    if (m_pos == m_end)
+    {
+        if (m_state == S_ExpectEnd)
+            return (m_tokenType = EndDocument);
+        return SetError("Unexpected end of file.", m_pos);
+    }
+
+    const char c = *m_pos;
+    if (m_state == S_ExpectEnd)
+        return SetError("Unexpected data after the root value.", m_pos);
+
+    if (m_state == S_ExpectCommaOrClose || m_state == S_ExpectValueOrClose ||
+        m_state == S_ExpectNameOrClose)
+    {
+        if (c == '}' || c == ']')
+        {
+            if (m_containerStack.last() != (c == '}'))
+                return SetError("Mismatched closing bracket.", m_pos);
+
+            m_containerStack.removeLast();
+            m_pos++;
+            ValueRead();
+            return (m_tokenType = (c == '}' ? EndObject : EndArray));
+        }
+        if (m_state == S_ExpectCommaOrClose)
+            return SetError(inObject ? "Expected ',' or '}'." : "Expected ',' or ']'.", m_pos);
+    }
+
+    if (m_state == S_ExpectName || m_state == S_ExpectNameOrClose)
+    {
+        if (c != '"')
+            return SetError("Expected a member name string.", m_pos);
+        if (!ReadString())
+            return Invalid;
+
+        SkipWhitespace();
+        if (m_pos == m_end || *m_pos != ':')
+            return SetError("Expected ':' after member name.", m_pos);
+        m_pos++;
+
+        m_state = S_ExpectValue;
+        return (m_tokenType = Name);
+    }
+
+    //A value is expected.
+    switch (c)
+    {
+    case '{':
+        m_containerStack.append(true);
+        m_pos++;
+        m_state = S_ExpectNameOrClose;
+        return (m_tokenType = StartObject);
+
+    case '[':
+        m_containerStack.append(false);
+        m_pos++;
+        m_state = S_ExpectValueOrClose;
+        return (m_tokenType = StartArray);
+
+    case '"':
+        if (!ReadString())
+            return Invalid;
+        ValueRead();
+        return (m_tokenType = String);
+
+    case 't':
+        if (!ReadLiteral("true", 4))
+            return Invalid;
+        m_bool = true;
+        ValueRead();
+        return (m_tokenType = Bool);
+
+    case 'f':
+        if (!ReadLiteral("false", 5))
+            return Invalid;
+        m_bool = false;
+        ValueRead();
+        return (m_tokenType = Bool);
+
+    case 'n':
+        if (!ReadLiteral("null", 4))
+            return Invalid;
+        ValueRead();
+        return (m_tokenType = Null);
+
+    default:
+        if (c != '-' && (c < '0' || c > '9'))
+            return SetError(QString("Unexpected character '%1'.").arg(QChar((uchar)c)), m_pos);
+        if (!ReadNumber())
+            return Invalid;
+        ValueRead();
+        return (m_tokenType = Number);
+    }
+}
+
+bool JsonStreamReader::skipCurrentValue()
+{
+    if (m_tokenType != StartObject && m_tokenType != StartArray)
+        return !hasError();
+
+    int depth = 1;
+    while (depth > 0)
+    {
+        switch (readNext())
+        {
+        case StartObject:
+        case StartArray:
+            depth++;
+            break;
+        case EndObject:
+        case EndArray:
+            depth--;
+            break;
+        case Invalid:
+            return false;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+qint64 JsonStreamReader::errorOffset() const
+{
+    if (m_tokenType == Invalid)
+        return m_errorPos - m_begin;
+    return m_pos - m_begin;
+}
+
+JsonStreamReader::TokenType JsonStreamReader::SetError(const QString& errorString, const char* pos)
+{
+    m_errorString = errorString;
+    m_errorPos = pos;
+    return (m_tokenType = Invalid);
+}
+
+void JsonStreamReader::SkipWhitespace()
+{
+    while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+        m_pos++;
+}
+
+bool JsonStreamReader::ReadString()
+{
+    //m_pos is at the opening quote.
+    const char* p = m_pos + 1;
+    const char* runStart = p;
+
+    //Fast path: Most strings don't have any escapes and are converted all at once.
+    while (p < m_end && *p != '"' && *p != '\\' && (uchar)*p >= 0x20)
+        p++;
+
+    if (p < m_end && *p == '"')
+    {
+        m_string = QString::fromUtf8(runStart, p - runStart);
+        m_pos = p + 1;
+        return true;
+    }
+
+    //Runs are only broken at ASCII characters, so no UTF-8 sequence is split between two runs.
+    QString result = QString::fromUtf8(runStart, p - runStart);
+    forever
+    {
+        if (p == m_end)
+        {
+            SetError("Unterminated string.", m_pos);
+            return false;
+        }
+
+        const char c = *p;
+        if (c == '"')
+            break;
+
+        if ((uchar)c < 0x20)
+        {
+            SetError("Control character in string.", p);
+            return false;
+        }
+
+        if (c != '\\')
+        {
+            runStart = p;
+            while (p < m_end && *p != '"' && *p != '\\' && (uchar)*p >= 0x20)
+                p++;
+            result += QString::fromUtf8(runStart, p - runStart);
+            continue;
+        }
+
+        //An escape sequence
+        const char* escapeStart = p;
+        p++;
+        if (p == m_end)
+            continue; //Reports unterminated string.
+
+        switch (*p)
+        {
+        case '"':  result += QChar('"');  break;
+        case '\\': result += QChar('\\'); break;
+        case '/':  result += QChar('/');  break;
+        case 'b':  result += QChar('\b'); break;
+        case 'f':  result += QChar('\f'); break;
+        case 'n':  result += QChar('\n'); break;
+        case 'r':  result += QChar('\r'); break;
+        case 't':  result += QChar('\t'); break;
+        case 'u':
+        {
+            if (m_end - p < 5)
+            {
+                SetError("Invalid unicode escape sequence.", escapeStart);
+                return false;
+            }
+
+            ushort codeUnit = 0;
+            for (int i = 1; i <= 4; i++)
+            {
+                const char h = p[i];
+                codeUnit <<= 4;
+                if (h >= '0' && h <= '9')
+                    codeUnit |= h - '0';
+                else if (h >= 'a' && h <= 'f')
+                    codeUnit |= h - 'a' + 10;
+                else if (h >= 'A' && h <= 'F')
+                    codeUnit |= h - 'A' + 10;
+                else
+                {
+                    SetError("Invalid unicode escape sequence.", escapeStart);
+                    return false;
+                }
+            }
+
+            //Surrogate pairs come as two escapes; appending both code units forms the pair.
+            result += QChar(codeUnit);
+            p += 4;
+            break;
+        }
+        default:
+            SetError("Invalid escape sequence.", escapeStart);
+            return false;
+        }
+        p++;
+    }
+
+    m_string = result;
+    m_pos = p + 1;
+    return true;
+}
+
+bool JsonStreamReader::ReadNumber()
+{
+    //Grammar: -? (0 | [1-9][0-9]*) (.[0-9]+)? ([eE][+-]?[0-9]+)?
+    const char* p = m_pos;
+    const bool negative = (*p == '-');
+    if (negative)
+        p++;
+
+    const char* digitsStart = p;
+    quint64 intValue = 0;
+    if (p < m_end && *p == '0')
+    {
+        p++;
+    }
+    else
+    {
+        while (p < m_end && *p >= '0' && *p <= '9')
+        {
+            intValue = intValue * 10 + (*p - '0');
+            p++;
+        }
+    }
+
+    const int intDigits = p - digitsStart;
+    if (intDigits == 0)
+    {
+        SetError("Invalid number.", m_pos);
+        return false;
+    }
+
+    bool isInteger = true;
+    if (p < m_end && *p == '.')
+    {
+        isInteger = false;
+        p++;
+        const char* fractionStart = p;
+        while (p < m_end && *p >= '0' && *p <= '9')
+            p++;
+        if (p == fractionStart)
+        {
+            SetError("Invalid number.", m_pos);
+            return false;
+        }
+    }
+
+    if (p < m_end && (*p == 'e' || *p == 'E'))
+    {
+        isInteger = false;
+        p++;
+        if (p < m_end && (*p == '+' || *p == '-'))
+            p++;
+        const char* exponentStart = p;
+        while (p < m_end && *p >= '0' && *p <= '9')
+            p++;
+        if (p == exponentStart)
+        {
+            SetError("Invalid number.", m_pos);
+            return false;
+        }
+    }
+
+    //Firefox ids, indices and timestamps are all integers; converting a 64-bit integer to double
+    //  is exactly rounded, so the result is the same as the general conversion.
+    if (isInteger && intDigits <= 18)
+    {
+        m_number = (negative ? -(double)intValue : (double)intValue);
+    }
+    else
+    {
+        bool ok;
+        m_number = QByteArray::fromRawData(m_pos, p - m_pos).toDouble(&ok);
+        if (!ok)
+        {
+            SetError("Invalid number.", m_pos);
+            return false;
+        }
+    }
+
+    m_pos = p;
+    return true;
+}
+
+bool JsonStreamReader::ReadLiteral(const char* literal, int length)
+{
+    if (m_end - m_pos < length || memcmp(m_pos, literal, length) != 0)
+    {
+        SetError("Invalid literal.", m_pos);
+        return false;
+    }
+    m_pos += length;
+    return true;
+}
+
+void JsonStreamReader::ValueRead()
+{
+    m_state = (m_containerStack.isEmpty() ? S_ExpectEnd : S_ExpectCommaOrClose);
+}
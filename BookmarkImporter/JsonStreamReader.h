@@ -0,0 +1,88 @@
+#pragma once
+#include <QString>
+#include <QVector>
+
+/// A pull-style JSON tokenizer over a memory buffer, similar to QXmlStreamReader. Unlike
+///   QJsonDocument it does not build a DOM, so big files can be processed in a single pass with
+///   memory proportional to what the caller keeps. The buffer is usually a memory-mapped file.
+/// Usage: call `readNext` until it returns `EndDocument` or `Invalid`. Inside objects, each member
+///   is reported as a `Name` token followed by the tokens of its value. Commas, colons and
+///   nesting are validated by the reader.
+class JsonStreamReader
+{
+public:
+    enum TokenType
+    {
+        NoToken,
+        Invalid,
+        StartObject,
+        EndObject,
+        StartArray,
+        EndArray,
+        Name,
+        String,
+        Number,
+        Bool,
+        Null,
+        EndDocument
+    };
+
+private:
+    const char* m_begin;
+    const char* m_end;
+    const char* m_pos;
+
+    enum State
+    {
+        S_ExpectValue,        //At the start, after ':', or after ',' in an array
+        S_ExpectValueOrClose, //After '['
+        S_ExpectName,         //After ',' in an object
+        S_ExpectNameOrClose,  //After '{'
+        S_ExpectCommaOrClose, //After a value inside an object or array
+        S_ExpectEnd           //After the root value
+    };
+    State m_state;
+    /// true for objects, false for arrays.
+    QVector<bool> m_containerStack;
+
+    TokenType m_tokenType;
+    const char* m_tokenStart;
+    QString m_string;
+    double m_number;
+    bool m_bool;
+
+    QString m_errorString;
+    const char* m_errorPos;
+
+public:
+    JsonStreamReader(const char* data, qint64 size);
+
+    TokenType readNext();
+    TokenType tokenType() const { return m_tokenType; }
+
+    /// For `Name` and `String` tokens.
+    const QString& stringValue() const { return m_string; }
+    double numberValue() const { return m_number; }
+    bool boolValue() const { return m_bool; }
+
+    /// If the current token is `StartObject` or `StartArray`, reads until the matching end token.
+    ///   Otherwise does nothing, since the other values consist of only one token.
+    bool skipCurrentValue();
+
+    bool hasError() const { return m_tokenType == Invalid; }
+    QString errorString() const { return m_errorString; }
+    /// Byte offset of the error, or of the current position if there is no error.
+    qint64 errorOffset() const;
+    /// Byte offset of the start of the current token.
+    qint64 tokenOffset() const { return m_tokenStart - m_begin; }
+    qint64 size() const { return m_end - m_begin; }
+
+private:
+    TokenType SetError(const QString& errorString, const char* pos);
+    void SkipWhitespace();
+    bool ReadString();
+    bool ReadNumber();
+    bool ReadLiteral(const char* literal, int length);
+    /// Called after a complete value is read.
+    void ValueRead();
+};
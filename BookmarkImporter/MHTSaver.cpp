@@ -1,20 +1,44 @@
 #include "MHTSaver.h"
 
+#include "PageFetchScheduler.h"
+#include "PageTokenizer.h"
+#include "ResourceCache.h"
+#include "Util/MimeEncoder.h"
 #include "Util/Util.h"
 #include <QFileInfo>
 #include <QRegularExpression>
 #include <QMimeDatabase>
 
-#include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 
+#include <QRunnable>
+#include <QThreadPool>
 #include <QTimer>
+#include <QVector>
+
+class MHTSaver::PartEncodingTask : public QRunnable
+{
+private:
+    MIMEPart& m_part;
+
+public:
+    PartEncodingTask(MIMEPart& part)
+        : m_part(part)
+    {
+    }
+
+    void run()
+    {
+        EncodePart(m_part);
+    }
+};
 
 MHTSaver::MHTSaver(QObject *parent) :
     QObject(parent)
 {
-    qnam = new QNetworkAccessManager(this);
+    m_scheduler = new PageFetchScheduler(24, 6, this);
+    m_resourceCache = NULL;
 
     m_useOverallTimer = false;
     m_overallTimer = new QTimer(this);
@@ -52,6 +76,18 @@ bool MHTSaver::stripJS() const
     return m_stripJS;
 }
 
+void MHTSaver::setFetchScheduler(PageFetchScheduler* scheduler)
+{
+    if (m_scheduler->parent() == this)
+        delete m_scheduler;
+    m_scheduler = scheduler;
+}
+
+void MHTSaver::setResourceCache(ResourceCache* cache)
+{
+    m_resourceCache = cache;
+}
+
 void MHTSaver::setOverallTimeoutTime(int seconds)
 {
     m_useOverallTimer = (seconds > 0);
@@ -72,7 +108,7 @@ void MHTSaver::OverallTimerTimeout()
 void MHTSaver::GetMHTData(const QString& url)
 {
     m_resources.clear();
-    m_ongoingReplies.clear();
+    m_ongoingFetches.clear();
     m_status.mainSuccess = false;
     m_status.mainHttpErrorCode = -1;
     m_status.mainNetworkReplyError = QNetworkReply::NoError;
@@ -95,8 +131,8 @@ void MHTSaver::GetMHTData(const QString& url)
 void MHTSaver::Cancel()
 {
     m_cancel = true;
-    foreach (QNetworkReply* reply, m_ongoingReplies.keys())
-        reply->abort(); //`finished()` will also be emitted, so don't remove them.
+    foreach (ScheduledFetch* fetch, m_ongoingFetches.keys())
+        fetch->abort(); //`finished()` will also be emitted, so don't remove them.
 }
 
 void MHTSaver::ExtractInfoDumb(const QByteArray& mhtData, QString& title, QString& url)
@@ -131,35 +167,61 @@ void MHTSaver::LoadResource(const QUrl& url, int redirectDepth)
     foreach (const Resource& res, m_resources)
         if (res.fullUrl == url)
             return;
-    foreach (const QNetworkReply* reply, m_ongoingReplies.keys())
-        if (reply->url() == url)
+    foreach (const ScheduledFetch* fetch, m_ongoingFetches.keys())
+        if (fetch->url() == url)
             return;
 
+    //Resources that are common in pages of a site are taken from the cache if we have one. The
+    //  main resource is always fetched.
+    bool useCache = (m_resourceCache != NULL && !m_resources.isEmpty());
+    if (useCache)
+    {
+        QString contentType;
+        QByteArray data;
+        if (m_resourceCache->LookupFresh(url, contentType, data))
+        {
+            AddResource(url, contentType, data, QString());
+            ParseAndAddResources(url, getRawContentType(contentType), data);
+            return;
+        }
+    }
+
+    FetchResource(url, redirectDepth, useCache);
+}
+
+void MHTSaver::FetchResource(const QUrl& url, int redirectDepth, bool conditional)
+{
     QNetworkRequest req;
     req.setUrl(url);
     QString chromeUserAgent = "Mozilla/5.0 (Windows NT 6.1; WOW64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/33.0.1750.154 Safari/537.36";
     req.setHeader(QNetworkRequest::UserAgentHeader, chromeUserAgent);
 
-    QNetworkReply* reply = qnam->get(req);
-    connect(reply, SIGNAL(finished()), this, SLOT(ResourceLoadingFinished()));
+    //Resources of a page we already have go before the main pages of other savers sharing our
+    //  scheduler, so that pages finish sooner rather than all of them progressing slowly.
+    if (!m_resources.isEmpty())
+        req.setPriority(QNetworkRequest::HighPriority);
+    if (conditional)
+        m_resourceCache->AddValidators(req);
+
+    ScheduledFetch* fetch = m_scheduler->Get(req, this);
+    connect(fetch, SIGNAL(finished()), this, SLOT(ResourceLoadingFinished()));
 
-    //Always set progress THEN the timestamp, to make sure if progress changes in between,
-    //  next call will update the timestamp. Actually I don't think it differs so much.
-    OngoingReply ongoingReply;
-    ongoingReply.redirectDepth = redirectDepth;
-    ongoingReply.progress = -1;
-    ongoingReply.progressTimeStamp = QDateTime::currentDateTime();
-    m_ongoingReplies.insert(reply, ongoingReply);
+    OngoingFetch ongoingFetch;
+    ongoingFetch.redirectDepth = redirectDepth;
+    ongoingFetch.conditional = conditional;
+    m_ongoingFetches.insert(fetch, ongoingFetch);
 }
 
 void MHTSaver::ResourceLoadingFinished()
 {
-    QNetworkReply* reply = dynamic_cast<QNetworkReply*>(sender());
+    ScheduledFetch* fetch = qobject_cast<ScheduledFetch*>(sender());
+    QNetworkReply* reply = fetch->reply();
 
-    if (m_cancel) //No need to check if reply is valid for this.
+    //Fetches are aborted before being started only when cancelling, so reply is NULL only then.
+    if (m_cancel || reply == NULL) //No need to check if reply is valid for this.
     {
         //Stop early
-        DeleteReplyAndCheckForFinish(reply);
+        DeleteFetchAndCheckForFinish(fetch);
         return;
     }
 
@@ -172,16 +234,18 @@ void MHTSaver::ResourceLoadingFinished()
         m_status.mainHttpErrorCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
         m_status.mainNetworkReplyError = reply->error();
         m_status.mainNetworkReplyErrorString = reply->errorString();
+        if (fetch->timedOut())
+            m_status.mainNetworkReplyErrorString = "Timed out, nothing was received for a long time.";
 
         if (reply->error() != QNetworkReply::NoError)
         {
             //Don't continue. We're done. Just emit an error.
-            return DeleteReplyAndCheckForFinish(reply); //Handles this error case also.
+            return DeleteFetchAndCheckForFinish(fetch); //Handles this error case also.
         }
     }
 
     if (reply->error() != QNetworkReply::NoError)
-        return DeleteReplyAndCheckForFinish(reply);
+        return DeleteFetchAndCheckForFinish(fetch);
 
     QString redirectLocation = QString();
     int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
@@ -197,14 +261,14 @@ void MHTSaver::ResourceLoadingFinished()
         //  the function continues and the `AddResource` call adds the resource to our list.
         //Btw prevent redirect loops: if we detect one, we just use the current resource and won't
         //  redirect anymore.
-        int redirectDepth = m_ongoingReplies[reply].redirectDepth + 1;
+        int redirectDepth = m_ongoingFetches[fetch].redirectDepth + 1;
         if (redirectDepth <= MAX_REDIRECT_DEPTH)
         {
             redirectLocation = reply->header(QNetworkRequest::LocationHeader).toString();
             ///qDebug() << "LOAD: Redirect to: " << redirectLocation;
             LoadResource(QUrl(redirectLocation), redirectDepth + 1);
             if (isMainResource)
-                return DeleteReplyAndCheckForFinish(reply);
+                return DeleteFetchAndCheckForFinish(fetch);
         }
     }
 
@@ -214,57 +278,34 @@ void MHTSaver::ResourceLoadingFinished()
         qDebug() << "LOAD: HTTP ERROR " << httpStatus << " for resource: " << reply->url();
     }
 
-    //Add the resource.
-    QString contentType = AddResource(reply, redirectLocation);
-
-    //Determine the file type and add any more contents.
-    contentType = getRawContentType(contentType);
-    ///qDebug() << "LOAD: URL and ContentType is " << reply->url() << contentType;
-
     QUrl url = reply->url();
-    if (!redirectLocation.isEmpty())
-    {
-        //If a redirect, don't parse it at all. Only exit the if/else ladder and go to end of the function.
-    }
-    else if (m_htmlContentTypes.contains(contentType))
-    {
-        //A common error is to have css or js files with this content type. check extesnsion here.
-        //  Actually any thing including images and downloaded files can come here too but we don't
-        //  check them.
-        //We use url's `path()` to make sure it doesn't contain query string or fragments.
-        if (url.path().right(4).toLower() == ".css")
-            ParseAndAddCSSResources(reply);
-        else if (url.path().right(3).toLower() == ".js")
-            {} //Scripts don't need parsing.
-        else
-            ParseAndAddHTMLResources(reply); //Now normal html
-    }
-    else if (m_cssContentTypes.contains(contentType))
+    QByteArray data = reply->readAll();
+    QString contentType;
+    if (httpStatus == 304 && m_ongoingFetches[fetch].conditional)
     {
-        ParseAndAddCSSResources(reply);
+        if (!m_resourceCache->Revalidated(url, contentType, data))
+        {
+            //Not modified, but the cached contents are gone meanwhile; get them again. Started
+            //  before deleting this fetch, so that the saver doesn't think it has finished.
+            FetchResource(url, m_ongoingFetches[fetch].redirectDepth, false);
+            return DeleteFetchAndCheckForFinish(fetch);
+        }
+        //Not modified since it was cached, and now we have the cached contents.
     }
-    else if (m_scriptContentTypes.contains(contentType)
-          || m_otherKnownContentTypes.contains(contentType))
+    else
     {
-        //Other known resource types. Has been added to resources list. No special processing.
+        contentType = getOrGuessMimeType(reply, data);
+        //The main resource is the bookmark itself and is not shared with other pages.
+        if (m_resourceCache != NULL && !isMainResource && httpStatus == 200)
+            data = m_resourceCache->Store(reply, contentType, data);
     }
-    else //includes `if (contentType.isNull())`
-    {
-        //Unknown resources. Has been added to resources list. We check for some additional extensions.
 
-        ///if (contentType.isNull())
-        ///    qDebug() << "LOAD: " << url << " doesn't have content type specified.";
-        ///else
-        ///    qDebug() << "LOAD: Unknown content type '" << contentType << "' for resource: "<< url;
+    //Add the resource.
+    AddResource(url, contentType, data, redirectLocation);
 
-        //A common error is to have css files produced e.g with php but not sending the correct
-        //  content-type header.
-        //  Actually any thing including images and downloaded files can come here too but we don't
-        //  check them.
-        //We use url's `path()` to make sure it doesn't contain query string or fragments.
-        if (url.path().right(4).toLower() == ".css")
-            ParseAndAddCSSResources(reply);
-    }
+    //Determine the file type and add any more contents. If a redirect, don't parse it at all.
+    if (redirectLocation.isEmpty())
+        ParseAndAddResources(url, getRawContentType(contentType), data);
 
     //For the main page, the `ParseAndAddHTMLResources` should set its title if it's an html page.
     //However if it doesn't have a title tag, or if it's not html (i.e maybe it's an image), we set
@@ -279,19 +320,21 @@ void MHTSaver::ResourceLoadingFinished()
             m_status.mainResourceTitle = "File";
     }
 
-    DeleteReplyAndCheckForFinish(reply);
+    DeleteFetchAndCheckForFinish(fetch);
 }
 
-void MHTSaver::DeleteReplyAndCheckForFinish(QNetworkReply* reply)
+void MHTSaver::DeleteFetchAndCheckForFinish(ScheduledFetch* fetch)
 {
-    //IMPORTANT: Don't forget!
-    reply->deleteLater();
-    m_ongoingReplies.remove(reply); //Remove from list of ongoing.
+    bool failed = (fetch->reply() == NULL || fetch->reply()->error() != QNetworkReply::NoError);
+
+    //IMPORTANT: Don't forget! Also deletes the reply.
+    fetch->deleteLater();
+    m_ongoingFetches.remove(fetch); //Remove from list of ongoing.
 
     if (m_cancel)
     {
         //If user cancelled, emit the special status when resources finish.
-        if (m_ongoingReplies.size() == 0)
+        if (m_ongoingFetches.size() == 0)
         {
             m_status.mainSuccess = true;
             m_status.mainHttpErrorCode = 0;
@@ -299,13 +342,13 @@ void MHTSaver::DeleteReplyAndCheckForFinish(QNetworkReply* reply)
             emit MHTDataReady(QByteArray(), m_status);
         }
     }
-    else if (m_resources.isEmpty() && reply->error() != QNetworkReply::NoError)
+    else if (m_resources.isEmpty() && failed)
     {
         //If this is an error on loading the first, i.e the main resource
         m_overallTimer->stop();
         emit MHTDataReady(QByteArray(), m_status);
     }
-    else if (m_ongoingReplies.size() == 0)
+    else if (m_ongoingFetches.size() == 0)
     {
         //Otherwise if things finished, generate the MHT.
         m_overallTimer->stop();
@@ -313,146 +356,113 @@ void MHTSaver::DeleteReplyAndCheckForFinish(QNetworkReply* reply)
     }
 }
 
-QString MHTSaver::AddResource(QNetworkReply* reply, const QString& redirectLocation)
+void MHTSaver::AddResource(const QUrl& url, const QString& contentType, const QByteArray& data,
+                           const QString& redirectLocation)
 {
-    QUrl url = reply->url();
-
     foreach (const Resource& res, m_resources)
     {
         if (res.fullUrl == url)
         {
             qDebug() << "ASSERTION FAILED! Resource " << url << " already exists!";
-            return QString();
+            return;
         }
     }
 
-    const QByteArray data = reply->peek(reply->bytesAvailable());
-    QString contentType = getOrGuessMimeType(reply, data);
     //We don't strip the 'charset=' part of the content type here.
-
     Resource res;
     res.fullUrl = url;
     res.contentType = contentType;
     res.data = data;
+    res.scriptsStripped = false;
     if (!redirectLocation.isEmpty())
         res.redirectTo = QUrl(redirectLocation);
 
     m_resources.append(res);
     m_status.resourceCount += 1;
-    m_status.resourceSuccess += (reply->error() == QNetworkReply::NoError ? 1 : 0);
-
-    return contentType;
+    m_status.resourceSuccess += 1; //Failed ones are not added.
 }
 
-void MHTSaver::ParseAndAddHTMLResources(QNetworkReply* reply)
+void MHTSaver::ParseAndAddResources(const QUrl& url, const QString& contentType, const QByteArray& data)
 {
-    ///qDebug() << "PARSE HTML: Base: " << url;
-
-    QUrl url = reply->url();
-    QByteArray data = reply->readAll();
-    QString str = QString::fromUtf8(data);
+    ///qDebug() << "LOAD: URL and ContentType is " << url << contentType;
 
-    //Regular expressions stolen from the following and modified a bit:
-    //http://www.codeproject.com/Articles/8268/Convert-any-URL-to-a-MHTML-archive-using-native-NE
-
-    //This will also catch the (i)frames recursively, as we automatically load all htmls' resources.
-
-    //Previous thing without <link> rel type understanding:
-    ///QString pattern = "(\\s(src|background)\\s*=\\s*|<link[^>]+?href\\s*=\\s*)"
-    ///                  "(?|'(?<url>[^'\\n\\r]+)|\"(?<url>[^\"\\n\\r]+)|(?<url>[^ \\n\\r]+))";
-    ///QRegularExpression regexp(pattern, QRegularExpression::CaseInsensitiveOption);
-    ///QRegularExpressionMatchIterator matches = regexp.globalMatch(str);
-
-    //There are lots of link rel types. E.g open any mozilla page; it has linked all pages of all
-    //  languages to every page.
-    QString attributeValueMatch = "(?|'(?<%1>[^'\\n\\r]+)|\"(?<%1>[^\"\\n\\r]+)|(?<%1>[^ \\n\\r]+))";
-    QStringList patterns = QStringList()
-            << "\\s(src|background)\\s*=\\s*" + attributeValueMatch.arg("url")
-            << "<link[^>]+?rel\\s*=\\s*" + attributeValueMatch.arg("rel") + "[^>]+?href\\s*=\\s*" + attributeValueMatch.arg("url")
-            << "<link[^>]+?href\\s*=\\s*" + attributeValueMatch.arg("url") + "[^>]+?rel\\s*=\\s*" + attributeValueMatch.arg("ref");
-
-    for (int i = 0; i < patterns.length(); i++)
+    if (m_htmlContentTypes.contains(contentType))
     {
-        const QString pattern = patterns[i];
-        QRegularExpression regexp(pattern, QRegularExpression::CaseInsensitiveOption);
-        QRegularExpressionMatchIterator matches = regexp.globalMatch(str);
-
-        if (i <= 0)
-        {
-            while (matches.hasNext())
-            {
-                QRegularExpressionMatch match = matches.next();
-                QString linkedUrl = match.captured("url");
-                DecideAndLoadURL(url, Util::UnEscapeHTMLEntities(linkedUrl));
-            }
-        }
+        //A common error is to have css or js files with this content type. check extesnsion here.
+        //  Actually any thing including images and downloaded files can come here too but we don't
+        //  check them.
+        //We use url's `path()` to make sure it doesn't contain query string or fragments.
+        if (url.path().right(4).toLower() == ".css")
+            ParseAndAddInlineCSSResources(url, data);
+        else if (url.path().right(3).toLower() == ".js")
+            {} //Scripts don't need parsing.
         else
-        {
-            while (matches.hasNext())
-            {
-                QRegularExpressionMatch match = matches.next();
-                QString rel = match.captured("rel");
-                QString linkedUrl = match.captured("url");
-                if (m_loadLinkRelTypes.contains(rel, Qt::CaseInsensitive))
-                    DecideAndLoadURL(url, Util::UnEscapeHTMLEntities(linkedUrl));
-            }
-        }
+            ParseAndAddHTMLResources(url, data); //Now normal html
     }
+    else if (m_cssContentTypes.contains(contentType))
+    {
+        ParseAndAddInlineCSSResources(url, data);
+    }
+    else if (m_scriptContentTypes.contains(contentType)
+          || m_otherKnownContentTypes.contains(contentType))
+    {
+        //Other known resource types. Has been added to resources list. No special processing.
+    }
+    else //includes `if (contentType.isNull())`
+    {
+        //Unknown resources. Has been added to resources list. We check for some additional extensions.
 
-    //Add the resources referenced in <style> tags css too. The most notable use is for google
-    //  search results. (We do nothing about 'style=' attributes though.)
-    QByteArray htmlStyles = getHTMLStyles(data);
-    if (!htmlStyles.isEmpty())
-        ParseAndAddInlineCSSResources(url, htmlStyles);
+        ///if (contentType.isNull())
+        ///    qDebug() << "LOAD: " << url << " doesn't have content type specified.";
+        ///else
+        ///    qDebug() << "LOAD: Unknown content type '" << contentType << "' for resource: "<< url;
 
-    //Also, if this is the first resource, get the html <title> from it.
-    if (m_resources.size() == 1)
-    {
-        QString title = Util::ExtractHTMLTitleText(str);
-        if (!title.isNull())
-            m_status.mainResourceTitle = title;
+        //A common error is to have css files produced e.g with php but not sending the correct
+        //  content-type header.
+        //  Actually any thing including images and downloaded files can come here too but we don't
+        //  check them.
+        //We use url's `path()` to make sure it doesn't contain query string or fragments.
+        if (url.path().right(4).toLower() == ".css")
+            ParseAndAddInlineCSSResources(url, data);
     }
 }
 
-void MHTSaver::ParseAndAddCSSResources(QNetworkReply* reply)
+void MHTSaver::ParseAndAddHTMLResources(const QUrl& url, const QByteArray& data)
 {
-    QUrl url = reply->url();
-    QByteArray data = reply->readAll();
-    ParseAndAddInlineCSSResources(url, data);
+    ///qDebug() << "PARSE HTML: Base: " << url;
+
+    //A single pass finds the links, the css in <style> tags and 'style=' attributes (the most
+    //  notable use is for google search results), and the title, and strips the scripts.
+    //This will also catch the (i)frames recursively, as we automatically load all htmls' resources.
+    PageTokenizer::HTMLInfo info;
+    PageTokenizer::TokenizeHTML(data, m_loadLinkRelTypes, m_stripJS, info);
+
+    //Do these before loading the links, which may add cached resources right away.
+    int resIndex = findResourceWithURL(url);
+    if (m_stripJS && resIndex != -1)
+    {
+        m_resources[resIndex].data = info.strippedHTML;
+        m_resources[resIndex].scriptsStripped = true;
+    }
+
+    //Also, if this is the first resource, get the html <title> from it.
+    if (m_resources.size() == 1 && !info.title.isNull())
+        m_status.mainResourceTitle = info.title;
+
+    foreach (const QString& linkedUrl, info.links)
+        DecideAndLoadURL(url, linkedUrl);
 }
 
 void MHTSaver::ParseAndAddInlineCSSResources(const QUrl& baseUrl, const QByteArray& style)
 {
     ///qDebug() << "PARSE CSS: Base: " << baseUrl;
 
-    QString str = QString::fromUtf8(style);
-
-    //The following QUESTION MARK actually makes our pattern recognize additional 'url('s that are
-    //  not part of an import/*-image/background.
-    //This QUESTION MARK HERE ---------------------------v
-    QString pattern = "(@import\\s|\\S+-image:|background:)\\s*?(url)?\\s*([\"'(]{1,2}(?<url>[^\"')]+)[\"')]{1,2})";
-    QRegularExpression regexp(pattern, QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatchIterator matches = regexp.globalMatch(str);
-
-    QString pattern2 = "url\\(\\s*[\"']?(?<url>[^\"'\\)]+)";
-    QRegularExpression regexp2(pattern2, QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatchIterator matches2 = regexp2.globalMatch(str);
-
     //Paths for CSS will be fine:
     //http://stackoverflow.com/questions/940451/using-relative-url-in-css-file-what-location-is-it-relative-to
-
-    while (matches.hasNext())
-    {
-        QRegularExpressionMatch match = matches.next();
-        QString linkedUrl = match.captured("url");
-        DecideAndLoadURL(baseUrl, linkedUrl);
-    }
-    while (matches2.hasNext())
-    {
-        QRegularExpressionMatch match = matches2.next();
-        QString linkedUrl = match.captured("url");
+    QStringList links;
+    PageTokenizer::TokenizeCSS(style, links);
+    foreach (const QString& linkedUrl, links)
         DecideAndLoadURL(baseUrl, linkedUrl);
-    }
 }
 
 void MHTSaver::DecideAndLoadURL(const QUrl& baseURL, const QString& linkedURL)
@@ -570,14 +580,20 @@ void MHTSaver::GenerateMHT()
 
     mhtdata += "This is a multi-part message in MIME format.\r\n\r\n";
 
+    //Headers are written and contents are prepared first, so that the parts can be encoded in
+    //  parallel and copied into a buffer of the right size.
+    QVector<MIMEPart> parts;
+    parts.reserve(m_resources.size());
     foreach (const Resource& res, m_resources)
     {
+        MIMEPart part;
         QUrl currentRedirectUrl;
         QString contentType;
         QByteArray data;
 
         contentType = res.contentType;
         data = res.data;
+        bool scriptsStripped = res.scriptsStripped;
 
         //First off, if the file was a redirect replace original data and content type with the
         //  redirect target. We don't replace the url as that requires changing files' source.
@@ -595,6 +611,7 @@ void MHTSaver::GenerateMHT()
             currentRedirectUrl = m_resources[i].fullUrl;
             contentType = m_resources[i].contentType;
             data = m_resources[i].data;
+            scriptsStripped = m_resources[i].scriptsStripped;
 
             //Check for more redirect depths.
             redirectTo = m_resources[i].redirectTo;
@@ -604,59 +621,93 @@ void MHTSaver::GenerateMHT()
         QString rawContentType = getRawContentType(contentType);
         bool isText = isMimeTypeTextFile(rawContentType);
 
-        mhtdata += "--" + boundary + "\r\n";
+        part.headers += "--" + boundary + "\r\n";
 
         if (!contentType.isEmpty())
-            mhtdata += "Content-Type: " + contentType.toLatin1() + "\r\n";
+            part.headers += "Content-Type: " + contentType.toLatin1() + "\r\n";
 
-        mhtdata += "Content-Transfer-Encoding: ";
-        mhtdata += (isText ? "quoted-printable" : "base64");
-        mhtdata += "\r\n";
+        part.headers += "Content-Transfer-Encoding: ";
+        part.headers += (isText ? "quoted-printable" : "base64");
+        part.headers += "\r\n";
 
-        mhtdata += "Content-Location: " + res.fullUrl.toString(QUrl::FullyEncoded) + "\r\n";
+        part.headers += "Content-Location: " + res.fullUrl.toString(QUrl::FullyEncoded) + "\r\n";
 
         if (!currentRedirectUrl.isEmpty())
         {
-            mhtdata += "X-BM-IsRedirect: Yes\r\n";
-            mhtdata += "X-BM-RedirectTarget: " + currentRedirectUrl.toString(QUrl::FullyEncoded)  + "\r\n";
-            mhtdata += "X-BM-OriginalContentType: " + res.contentType.toLatin1()  + "\r\n";
+            part.headers += "X-BM-IsRedirect: Yes\r\n";
+            part.headers += "X-BM-RedirectTarget: " + currentRedirectUrl.toString(QUrl::FullyEncoded)  + "\r\n";
+            part.headers += "X-BM-OriginalContentType: " + res.contentType.toLatin1()  + "\r\n";
         }
 
-        mhtdata += "\r\n";
+        part.headers += "\r\n";
 
-        //Strip JS
+        //Strip JS; html files that were parsed are already stripped.
         if (m_stripJS && m_htmlContentTypes.contains(rawContentType))
         {
-            data = stripHTMLScripts(data);
+            if (!scriptsStripped)
+                data = PageTokenizer::StripScripts(data);
         }
         else if (m_stripJS && m_scriptContentTypes.contains(rawContentType))
         {
             data = QByteArray("/* Script removed by snapshot save */\n");
         }
 
-        //Write content
-        if (isText)
-        {
-            mhtdata += Util::EncodeQuotedPrintable(data);
-        }
-        else
-        {
-            QByteArray base64 = data.toBase64();
-            QByteArray base64lines;
-            for (int i = 0; i <= base64.length() / 76; i++)
-                base64lines += base64.mid(i * 76, ((i+1)*76 > base64.length() ? -1 : 76)) + "\r\n";
-            mhtdata += base64lines;
-        }
-        mhtdata += "\r\n";
+        part.data = data;
+        part.quotedPrintable = isText;
+        parts.append(part);
     }
 
+    EncodeParts(parts);
+
     //Last one has an additional '--' at end.
-    mhtdata += "--" + boundary + "--\r\n";
+    const QByteArray closingBoundary = "--" + boundary + "--\r\n";
+
+    int totalSize = mhtdata.size() + closingBoundary.size();
+    foreach (const MIMEPart& part, parts)
+        totalSize += part.headers.size() + part.encoded.size() + 2;
+    mhtdata.reserve(totalSize);
+
+    for (int i = 0; i < parts.size(); i++)
+    {
+        mhtdata += parts[i].headers;
+        mhtdata += parts[i].encoded;
+        mhtdata += "\r\n";
+        parts[i].encoded.clear(); //Don't keep two copies of large pages.
+    }
+    mhtdata += closingBoundary;
 
     m_status.fileSuffix = "mhtml";
     emit MHTDataReady(mhtdata, m_status);
 }
 
+void MHTSaver::EncodeParts(QVector<MIMEPart>& parts)
+{
+    //Threads are only worth it for large parts, and only if there are more than one of them.
+    int largePartsCount = 0;
+    foreach (const MIMEPart& part, parts)
+        if (part.data.size() >= ParallelEncodingMinPartSize)
+            largePartsCount += 1;
+
+    QThreadPool pool;
+    for (int i = 0; i < parts.size(); i++)
+    {
+        if (largePartsCount > 1 && parts[i].data.size() >= ParallelEncodingMinPartSize)
+            pool.start(new PartEncodingTask(parts[i]));
+        else
+            EncodePart(parts[i]);
+    }
+    pool.waitForDone();
+}
+
+void MHTSaver::EncodePart(MIMEPart& part)
+{
+    if (part.quotedPrintable)
+        part.encoded = MimeEncoder::EncodeQuotedPrintable(part.data);
+    else
+        part.encoded = MimeEncoder::EncodeBase64Lines(part.data);
+    part.data.clear();
+}
+
 void MHTSaver::GenerateFile()
 {
     //We have used `completeBaseName()` before. Now we use only 'suffix()'.
@@ -728,110 +779,3 @@ QString MHTSaver::getOrGuessMimeType(QNetworkReply* reply, const QByteArray& dat
     }
     return contentType;
 }
-
-QByteArray MHTSaver::getHTMLStyles(const QByteArray& html)
-{
-    //Limitations:
-    //  Read `MHTSaver::stripHTMLScripts`'s limitations.
-
-    QByteArray output;
-    int startIndex = 0;
-
-    //In each round find a style tag and copy data inside it.
-    while (true)
-    {
-        //Find '<style'
-        int openStyleTagIndex = html.indexOf(QByteArray("<style"), startIndex);
-        if (openStyleTagIndex == -1)
-        {
-            break;
-        }
-
-        //Find '>'
-        int openStyleTagUntil = html.indexOf('>', openStyleTagIndex);
-        if (openStyleTagUntil == -1)
-        {
-            break;
-        }
-
-        int styleContentBeginning = openStyleTagUntil + 1; // `+ 1` to consume the '>' itself
-
-        //Find '</style>'
-        int closeStyleTagIndex = html.indexOf(QByteArray("</style>"), styleContentBeginning);
-        if (closeStyleTagIndex == -1)
-        {
-            //Unclosed style. Maybe tempted to copy it! Yes do it! Syntax errors are not a big deal here.
-            output += html.mid(styleContentBeginning);
-            break;
-        }
-        else
-        {
-            output += html.mid(styleContentBeginning, closeStyleTagIndex - styleContentBeginning);
-            output += " "; //Try to separate them.
-        }
-
-        //Skip the closing style tag to get ready for next round
-        startIndex = closeStyleTagIndex + 8; //8 is len("</style>")
-    }
-
-    return output;
-}
-
-QByteArray MHTSaver::stripHTMLScripts(const QByteArray& html)
-{
-    //Limitations:
-    //- Doesn't support encodings
-    //- Doesn't strip non-lowercase scripts
-    //- This is primitive, doesn't parse the html file. E.g may get caught by '<script> being
-    //  inside a string.
-
-    QByteArray output;
-    int startIndex = 0;
-
-    //In each round, copy data before script, the script tag, then the 'removed' message and the
-    //  closing script tag. If in a round a script tag was not found, copy til the end and return.
-    while (true)
-    {
-        //Find '<script'
-        int openScriptTagIndex = html.indexOf(QByteArray("<script"), startIndex);
-        if (openScriptTagIndex == -1)
-        {
-            output += html.mid(startIndex);
-            break;
-        }
-
-        //Find '>'
-        int openScriptTagUntil = html.indexOf('>', openScriptTagIndex);
-        if (openScriptTagUntil == -1)
-        {
-            output += html.mid(startIndex);
-            break;
-        }
-
-        int scriptContentBeginning = openScriptTagUntil + 1; // `+ 1` to consume the '>' itself
-
-        //Copy until the script content beginning
-        output += html.mid(startIndex, scriptContentBeginning - startIndex);
-        //Add the 'removed' message.
-        //Unlike MAFF, we do not add '\n's here. Maybe this is in a JS string!
-        output += QByteArray("<!-- /* Script removed by snapshot save */ -->");
-
-        //Find '</script>'
-        int closeScriptTagIndex = html.indexOf(QByteArray("</script>"), scriptContentBeginning);
-        if (closeScriptTagIndex == -1)
-        {
-            //Unclosed script. Maybe tempted to not copy anything, but we'd better copy everything
-            //  til the end to avoid data loss.
-            output += html.mid(scriptContentBeginning);
-            break;
-        }
-
-        //"Copy" the closing script tag
-        output += QByteArray("</script>");
-
-        //Skip it to get ready for next round
-        startIndex = closeScriptTagIndex + 9; //9 is len("</script>")
-    }
-
-    return output;
-}
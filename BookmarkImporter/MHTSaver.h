@@ -5,10 +5,13 @@
 #include <QHash>
 #include <QDateTime>
 #include <QStringList>
+#include <QVector>
 
 class QTimer;
 class QNetworkReply;
-class QNetworkAccessManager;
+class PageFetchScheduler;
+class ResourceCache;
+class ScheduledFetch;
 
 /// Save URLs as MHT files!
 ///     This class is designed to suffice NOT-SO-IMPORTANT usages. It may not be suitable for
@@ -21,20 +24,18 @@ class QNetworkAccessManager;
 ///        will fix it, but doesn't do the same thing for e.g images having text/html mime type.)
 ///        UPDATE: Now we use QMimeDatabase to correctly guess the mime type of unknown files on
 ///        based on extension and contents.
-///     3. Doesn't have a timer or something to abort slow or stalled network operations.
-///        We can use an e.g 20sec timer to abort operations with slow/stalled progresses during
-///        the last 10 seconds. Update: But we DON'T. Maybe if we aren't receiving a qreply's
-///        finished signal, we are just receiving a big file. And if it gets stalled for a long
-///        time, we let the system time it out itself. Anyway if there is any such timer, it has to
-///        record progress or number of received bytes and judge according to that, not time alone.
-///        However that is for single replies alone. We do have a timer that controls overall
-///        receiving time of the whole page. It should be set to a big value to allow for large file
-///        downloads.
+///     3. Slow or stalled network operations are aborted by the PageFetchScheduler, which judges
+///        by the received bytes, not time alone; so large file downloads that keep progressing are
+///        not aborted. We also have a timer that controls overall receiving time of the whole
+///        page. It should be set to a big value to allow for large file downloads.
 ///     4. The HTML and CSS parsers are very simple, don't skip comments and use simple regexps.
+///        UPDATE: They are now a single-pass tokenizer (PageTokenizer) that skips comments, but it
+///        is still not a real parser.
 ///     5. Doesn't strip scripts.
 ///     6. Doesn't load resources that are additionally loaded in scripts, or change DOM after
 ///        loading a page; only a browser can do that.
 ///     7. Doesn't load resources referenced in 'style="..."' attributes. Supports <style> though.
+///        UPDATE: Loads them now.
 ///     8. Redirections support is limited and is only done correctly for the main page. Although
 ///        the redirect targets are being fetched and saved, they are NOT displayed e.g in case of
 ///        pictures, because we neither modify the urls in the html/css files nor do we save the
@@ -71,7 +72,8 @@ public:
     };
 
 private:
-    QNetworkAccessManager* qnam;
+    PageFetchScheduler* m_scheduler;
+    ResourceCache* m_resourceCache;
     Status m_status;
     bool m_cancel;
 
@@ -88,18 +90,18 @@ private:
         QUrl fullUrl;
         QString contentType;
         QByteArray data;
+        bool scriptsStripped;
         QUrl redirectTo;
     };
     QList<Resource> m_resources;
 
-    struct OngoingReply
+    struct OngoingFetch
     {
         int redirectDepth;
-        //Note: Can use a timer to abort operations with slow/stalled progresses.
-        int progress;
-        QDateTime progressTimeStamp;
+        /// Made conditional by the resource cache's validators.
+        bool conditional;
     };
-    QHash<QNetworkReply*,OngoingReply> m_ongoingReplies;
+    QHash<ScheduledFetch*,OngoingFetch> m_ongoingFetches;
 
     QStringList m_htmlContentTypes;
     QStringList m_scriptContentTypes;
@@ -108,6 +110,16 @@ private:
 
     QStringList m_loadLinkRelTypes;
 
+    struct MIMEPart
+    {
+        QByteArray headers;
+        QByteArray data;
+        bool quotedPrintable; //Otherwise base64
+        QByteArray encoded;
+    };
+    class PartEncodingTask;
+    static const int ParallelEncodingMinPartSize = 256 * 1024;
+
 public:
     explicit MHTSaver(QObject *parent = 0);
     ~MHTSaver();
@@ -116,6 +128,12 @@ public:
 public:
     int overallTimeoutTime() const; ///Returns -1 if disabled
     bool stripJS() const;
+    /// By default each MHTSaver has its own scheduler. Several MHTSavers can share one to reuse
+    ///   connections and limit their total requests; it must outlive them. Don't set while fetching.
+    void setFetchScheduler(PageFetchScheduler* scheduler);
+    /// Resources other than the main one are taken from and added to `cache`, which is NULL by
+    ///   default. It can be shared like the scheduler and must outlive the MHTSaver too.
+    void setResourceCache(ResourceCache* cache);
 public slots:
     void setOverallTimeoutTime(int seconds); ///Pass -1 to disable
     void setStripJS(bool strip);
@@ -141,13 +159,17 @@ public:
 private:
     //// Loading Resources From Web ///////////////////////////////////////////
     void LoadResource(const QUrl& url, int redirectDepth);
+    /// Requests `url` without checking if it is already loaded or cached.
+    void FetchResource(const QUrl& url, int redirectDepth, bool conditional);
     Q_SLOT void ResourceLoadingFinished();
-    void DeleteReplyAndCheckForFinish(QNetworkReply* reply);
-    QString AddResource(QNetworkReply* reply, const QString& redirectLocation);
+    void DeleteFetchAndCheckForFinish(ScheduledFetch* fetch);
+    void AddResource(const QUrl& url, const QString& contentType, const QByteArray& data,
+                     const QString& redirectLocation);
 
     //// File Parsing /////////////////////////////////////////////////////////
-    void ParseAndAddHTMLResources(QNetworkReply* reply);
-    void ParseAndAddCSSResources(QNetworkReply* reply);
+    /// Loads the resources referenced in html and css files; `contentType` must be raw.
+    void ParseAndAddResources(const QUrl& url, const QString& contentType, const QByteArray& data);
+    void ParseAndAddHTMLResources(const QUrl& url, const QByteArray& data);
     void ParseAndAddInlineCSSResources(const QUrl& baseUrl, const QByteArray& style);
     void DecideAndLoadURL(const QUrl& baseURL, const QString& linkedURL);
 
@@ -156,6 +178,9 @@ private:
     void GenerateMHT();
     // For single-file saves
     void GenerateFile();
+    // Encodes the large parts of a page in parallel
+    static void EncodeParts(QVector<MIMEPart>& parts);
+    static void EncodePart(MIMEPart& part);
 
     //// Utility Functions ////////////////////////////////////////////////////
     int findResourceWithURL(const QUrl& url);
@@ -164,6 +189,4 @@ private:
     bool isMimeTypeTextFile(const QString& mimeType);
     QString getOrGuessMimeType(QNetworkReply* reply, const QByteArray& data);
 
-    QByteArray getHTMLStyles(const QByteArray& html);
-    QByteArray stripHTMLScripts(const QByteArray& html);
 };
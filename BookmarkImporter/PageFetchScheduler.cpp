@@ -0,0 +1,258 @@
+#include "PageFetchScheduler.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTimer>
+
+ScheduledFetch::ScheduledFetch(PageFetchScheduler* scheduler, const QNetworkRequest& request, QObject* parent)
+    : QObject(parent), m_scheduler(scheduler), m_request(request), m_reply(NULL)
+    , m_done(false), m_timedOut(false), m_bytesReceived(0), m_lastActivityMSecs(0)
+{
+
+}
+
+ScheduledFetch::~ScheduledFetch()
+{
+    //The reply is our child and is deleted after us; but the scheduler must not count it anymore.
+    if (!m_done && !m_scheduler.isNull())
+        m_scheduler->Forget(this);
+}
+
+QUrl ScheduledFetch::url() const
+{
+    return m_request.url();
+}
+
+QNetworkReply* ScheduledFetch::reply() const
+{
+    return m_reply;
+}
+
+bool ScheduledFetch::timedOut() const
+{
+    return m_timedOut;
+}
+
+void ScheduledFetch::abort()
+{
+    if (!m_done && !m_scheduler.isNull())
+        m_scheduler->Abort(this);
+}
+
+PageFetchScheduler::PageFetchScheduler(int maxConcurrentFetches, int maxFetchesPerHost, QObject* parent)
+    : QObject(parent), m_maxConcurrentFetches(qMax(1, maxConcurrentFetches))
+    , m_maxFetchesPerHost(qMax(1, maxFetchesPerHost))
+{
+    qnam = new QNetworkAccessManager(this);
+
+    m_firstByteTimeout = 30;
+    m_stallTimeout = 30;
+
+    m_stats.activeFetches = 0;
+    m_stats.queuedFetches = 0;
+    m_stats.maxActiveFetches = 0;
+    m_stats.finishedFetches = 0;
+    m_stats.failedFetches = 0;
+    m_stats.timedOutFetches = 0;
+    m_stats.bytesReceived = 0;
+    m_stats.bytesPerSecond = 0;
+
+    m_clock.start();
+    m_watchTimer = new QTimer(this);
+    m_watchTimer->setInterval(1000);
+    connect(m_watchTimer, SIGNAL(timeout()), this, SLOT(CheckFetches()));
+}
+
+PageFetchScheduler::~PageFetchScheduler()
+{
+    //Finish whatever is left so that no one waits for them forever; queued ones first, so that
+    //  finishing the active ones doesn't start them.
+    while (!m_queue.isEmpty())
+        Abort(m_queue.first());
+    foreach (QNetworkReply* reply, m_activeFetches.keys())
+        if (m_activeFetches.contains(reply))
+            reply->abort();
+}
+
+void PageFetchScheduler::setTimeouts(int firstByteTimeout, int stallTimeout)
+{
+    m_firstByteTimeout = firstByteTimeout;
+    m_stallTimeout = stallTimeout;
+}
+
+ScheduledFetch* PageFetchScheduler::Get(const QNetworkRequest& request, QObject* parent)
+{
+    ScheduledFetch* fetch = new ScheduledFetch(this, request, parent);
+
+    //Lower values of QNetworkRequest::Priority are more important. Keep the order of requests
+    //  with the same priority.
+    int priority = request.priority();
+    int insertPos = m_queue.size();
+    while (insertPos > 0 && m_queue[insertPos - 1]->m_request.priority() > priority)
+        insertPos -= 1;
+    m_queue.insert(insertPos, fetch);
+
+    //Doesn't emit anything, so the caller can still connect to `finished()` after we return.
+    StartQueuedFetches();
+    return fetch;
+}
+
+PageFetchScheduler::Stats PageFetchScheduler::stats() const
+{
+    return m_stats;
+}
+
+void PageFetchScheduler::FetchProgress(qint64 bytesReceived, qint64 bytesTotal)
+{
+    Q_UNUSED(bytesTotal);
+    ScheduledFetch* fetch = m_activeFetches.value(qobject_cast<QNetworkReply*>(sender()), NULL);
+    if (fetch == NULL || bytesReceived <= fetch->m_bytesReceived)
+        return;
+
+    m_stats.bytesReceived += bytesReceived - fetch->m_bytesReceived;
+    fetch->m_bytesReceived = bytesReceived;
+    fetch->m_lastActivityMSecs = m_clock.elapsed();
+}
+
+void PageFetchScheduler::FetchFinished()
+{
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    ScheduledFetch* fetch = m_activeFetches.take(reply);
+    if (fetch == NULL)
+        return;
+
+    QString host = HostKey(fetch->url());
+    m_activeFetchesPerHost[host] -= 1;
+    if (m_activeFetchesPerHost[host] <= 0)
+        m_activeFetchesPerHost.remove(host);
+
+    m_stats.activeFetches -= 1;
+    m_stats.finishedFetches += 1;
+    if (fetch->m_timedOut)
+        m_stats.timedOutFetches += 1;
+    else if (reply->error() != QNetworkReply::NoError)
+        m_stats.failedFetches += 1;
+
+    fetch->m_done = true;
+    StartQueuedFetches();
+
+    //The caller may start new fetches or delete this one in response.
+    emit fetch->finished();
+}
+
+void PageFetchScheduler::CheckFetches()
+{
+    qint64 now = m_clock.elapsed();
+
+    //Aborting emits `finished()` synchronously and callers may start or abort other fetches in
+    //  response, so look up each reply again instead of keeping the fetch pointers.
+    foreach (QNetworkReply* reply, m_activeFetches.keys())
+    {
+        ScheduledFetch* fetch = m_activeFetches.value(reply, NULL);
+        if (fetch == NULL)
+            continue;
+
+        int timeout = (fetch->m_bytesReceived == 0 ? m_firstByteTimeout : m_stallTimeout);
+        if (timeout > 0 && now - fetch->m_lastActivityMSecs > timeout * 1000LL)
+        {
+            fetch->m_timedOut = true;
+            reply->abort();
+        }
+    }
+
+    //Measure the throughput over the last few ticks.
+    m_rateSamples.append(m_stats.bytesReceived);
+    if (m_rateSamples.size() > RateSamplesCount + 1)
+        m_rateSamples.removeFirst();
+    if (m_rateSamples.size() >= 2)
+        m_stats.bytesPerSecond = (m_rateSamples.last() - m_rateSamples.first())
+                                 / (double)(m_rateSamples.size() - 1);
+
+    if (m_activeFetches.isEmpty())
+    {
+        m_watchTimer->stop();
+        m_rateSamples.clear();
+        m_stats.bytesPerSecond = 0;
+    }
+}
+
+void PageFetchScheduler::StartQueuedFetches()
+{
+    //The queue is by priority, so this starts the most important fetch whose host is not busy.
+    for (int i = 0; i < m_queue.size() && m_activeFetches.size() < m_maxConcurrentFetches; )
+    {
+        ScheduledFetch* fetch = m_queue[i];
+        if (m_activeFetchesPerHost.value(HostKey(fetch->url()), 0) < m_maxFetchesPerHost)
+        {
+            m_queue.removeAt(i);
+            Start(fetch);
+        }
+        else
+        {
+            i += 1;
+        }
+    }
+
+    m_stats.queuedFetches = m_queue.size();
+}
+
+void PageFetchScheduler::Start(ScheduledFetch* fetch)
+{
+    QNetworkReply* reply = qnam->get(fetch->m_request);
+    reply->setParent(fetch);
+    connect(reply, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(FetchProgress(qint64,qint64)));
+    connect(reply, SIGNAL(finished()), this, SLOT(FetchFinished()));
+
+    fetch->m_reply = reply;
+    fetch->m_lastActivityMSecs = m_clock.elapsed();
+    m_activeFetches.insert(reply, fetch);
+    m_activeFetchesPerHost[HostKey(fetch->url())] += 1;
+
+    m_stats.activeFetches += 1;
+    m_stats.maxActiveFetches = qMax(m_stats.maxActiveFetches, m_stats.activeFetches);
+
+    if (!m_watchTimer->isActive())
+        m_watchTimer->start();
+}
+
+void PageFetchScheduler::Abort(ScheduledFetch* fetch)
+{
+    if (fetch->m_reply != NULL)
+    {
+        fetch->m_reply->abort(); //`FetchFinished` does the rest.
+        return;
+    }
+
+    m_queue.removeOne(fetch);
+    m_stats.queuedFetches = m_queue.size();
+    fetch->m_done = true;
+    emit fetch->finished();
+}
+
+void PageFetchScheduler::Forget(ScheduledFetch* fetch)
+{
+    if (fetch->m_reply == NULL)
+    {
+        m_queue.removeOne(fetch);
+        m_stats.queuedFetches = m_queue.size();
+        return;
+    }
+
+    //Its reply is about to be deleted, which aborts it; we won't hear from it again.
+    disconnect(fetch->m_reply, 0, this, 0);
+    if (m_activeFetches.remove(fetch->m_reply) == 0)
+        return;
+
+    QString host = HostKey(fetch->url());
+    m_activeFetchesPerHost[host] -= 1;
+    if (m_activeFetchesPerHost[host] <= 0)
+        m_activeFetchesPerHost.remove(host);
+    m_stats.activeFetches -= 1;
+
+    StartQueuedFetches();
+}
+
+QString PageFetchScheduler::HostKey(const QUrl& url)
+{
+    return url.host().toLower();
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <QObject>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+class PageFetchScheduler;
+
+/// A request given to PageFetchScheduler. It waits in the scheduler's queue until it can be
+///     started, then `reply()` becomes non-NULL. `finished()` is emitted once, whether the reply
+///     finished, failed or timed out, or the fetch was aborted before being started.
+/// Deleting the fetch also deletes and aborts its reply.
+class ScheduledFetch : public QObject
+{
+    Q_OBJECT
+    friend class PageFetchScheduler;
+
+private:
+    QPointer<PageFetchScheduler> m_scheduler;
+    QNetworkRequest m_request;
+    QNetworkReply* m_reply;
+    bool m_done;
+    bool m_timedOut;
+    qint64 m_bytesReceived;
+    qint64 m_lastActivityMSecs; //On the scheduler's clock; start time until the first bytes arrive.
+
+    ScheduledFetch(PageFetchScheduler* scheduler, const QNetworkRequest& request, QObject* parent);
+
+public:
+    ~ScheduledFetch();
+
+    QUrl url() const;
+    /// NULL if it was not started yet, or was aborted before being started.
+    QNetworkReply* reply() const;
+    /// If true, the reply was aborted by the scheduler because nothing was received for too long.
+    bool timedOut() const;
+
+public slots:
+    void abort();
+
+signals:
+    void finished();
+};
+
+/// Runs the network requests of many MHTSavers on a single QNetworkAccessManager, so that their
+///     connections to the same hosts are reused, and limits how many of them run at once both in
+///     total and for each host; the rest are queued.
+/// Queued requests with a higher QNetworkRequest::Priority are started first; MHTSaver requests
+///     the resources of pages it has already started with a high priority so that they finish
+///     before new pages start.
+/// Timeouts are judged by received bytes, not the total time: a request is aborted if it receives
+///     no bytes for `firstByteTimeout` seconds after starting, or for `stallTimeout` seconds at any
+///     later time. Large downloads that keep progressing are never aborted.
+class PageFetchScheduler : public QObject
+{
+    Q_OBJECT
+    friend class ScheduledFetch;
+
+public:
+    struct Stats
+    {
+        int activeFetches;
+        int queuedFetches;
+        int maxActiveFetches; //The most that ran at once.
+        long long finishedFetches; //Includes failed and timed out ones.
+        long long failedFetches;
+        long long timedOutFetches;
+        long long bytesReceived;
+        double bytesPerSecond; //Over the last few seconds.
+    };
+
+private:
+    QNetworkAccessManager* qnam;
+    const int m_maxConcurrentFetches;
+    const int m_maxFetchesPerHost;
+    int m_firstByteTimeout;
+    int m_stallTimeout;
+
+    QList<ScheduledFetch*> m_queue; //By descending priority, then by order of request.
+    QHash<QNetworkReply*, ScheduledFetch*> m_activeFetches;
+    QHash<QString, int> m_activeFetchesPerHost;
+    Stats m_stats;
+
+    QElapsedTimer m_clock;
+    QTimer* m_watchTimer;
+    enum { RateSamplesCount = 5 };
+    QList<long long> m_rateSamples; //bytesReceived at each of the last few ticks of m_watchTimer.
+
+public:
+    /// `maxFetchesPerHost` should not be more than QNetworkAccessManager's own per-host connection
+    ///   count (6 in Qt5), otherwise the extra requests wait inside it, with their timers running.
+    explicit PageFetchScheduler(int maxConcurrentFetches = 24, int maxFetchesPerHost = 6,
+                                QObject* parent = 0);
+    ~PageFetchScheduler();
+
+    /// Seconds. Pass -1 to disable.
+    void setTimeouts(int firstByteTimeout, int stallTimeout);
+
+    /// The returned fetch is owned by `parent`; delete it (or `deleteLater` it) when done with it.
+    ScheduledFetch* Get(const QNetworkRequest& request, QObject* parent);
+
+    Stats stats() const;
+
+private slots:
+    void FetchProgress(qint64 bytesReceived, qint64 bytesTotal);
+    void FetchFinished();
+    void CheckFetches();
+
+private:
+    void StartQueuedFetches();
+    void Start(ScheduledFetch* fetch);
+    void Abort(ScheduledFetch* fetch);
+    /// Only for a fetch that is being deleted while queued or running.
+    void Forget(ScheduledFetch* fetch);
+
+    static QString HostKey(const QUrl& url);
+};
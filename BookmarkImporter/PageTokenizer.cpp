@@ -0,0 +1,321 @@
+#include "PageTokenizer.h"
+
+#include "Util/Util.h"
+
+#include <cstring>
+
+void PageTokenizer::TokenizeHTML(const QByteArray& html, const QStringList& loadLinkRelTypes,
+                                 bool stripScripts, HTMLInfo& info)
+{
+    //Do it for caller
+    info.links.clear();
+    info.title = QString();
+    info.strippedHTML = QByteArray();
+
+    const char* const begin = html.constData();
+    const char* const end = begin + html.size();
+    const char* p = begin;
+    const char* copiedUntil = begin; //Of strippedHTML
+
+    TagAttributes attributes;
+    while (p < end)
+    {
+        //Text is skipped as fast as possible.
+        p = (const char*)memchr(p, '<', end - p);
+        if (p == NULL)
+            break;
+        p += 1;
+
+        if (StartsWithNoCase(p, end, "!--"))
+        {
+            //Comments are skipped altogether; e.g commented out <img>s are not loaded.
+            const char* commentEnd = FindNoCase(p + 3, end, "-->");
+            p = (commentEnd == NULL ? end : commentEnd + 3);
+            continue;
+        }
+        if (p < end && (*p == '/' || *p == '!' || *p == '?'))
+        {
+            //End tags, doctype, etc.
+            const char* tagEnd = (const char*)memchr(p, '>', end - p);
+            p = (tagEnd == NULL ? end : tagEnd + 1);
+            continue;
+        }
+        if (p >= end || !isLetter(*p))
+            continue; //A lone '<' in the text.
+
+        const char* nameBegin = p;
+        while (p < end && !isSpace(*p) && *p != '>' && *p != '/')
+            p++;
+        const QByteArray tagName = QByteArray(nameBegin, p - nameBegin).toLower();
+
+        bool selfClosing;
+        p = ReadAttributes(p, end, attributes, selfClosing);
+
+        if (!attributes.src.isEmpty())
+            AddHTMLLink(attributes.src, info.links);
+        if (!attributes.background.isEmpty())
+            AddHTMLLink(attributes.background, info.links);
+        if (tagName == "link" && !attributes.href.isEmpty() &&
+            loadLinkRelTypes.contains(QString::fromUtf8(attributes.rel).trimmed(), Qt::CaseInsensitive))
+            AddHTMLLink(attributes.href, info.links);
+        if (!attributes.style.isEmpty())
+        {
+            if (attributes.style.contains('&'))
+                TokenizeCSS(Util::UnEscapeHTMLEntities(QString::fromUtf8(attributes.style)).toUtf8(), info.links);
+            else
+                TokenizeCSS(attributes.style, info.links);
+        }
+
+        //The contents of these elements are not html, and continue until their closing tag.
+        if (selfClosing || !(tagName == "script" || tagName == "style" || tagName == "textarea" ||
+                             tagName == "title"))
+            continue;
+
+        const QByteArray closeTag = "</" + tagName;
+        const char* contentEnd = FindNoCase(p, end, closeTag.constData());
+        if (contentEnd == NULL)
+            contentEnd = end; //Unclosed; syntax errors are not a big deal here.
+
+        if (tagName == "style")
+        {
+            TokenizeCSS(QByteArray::fromRawData(p, contentEnd - p), info.links);
+        }
+        else if (tagName == "title" && info.title.isNull())
+        {
+            info.title = Util::UnEscapeHTMLEntities(QString::fromUtf8(p, contentEnd - p));
+        }
+        else if (tagName == "script" && stripScripts && contentEnd > p)
+        {
+            //Unlike MAFF, we do not add '\n's here. Maybe this is in a JS string!
+            info.strippedHTML.append(copiedUntil, p - copiedUntil);
+            info.strippedHTML += "<!-- /* Script removed by snapshot save */ -->";
+            copiedUntil = contentEnd; //The closing tag is copied as it is.
+        }
+
+        //The closing tag is skipped in the next round.
+        p = contentEnd;
+    }
+
+    if (stripScripts)
+    {
+        if (copiedUntil == begin)
+            info.strippedHTML = html;
+        else
+            info.strippedHTML.append(copiedUntil, end - copiedUntil);
+    }
+}
+
+void PageTokenizer::TokenizeCSS(const QByteArray& css, QStringList& links)
+{
+    const char* const begin = css.constData();
+    const char* const end = begin + css.size();
+    const char* p = begin;
+    bool afterImport = false; //The next string is an imported url.
+
+    while (p < end)
+    {
+        const char c = *p;
+        if (c == '/' && p + 1 < end && p[1] == '*')
+        {
+            const char* commentEnd = FindNoCase(p + 2, end, "*/");
+            p = (commentEnd == NULL ? end : commentEnd + 2);
+        }
+        else if (c == '"' || c == '\'')
+        {
+            QByteArray value;
+            p = ReadCSSString(p, end, value);
+            if (afterImport)
+                AddLink(QString::fromUtf8(value).trimmed(), links);
+            afterImport = false;
+        }
+        else if ((c == 'u' || c == 'U') && StartsWithNoCase(p, end, "url(") &&
+                 (p == begin || !(isLetter(p[-1]) || p[-1] == '-' || (p[-1] >= '0' && p[-1] <= '9'))))
+        {
+            p += 4;
+            while (p < end && isSpace(*p))
+                p++;
+
+            QByteArray value;
+            if (p < end && (*p == '"' || *p == '\''))
+            {
+                p = ReadCSSString(p, end, value);
+            }
+            else
+            {
+                const char* valueBegin = p;
+                while (p < end && *p != ')')
+                    p++;
+                value = QByteArray::fromRawData(valueBegin, p - valueBegin);
+            }
+
+            const char* urlEnd = (const char*)memchr(p, ')', end - p);
+            p = (urlEnd == NULL ? end : urlEnd + 1);
+            AddLink(QString::fromUtf8(value).trimmed(), links);
+            afterImport = false;
+        }
+        else if (c == '@' && StartsWithNoCase(p, end, "@import"))
+        {
+            p += 7;
+            afterImport = true;
+        }
+        else
+        {
+            if (!isSpace(c))
+                afterImport = false;
+            p++;
+        }
+    }
+}
+
+QByteArray PageTokenizer::StripScripts(const QByteArray& html)
+{
+    HTMLInfo info;
+    TokenizeHTML(html, QStringList(), true, info);
+    return info.strippedHTML;
+}
+
+const char* PageTokenizer::ReadAttributes(const char* p, const char* end, TagAttributes& attributes,
+                                          bool& selfClosing)
+{
+    attributes.src.clear();
+    attributes.background.clear();
+    attributes.href.clear();
+    attributes.rel.clear();
+    attributes.style.clear();
+    selfClosing = false;
+
+    while (p < end)
+    {
+        while (p < end && isSpace(*p))
+            p++;
+        if (p >= end)
+            break;
+        if (*p == '>')
+            return p + 1;
+        if (*p == '/')
+        {
+            p++;
+            if (p < end && *p == '>')
+            {
+                selfClosing = true;
+                return p + 1;
+            }
+            continue;
+        }
+
+        const char* nameBegin = p;
+        while (p < end && !isSpace(*p) && *p != '=' && *p != '>' && *p != '/')
+            p++;
+        const char* nameEnd = p;
+
+        while (p < end && isSpace(*p))
+            p++;
+        if (p >= end || *p != '=')
+            continue; //Attribute without a value
+
+        p++;
+        while (p < end && isSpace(*p))
+            p++;
+
+        const char* valueBegin = p;
+        const char* valueEnd;
+        if (p < end && (*p == '"' || *p == '\''))
+        {
+            valueBegin = p + 1;
+            valueEnd = (const char*)memchr(valueBegin, *p, end - valueBegin);
+            if (valueEnd == NULL)
+                valueEnd = end;
+            p = (valueEnd == end ? end : valueEnd + 1);
+        }
+        else
+        {
+            while (p < end && !isSpace(*p) && *p != '>')
+                p++;
+            valueEnd = p;
+        }
+
+        QByteArray* target = NULL;
+        switch (nameEnd - nameBegin)
+        {
+        case 3:
+            if (StartsWithNoCase(nameBegin, nameEnd, "src"))
+                target = &attributes.src;
+            else if (StartsWithNoCase(nameBegin, nameEnd, "rel"))
+                target = &attributes.rel;
+            break;
+        case 4:
+            if (StartsWithNoCase(nameBegin, nameEnd, "href"))
+                target = &attributes.href;
+            break;
+        case 5:
+            if (StartsWithNoCase(nameBegin, nameEnd, "style"))
+                target = &attributes.style;
+            break;
+        case 10:
+            if (StartsWithNoCase(nameBegin, nameEnd, "background"))
+                target = &attributes.background;
+            break;
+        }
+        if (target != NULL)
+            *target = QByteArray::fromRawData(valueBegin, valueEnd - valueBegin);
+    }
+
+    return end;
+}
+
+const char* PageTokenizer::ReadCSSString(const char* p, const char* end, QByteArray& value)
+{
+    const char quote = *p;
+    p++;
+    const char* valueBegin = p;
+    while (p < end && *p != quote)
+    {
+        if (*p == '\\' && p + 1 < end)
+            p++; //Skip the escaped character.
+        p++;
+    }
+
+    value = QByteArray::fromRawData(valueBegin, p - valueBegin);
+    return (p < end ? p + 1 : end);
+}
+
+void PageTokenizer::AddHTMLLink(const QByteArray& value, QStringList& links)
+{
+    QString link = QString::fromUtf8(value).trimmed();
+    //Unescaping is slow, so only do it if there can be an entity.
+    if (link.contains('&'))
+        link = Util::UnEscapeHTMLEntities(link);
+    AddLink(link, links);
+}
+
+void PageTokenizer::AddLink(const QString& link, QStringList& links)
+{
+    //These are not separate resources.
+    if (link.isEmpty() || link.startsWith("data:", Qt::CaseInsensitive) ||
+        link.startsWith("javascript:", Qt::CaseInsensitive))
+        return;
+    links.append(link);
+}
+
+bool PageTokenizer::StartsWithNoCase(const char* p, const char* end, const char* lowerWord)
+{
+    for (; *lowerWord != '\0'; p++, lowerWord++)
+        if (p >= end || (isLetter(*p) ? (char)(*p | 0x20) : *p) != *lowerWord)
+            return false;
+    return true;
+}
+
+const char* PageTokenizer::FindNoCase(const char* p, const char* end, const char* lowerWord)
+{
+    //The first character is found fast; it is never a letter in our searches.
+    while (p < end)
+    {
+        p = (const char*)memchr(p, lowerWord[0], end - p);
+        if (p == NULL)
+            return NULL;
+        if (StartsWithNoCase(p, end, lowerWord))
+            return p;
+        p++;
+    }
+    return NULL;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+/// Finds what MHTSaver needs from html and css files in a single pass over their bytes, without
+///     decoding them or using regular expressions.
+/// This is a tokenizer, not a parser: it knows about tags, attributes, comments, quotes and the
+///     elements whose contents are not html (script, style, textarea, title), but not about the
+///     document structure, conditional comments, `<base href>` or css escapes.
+/// Like the rest of MHTSaver, it assumes the files are in UTF-8 or an ASCII-compatible encoding.
+class PageTokenizer
+{
+public:
+    struct HTMLInfo
+    {
+        /// Urls of the resources, in the order they appear: `src` and `background` attributes of
+        ///   all tags, `href` of <link>s with one of the given rel types, and `url()`s and
+        ///   `@import`s in <style> elements and `style` attributes. HTML entities are unescaped.
+        QStringList links;
+        /// Text of the first <title>, with entities unescaped. Null if there is none.
+        QString title;
+        /// Only if `stripScripts` is given: the html with the contents of scripts replaced with a
+        ///   comment. It is the same (shared) QByteArray if there were no inline scripts.
+        QByteArray strippedHTML;
+    };
+
+    static void TokenizeHTML(const QByteArray& html, const QStringList& loadLinkRelTypes,
+                             bool stripScripts, HTMLInfo& info);
+    /// Appends the urls of `url()`s and `@import "..."`s to `links`, skipping comments.
+    static void TokenizeCSS(const QByteArray& css, QStringList& links);
+    static QByteArray StripScripts(const QByteArray& html);
+
+private:
+    /// Only the attributes we use; they point into the html data.
+    struct TagAttributes
+    {
+        QByteArray src;
+        QByteArray background;
+        QByteArray href;
+        QByteArray rel;
+        QByteArray style;
+    };
+
+    static const char* ReadAttributes(const char* p, const char* end, TagAttributes& attributes,
+                                      bool& selfClosing);
+    /// `p` is at the opening quote. Returns the position after the closing quote.
+    static const char* ReadCSSString(const char* p, const char* end, QByteArray& value);
+    static void AddHTMLLink(const QByteArray& value, QStringList& links);
+    static void AddLink(const QString& link, QStringList& links);
+
+    static inline bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+    }
+    static inline bool isLetter(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+    /// `lowerWord` must be in lower case; for FindNoCase its first character must not be a letter.
+    static bool StartsWithNoCase(const char* p, const char* end, const char* lowerWord);
+    static const char* FindNoCase(const char* p, const char* end, const char* lowerWord);
+};
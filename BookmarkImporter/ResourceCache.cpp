@@ -0,0 +1,248 @@
+#include "ResourceCache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSaveFile>
+#include <QSet>
+
+ResourceCache::ResourceCache(const QString& dirPath, int maxMemorySizeMB, int maxDiskSizeMB, QObject* parent)
+    : QObject(parent), m_dirPath(dirPath), m_useDisk(true)
+{
+    m_contents.setMaxCost(maxMemorySizeMB * 1024);
+
+    m_stats.hits = 0;
+    m_stats.revalidations = 0;
+    m_stats.stores = 0;
+    m_stats.sharedContents = 0;
+    m_stats.bytesSaved = 0;
+
+    LoadIndex(maxDiskSizeMB);
+}
+
+ResourceCache::~ResourceCache()
+{
+    SaveIndex();
+}
+
+bool ResourceCache::LookupFresh(const QUrl& url, QString& contentType, QByteArray& data)
+{
+    const QString key = url.toString();
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(key);
+    if (it == m_entries.constEnd() || !it.value().fresh)
+        return false;
+
+    const Entry entry = it.value();
+    if (!ReadContents(entry.contentHash, data))
+    {
+        m_entries.remove(key);
+        return false;
+    }
+
+    contentType = entry.contentType;
+    m_stats.hits += 1;
+    m_stats.bytesSaved += data.size();
+    return true;
+}
+
+void ResourceCache::AddValidators(QNetworkRequest& request)
+{
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(request.url().toString());
+    if (it == m_entries.constEnd() || it.value().fresh)
+        return;
+
+    if (!it.value().eTag.isEmpty())
+        request.setRawHeader("If-None-Match", it.value().eTag);
+    if (!it.value().lastModified.isEmpty())
+        request.setRawHeader("If-Modified-Since", it.value().lastModified);
+}
+
+bool ResourceCache::Revalidated(const QUrl& url, QString& contentType, QByteArray& data)
+{
+    const QString key = url.toString();
+    QHash<QString, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end())
+        return false;
+
+    if (!ReadContents(it.value().contentHash, data))
+    {
+        m_entries.erase(it);
+        return false;
+    }
+
+    it.value().fresh = true;
+    contentType = it.value().contentType;
+    m_stats.revalidations += 1;
+    m_stats.bytesSaved += data.size();
+    return true;
+}
+
+QByteArray ResourceCache::Store(QNetworkReply* reply, const QString& contentType, const QByteArray& data)
+{
+    //Don't keep what the server doesn't want kept.
+    if (reply->rawHeader("Cache-Control").toLower().contains("no-store"))
+        return data;
+
+    const QByteArray contentHash = QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+    const QString contentPath = m_dirPath + "/" + contentHash;
+
+    QByteArray sharedData = data;
+    const QByteArray* inMemory = m_contents.object(contentHash);
+    if (inMemory != NULL)
+    {
+        sharedData = *inMemory;
+        m_stats.sharedContents += 1;
+    }
+    else if (m_useDisk && QFile::exists(contentPath))
+    {
+        KeepInMemory(contentHash, data);
+        m_stats.sharedContents += 1;
+    }
+    else
+    {
+        if (m_useDisk)
+        {
+            QSaveFile contentFile(contentPath);
+            if (!contentFile.open(QIODevice::WriteOnly) || contentFile.write(data) != data.size()
+                || !contentFile.commit())
+                qDebug() << "ResourceCache: Could not write" << contentPath;
+        }
+        KeepInMemory(contentHash, data);
+    }
+
+    Entry entry;
+    entry.contentType = contentType;
+    entry.eTag = reply->rawHeader("ETag");
+    entry.lastModified = reply->rawHeader("Last-Modified");
+    entry.contentHash = contentHash;
+    entry.fresh = true;
+    m_entries.insert(reply->url().toString(), entry);
+    m_stats.stores += 1;
+
+    return sharedData;
+}
+
+ResourceCache::Stats ResourceCache::stats() const
+{
+    return m_stats;
+}
+
+bool ResourceCache::ReadContents(const QByteArray& contentHash, QByteArray& data)
+{
+    const QByteArray* inMemory = m_contents.object(contentHash);
+    if (inMemory != NULL)
+    {
+        data = *inMemory;
+        return true;
+    }
+
+    if (!m_useDisk)
+        return false;
+
+    QFile contentFile(m_dirPath + "/" + contentHash);
+    if (!contentFile.open(QIODevice::ReadOnly))
+        return false;
+    data = contentFile.readAll();
+    KeepInMemory(contentHash, data);
+    return true;
+}
+
+void ResourceCache::KeepInMemory(const QByteArray& contentHash, const QByteArray& data)
+{
+    //QCache deletes the object at once if it is larger than the whole cache.
+    int cost = data.size() / 1024 + 1;
+    if (cost <= m_contents.maxCost())
+        m_contents.insert(contentHash, new QByteArray(data), cost);
+}
+
+void ResourceCache::LoadIndex(int maxDiskSizeMB)
+{
+    QDir dir(m_dirPath);
+    if (!dir.exists() && !dir.mkpath("."))
+    {
+        qDebug() << "ResourceCache: Could not create" << m_dirPath << ", caching only in memory.";
+        m_useDisk = false;
+        return;
+    }
+
+    //Rather than keeping track of which resources were used last, start over when it's too large.
+    qint64 diskSize = 0;
+    QFileInfoList files = dir.entryInfoList(QDir::Files);
+    foreach (const QFileInfo& fi, files)
+        diskSize += fi.size();
+    if (diskSize > maxDiskSizeMB * 1024LL * 1024LL)
+    {
+        foreach (const QFileInfo& fi, files)
+            QFile::remove(fi.filePath());
+        return;
+    }
+
+    QFile indexFile(IndexFilePath());
+    if (!indexFile.open(QIODevice::ReadOnly))
+        return; //Not used before.
+
+    QDataStream in(&indexFile);
+    qint32 version;
+    in >> version;
+    if (version != IndexFileVersion)
+        return;
+
+    while (!in.atEnd())
+    {
+        QString url;
+        Entry entry;
+        in >> url >> entry.contentType >> entry.eTag >> entry.lastModified >> entry.contentHash;
+        if (in.status() != QDataStream::Ok)
+            break;
+
+        //Those without validators can't be revalidated, so are useless from now on.
+        entry.fresh = false;
+        if (entry.eTag.isEmpty() && entry.lastModified.isEmpty())
+            continue;
+        m_entries.insert(url, entry);
+    }
+}
+
+void ResourceCache::SaveIndex()
+{
+    if (!m_useDisk)
+        return;
+
+    QSaveFile indexFile(IndexFilePath());
+    if (!indexFile.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "ResourceCache: Could not write" << IndexFilePath();
+        return;
+    }
+
+    QSet<QString> usedContents;
+    QDataStream out(&indexFile);
+    out << (qint32)IndexFileVersion;
+    for (QHash<QString, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+    {
+        const Entry& entry = it.value();
+        if (entry.eTag.isEmpty() && entry.lastModified.isEmpty())
+            continue;
+        out << it.key() << entry.contentType << entry.eTag << entry.lastModified << entry.contentHash;
+        usedContents.insert(QString::fromLatin1(entry.contentHash));
+    }
+    if (!indexFile.commit())
+        return;
+
+    //Remove the contents that no resource uses anymore.
+    QDir dir(m_dirPath);
+    const QString indexFileName = QFileInfo(IndexFilePath()).fileName();
+    foreach (const QString& fileName, dir.entryList(QDir::Files))
+        if (fileName != indexFileName && !usedContents.contains(fileName))
+            dir.remove(fileName);
+}
+
+QString ResourceCache::IndexFilePath() const
+{
+    return m_dirPath + "/index.dat";
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <QObject>
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QString>
+#include <QUrl>
+
+class QNetworkReply;
+class QNetworkRequest;
+
+/// Keeps the resources (css, js, images, fonts, ...) of the pages that MHTSaver saves, so that when
+///     many pages of a site are saved, their common resources are downloaded only once.
+/// Resources are remembered by url, together with their ETag and Last-Modified validators. Their
+///     contents are kept by their hash, in memory up to a limit and on disk in `dirPath`, so
+///     identical contents at different urls are stored once and shared in memory.
+/// Resources cached since the cache was opened are used as they are. Those cached before (i.e in an
+///     earlier import) must be revalidated with a conditional request; if the server replies
+///     '304 Not Modified' the cached contents are used.
+/// Caching is best-effort: if the disk can't be used, it only works in memory.
+class ResourceCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats
+    {
+        int hits; //Used without a request.
+        int revalidations; //Used after a '304 Not Modified'.
+        int stores;
+        int sharedContents; //Stored ones whose contents were already cached for another url.
+        long long bytesSaved; //Of the hits and revalidations.
+    };
+
+private:
+    struct Entry
+    {
+        QString contentType;
+        QByteArray eTag;
+        QByteArray lastModified;
+        QByteArray contentHash; //Hex; also the file name of the contents in the cache directory.
+        bool fresh; //Cached or revalidated since opening the cache.
+    };
+
+    enum { IndexFileVersion = 1 };
+
+    QString m_dirPath;
+    bool m_useDisk;
+    QHash<QString, Entry> m_entries; //By url
+    QCache<QByteArray, QByteArray> m_contents; //By hash; cost is in KBs.
+    Stats m_stats;
+
+public:
+    /// If the contents on disk are more than `maxDiskSizeMB`, they are all removed when opening.
+    ResourceCache(const QString& dirPath, int maxMemorySizeMB, int maxDiskSizeMB, QObject* parent = 0);
+    /// Writes the index of the resources to the disk.
+    ~ResourceCache();
+
+    /// Returns true if `url` can be used without a request.
+    bool LookupFresh(const QUrl& url, QString& contentType, QByteArray& data);
+    /// For resources cached before opening, adds the headers that make `request` conditional.
+    void AddValidators(QNetworkRequest& request);
+    /// Call for a '304 Not Modified' reply to a request made conditional by `AddValidators`.
+    ///   Returns false if the cached resource is not available anymore.
+    bool Revalidated(const QUrl& url, QString& contentType, QByteArray& data);
+    /// Caches a successfully fetched resource unless the server forbids it. Returns `data` itself,
+    ///   or the same contents that were already in memory so that they can be shared.
+    QByteArray Store(QNetworkReply* reply, const QString& contentType, const QByteArray& data);
+
+    Stats stats() const;
+
+private:
+    bool ReadContents(const QByteArray& contentHash, QByteArray& data);
+    void KeepInMemory(const QByteArray& contentHash, const QByteArray& data);
+
+    void LoadIndex(int maxDiskSizeMB);
+    void SaveIndex();
+    QString IndexFilePath() const;
+};
@@ -22,6 +22,7 @@ LOCAL_INCLUDE_DIRS = $$_PRO_FILE_PWD_ \
     $$_PRO_FILE_PWD_/BookmarkImporter \
     $$_PRO_FILE_PWD_/Bookmarks \
     $$_PRO_FILE_PWD_/Database \
+    $$_PRO_FILE_PWD_/Debug \
     $$_PRO_FILE_PWD_/Files \
     $$_PRO_FILE_PWD_/FileViewer \
     $$_PRO_FILE_PWD_/PreviewHandlers \
@@ -44,22 +45,36 @@ SOURCES += BMApplication.cpp \
     BookmarkFolders/BookmarkFoldersTreeWidget.cpp \
     BookmarkFolders/BookmarkFoldersView.cpp \
     BookmarkImporter/BookmarkImporter.cpp \
+    BookmarkImporter/ChromiumBookmarksFileParser.cpp \
     BookmarkImporter/FirefoxBookmarkJSONFileParser.cpp \
+    BookmarkImporter/FirefoxPlacesFileParser.cpp \
     BookmarkImporter/ImportedBookmarkProcessor.cpp \
     BookmarkImporter/ImportedBookmarksPreviewDialog.cpp \
     BookmarkImporter/ImportedBookmarksProcessor.cpp \
+    BookmarkImporter/JsonStreamReader.cpp \
     BookmarkImporter/MHTSaver.cpp \
+    BookmarkImporter/PageFetchScheduler.cpp \
+    BookmarkImporter/PageTokenizer.cpp \
+    BookmarkImporter/ResourceCache.cpp \
+    Bookmarks/BookmarkBitmap.cpp \
     Bookmarks/BookmarkEditDialog.cpp \
     Bookmarks/BookmarkExtraInfoAddEditDialog.cpp \
     Bookmarks/BookmarkManager.cpp \
+    Bookmarks/BookmarkSearchIndex.cpp \
+    Bookmarks/BookmarkSearchThread.cpp \
+    Bookmarks/BookmarksModel.cpp \
     Bookmarks/BookmarksSortFilterProxyModel.cpp \
     Bookmarks/BookmarksView.cpp \
     Bookmarks/BookmarkViewDialog.cpp \
     Bookmarks/FiveStarRatingWidget.cpp \
     Bookmarks/MergeConfirmationDialog.cpp \
     Bookmarks/QuickBookmarkSelectDialog.cpp \
+    Database/DatabaseBackupThread.cpp \
     Database/DatabaseManager.cpp \
+    Debug/Benchmarks.cpp \
+    Debug/PageFetchBenchmark.cpp \
     Files/FileArchiveManager.cpp \
+    Files/FileArchiveVerifier.cpp \
     Files/FileManager.cpp \
     Files/FileSandBoxManager.cpp \
     Files/IArchiveManager.cpp \
@@ -80,6 +95,8 @@ SOURCES += BMApplication.cpp \
     Tags/TagManager.cpp \
     Tags/TagsView.cpp \
     Util/CtLogger.cpp \
+    Util/FileHasher.cpp \
+    Util/MimeEncoder.cpp \
     Util/TransactionalFileOperator.cpp \
     Util/Util.cpp \
     Util/WindowSizeMemory.cpp \
@@ -94,27 +111,41 @@ HEADERS += BMApplication.h \
     BookmarkFolders/BookmarkFoldersTreeWidget.h \
     BookmarkFolders/BookmarkFoldersView.h \
     BookmarkImporter/BookmarkImporter.h \
+    BookmarkImporter/ChromiumBookmarksFileParser.h \
     BookmarkImporter/FirefoxBookmarkJSONFileParser.h \
+    BookmarkImporter/FirefoxPlacesFileParser.h \
     BookmarkImporter/ImportedBookmarkProcessor.h \
     BookmarkImporter/ImportedBookmarksPreviewDialog.h \
     BookmarkImporter/ImportedBookmarksProcessor.h \
     BookmarkImporter/ImportedEntity.h \
+    BookmarkImporter/JsonStreamReader.h \
     BookmarkImporter/MHTSaver.h \
+    BookmarkImporter/PageFetchScheduler.h \
+    BookmarkImporter/PageTokenizer.h \
+    BookmarkImporter/ResourceCache.h \
+    Bookmarks/BookmarkBitmap.h \
     Bookmarks/BookmarkEditDialog.h \
     Bookmarks/BookmarkExtraInfoAddEditDialog.h \
     Bookmarks/BookmarkExtraInfoTypeChooser.h \
     Bookmarks/BookmarkFilter.h \
     Bookmarks/BookmarkManager.h \
+    Bookmarks/BookmarkSearchIndex.h \
+    Bookmarks/BookmarkSearchThread.h \
+    Bookmarks/BookmarksModel.h \
     Bookmarks/BookmarksSortFilterProxyModel.h \
     Bookmarks/BookmarksView.h \
     Bookmarks/BookmarkViewDialog.h \
     Bookmarks/FiveStarRatingWidget.h \
     Bookmarks/MergeConfirmationDialog.h \
     Bookmarks/QuickBookmarkSelectDialog.h \
+    Database/DatabaseBackupThread.h \
     Database/DatabaseManager.h \
     Database/IManager.h \
     Database/ISubManager.h \
+    Debug/Benchmarks.h \
+    Debug/PageFetchBenchmark.h \
     Files/FileArchiveManager.h \
+    Files/FileArchiveVerifier.h \
     Files/FileManager.h \
     Files/FileSandBoxManager.h \
     Files/IArchiveManager.h \
@@ -135,7 +166,9 @@ HEADERS += BMApplication.h \
     Tags/TagManager.h \
     Tags/TagsView.h \
     Util/CtLogger.h \
+    Util/FileHasher.h \
     Util/ListWidgetWithEmptyPlaceholder.h \
+    Util/MimeEncoder.h \
     Util/RichRadioButton.h \
     Util/TransactionalFileOperator.h \
     Util/Util.h \
@@ -0,0 +1,303 @@
+#include "BookmarkBitmap.h"
+
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+enum Operation { Op_Or, Op_And, Op_AndNot };
+}
+
+BookmarkBitmap::BookmarkBitmap()
+{
+}
+
+BookmarkBitmap BookmarkBitmap::FromSet(const QSet<long long>& BIDs)
+{
+    //Adding in order makes every array insertion an append.
+    QList<long long> sortedBIDs = BIDs.toList();
+    std::sort(sortedBIDs.begin(), sortedBIDs.end());
+
+    BookmarkBitmap bitmap;
+    foreach (long long BID, sortedBIDs)
+        bitmap.Add(BID);
+    return bitmap;
+}
+
+void BookmarkBitmap::Add(long long BID)
+{
+    if (BID < 0)
+        return; //Never a real BID.
+
+    const quint32 key = quint32(BID >> 16);
+    const quint16 low = quint16(BID & 0xFFFF);
+
+    int i = FindContainer(key);
+    if (i < 0)
+    {
+        i = -i - 1;
+        Container c;
+        c.key = key;
+        c.cardinality = 0;
+        containers.insert(i, c);
+    }
+
+    Container& c = containers[i];
+    if (c.isBitmap())
+    {
+        quint64& word = c.bits[low >> 6];
+        const quint64 mask = quint64(1) << (low & 63);
+        if (!(word & mask))
+        {
+            word |= mask;
+            c.cardinality++;
+        }
+        return;
+    }
+
+    if (c.array.isEmpty() || c.array.last() < low)
+    {
+        c.array.append(low);
+    }
+    else
+    {
+        QVector<quint16>::iterator it = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (*it == low)
+            return;
+        c.array.insert(it, low);
+    }
+    c.cardinality++;
+
+    if (c.cardinality > ArrayMaxSize)
+        ToBitmap(c);
+}
+
+void BookmarkBitmap::Remove(long long BID)
+{
+    if (BID < 0)
+        return;
+
+    const quint16 low = quint16(BID & 0xFFFF);
+    const int i = FindContainer(quint32(BID >> 16));
+    if (i < 0)
+        return;
+
+    Container& c = containers[i];
+    if (c.isBitmap())
+    {
+        quint64& word = c.bits[low >> 6];
+        const quint64 mask = quint64(1) << (low & 63);
+        if (!(word & mask))
+            return;
+        word &= ~mask;
+        c.cardinality--;
+        ToArrayIfSparse(c);
+    }
+    else
+    {
+        QVector<quint16>::iterator it = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (it == c.array.end() || *it != low)
+            return;
+        c.array.erase(it);
+        c.cardinality--;
+    }
+
+    if (c.cardinality == 0)
+        containers.remove(i);
+}
+
+bool BookmarkBitmap::Contains(long long BID) const
+{
+    if (BID < 0)
+        return false;
+
+    const quint16 low = quint16(BID & 0xFFFF);
+    const int i = FindContainer(quint32(BID >> 16));
+    if (i < 0)
+        return false;
+
+    const Container& c = containers[i];
+    if (c.isBitmap())
+        return (c.bits[low >> 6] >> (low & 63)) & 1;
+    return std::binary_search(c.array.constBegin(), c.array.constEnd(), low);
+}
+
+void BookmarkBitmap::clear()
+{
+    containers.clear();
+}
+
+bool BookmarkBitmap::isEmpty() const
+{
+    return containers.isEmpty();
+}
+
+int BookmarkBitmap::count() const
+{
+    int total = 0;
+    foreach (const Container& c, containers)
+        total += c.cardinality;
+    return total;
+}
+
+QList<long long> BookmarkBitmap::toList() const
+{
+    QList<long long> BIDs;
+    BIDs.reserve(count());
+    foreach (const Container& c, containers)
+    {
+        const long long high = (long long)c.key << 16;
+        if (c.isBitmap())
+        {
+            for (int w = 0; w < BitmapWords; w++)
+                for (quint64 word = c.bits[w]; word != 0; word &= word - 1) //Clears the lowest bit.
+                    BIDs.append(high + w * 64 + (qPopulationCount((word & (~word + 1)) - 1)));
+        }
+        else
+        {
+            foreach (quint16 low, c.array)
+                BIDs.append(high + low);
+        }
+    }
+    return BIDs;
+}
+
+BookmarkBitmap& BookmarkBitmap::operator|=(const BookmarkBitmap& other)
+{
+    foreach (const Container& otherC, other.containers)
+    {
+        int i = FindContainer(otherC.key);
+        if (i < 0)
+            containers.insert(-i - 1, otherC); //Implicitly shared, no copying.
+        else
+            Combine(containers[i], otherC, Op_Or);
+    }
+    return *this;
+}
+
+BookmarkBitmap& BookmarkBitmap::operator&=(const BookmarkBitmap& other)
+{
+    QVector<Container> result;
+    for (int i = 0; i < containers.size(); i++)
+    {
+        int j = other.FindContainer(containers[i].key);
+        if (j < 0)
+            continue;
+
+        Container& c = containers[i];
+        Combine(c, other.containers[j], Op_And);
+        if (c.cardinality > 0)
+            result.append(c);
+    }
+    containers.swap(result);
+    return *this;
+}
+
+BookmarkBitmap& BookmarkBitmap::operator-=(const BookmarkBitmap& other)
+{
+    QVector<Container> result;
+    for (int i = 0; i < containers.size(); i++)
+    {
+        Container& c = containers[i];
+        int j = other.FindContainer(c.key);
+        if (j >= 0)
+            Combine(c, other.containers[j], Op_AndNot);
+        if (c.cardinality > 0)
+            result.append(c);
+    }
+    containers.swap(result);
+    return *this;
+}
+
+int BookmarkBitmap::FindContainer(quint32 key) const
+{
+    //Returns -(insertion position + 1) when not found.
+    int low = 0, high = containers.size() - 1;
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        if (containers[mid].key < key)
+            low = mid + 1;
+        else if (containers[mid].key > key)
+            high = mid - 1;
+        else
+            return mid;
+    }
+    return -(low + 1);
+}
+
+void BookmarkBitmap::ToBitmap(Container& c)
+{
+    if (c.isBitmap())
+        return;
+
+    c.bits.fill(0, BitmapWords);
+    foreach (quint16 low, c.array)
+        c.bits[low >> 6] |= quint64(1) << (low & 63);
+    c.array.clear();
+}
+
+void BookmarkBitmap::ToArrayIfSparse(Container& c)
+{
+    if (!c.isBitmap() || c.cardinality > ArrayMaxSize)
+        return;
+
+    QVector<quint16> array;
+    array.reserve(c.cardinality);
+    for (int w = 0; w < BitmapWords; w++)
+        for (int b = 0; b < 64; b++)
+            if ((c.bits[w] >> b) & 1)
+                array.append(quint16(w * 64 + b));
+
+    c.array.swap(array);
+    c.bits.clear();
+}
+
+void BookmarkBitmap::Combine(Container& c, const Container& other, int operation)
+{
+    if (!c.isBitmap() && !other.isBitmap())
+    {
+        QVector<quint16> result;
+        result.reserve(operation == Op_Or ? c.array.size() + other.array.size() : c.array.size());
+        std::back_insert_iterator<QVector<quint16>> out(result);
+        if (operation == Op_Or)
+            std::set_union(c.array.constBegin(), c.array.constEnd(),
+                           other.array.constBegin(), other.array.constEnd(), out);
+        else if (operation == Op_And)
+            std::set_intersection(c.array.constBegin(), c.array.constEnd(),
+                                  other.array.constBegin(), other.array.constEnd(), out);
+        else
+            std::set_difference(c.array.constBegin(), c.array.constEnd(),
+                                other.array.constBegin(), other.array.constEnd(), out);
+
+        c.array.swap(result);
+        c.cardinality = c.array.size();
+        if (c.cardinality > ArrayMaxSize)
+            ToBitmap(c);
+        return;
+    }
+
+    //At least one is dense; do it word by word.
+    ToBitmap(c);
+    Container otherBitmap = other; //Only copies if it is an array.
+    ToBitmap(otherBitmap);
+
+    quint64* words = c.bits.data();
+    const quint64* otherWords = otherBitmap.bits.constData();
+    int cardinality = 0;
+    for (int w = 0; w < BitmapWords; w++)
+    {
+        if (operation == Op_Or)
+            words[w] |= otherWords[w];
+        else if (operation == Op_And)
+            words[w] &= otherWords[w];
+        else
+            words[w] &= ~otherWords[w];
+        cardinality += qPopulationCount(words[w]);
+    }
+
+    c.cardinality = cardinality;
+    ToArrayIfSparse(c);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <QList>
+#include <QSet>
+#include <QVector>
+
+/// A compressed set of BIDs, used for evaluating bookmark filters (folders, tags, search results).
+/// Roaring-style: BIDs are partitioned into chunks of 65536 by their high bits; each chunk is
+///   stored either as a sorted array of the low 16 bits while it is sparse, or as a 65536-bit
+///   bitmap when it is dense. Set operations on dense chunks are done 64 bits at a time.
+/// BIDs are AUTOINCREMENT and are not reused, so they are mostly dense in a few chunks.
+class BookmarkBitmap
+{
+private:
+    /// A chunk switches from array to bitmap above this many BIDs, when the array would be bigger.
+    static const int ArrayMaxSize = 4096;
+    static const int BitmapWords = 65536 / 64;
+
+    struct Container
+    {
+        quint32 key; //BID >> 16
+        int cardinality;
+        QVector<quint16> array; //Sorted. Used while `bits` is empty.
+        QVector<quint64> bits;  //BitmapWords words, or empty.
+
+        bool isBitmap() const { return !bits.isEmpty(); }
+    };
+
+    /// Sorted by key; no empty containers.
+    QVector<Container> containers;
+
+public:
+    BookmarkBitmap();
+
+    static BookmarkBitmap FromSet(const QSet<long long>& BIDs);
+
+    void Add(long long BID);
+    void Remove(long long BID);
+    bool Contains(long long BID) const;
+
+    void clear();
+    bool isEmpty() const;
+    int count() const;
+    QList<long long> toList() const;
+
+    BookmarkBitmap& operator|=(const BookmarkBitmap& other);
+    BookmarkBitmap& operator&=(const BookmarkBitmap& other);
+    /// Removes the BIDs that are in `other`, i.e AND NOT.
+    BookmarkBitmap& operator-=(const BookmarkBitmap& other);
+
+private:
+    int FindContainer(quint32 key) const;
+    static void ToBitmap(Container& c);
+    static void ToArrayIfSparse(Container& c);
+    static void Combine(Container& c, const Container& other, int operation);
+};
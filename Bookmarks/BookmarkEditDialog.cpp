@@ -13,9 +13,11 @@
 #include "QuickBookmarkSelectDialog.h"
 
 #include <QDebug>
+#include <QEventLoop>
 #include <QFileDialog>
 #include <QInputDialog>
 #include <QMenu>
+#include <QProgressDialog>
 #include <QStandardPaths>
 
 #include <QtSql/QSqlTableModel>
@@ -452,19 +454,36 @@ void BookmarkEditDialog::on_btnAttach_clicked()
     QFileInfo attachFileNameInfo(fileNames[0]);
     dbm->sets.SetSetting("LastAttachBrowseDir", attachFileNameInfo.absolutePath());
 
+    QStringList existingFileNames;
     foreach (QString fileName, fileNames)
     {
         //Remove possible extra quotes.
         if (fileName.left(1) == "\"" && fileName.right(1) == "\"")
             fileName = fileName.mid(1, fileName.length() - 2);
 
-        QFileInfo fileInfo(fileName);
-        if (!fileInfo.isFile())
+        if (!QFileInfo(fileName).isFile())
         {
             QMessageBox::warning(this, "Can't Attach Files", "The file \"" + fileName + "\" "
                                  "does not exist! It will be skipped and not attached.");
             continue;
         }
+        existingFileNames.append(fileName);
+    }
+
+    //Nothing is attached if the user cancels it; the attach UI stays as it is.
+    QList<FileHasher::Result> hashResults;
+    if (!HashFilesToAttach(existingFileNames, hashResults))
+        return;
+
+    foreach (const FileHasher::Result& hashResult, hashResults)
+    {
+        const QString& fileName = hashResult.filePath;
+        if (!hashResult.success)
+        {
+            QMessageBox::warning(this, "Can't Attach Files", "The file \"" + fileName + "\" "
+                                 "could not be read! It will be skipped and not attached.");
+            continue;
+        }
 
         //IMPORTANT: [File Attaching]:
         //Original file Information MUST be filled by us. We will SET BOTH `BFID` AND `FID` to -1,
@@ -481,11 +500,12 @@ void BookmarkEditDialog::on_btnAttach_clicked()
         bf.FID          = -1; //Leave to FileManager.
         bf.OriginalName = fileName;
         bf.ArchiveURL   = ""; //Leave to FileManager.
-        bf.ModifyDate   = fileInfo.lastModified();
-        bf.Size         = fileInfo.size();
-        bf.MD5          = Util::GetMD5HashForFile(fileName);
+        bf.ModifyDate   = QFileInfo(fileName).lastModified();
+        bf.Size         = hashResult.size;
+        bf.MD5          = hashResult.md5;
         bf.Ex_IsDefaultFileForEditedBookmark = false;
         bf.Ex_RemoveAfterAttach = ui->chkRemoveOriginalFile->isChecked();
+        bf.Ex_ContentHash = hashResult.strongHash;
 
         editedFilesList.append(bf);
     }
@@ -507,6 +527,39 @@ void BookmarkEditDialog::ClearAndSwitchToAttachedFilesTab()
     ui->twAttachedFiles->setFocus();
 }
 
+bool BookmarkEditDialog::HashFilesToAttach(const QStringList& fileNames,
+                                           QList<FileHasher::Result>& hashResults)
+{
+    //Hashing e.g a video takes long enough to freeze the dialog, so it's done on another thread.
+    FileHasher hasher;
+    //The strong hash is for content-addressed archives, so they don't read the files again later
+    //  on this thread. Both are computed in one pass.
+    hasher.SetFiles(fileNames, FileHasher::HT_MD5 | FileHasher::HT_Strong);
+
+    QProgressDialog progressDialog("Reading the files to attach, please wait...", "Cancel",
+                                   0, 100, this);
+    progressDialog.setWindowTitle("Attach Files");
+    progressDialog.setWindowModality(Qt::WindowModal);
+    connect(&hasher, SIGNAL(Progress(int)), &progressDialog, SLOT(setValue(int)));
+    connect(&progressDialog, SIGNAL(canceled()), &hasher, SLOT(Cancel()));
+
+    //Shown right away rather than after its default minimum duration, as until then nothing
+    //  would keep user from using this dialog (e.g attaching again or closing it) while the
+    //  event loop below runs.
+    progressDialog.setMinimumDuration(0);
+    progressDialog.show();
+
+    //Queued from the hasher thread, so it is not missed even if hashing finishes right away.
+    QEventLoop waitLoop;
+    connect(&hasher, SIGNAL(finished()), &waitLoop, SLOT(quit()));
+    hasher.start();
+    waitLoop.exec();
+    progressDialog.reset();
+
+    hashResults = hasher.Results(); //Out param
+    return !hasher.IsCancelled();
+}
+
 void BookmarkEditDialog::af_showAttachUI()
 {
     ui->stwFileAttachments->setCurrentWidget(ui->pageAttachNew);
@@ -2,6 +2,7 @@
 #include <QDialog>
 
 #include "Database/DatabaseManager.h"
+#include "Util/FileHasher.h"
 
 class FileManager;
 class QTableWidgetItem;
@@ -47,6 +48,9 @@ public:
 private:
     /// Validation before acception.
     bool validate();
+    /// Hashes the files on another thread, showing the progress. Returns false if the user
+    ///   cancelled it.
+    bool HashFilesToAttach(const QStringList& fileNames, QList<FileHasher::Result>& hashResults);
 
 public slots:
     void accept();
@@ -14,7 +14,13 @@ private:
     friend class BookmarksSortFilterProxyModel;
     QSet<long long> filterFOIDs;
     QSet<long long> filterBIDs;
+    /// If not empty, filterBIDs in the order of their relevance, e.g for full text search results.
+    QList<long long> rankedBIDs;
     QSet<long long> filterTIDs;
+    /// Bookmarks must have all of filterTIDs instead of any of them.
+    bool matchAllTIDs;
+    /// Bookmarks must have none of these tags.
+    QSet<long long> excludeTIDs;
 
     //For Folder or Tag filtering, the filterer just checks if there are entries or not.
     //However if the list of BIDs to filter is empty, it's not clear whether user has not set a
@@ -28,14 +34,18 @@ public:
     BookmarkFilter()
     {
         hasFilterBIDs = false;
+        matchAllTIDs = false;
     }
 
     void ClearFilters()
     {
         hasFilterBIDs = false;
+        matchAllTIDs = false;
         filterFOIDs.clear();
         filterBIDs.clear();
+        rankedBIDs.clear();
         filterTIDs.clear();
+        excludeTIDs.clear();
     }
 
     void FilterSpecificFolderIDs(const QSet<long long>& FOIDs)
@@ -43,15 +53,25 @@ public:
         filterFOIDs = FOIDs;
     }
 
-    void FilterSpecificBookmarkIDs(const QList<long long>& BIDs)
+    /// ranked: BIDs are ordered by relevance, best first. The default (unsorted) order of the
+    ///   bookmarks view then follows them instead of BIDs.
+    void FilterSpecificBookmarkIDs(const QList<long long>& BIDs, bool ranked = false)
     {
         hasFilterBIDs = true;
         filterBIDs = QSet<long long>::fromList(BIDs);
+        rankedBIDs = (ranked ? BIDs : QList<long long>());
     }
 
-    void FilterSpecificTagIDs(const QSet<long long>& TIDs)
+    /// By default bookmarks having ANY of the tags pass the filter.
+    void FilterSpecificTagIDs(const QSet<long long>& TIDs, bool matchAll = false)
     {
         filterTIDs = TIDs;
+        matchAllTIDs = matchAll;
+    }
+
+    void ExcludeTagIDs(const QSet<long long>& TIDs)
+    {
+        excludeTIDs = TIDs;
     }
 
 private:
@@ -60,6 +80,9 @@ private:
         return (hasFilterBIDs == another.hasFilterBIDs)
             && (filterFOIDs== another.filterFOIDs)
             && (filterBIDs == another.filterBIDs)
-            && (filterTIDs == another.filterTIDs);
+            && (rankedBIDs == another.rankedBIDs)
+            && (filterTIDs == another.filterTIDs)
+            && (matchAllTIDs == another.matchAllTIDs)
+            && (excludeTIDs == another.excludeTIDs);
     }
 };
@@ -7,16 +7,20 @@
 
 #include "Util/Util.h"
 
+#include <QRegularExpression>
+
 BookmarkManager::BookmarkManager(QWidget* dialogParent, Config* conf)
     : ISubManager(dialogParent, conf)
 {
+    searchIndexValid = false;
+    folderBitmapsValid = false;
+    fullTextSearchAvailable = false;
 }
 
 bool BookmarkManager::RetrieveBookmark(long long BID, BookmarkManager::BookmarkData& bdata)
 {
     QString retrieveError = "Could not get bookmark information from database.";
-    QSqlQuery query(db);
-    query.prepare("SELECT * FROM Bookmark WHERE BID = ?");
+    QSqlQuery query = CachedQuery("SELECT * FROM Bookmark WHERE BID = ?");
     query.addBindValue(BID);
 
     if (!query.exec())
@@ -35,6 +39,7 @@ bool BookmarkManager::RetrieveBookmark(long long BID, BookmarkManager::BookmarkD
     bdata.Rating   = record.value("Rating"  ).toInt();
     bdata.AddDate  = record.value("AddDate" ).toLongLong();
 
+    query.finish();
     return true;
 }
 
@@ -59,8 +64,12 @@ bool BookmarkManager::AddOrEditBookmark(long long& BID, BookmarkManager::Bookmar
                 "WHERE BID = ?";
     }
 
-    QSqlQuery query(db);
-    query.prepare(querystr);
+    //The bookmark is removed from its previous folder's bitmap only.
+    long long oldFOID = -1;
+    if (BID != -1 && !RetrieveBookmarkFOID(BID, oldFOID))
+        return false;
+
+    QSqlQuery query = CachedQuery(querystr);
 
     query.addBindValue(bdata.FOID);
     query.addBindValue(bdata.Name);
@@ -84,6 +93,42 @@ bool BookmarkManager::AddOrEditBookmark(long long& BID, BookmarkManager::Bookmar
         bdata.BID = addedBID;
     }
 
+    searchIndex.AddOrUpdate(BID, bdata.Name, bdata.URLs, bdata.Desc);
+    if (oldFOID != bdata.FOID)
+    {
+        if (oldFOID != -1)
+            RemoveFromFolderBitmap(BID, oldFOID);
+        folderBitmaps[bdata.FOID].Add(BID);
+    }
+    return true;
+}
+
+bool BookmarkManager::AddBookmarks(QList<BookmarkData>& bdatas, QList<long long>& addedBIDs)
+{
+    //Do it for caller
+    addedBIDs.clear();
+
+    const qint64 addDate = QDateTime::currentMSecsSinceEpoch();
+    QVariantList values;
+    values.reserve(bdatas.size() * 7);
+    foreach (const BookmarkData& bdata, bdatas)
+    {
+        //Same as AddOrEditBookmark.
+        values << bdata.FOID << bdata.Name << bdata.URLs << bdata.Desc << bdata.DefBFID
+               << bdata.Rating << addDate;
+    }
+
+    if (!MultiRowInsert("INSERT INTO Bookmark (FOID, Name, URLs, Desc, DefBFID, Rating, AddDate)", 7,
+                        values, "Could not add bookmark information to database.", &addedBIDs))
+        return false;
+
+    for (int i = 0; i < bdatas.size(); i++)
+    {
+        BookmarkData& bdata = bdatas[i];
+        bdata.BID = addedBIDs[i];
+        searchIndex.AddOrUpdate(bdata.BID, bdata.Name, bdata.URLs, bdata.Desc);
+        folderBitmaps[bdata.FOID].Add(bdata.BID);
+    }
     return true;
 }
 
@@ -92,8 +137,7 @@ bool BookmarkManager::SetBookmarkDefBFID(long long BID, long long BFID)
     QString setDefBFIDError =
             "Could not alter attached files information for the bookmark in the database.";
 
-    QSqlQuery query(db);
-    query.prepare("UPDATE Bookmark SET DefBFID = ? WHERE BID = ?");
+    QSqlQuery query = CachedQuery("UPDATE Bookmark SET DefBFID = ? WHERE BID = ?");
     query.addBindValue(BFID);
     query.addBindValue(BID);
 
@@ -105,13 +149,18 @@ bool BookmarkManager::SetBookmarkDefBFID(long long BID, long long BFID)
 
 bool BookmarkManager::RemoveBookmark(long long BID)
 {
-    QSqlQuery query(db);
-    query.prepare("DELETE FROM Bookmark WHERE BID = ?");
+    long long FOID;
+    if (!RetrieveBookmarkFOID(BID, FOID))
+        return false;
+
+    QSqlQuery query = CachedQuery("DELETE FROM Bookmark WHERE BID = ?");
     query.addBindValue(BID);
 
     if (!query.exec())
         return Error("Could not remove bookmark.", query.lastError());
 
+    searchIndex.Remove(BID);
+    RemoveFromFolderBitmap(BID, FOID);
     return true;
 }
 
@@ -173,6 +222,20 @@ bool BookmarkManager::RetrieveBookmarksInFolder(QList<long long>& BIDs, const lo
     return true;
 }
 
+void BookmarkManager::GetBookmarksInFoldersBitmap(const QSet<long long>& FOIDs, BookmarkBitmap& BIDs)
+{
+    if (!folderBitmapsValid) //E.g after a rollback, if the models are not re-populated yet.
+        RebuildFolderBitmaps();
+
+    BIDs.clear(); //Do it for caller
+    foreach (long long FOID, FOIDs)
+    {
+        QHash<long long, BookmarkBitmap>::const_iterator it = folderBitmaps.constFind(FOID);
+        if (it != folderBitmaps.constEnd())
+            BIDs |= it.value();
+    }
+}
+
 bool BookmarkManager::RetrieveBookmarksInFolders(QSet<long long>& BIDs, const QSet<long long>& FOIDs)
 {
     /// Mostly same as TagManager::GetBookmarkIDsForTags
@@ -210,9 +273,9 @@ bool BookmarkManager::InsertBookmarkIntoTrash(const QString& Folder, const QStri
         const QString& Tags, const QString& AttachedFIDs, const long long DefFID, const int Rating,
         long long AddDate, const QString& ExtraInfos)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO BookmarkTrash(Folder, Name, URLs, Desc, AttachedFIDs, DefFID, Rating, Tags, "
-                  "                          ExtraInfos, DeleteDate, AddDate) VALUES (?,?,?,?,?,?,?,?,?,?,?)");
+    QSqlQuery query = CachedQuery(
+                "INSERT INTO BookmarkTrash(Folder, Name, URLs, Desc, AttachedFIDs, DefFID, Rating, Tags, "
+                "                          ExtraInfos, DeleteDate, AddDate) VALUES (?,?,?,?,?,?,?,?,?,?,?)");
     query.addBindValue(Folder);
     query.addBindValue(Name);
     query.addBindValue(URLs);
@@ -234,10 +297,9 @@ bool BookmarkManager::InsertBookmarkIntoTrash(const QString& Folder, const QStri
 bool BookmarkManager::RetrieveLinkedBookmarks(long long BID, QList<long long>& linkedBIDs)
 {
     QString retrieveError = "Could not retrieve linked bookmark information from database.";
-    QSqlQuery query(db);
-    query.prepare("SELECT BID1 AS BID FROM BookmarkLink WHERE BID2 = ? "
-                  "UNION "
-                  "SELECT BID2 AS BID FROM BookmarkLink WHERE BID1 = ? ");
+    QSqlQuery query = CachedQuery("SELECT BID1 AS BID FROM BookmarkLink WHERE BID2 = ? "
+                                  "UNION "
+                                  "SELECT BID2 AS BID FROM BookmarkLink WHERE BID1 = ? ");
     query.addBindValue(BID);
     query.addBindValue(BID);
 
@@ -410,8 +472,7 @@ bool BookmarkManager::RemoveBookmarkExtraInfoFromModel(QSqlTableModel& extraInfo
 bool BookmarkManager::RetrieveBookmarkExtraInfos(long long BID, QList<BookmarkManager::BookmarkExtraInfoData>& extraInfos)
 {
     QString retrieveError = "Could not get bookmark extra information from database.";
-    QSqlQuery query(db);
-    query.prepare("SELECT * FROM BookmarkExtraInfo WHERE BID = ?");
+    QSqlQuery query = CachedQuery("SELECT * FROM BookmarkExtraInfo WHERE BID = ?");
     query.addBindValue(BID);
 
     if (!query.exec())
@@ -504,14 +565,15 @@ bool BookmarkManager::UpdateBookmarkExtraInfos(long long BID, const QList<Bookma
     //  which makes situation complicated.
     foreach (const BookmarkExtraInfoData& addExtraInfo, addExtraInfos)
     {
-        query.prepare("INSERT INTO BookmarkExtraInfo(BID, Name, Type, Value) VALUES (?, ?, ?, ?)");
-        query.addBindValue(BID); //Don't use addExtraInfo's one. More error-proof.
-        query.addBindValue(addExtraInfo.Name);
-        query.addBindValue(static_cast<int>(addExtraInfo.Type));
-        query.addBindValue(addExtraInfo.Value);
-
-        if (!query.exec())
-            return Error(addError, query.lastError());
+        QSqlQuery insertQuery = CachedQuery(
+                    "INSERT INTO BookmarkExtraInfo(BID, Name, Type, Value) VALUES (?, ?, ?, ?)");
+        insertQuery.addBindValue(BID); //Don't use addExtraInfo's one. More error-proof.
+        insertQuery.addBindValue(addExtraInfo.Name);
+        insertQuery.addBindValue(static_cast<int>(addExtraInfo.Type));
+        insertQuery.addBindValue(addExtraInfo.Value);
+
+        if (!insertQuery.exec())
+            return Error(addError, insertQuery.lastError());
     }
 
     //The model-based equivalent of this function does deletion, insertion and updates automatically
@@ -523,19 +585,31 @@ bool BookmarkManager::UpdateBookmarkExtraInfos(long long BID, const QList<Bookma
     QList<int> updateIndexes = UtilT::ListIntersect(extraInfos, originalExtraInfos, BookmarkExtraInfoKey);
     foreach (int updateIndex, updateIndexes)
     {
-        query.prepare("UPDATE BookmarkExtraInfo SET Name = ?, Type = ?, Value = ? WHERE BEIID = ?");
-        query.addBindValue(extraInfos[updateIndex].Name);
-        query.addBindValue(static_cast<int>(extraInfos[updateIndex].Type));
-        query.addBindValue(extraInfos[updateIndex].Value);
-        query.addBindValue(extraInfos[updateIndex].BEIID);
-
-        if (!query.exec())
-            return Error(updateError, query.lastError());
+        QSqlQuery updateQuery = CachedQuery(
+                    "UPDATE BookmarkExtraInfo SET Name = ?, Type = ?, Value = ? WHERE BEIID = ?");
+        updateQuery.addBindValue(extraInfos[updateIndex].Name);
+        updateQuery.addBindValue(static_cast<int>(extraInfos[updateIndex].Type));
+        updateQuery.addBindValue(extraInfos[updateIndex].Value);
+        updateQuery.addBindValue(extraInfos[updateIndex].BEIID);
+
+        if (!updateQuery.exec())
+            return Error(updateError, updateQuery.lastError());
     }
 
     return true;
 }
 
+bool BookmarkManager::AddBookmarksExtraInfos(const QList<BookmarkExtraInfoData>& extraInfos)
+{
+    QVariantList values;
+    values.reserve(extraInfos.size() * 4);
+    foreach (const BookmarkExtraInfoData& extraInfo, extraInfos)
+        values << extraInfo.BID << extraInfo.Name << static_cast<int>(extraInfo.Type) << extraInfo.Value;
+
+    return MultiRowInsert("INSERT INTO BookmarkExtraInfo(BID, Name, Type, Value)", 4, values,
+                          "Could not add bookmark extra information to database.");
+}
+
 bool BookmarkManager::RetrieveBookmarkNames(const QList<long long>& BIDs, QStringList& names)
 {
     names.clear(); //Do it for caller
@@ -661,6 +735,293 @@ bool BookmarkManager::RetrieveSpecificExtraInfoForAllBookmarks(const QString& ex
     return true;
 }
 
+QList<long long> BookmarkManager::SearchBookmarksText(const QString& searchTerm) const
+{
+    return searchIndex.Search(searchTerm);
+}
+
+void BookmarkManager::InvalidateSearchIndex()
+{
+    searchIndexValid = false;
+    folderBitmapsValid = false;
+}
+
+bool BookmarkManager::SearchBookmarksRegExp(const QRegularExpression& regExp, QList<long long>& BIDs)
+{
+    QSqlError error;
+    if (!SearchBookmarksRegExp(db, regExp, BIDs, error, NULL))
+        return Error("Could not search bookmarks in the database.", error);
+    return true;
+}
+
+bool BookmarkManager::SearchBookmarksFullText(const QString& searchText, QList<long long>& BIDs)
+{
+    QSqlError error;
+    if (!SearchBookmarksFullText(db, searchText, BIDs, error, NULL))
+        return Error("Could not search bookmarks.", error);
+    return true;
+}
+
+bool BookmarkManager::SearchBookmarksRegExp(QSqlDatabase& database, const QRegularExpression& regExp,
+                                            QList<long long>& BIDs, QSqlError& error,
+                                            const QAtomicInt* cancelled)
+{
+    BIDs.clear(); //Do it for caller
+
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT BID, Name, URLs, Desc FROM Bookmark"))
+    {
+        error = query.lastError();
+        return false;
+    }
+
+    int rowsRead = 0;
+    while (query.next())
+    {
+        if (cancelled != NULL && ++rowsRead % 256 == 0 && cancelled->loadAcquire() != 0)
+            return true;
+
+        if (regExp.match(query.value(1).toString(), 0).hasMatch() ||
+            regExp.match(query.value(2).toString(), 0).hasMatch() ||
+            regExp.match(query.value(3).toString(), 0).hasMatch())
+            BIDs.append(query.value(0).toLongLong());
+    }
+
+    return true;
+}
+
+bool BookmarkManager::SearchBookmarksFullText(QSqlDatabase& database, const QString& searchText,
+                                              QList<long long>& BIDs, QSqlError& error,
+                                              const QAtomicInt* cancelled)
+{
+    BIDs.clear(); //Do it for caller
+
+    QString matchExpression = FullTextMatchExpression(searchText);
+    if (matchExpression.isEmpty())
+        return true;
+
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    query.prepare("SELECT rowid FROM BookmarkFTS WHERE BookmarkFTS MATCH ? ORDER BY rank");
+    query.addBindValue(matchExpression);
+
+    if (!query.exec())
+    {
+        error = query.lastError();
+        return false;
+    }
+
+    int rowsRead = 0;
+    while (query.next())
+    {
+        if (cancelled != NULL && ++rowsRead % 1024 == 0 && cancelled->loadAcquire() != 0)
+            return true;
+        BIDs.append(query.value(0).toLongLong());
+    }
+
+    return true;
+}
+
+bool BookmarkManager::IsFullTextSearchAvailable() const
+{
+    return fullTextSearchAvailable;
+}
+
+QString BookmarkManager::FullTextMatchExpression(const QString& searchText)
+{
+    //Quote every word as an FTS5 string, so that user input is never interpreted as FTS5 query
+    //  syntax (e.g `AND`, `-`, `:` or unbalanced quotes).
+    QStringList words = searchText.split(QRegularExpression("\\s+"), QString::SkipEmptyParts);
+    if (words.isEmpty())
+        return QString();
+
+    QStringList quotedWords;
+    foreach (const QString& word, words)
+        quotedWords.append("\"" + QString(word).replace('"', "\"\"") + "\"");
+    quotedWords.last() += "*";
+
+    return quotedWords.join(' ');
+}
+
+bool BookmarkManager::CreateFullTextSearchTables(bool populate)
+{
+    fullTextSearchAvailable = false;
+    if (!IsFTS5Supported())
+        return true;
+
+    QString createError = "Could not create the full-text search index.";
+    QSqlQuery query(db);
+
+    //The FTS table stores its own copy of the text, and its rowid is the BID. ExtraInfos holds
+    //  all BookmarkExtraInfo values of the bookmark concatenated.
+    QStringList queries = QStringList()
+        << "CREATE VIRTUAL TABLE BookmarkFTS USING fts5(Name, URLs, Desc, ExtraInfos)"
+
+        << "CREATE TRIGGER BookmarkFTS_BookmarkInsert AFTER INSERT ON Bookmark BEGIN "
+           "  INSERT INTO BookmarkFTS(rowid, Name, URLs, Desc, ExtraInfos) "
+           "  VALUES (new.BID, new.Name, new.URLs, new.Desc, ''); "
+           "END"
+        << "CREATE TRIGGER BookmarkFTS_BookmarkUpdate AFTER UPDATE OF Name, URLs, Desc ON Bookmark BEGIN "
+           "  UPDATE BookmarkFTS SET Name = new.Name, URLs = new.URLs, Desc = new.Desc "
+           "  WHERE rowid = new.BID; "
+           "END"
+        << "CREATE TRIGGER BookmarkFTS_BookmarkDelete AFTER DELETE ON Bookmark BEGIN "
+           "  DELETE FROM BookmarkFTS WHERE rowid = old.BID; "
+           "END"
+
+        << "CREATE TRIGGER BookmarkFTS_ExtraInfoInsert AFTER INSERT ON BookmarkExtraInfo BEGIN "
+           "  UPDATE BookmarkFTS SET ExtraInfos = (SELECT group_concat(Value, ' ') "
+           "    FROM BookmarkExtraInfo WHERE BID = new.BID) WHERE rowid = new.BID; "
+           "END"
+        << "CREATE TRIGGER BookmarkFTS_ExtraInfoUpdate AFTER UPDATE ON BookmarkExtraInfo BEGIN "
+           "  UPDATE BookmarkFTS SET ExtraInfos = (SELECT group_concat(Value, ' ') "
+           "    FROM BookmarkExtraInfo WHERE BID = old.BID) WHERE rowid = old.BID; "
+           "  UPDATE BookmarkFTS SET ExtraInfos = (SELECT group_concat(Value, ' ') "
+           "    FROM BookmarkExtraInfo WHERE BID = new.BID) WHERE rowid = new.BID; "
+           "END"
+        << "CREATE TRIGGER BookmarkFTS_ExtraInfoDelete AFTER DELETE ON BookmarkExtraInfo BEGIN "
+           "  UPDATE BookmarkFTS SET ExtraInfos = (SELECT group_concat(Value, ' ') "
+           "    FROM BookmarkExtraInfo WHERE BID = old.BID) WHERE rowid = old.BID; "
+           "END";
+
+    if (populate)
+        queries << "INSERT INTO BookmarkFTS(rowid, Name, URLs, Desc, ExtraInfos) "
+                   "SELECT BID, Name, URLs, Desc, "
+                   "  (SELECT group_concat(Value, ' ') FROM BookmarkExtraInfo WHERE BID = b.BID) "
+                   "FROM Bookmark b";
+
+    foreach (const QString& querystr, queries)
+        if (!query.exec(querystr))
+            return Error(createError, query.lastError());
+
+    fullTextSearchAvailable = true;
+    return true;
+}
+
+bool BookmarkManager::InitializeFullTextSearch()
+{
+    fullTextSearchAvailable = false;
+    QString checkError = "Could not check the full-text search index.";
+    QSqlQuery query(db);
+
+    if (!query.exec("SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = 'BookmarkFTS'")
+        || !query.first())
+        return Error(checkError, query.lastError());
+    bool tableExists = (query.value(0).toInt() > 0);
+
+    if (!query.exec("SELECT name FROM sqlite_master "
+                    "WHERE type = 'trigger' AND name LIKE 'BookmarkFTS\\_%' ESCAPE '\\'"))
+        return Error(checkError, query.lastError());
+    QStringList triggerNames;
+    while (query.next())
+        triggerNames.append(query.value(0).toString());
+
+    if (!IsFTS5Supported())
+    {
+        //E.g the database was used with an SQLite that had FTS5. Its triggers would make every
+        //  change to Bookmark and BookmarkExtraInfo fail, so drop them. The table itself can't be
+        //  dropped without the module; it is re-created when FTS5 is available again.
+        foreach (const QString& triggerName, triggerNames)
+            if (!query.exec("DROP TRIGGER " + triggerName))
+                return Error(checkError, query.lastError());
+        return true;
+    }
+
+    if (tableExists && triggerNames.size() == FullTextSearchTriggersCount)
+    {
+        fullTextSearchAvailable = true;
+        return true;
+    }
+
+    //Never created, e.g for a new database, or missed changes while its triggers were dropped.
+    foreach (const QString& triggerName, triggerNames)
+        if (!query.exec("DROP TRIGGER " + triggerName))
+            return Error(checkError, query.lastError());
+    if (tableExists && !query.exec("DROP TABLE BookmarkFTS"))
+        return Error(checkError, query.lastError());
+
+    return CreateFullTextSearchTables(true);
+}
+
+bool BookmarkManager::IsFTS5Supported()
+{
+    //Qt's bundled SQLite is not guaranteed to have been compiled with FTS5, and it may also be
+    //  loaded as an extension; so simply try it.
+    QSqlQuery query(db);
+    if (!query.exec("CREATE VIRTUAL TABLE temp.FTS5SupportCheck USING fts5(x)"))
+        return false;
+    query.exec("DROP TABLE temp.FTS5SupportCheck");
+    return true;
+}
+
+void BookmarkManager::RebuildSearchIndex()
+{
+    //The model doesn't keep the URLs and Desc, so read them directly.
+    searchIndex.Clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT BID, Name, URLs, Desc FROM Bookmark"))
+    {
+        Error("Error while building the bookmarks search index.", query.lastError());
+        return;
+    }
+
+    while (query.next())
+        searchIndex.AddOrUpdate(query.value(0).toLongLong(), query.value(1).toString(),
+                                query.value(2).toString(), query.value(3).toString());
+    searchIndexValid = true;
+}
+
+void BookmarkManager::RebuildFolderBitmaps()
+{
+    folderBitmaps.clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    //Ordered by BID, so that adding to the bitmaps are appends.
+    if (!query.exec("SELECT FOID, BID FROM Bookmark ORDER BY BID"))
+    {
+        Error("Error while building the bookmarks folder index.", query.lastError());
+        return;
+    }
+
+    while (query.next())
+        folderBitmaps[query.value(0).toLongLong()].Add(query.value(1).toLongLong());
+    folderBitmapsValid = true;
+}
+
+void BookmarkManager::RemoveFromFolderBitmap(long long BID, long long FOID)
+{
+    QHash<long long, BookmarkBitmap>::iterator it = folderBitmaps.find(FOID);
+    if (it == folderBitmaps.end())
+        return;
+
+    it.value().Remove(BID);
+    if (it.value().isEmpty())
+        folderBitmaps.erase(it);
+}
+
+bool BookmarkManager::RetrieveBookmarkFOID(long long BID, long long& FOID)
+{
+    FOID = -1; //Do it for caller
+
+    QSqlQuery query = CachedQuery("SELECT FOID FROM Bookmark WHERE BID = ?");
+    query.addBindValue(BID);
+
+    if (!query.exec())
+        return Error("Could not retrieve the folder of the bookmark.", query.lastError());
+
+    if (!query.first())
+        return Error("Could not retrieve the folder of the bookmark.\nThe bookmark was not found.");
+
+    FOID = query.value(0).toLongLong();
+    query.finish();
+    return true;
+}
+
 void BookmarkManager::SetBookmarkExtraInfoIndexes(const QSqlRecord& record)
 {
     beiidx.BEIID = record.indexOf("BEIID");
@@ -670,6 +1031,18 @@ void BookmarkManager::SetBookmarkExtraInfoIndexes(const QSqlRecord& record)
     beiidx.Value = record.indexOf("Value");
 }
 
+QStringList BookmarkManager::CreateIndexQueries()
+{
+    //Indexes for the foreign keys and other frequently filtered columns. The rowid (i.e BID,
+    //  BLID, etc) is implicitly part of every index, making e.g `SELECT BID WHERE FOID` covered.
+    return QStringList()
+        << "CREATE INDEX IF NOT EXISTS IX_Bookmark_FOID ON Bookmark(FOID)"
+        << "CREATE INDEX IF NOT EXISTS IX_BookmarkLink_BID1 ON BookmarkLink(BID1, BID2)"
+        << "CREATE INDEX IF NOT EXISTS IX_BookmarkLink_BID2 ON BookmarkLink(BID2, BID1)"
+        << "CREATE INDEX IF NOT EXISTS IX_BookmarkExtraInfo_BID ON BookmarkExtraInfo(BID)"
+        << "CREATE INDEX IF NOT EXISTS IX_BookmarkExtraInfo_Name ON BookmarkExtraInfo(Name)";
+}
+
 void BookmarkManager::CreateTables()
 {
     QSqlQuery query(db);
@@ -694,21 +1067,22 @@ void BookmarkManager::CreateTables()
                "( BEIID INTEGER PRIMARY KEY AUTOINCREMENT, BID INTEGER, "
                "  Name TEXT, Type TEXT, Value TEXT,"
                "  FOREIGN KEY(BID) REFERENCES Bookmark(BID) ON DELETE CASCADE )");
+
+    foreach (const QString& createIndexQuery, CreateIndexQueries())
+        query.exec(createIndexQuery);
+
+    //The full-text search table is created by `InitializeFullTextSearch` after opening.
 }
 
 void BookmarkManager::PopulateModelsAndInternalTables()
 {
-    model.setQuery("SELECT * FROM Bookmark", db);
-
-    if (model.lastError().isValid())
+    //Only fetches the small columns; URLs and Desc are loaded when they are displayed.
+    if (!model.Populate(db))
     {
         Error("Error while populating bookmark models.", model.lastError());
         return;
     }
 
-    while (model.canFetchMore())
-        model.fetchMore();
-
     //Indexes of empty model.record() from empty table are correct.
     bidx.BID      = model.record().indexOf("BID"     );
     bidx.FOID     = model.record().indexOf("FOID"    );
@@ -727,4 +1101,11 @@ void BookmarkManager::PopulateModelsAndInternalTables()
     model.setHeaderData(bidx.DefBFID , Qt::Horizontal, "Default File");
     model.setHeaderData(bidx.Rating  , Qt::Horizontal, "Rating"      );
     model.setHeaderData(bidx.AddDate , Qt::Horizontal, "Date Added"  );
+
+    //The model is re-populated after every action, but the search index is kept up-to-date
+    //  incrementally and is only rebuilt the first time or after being invalidated.
+    if (!searchIndexValid)
+        RebuildSearchIndex();
+    if (!folderBitmapsValid)
+        RebuildFolderBitmaps();
 }
@@ -1,6 +1,10 @@
 #pragma once
 #include "Database/ISubManager.h"
+#include "Bookmarks/BookmarkBitmap.h"
+#include "Bookmarks/BookmarkSearchIndex.h"
+#include "Bookmarks/BookmarksModel.h"
 #include "Files/FileManager.h"
+#include <QAtomicInt>
 #include <QHash>
 #include <QStringList>
 #include <QtSql/QSqlQueryModel>
@@ -8,6 +12,7 @@
 
 class DatabaseManager;
 class BookmarksView;
+class QRegularExpression;
 
 class BookmarkManager : public ISubManager
 {
@@ -15,7 +20,7 @@ class BookmarkManager : public ISubManager
     friend class BookmarksView;
 
 public:
-    QSqlQueryModel model;
+    BookmarksModel model;
 
     struct BookmarkExtraInfoIndexes
     {
@@ -94,6 +99,24 @@ public:
         QList<FileManager::BookmarkFile> Ex_FilesList;
     };
 
+private:
+    /// Built at the first `PopulateModelsAndInternalTables` and afterwards kept up-to-date by
+    ///   `AddOrEditBookmark` and `RemoveBookmark`. Rolled back actions can leave it out of sync with
+    ///   the database, so `InvalidateSearchIndex` makes the next populate rebuild it from scratch.
+    BookmarkSearchIndex searchIndex;
+    bool searchIndexValid;
+
+    /// BIDs of the bookmarks in each folder, for filtering. Maintained the same way as
+    ///   `searchIndex`, and invalidated along with it.
+    QHash<long long, BookmarkBitmap> folderBitmaps;
+    bool folderBitmapsValid;
+
+    /// Whether the `BookmarkFTS` full-text table exists; it is optional as the SQLite build we
+    ///   are linked to may lack the FTS5 module. Set once by `InitializeFullTextSearch`.
+    bool fullTextSearchAvailable;
+    /// The triggers that `CreateFullTextSearchTables` creates.
+    static const int FullTextSearchTriggersCount = 6;
+
 public:
     BookmarkManager(QWidget* dialogParent, Config* conf);
 
@@ -101,6 +124,9 @@ public:
     /// For adding bookmark (i.e when BID == -1), both the BID arg and bdata.BID will contain
     ///   the BID of the inserted bookmark.
     bool AddOrEditBookmark(long long& BID, BookmarkData& bdata);
+    /// Adds all `bdatas` with a few multi-row inserts; used for bulk imports. Like adding with
+    ///   AddOrEditBookmark, their `BID`s are set and also returned in `addedBIDs`, in order.
+    bool AddBookmarks(QList<BookmarkData>& bdatas, QList<long long>& addedBIDs);
     bool SetBookmarkDefBFID(long long BID, long long BFID);
     bool RemoveBookmark(long long BID);
 
@@ -108,6 +134,8 @@ public:
     bool CountBookmarksInFolders(int& count, const QSet<long long>& FOIDs);
     bool RetrieveBookmarksInFolder(QList<long long>& BIDs, const long long FOID);
     bool RetrieveBookmarksInFolders(QSet<long long>& BIDs, const QSet<long long>& FOIDs);
+    /// Same as `RetrieveBookmarksInFolders`, but from memory and as a bitmap, for filtering.
+    void GetBookmarksInFoldersBitmap(const QSet<long long>& FOIDs, BookmarkBitmap& BIDs);
 
     bool InsertBookmarkIntoTrash(
             const QString& Folder, const QString& Name, const QString& URLs, const QString& Description,
@@ -137,6 +165,9 @@ public:
     bool RetrieveBookmarkExtraInfos(long long BID, QList<BookmarkExtraInfoData>& extraInfos);
     bool UpdateBookmarkExtraInfos(long long BID, const QList<BookmarkExtraInfoData>& originalExtraInfos,
                                   const QList<BookmarkExtraInfoData>& extraInfos);
+    /// Adds extra infos of new bookmarks with multi-row inserts. Unlike the above, the `BID` of
+    ///   each item is used.
+    bool AddBookmarksExtraInfos(const QList<BookmarkExtraInfoData>& extraInfos);
 
     /// Convenience function mainly to get linked bookmarks' names. Preserves the order.
     bool RetrieveBookmarkNames(const QList<long long>& BIDs, QStringList& names);
@@ -147,8 +178,58 @@ public:
     /// Works case-sensitively.
     bool RetrieveSpecificExtraInfoForAllBookmarks(const QString& extraInfoName, QList<BookmarkExtraInfoData>& extraInfos);
 
+    //Searching
+    /// Finds bookmarks whose Name, URLs or Desc contain `searchTerm` case-insensitively, using the
+    ///   in-memory search index instead of scanning the model.
+    QList<long long> SearchBookmarksText(const QString& searchTerm) const;
+    /// Must be called when the database changes without going through this class, e.g when an
+    ///   action transaction is rolled back. Also invalidates the folder bitmaps.
+    void InvalidateSearchIndex();
+    /// Finds bookmarks whose Name, URLs or Desc match `regExp`. Reads them from the database, as
+    ///   the model doesn't keep URLs and Desc.
+    bool SearchBookmarksRegExp(const QRegularExpression& regExp, QList<long long>& BIDs);
+
+    /// Full-text search over Name, URLs, Desc and extra info values, using the FTS5 table.
+    ///   `searchText` is split into words which all must exist; the last word is prefix-matched
+    ///   to be useful while user is still typing. `BIDs` is ordered by BM25 rank, best first.
+    bool SearchBookmarksFullText(const QString& searchText, QList<long long>& BIDs);
+    bool IsFullTextSearchAvailable() const;
+
+    /// The implementations of the above two searches, without showing errors. They can be run
+    ///   on any connection to the database, e.g that of BookmarkSearchThread. If `cancelled` is
+    ///   given, it is checked every few rows; once it is non-zero the search stops and returns
+    ///   true with incomplete `BIDs`.
+    static bool SearchBookmarksRegExp(QSqlDatabase& database, const QRegularExpression& regExp,
+                                      QList<long long>& BIDs, QSqlError& error,
+                                      const QAtomicInt* cancelled);
+    static bool SearchBookmarksFullText(QSqlDatabase& database, const QString& searchText,
+                                        QList<long long>& BIDs, QSqlError& error,
+                                        const QAtomicInt* cancelled);
+    /// The FTS5 MATCH expression used by `SearchBookmarksFullText`.
+    static QString FullTextMatchExpression(const QString& searchText);
+
+    /// Creates the FTS5 table and the triggers that keep it in sync with Bookmark and
+    ///   BookmarkExtraInfo. If `populate` is true it also indexes the existing bookmarks.
+    /// Silently returns true if FTS5 is not supported, as full-text searching is optional.
+    /// Used both by `InitializeFullTextSearch` and database migration.
+    /// IMPORTANT: Migrations that drop and re-create the Bookmark or BookmarkExtraInfo tables
+    ///   also drop these triggers and must call this function again.
+    bool CreateFullTextSearchTables(bool populate);
+    /// Called once after opening the database. Creates the FTS5 table if it is missing, or
+    ///   rebuilds it if its triggers are missing; if FTS5 is not supported, drops the triggers
+    ///   so that they don't break changing the bookmarks.
+    bool InitializeFullTextSearch();
+
 private:
     void SetBookmarkExtraInfoIndexes(const QSqlRecord& record);
+    void RebuildSearchIndex();
+    void RebuildFolderBitmaps();
+    void RemoveFromFolderBitmap(long long BID, long long FOID);
+    bool RetrieveBookmarkFOID(long long BID, long long& FOID);
+    bool IsFTS5Supported();
+
+public:
+    static QStringList CreateIndexQueries();
 
 protected:
     // ISubManager interface
@@ -0,0 +1,164 @@
+#include "BookmarkSearchIndex.h"
+
+#include <algorithm>
+#include <iterator>
+
+BookmarkSearchIndex::BookmarkSearchIndex()
+{
+}
+
+void BookmarkSearchIndex::Clear()
+{
+    foldedTexts.clear();
+    postings.clear();
+}
+
+void BookmarkSearchIndex::AddOrUpdate(long long BID, const QString& name, const QString& urls,
+                                      const QString& desc)
+{
+    if (foldedTexts.contains(BID))
+        Remove(BID);
+
+    const QString foldedText = FoldedText(name, urls, desc);
+    foldedTexts.insert(BID, foldedText);
+
+    QVector<Trigram> trigrams;
+    ExtractTrigrams(foldedText, trigrams);
+    foreach (Trigram trigram, trigrams)
+    {
+        QVector<long long>& BIDs = postings[trigram];
+        //New bookmarks get increasing BIDs, so this is nearly always an append.
+        if (BIDs.isEmpty() || BIDs.last() < BID)
+        {
+            BIDs.append(BID);
+        }
+        else
+        {
+            QVector<long long>::iterator it = std::lower_bound(BIDs.begin(), BIDs.end(), BID);
+            if (it == BIDs.end() || *it != BID)
+                BIDs.insert(it, BID);
+        }
+    }
+}
+
+void BookmarkSearchIndex::Remove(long long BID)
+{
+    QHash<long long, QString>::iterator textIt = foldedTexts.find(BID);
+    if (textIt == foldedTexts.end())
+        return;
+
+    QVector<Trigram> trigrams;
+    ExtractTrigrams(textIt.value(), trigrams);
+    foldedTexts.erase(textIt);
+
+    foreach (Trigram trigram, trigrams)
+    {
+        QHash<Trigram, QVector<long long>>::iterator postingIt = postings.find(trigram);
+        if (postingIt == postings.end())
+            continue;
+
+        QVector<long long>& BIDs = postingIt.value();
+        QVector<long long>::iterator it = std::lower_bound(BIDs.begin(), BIDs.end(), BID);
+        if (it != BIDs.end() && *it == BID)
+            BIDs.erase(it);
+        if (BIDs.isEmpty())
+            postings.erase(postingIt);
+    }
+}
+
+QList<long long> BookmarkSearchIndex::Search(const QString& term) const
+{
+    QList<long long> foundBIDs;
+    const QString foldedTerm = term.toCaseFolded();
+    if (foldedTerm.isEmpty())
+        return foundBIDs;
+
+    //Too short to have a trigram; verify every stored text. Still much cheaper than going through
+    //  the model's QSqlRecords and QVariants.
+    if (foldedTerm.length() < 3)
+    {
+        for (QHash<long long, QString>::const_iterator it = foldedTexts.constBegin();
+             it != foldedTexts.constEnd(); ++it)
+            if (it.value().contains(foldedTerm))
+                foundBIDs.append(it.key());
+        qSort(foundBIDs);
+        return foundBIDs;
+    }
+
+    QVector<Trigram> trigrams;
+    ExtractTrigrams(foldedTerm, trigrams);
+
+    //Intersect starting with the shortest posting lists, so that the candidates set shrinks fast.
+    QList<const QVector<long long>*> lists;
+    foreach (Trigram trigram, trigrams)
+    {
+        QHash<Trigram, QVector<long long>>::const_iterator postingIt = postings.constFind(trigram);
+        if (postingIt == postings.constEnd())
+            return foundBIDs; //A trigram that no bookmark has.
+        lists.append(&postingIt.value());
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const QVector<long long>* a, const QVector<long long>* b)
+              { return a->size() < b->size(); });
+
+    QVector<long long> candidates = *lists[0];
+    QVector<long long> intersection;
+    for (int i = 1; i < lists.size() && !candidates.isEmpty(); i++)
+    {
+        intersection.clear();
+        intersection.reserve(candidates.size());
+        std::set_intersection(candidates.constBegin(), candidates.constEnd(),
+                              lists[i]->constBegin(), lists[i]->constEnd(),
+                              std::back_inserter(intersection));
+        candidates.swap(intersection);
+    }
+
+    //Having all trigrams doesn't mean having them consecutively; verify.
+    foreach (long long BID, candidates)
+        if (foldedTexts.value(BID).contains(foldedTerm))
+            foundBIDs.append(BID);
+
+    return foundBIDs;
+}
+
+int BookmarkSearchIndex::count() const
+{
+    return foldedTexts.size();
+}
+
+QString BookmarkSearchIndex::FoldedText(const QString& name, const QString& urls, const QString& desc)
+{
+    //The separators make sure a search term never matches across two fields, just like when
+    //  the fields are searched separately.
+    QString text;
+    text.reserve(name.length() + urls.length() + desc.length() + 2);
+    text += name;
+    text += QChar(0);
+    text += urls;
+    text += QChar(0);
+    text += desc;
+    return text.toCaseFolded();
+}
+
+void BookmarkSearchIndex::ExtractTrigrams(const QString& foldedText, QVector<Trigram>& trigrams)
+{
+    trigrams.clear();
+    const int length = foldedText.length();
+    if (length < 3)
+        return;
+
+    trigrams.reserve(length - 2);
+    const QChar* data = foldedText.constData();
+    for (int i = 0; i + 2 < length; i++)
+    {
+        if (data[i].isNull() || data[i+1].isNull() || data[i+2].isNull())
+            continue;
+
+        trigrams.append(  (Trigram(data[i  ].unicode()) << 32)
+                        | (Trigram(data[i+1].unicode()) << 16)
+                        |  Trigram(data[i+2].unicode()));
+    }
+
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+}
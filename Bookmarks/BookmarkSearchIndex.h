@@ -0,0 +1,44 @@
+#pragma once
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+/// An in-memory trigram inverted index over bookmarks' Name, URLs and Desc fields.
+/// Used for the plain-text (i.e non-RegExp) mode of the main window search box, which previously
+///   walked all rows of the bookmarks model on every keystroke.
+/// Search semantics are EXACTLY those of `QString::contains(term, Qt::CaseInsensitive)` on any of
+///   the three fields: the trigram postings only produce candidates, and each candidate is then
+///   verified against its stored case-folded text.
+/// Owned and kept up-to-date by BookmarkManager; see `BookmarkManager::SearchBookmarksText`.
+class BookmarkSearchIndex
+{
+private:
+    /// Three UTF-16 code units packed into the lower 48 bits.
+    typedef quint64 Trigram;
+
+    /// Case-folded "Name\0URLs\0Desc" of each indexed bookmark.
+    QHash<long long, QString> foldedTexts;
+    /// For each trigram, the SORTED list of BIDs that contain it.
+    QHash<Trigram, QVector<long long>> postings;
+
+public:
+    BookmarkSearchIndex();
+
+    void Clear();
+    /// Adds a new bookmark to the index, or re-indexes it if it is already there.
+    void AddOrUpdate(long long BID, const QString& name, const QString& urls, const QString& desc);
+    void Remove(long long BID);
+
+    /// Returns the BIDs of bookmarks whose Name, URLs or Desc contain `term` case-insensitively.
+    /// The returned list is sorted by BID.
+    QList<long long> Search(const QString& term) const;
+
+    int count() const;
+
+private:
+    static QString FoldedText(const QString& name, const QString& urls, const QString& desc);
+    /// Fills `trigrams` with the sorted, duplicate-free trigrams of `foldedText`. Trigrams that
+    ///   span the field separators are skipped, as no search term can contain them.
+    static void ExtractTrigrams(const QString& foldedText, QVector<Trigram>& trigrams);
+};
@@ -0,0 +1,109 @@
+#include "BookmarkSearchThread.h"
+
+#include "Bookmarks/BookmarkManager.h"
+
+#include <QMetaType>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+
+BookmarkSearchThread::BookmarkSearchThread(QObject* parent)
+    : QThread(parent), m_stop(false), m_hasRequest(false), m_latestGeneration(0)
+    , m_requestMode(SM_FullText), m_cancelled(0)
+{
+    //For queued connections of `SearchFinished`.
+    qRegisterMetaType<QList<long long>>("QList<long long>");
+}
+
+BookmarkSearchThread::~BookmarkSearchThread()
+{
+    Stop();
+    wait();
+}
+
+void BookmarkSearchThread::SetDatabaseFilePath(const QString& databaseFilePath)
+{
+    m_databaseFilePath = databaseFilePath;
+}
+
+quint64 BookmarkSearchThread::RequestSearch(SearchMode mode, const QString& searchText)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cancelled.storeRelease(1); //The running search, if any.
+    m_latestGeneration++;
+    m_requestMode = mode;
+    m_requestText = searchText;
+    m_hasRequest = true;
+    m_requestAvailable.wakeOne();
+    return m_latestGeneration;
+}
+
+void BookmarkSearchThread::Stop()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cancelled.storeRelease(1);
+    m_stop = true;
+    m_requestAvailable.wakeOne();
+}
+
+void BookmarkSearchThread::run()
+{
+    //Connections can only be used in the thread that created them; so this thread has its own.
+    const QString connectionName = "BookmarkSearchThread";
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(m_databaseFilePath);
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        bool opened = db.open();
+
+        forever
+        {
+            quint64 generation;
+            SearchMode mode;
+            QString searchText;
+            {
+                QMutexLocker locker(&m_mutex);
+                while (!m_hasRequest && !m_stop)
+                    m_requestAvailable.wait(&m_mutex);
+                if (m_stop)
+                    break;
+
+                generation = m_latestGeneration;
+                mode = m_requestMode;
+                searchText = m_requestText;
+                m_hasRequest = false;
+                m_cancelled.storeRelease(0);
+            }
+
+            QList<long long> BIDs;
+            QSqlError error;
+            bool success;
+            if (!opened)
+            {
+                success = false;
+                error = db.lastError();
+            }
+            else if (mode == SM_FullText)
+            {
+                success = BookmarkManager::SearchBookmarksFullText(db, searchText, BIDs, error,
+                                                                   &m_cancelled);
+            }
+            else
+            {
+                QRegularExpression regExp(searchText, QRegularExpression::CaseInsensitiveOption |
+                                                      QRegularExpression::UseUnicodePropertiesOption);
+                regExp.optimize();
+                success = BookmarkManager::SearchBookmarksRegExp(db, regExp, BIDs, error,
+                                                                 &m_cancelled);
+            }
+
+            //Set only by a newer request or stopping; the results are discarded then.
+            if (m_cancelled.loadAcquire() == 0)
+                emit SearchFinished(generation, BIDs, success, error.text());
+        }
+
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
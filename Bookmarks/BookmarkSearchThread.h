@@ -0,0 +1,65 @@
+#pragma once
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+/// Runs the bookmark searches that need to go through all bookmarks in the database, i.e
+///   full-text and RegExp searches, off the GUI thread; so typing in the search box never blocks.
+/// - Uses its own read-only connection to the database file; in WAL mode this doesn't block
+///   and isn't blocked by the GUI thread's writes. It only sees committed changes, and the
+///   GUI must request a new search after changing bookmarks.
+/// - Only the latest request matters: a new request cancels the queued one and makes the running
+///   one stop at its next check and discard its results.
+/// - Results are delivered with the `SearchFinished` signal, which is queued to the receiver's
+///   thread; receivers should compare its `generation` with that of their latest request.
+class BookmarkSearchThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum SearchMode
+    {
+        SM_FullText,
+        SM_RegExp
+    };
+
+private:
+    QString m_databaseFilePath;
+
+    //Guarded by m_mutex
+    QMutex m_mutex;
+    QWaitCondition m_requestAvailable;
+    bool m_stop;
+    bool m_hasRequest;
+    quint64 m_latestGeneration;
+    SearchMode m_requestMode;
+    QString m_requestText;
+
+    /// Set when the running search is superseded; checked by the search while reading rows.
+    QAtomicInt m_cancelled;
+
+public:
+    explicit BookmarkSearchThread(QObject* parent = 0);
+    /// Stops the thread and waits for it.
+    ~BookmarkSearchThread();
+
+    /// Must be called before starting the thread.
+    void SetDatabaseFilePath(const QString& databaseFilePath);
+
+    /// Queues a search, cancelling the previous one. Returns the generation of the request which
+    ///   is passed back in `SearchFinished`; generations are increasing and never 0.
+    quint64 RequestSearch(SearchMode mode, const QString& searchText);
+    void Stop();
+
+signals:
+    /// BIDs of full text searches are ranked best first; those of RegExp searches are in no
+    ///   particular order.
+    void SearchFinished(quint64 generation, const QList<long long>& BIDs, bool success,
+                        const QString& errorText);
+
+protected:
+    void run();
+};
@@ -0,0 +1,305 @@
+#include "BookmarksModel.h"
+
+#include <QCollator>
+#include <QDebug>
+#include <QtSql/QSqlQuery>
+
+#include <algorithm>
+#include <vector>
+
+BookmarksModel::BookmarksModel(QObject* parent)
+    : QAbstractTableModel(parent)
+{
+    m_colBID = m_colFOID = m_colName = m_colURLs = m_colDesc = -1;
+    m_colDefBFID = m_colRating = m_colAddDate = -1;
+}
+
+bool BookmarksModel::Populate(QSqlDatabase& db)
+{
+    beginResetModel();
+
+    ClearData();
+    m_db = db;
+    m_lastError = QSqlError();
+    m_record = db.record("Bookmark");
+
+    m_colBID     = m_record.indexOf("BID"    );
+    m_colFOID    = m_record.indexOf("FOID"   );
+    m_colName    = m_record.indexOf("Name"   );
+    m_colURLs    = m_record.indexOf("URLs"   );
+    m_colDesc    = m_record.indexOf("Desc"   );
+    m_colDefBFID = m_record.indexOf("DefBFID");
+    m_colRating  = m_record.indexOf("Rating" );
+    m_colAddDate = m_record.indexOf("AddDate");
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true); //Don't cache the rows in the result set, we have our own copy.
+
+    if (query.exec("SELECT COUNT(*) FROM Bookmark") && query.first())
+    {
+        int count = query.value(0).toInt();
+        m_BIDs.reserve(count);
+        m_FOIDs.reserve(count);
+        m_names.reserve(count);
+        m_DefBFIDs.reserve(count);
+        m_ratings.reserve(count);
+        m_addDates.reserve(count);
+    }
+    query.finish();
+
+    bool success = query.exec("SELECT BID, FOID, Name, DefBFID, Rating, AddDate "
+                              "FROM Bookmark ORDER BY BID");
+    if (success)
+    {
+        while (query.next())
+        {
+            m_BIDs    .append(query.value(0).toLongLong());
+            m_FOIDs   .append(query.value(1).toLongLong());
+            m_names   .append(query.value(2).toString());
+            m_DefBFIDs.append(query.value(3).toLongLong());
+            m_ratings .append(query.value(4).toInt());
+            m_addDates.append(query.value(5).toLongLong());
+        }
+    }
+    else
+    {
+        m_lastError = query.lastError();
+        ClearData();
+    }
+
+    endResetModel();
+    return success;
+}
+
+QSqlError BookmarksModel::lastError() const
+{
+    return m_lastError;
+}
+
+QSqlRecord BookmarksModel::record() const
+{
+    return m_record;
+}
+
+int BookmarksModel::RowOfBID(long long BID) const
+{
+    QVector<long long>::const_iterator it = std::lower_bound(m_BIDs.constBegin(), m_BIDs.constEnd(), BID);
+    if (it == m_BIDs.constEnd() || *it != BID)
+        return -1;
+    return it - m_BIDs.constBegin();
+}
+
+int BookmarksModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_BIDs.size();
+}
+
+int BookmarksModel::columnCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_record.count();
+}
+
+QVariant BookmarksModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_BIDs.size())
+        return QVariant();
+    if (role != Qt::DisplayRole && role != Qt::EditRole && role != SortRole)
+        return QVariant();
+
+    const int row = index.row();
+    const int column = index.column();
+
+    if (role == SortRole)
+        return SortKeys(column).value(row);
+
+    if (column == m_colBID)
+        return m_BIDs[row];
+    else if (column == m_colFOID)
+        return m_FOIDs[row];
+    else if (column == m_colName)
+        return m_names[row];
+    else if (column == m_colDefBFID)
+        return m_DefBFIDs[row];
+    else if (column == m_colRating)
+        return m_ratings[row];
+    else if (column == m_colAddDate)
+        return m_addDates[row];
+    else if (column == m_colURLs || column == m_colDesc)
+    {
+        const TextWindow& window = FetchWindow(row / WindowSize);
+        const QVector<QString>& texts = (column == m_colURLs ? window.URLs : window.descs);
+        return texts.value(row % WindowSize);
+    }
+
+    return QVariant();
+}
+
+QVariant BookmarksModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && (role == Qt::DisplayRole || role == Qt::EditRole))
+    {
+        if (m_headers.contains(section))
+            return m_headers[section];
+        if (section >= 0 && section < m_record.count())
+            return m_record.fieldName(section);
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+bool BookmarksModel::setHeaderData(int section, Qt::Orientation orientation, const QVariant& value,
+                                   int role)
+{
+    if (orientation != Qt::Horizontal || section < 0 || section >= m_record.count()
+        || (role != Qt::DisplayRole && role != Qt::EditRole))
+        return false;
+
+    m_headers[section] = value.toString();
+    emit headerDataChanged(orientation, section, section);
+    return true;
+}
+
+void BookmarksModel::ClearData()
+{
+    m_BIDs.clear();
+    m_FOIDs.clear();
+    m_names.clear();
+    m_DefBFIDs.clear();
+    m_ratings.clear();
+    m_addDates.clear();
+
+    m_windows.clear();
+    m_windowsMRU.clear();
+    m_sortKeys.clear();
+}
+
+const BookmarksModel::TextWindow& BookmarksModel::FetchWindow(int window) const
+{
+    QHash<int, TextWindow>::const_iterator it = m_windows.constFind(window);
+    if (it != m_windows.constEnd())
+    {
+        if (m_windowsMRU.first() != window)
+        {
+            m_windowsMRU.removeOne(window);
+            m_windowsMRU.prepend(window);
+        }
+        return it.value();
+    }
+
+    if (m_windows.size() >= MaxCachedWindows)
+        m_windows.remove(m_windowsMRU.takeLast());
+
+    const int firstRow = window * WindowSize;
+    const int lastRow = qMin(firstRow + WindowSize, m_BIDs.size()) - 1;
+
+    TextWindow& textWindow = m_windows[window];
+    m_windowsMRU.prepend(window);
+    textWindow.URLs.resize(lastRow - firstRow + 1);
+    textWindow.descs.resize(lastRow - firstRow + 1);
+
+    //Rows are ordered by BID, so the window is exactly a BID range.
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT BID, URLs, Desc FROM Bookmark WHERE BID BETWEEN ? AND ?");
+    query.addBindValue(m_BIDs[firstRow]);
+    query.addBindValue(m_BIDs[lastRow]);
+
+    if (!query.exec())
+    {
+        //Can't show errors from inside views' painting; the cells are just shown empty.
+        qDebug() << "BookmarksModel: Could not load bookmarks' URLs and descriptions:" << query.lastError();
+        return textWindow;
+    }
+
+    while (query.next())
+    {
+        int row = RowOfBID(query.value(0).toLongLong());
+        if (row < firstRow || row > lastRow)
+            continue; //Can't happen, unless the table is changed without re-populating us.
+        textWindow.URLs [row - firstRow] = query.value(1).toString();
+        textWindow.descs[row - firstRow] = query.value(2).toString();
+    }
+
+    return textWindow;
+}
+
+const QVector<long long>& BookmarksModel::SortKeys(int column) const
+{
+    if (column == m_colBID)
+        return m_BIDs;
+    else if (column == m_colFOID)
+        return m_FOIDs;
+    else if (column == m_colDefBFID)
+        return m_DefBFIDs;
+    else if (column == m_colAddDate)
+        return m_addDates;
+
+    QHash<int, QVector<long long>>::const_iterator it = m_sortKeys.constFind(column);
+    if (it != m_sortKeys.constEnd())
+        return it.value();
+
+    QVector<long long>& keys = m_sortKeys[column];
+    keys.fill(0, m_BIDs.size());
+
+    if (column == m_colRating)
+        for (int row = 0; row < m_ratings.size(); row++)
+            keys[row] = m_ratings[row];
+    else if (column == m_colName)
+        ComputeNameSortKeys(keys);
+    else if (column == m_colURLs || column == m_colDesc)
+        ComputeDatabaseSortKeys(column, keys);
+
+    return keys;
+}
+
+void BookmarksModel::ComputeNameSortKeys(QVector<long long>& keys) const
+{
+    //Collating once per row and sorting the collation keys is much faster than collating two
+    //  names in every comparison.
+    QCollator collator;
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+
+    std::vector<QCollatorSortKey> collationKeys;
+    collationKeys.reserve(m_names.size());
+    foreach (const QString& name, m_names)
+        collationKeys.push_back(collator.sortKey(name));
+
+    QVector<int> rows(m_names.size());
+    for (int row = 0; row < rows.size(); row++)
+        rows[row] = row;
+    std::sort(rows.begin(), rows.end(), [&collationKeys](int a, int b)
+              { return collationKeys[a].compare(collationKeys[b]) < 0; });
+
+    long long rank = 0;
+    for (int i = 0; i < rows.size(); i++)
+    {
+        if (i > 0 && collationKeys[rows[i - 1]].compare(collationKeys[rows[i]]) != 0)
+            rank++;
+        keys[rows[i]] = rank;
+    }
+}
+
+void BookmarksModel::ComputeDatabaseSortKeys(int column, QVector<long long>& keys) const
+{
+    //Let SQLite do the ordering so the column doesn't need to be loaded.
+    //Note: SQLite's BINARY collation orders by code points while QString compares UTF-16 code
+    //  units; they only differ for characters outside the BMP.
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT BID FROM Bookmark ORDER BY " + m_record.fieldName(column) + ", BID"))
+    {
+        qDebug() << "BookmarksModel: Could not sort bookmarks:" << query.lastError();
+        return;
+    }
+
+    long long rank = 0;
+    while (query.next())
+    {
+        int row = RowOfBID(query.value(0).toLongLong());
+        if (row != -1)
+            keys[row] = rank++;
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlRecord>
+
+/// The model of all bookmarks, replacing a fully-fetched `SELECT * FROM Bookmark` QSqlQueryModel.
+/// - Its columns are those of the Bookmark table, in the same order, so `record().indexOf` and
+///   `BookmarkManager::bidx` work the same as with QSqlQueryModel.
+/// - The small columns are kept resident in columnar arrays. The big URLs and Desc columns are
+///   loaded on demand, in windows of consecutive rows, when views ask for them; only the most
+///   recently used windows are kept.
+/// - Rows are ordered by BID.
+/// Like the other models it is re-populated after every change to the bookmarks, so it doesn't
+///   need to track changes itself.
+class BookmarksModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles
+    {
+        /// Values to sort by; the same as `SortKeys`.
+        SortRole = Qt::UserRole + 1
+    };
+
+private:
+    static const int WindowSize = 256;
+    static const int MaxCachedWindows = 32;
+
+    QSqlDatabase m_db;
+    QSqlRecord m_record;
+    QSqlError m_lastError;
+    QHash<int, QString> m_headers;
+
+    //Column indexes in m_record.
+    int m_colBID, m_colFOID, m_colName, m_colURLs, m_colDesc, m_colDefBFID, m_colRating, m_colAddDate;
+
+    //Resident columns; all have rowCount() items.
+    QVector<long long> m_BIDs;
+    QVector<long long> m_FOIDs;
+    QVector<QString> m_names;
+    QVector<long long> m_DefBFIDs;
+    QVector<int> m_ratings;
+    QVector<long long> m_addDates;
+
+    //Lazily-loaded columns
+    struct TextWindow
+    {
+        QVector<QString> URLs;
+        QVector<QString> descs;
+    };
+    mutable QHash<int, TextWindow> m_windows;
+    /// Window numbers, most recently used first.
+    mutable QList<int> m_windowsMRU;
+    /// Column index => sort key of each row, for columns that don't have integer values.
+    mutable QHash<int, QVector<long long>> m_sortKeys;
+
+public:
+    explicit BookmarksModel(QObject* parent = 0);
+
+    /// Loads the resident columns of all bookmarks from `db` and resets the model.
+    /// On error returns false and `lastError()` has the error; the model is empty then.
+    bool Populate(QSqlDatabase& db);
+    QSqlError lastError() const;
+    /// The Bookmark table's fields, without values; similar to `QSqlQueryModel::record()`.
+    QSqlRecord record() const;
+
+    /// Direct access to the resident columns, without going through QVariants.
+    long long BIDAt(int row) const { return m_BIDs[row]; }
+    long long FOIDAt(int row) const { return m_FOIDs[row]; }
+    /// Returns -1 if the bookmark is not in the model.
+    int RowOfBID(long long BID) const;
+
+    /// Returns an integer key for each row such that ordering rows by their keys orders them by
+    ///   `column`; this makes sorting a comparison of integers instead of QVariants.
+    /// - For integer columns these are the values themselves.
+    /// - For Name, it is the rank of the row when ordered by locale-aware, case-insensitive
+    ///   collation of names. Rows with equal names have equal ranks.
+    /// - For URLs and Desc, it is the rank of the row when SQLite orders the table by that
+    ///   column; so sorting doesn't need to load the whole column.
+    /// Keys other than integer values are computed on first use after each `Populate`.
+    const QVector<long long>& SortKeys(int column) const;
+
+    // QAbstractItemModel interface
+public:
+    virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    virtual int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+    virtual bool setHeaderData(int section, Qt::Orientation orientation, const QVariant& value,
+                               int role = Qt::EditRole);
+
+private:
+    void ClearData();
+    const TextWindow& FetchWindow(int window) const;
+    void ComputeNameSortKeys(QVector<long long>& keys) const;
+    void ComputeDatabaseSortKeys(int column, QVector<long long>& keys) const;
+};
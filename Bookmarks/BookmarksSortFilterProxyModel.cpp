@@ -4,6 +4,8 @@
 
 #include <QMimeData>
 
+#include <climits>
+
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlRecord>
 #include <QtSql/QSqlResult>
@@ -11,8 +13,10 @@
 BookmarksSortFilterProxyModel::BookmarksSortFilterProxyModel
     (DatabaseManager* dbm, QWidget* dialogParent, QObject* parent)
     : QSortFilterProxyModel(parent), IManager(dialogParent, dbm->conf), dbm(dbm), allowAllBookmarks(true)
+    , filterByBookmarkIDs(false)
 {
-
+    //Sorting by the URLs and Desc columns must not load them completely into the model.
+    setSortRole(BookmarksModel::SortRole);
 }
 
 bool BookmarksSortFilterProxyModel::SetFilter(const BookmarkFilter& filter, bool forceReset)
@@ -20,9 +24,19 @@ bool BookmarksSortFilterProxyModel::SetFilter(const BookmarkFilter& filter, bool
     //If the number of bookmarks is big, we can show a busy cursor to user while filtering.
     if (forceReset || !m_filter.FilterEquals(filter))
     {
+        bool rankChanged = (m_filter.rankedBIDs != filter.rankedBIDs);
         m_filter = filter;
         bool success = populateFilteredBookmarkIDs();
-        invalidateFilter(); //Read function header docs
+
+        //Filtering alone doesn't move the rows that were already shown, so sort again if the
+        //  ranking of the default order has changed. Before the user clicks any header the model
+        //  is not sorted at all, so start sorting it in the default order.
+        if (!bookmarkRanks.isEmpty() && sortColumn() == -1)
+            sort(dbm->bms.bidx.BID, Qt::AscendingOrder);
+        else if (rankChanged)
+            invalidate();
+        else
+            invalidateFilter(); //Read function header docs
         return success;
     }
     return true;
@@ -78,52 +92,64 @@ Qt::DropActions BookmarksSortFilterProxyModel::supportedDragActions() const
 bool BookmarksSortFilterProxyModel::populateFilteredBookmarkIDs()
 {
     bool first = true;
-    bool success = true;
     allowAllBookmarks = true;
+    filterByBookmarkIDs = false;
     filteredBookmarkIDs.clear();
+    excludedBookmarkIDs.clear();
+    bookmarkRanks.clear();
+
+    for (int i = 0; i < m_filter.rankedBIDs.size(); i++)
+        bookmarkRanks.insert(m_filter.rankedBIDs[i], i);
 
     //We will add items of the first filter to the master filter set, then we will intersect it with
-    //  the future filters. Hence the unite/intersect function choices below. (Well `intersect` for
-    //  the first filter is unused.) Can't use `if (filteredBookmarkIDs.empty())` because it may
-    //  have become empty in the previous filters, So we use a `first` variable.
+    //  the future filters. Can't use `if (filteredBookmarkIDs.isEmpty())` because it may have
+    //  become empty in the previous filters, So we use a `first` variable.
+    //The folder and tag bitmaps are kept in memory by their managers, so no queries are needed,
+    //  and the unions and intersections work on whole words of the bitmaps.
+    QList<BookmarkBitmap> filters;
 
     if (!m_filter.filterFOIDs.empty())
     {
-        allowAllBookmarks = false;
-        QSet<long long> bookmarkIDsForFolders;
-        if (!dbm->bms.RetrieveBookmarksInFolders(bookmarkIDsForFolders, m_filter.filterFOIDs))
-            success = false;
-        if (first)
-            filteredBookmarkIDs.unite(bookmarkIDsForFolders);
-        else
-            filteredBookmarkIDs.intersect(bookmarkIDsForFolders);
-        first = false;
+        BookmarkBitmap bookmarkIDsForFolders;
+        dbm->bms.GetBookmarksInFoldersBitmap(m_filter.filterFOIDs, bookmarkIDsForFolders);
+        filters.append(bookmarkIDsForFolders);
     }
 
     if (m_filter.hasFilterBIDs)
+        filters.append(BookmarkBitmap::FromSet(m_filter.filterBIDs));
+
+    if (!m_filter.filterTIDs.empty())
+    {
+        BookmarkBitmap bookmarkIDsForTags;
+        dbm->tags.GetBookmarksWithTagsBitmap(m_filter.filterTIDs, m_filter.matchAllTIDs,
+                                             bookmarkIDsForTags);
+        filters.append(bookmarkIDsForTags);
+    }
+
+    foreach (const BookmarkBitmap& filter, filters)
     {
         allowAllBookmarks = false;
+        filterByBookmarkIDs = true;
         if (first)
-            filteredBookmarkIDs.unite(m_filter.filterBIDs);
+            filteredBookmarkIDs = filter;
         else
-            filteredBookmarkIDs.intersect(m_filter.filterBIDs);
+            filteredBookmarkIDs &= filter;
         first = false;
     }
 
-    if (!m_filter.filterTIDs.empty())
+    if (!m_filter.excludeTIDs.empty())
     {
         allowAllBookmarks = false;
-        QSet<long long> bookmarkIDsForTags;
-        if (!dbm->tags.GetBookmarkIDsForTags(m_filter.filterTIDs, bookmarkIDsForTags))
-            success = false;
-        if (first)
-            filteredBookmarkIDs.unite(bookmarkIDsForTags);
-        else
-            filteredBookmarkIDs.intersect(bookmarkIDsForTags);
-        first = false;
+        dbm->tags.GetBookmarksWithTagsBitmap(m_filter.excludeTIDs, false, excludedBookmarkIDs);
+        if (filterByBookmarkIDs)
+        {
+            //No need to check both in `filterAcceptsRow`.
+            filteredBookmarkIDs -= excludedBookmarkIDs;
+            excludedBookmarkIDs.clear();
+        }
     }
 
-    return success;
+    return true;
 }
 
 bool BookmarksSortFilterProxyModel::filterAcceptsRow
@@ -134,9 +160,24 @@ bool BookmarksSortFilterProxyModel::filterAcceptsRow
     if (allowAllBookmarks)
         return true;
 
-    if (filteredBookmarkIDs.contains(
-        dbm->bms.model.index(source_row, dbm->bms.bidx.BID).data().toLongLong()))
-        return true;
+    //Read the BID directly; going through `index().data()` boxes every value into a QVariant,
+    //  for every row on each filtering.
+    long long BID = dbm->bms.model.BIDAt(source_row);
+    if (filterByBookmarkIDs)
+        return filteredBookmarkIDs.Contains(BID);
+    return !excludedBookmarkIDs.Contains(BID);
+}
 
-    return false;
+bool BookmarksSortFilterProxyModel::lessThan
+    (const QModelIndex& source_left, const QModelIndex& source_right) const
+{
+    //Ranked bookmarks (e.g full text search results) are shown best first in the default order.
+    if (!bookmarkRanks.isEmpty() && source_left.column() == dbm->bms.bidx.BID)
+        return bookmarkRanks.value(dbm->bms.model.BIDAt(source_left.row()), INT_MAX)
+             < bookmarkRanks.value(dbm->bms.model.BIDAt(source_right.row()), INT_MAX);
+
+    //Compare the precomputed integer sort keys instead of QVariants (and instead of collating
+    //  two names on every comparison).
+    const QVector<long long>& sortKeys = dbm->bms.model.SortKeys(source_left.column());
+    return sortKeys[source_left.row()] < sortKeys[source_right.row()];
 }
@@ -2,8 +2,10 @@
 #include <QSortFilterProxyModel>
 #include "Database/IManager.h"
 
+#include "BookmarkBitmap.h"
 #include "BookmarkFilter.h"
 #include "Database/DatabaseManager.h"
+#include <QHash>
 #include <QSet>
 
 class BookmarksSortFilterProxyModel : public QSortFilterProxyModel, public IManager
@@ -14,7 +16,14 @@ private:
     DatabaseManager* dbm;
     BookmarkFilter m_filter;
     bool allowAllBookmarks;
-    QSet<long long> filteredBookmarkIDs;
+    /// Whether bookmarks must be in `filteredBookmarkIDs`; otherwise they must not be in
+    ///   `excludedBookmarkIDs`.
+    bool filterByBookmarkIDs;
+    BookmarkBitmap filteredBookmarkIDs;
+    BookmarkBitmap excludedBookmarkIDs;
+    /// Position of each bookmark in `m_filter.rankedBIDs`; the default order (i.e sorting by the
+    ///   hidden BID column) uses it instead of the BIDs while it's not empty.
+    QHash<long long, int> bookmarkRanks;
 
 public:
     BookmarksSortFilterProxyModel(DatabaseManager* dbm, QWidget* dialogParent,
@@ -44,4 +53,5 @@ private:
 
 protected:
     virtual bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const;
+    virtual bool lessThan(const QModelIndex& source_left, const QModelIndex& source_right) const;
 };
@@ -67,6 +67,9 @@ bool BookmarksBusinessLogic::RollBackActionTransaction()
 {
     //Rolling back file transactions might fail, and is kinda a bad fail.
     dbm->db.rollback();
+    //The incremental search index and filter bitmaps updates of this transaction were not rolled back.
+    dbm->bms.InvalidateSearchIndex();
+    dbm->tags.InvalidateTagBitmaps();
 
     bool rollbackResult = dbm->files.RollBackFilesTransaction();
     if (!rollbackResult)
@@ -189,6 +192,69 @@ bool BookmarksBusinessLogic::AddOrEditBookmark(
     return true;
 }
 
+bool BookmarksBusinessLogic::AddBookmarksBatch(QList<NewBookmark>& newBookmarks, QList<long long>& addedBIDs,
+                                               QList<long long>& associatedTIDs)
+{
+    bool success;
+
+    QList<BookmarkManager::BookmarkData> bdatas;
+    foreach (const NewBookmark& nb, newBookmarks)
+        bdatas.append(nb.bdata);
+
+    success = dbm->bms.AddBookmarks(bdatas, addedBIDs);
+    if (!success)
+        return false;
+
+    QList<BookmarkManager::BookmarkExtraInfoData> extraInfos;
+    QList<QStringList> tagsLists;
+    for (int i = 0; i < newBookmarks.size(); i++)
+    {
+        newBookmarks[i].bdata.BID = addedBIDs[i];
+        foreach (BookmarkManager::BookmarkExtraInfoData extraInfo, newBookmarks[i].extraInfos)
+        {
+            extraInfo.BID = addedBIDs[i]; //Don't use the given one, like UpdateBookmarkExtraInfos.
+            extraInfos.append(extraInfo);
+        }
+        tagsLists.append(newBookmarks[i].tagsList);
+    }
+
+    success = dbm->bms.AddBookmarksExtraInfos(extraInfos);
+    if (!success)
+        return false;
+
+    success = dbm->tags.AddBookmarksTags(addedBIDs, tagsLists, associatedTIDs);
+    if (!success)
+        return false;
+
+    //Files are stored one bookmark at a time as in AddOrEditBookmark, but all in the same files
+    //  transaction.
+    const QList<FileManager::BookmarkFile> noOriginalFiles;
+    foreach (const NewBookmark& nb, newBookmarks)
+    {
+        if (nb.filesList.isEmpty())
+            continue;
+
+        QString fileArchiveName, folderHint;
+        success = dbm->bfs.GetFileArchiveAndFolderHint(nb.bdata.FOID, fileArchiveName, folderHint);
+        if (!success)
+            return false;
+
+        QList<long long> updatedBFIDs;
+        success = dbm->files.UpdateBookmarkFiles(nb.bdata.BID, folderHint, nb.bdata.Name,
+                                                 noOriginalFiles, nb.filesList, updatedBFIDs,
+                                                 fileArchiveName, "storing bookmark files information");
+        if (!success)
+            return false;
+
+        //[KeepDefaultFile-1]
+        success = dbm->bms.SetBookmarkDefBFID(nb.bdata.BID, updatedBFIDs[0]);
+        if (!success)
+            return false;
+    }
+
+    return true;
+}
+
 bool BookmarksBusinessLogic::DeleteBookmarksTrans(const QList<long long>& BIDs)
 {
     //[Similar BookmarksBusinessLogic Implementation]
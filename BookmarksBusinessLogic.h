@@ -6,6 +6,16 @@ class DatabaseManager;
 
 class BookmarksBusinessLogic
 {
+public:
+    /// A bookmark to be added by AddBookmarksBatch. Its first file, if any, becomes its default file.
+    struct NewBookmark
+    {
+        BookmarkManager::BookmarkData bdata;
+        QList<BookmarkManager::BookmarkExtraInfoData> extraInfos;
+        QStringList tagsList;
+        QList<FileManager::BookmarkFile> filesList;
+    };
+
 private:
     DatabaseManager* dbm;
     QWidget* dialogParent;
@@ -38,6 +48,13 @@ public:
             const QStringList& tagsList, QList<long long>& associatedTIDs,
             const QList<FileManager::BookmarkFile>& editedFilesList, int defaultFileIndex);
 
+    //Needs transaction to have been started before calling.
+    /// Adds many new bookmarks at once, e.g for imports, with multi-row inserts for the bookmarks,
+    ///   their extra infos and tags instead of the statements for each bookmark that
+    ///   AddOrEditBookmark runs. `addedBIDs` are in the same order as `newBookmarks`.
+    bool AddBookmarksBatch(QList<NewBookmark>& newBookmarks, QList<long long>& addedBIDs,
+                           QList<long long>& associatedTIDs);
+
     //The former ones are shortcut function that wrap the latter, which needs a transaction, in a transaction.
     bool DeleteBookmarksTrans(const QList<long long>& BIDs);
     bool DeleteBookmarkTrans(long long BID);
@@ -228,11 +228,25 @@ public:
     {
         //// SETTINGS DEFAULT VALUES
         defaultFsTransformUnicode = false;
+        defaultDbJournalMode = "WAL";
+        defaultDbSynchronous = "NORMAL";
+        defaultDbMmapSizeMB = 256;
+        defaultDbCacheSizeKB = 64 * 1024;
+        defaultDbTempStoreInMemory = true;
+        defaultBackupKeepLatest = 5;
+        defaultBackupKeepDaily = 7;
+        defaultBackupKeepWeekly = 8;
+        defaultImportBatchSize = 200;
 
         //// CONSTANTS
         concurrentBookmarkProcessings = 10;
+        maxConcurrentPageFetches = 24;
+        maxPageFetchesPerHost = 6;
+        resourceCacheDirName = "PageResourceCache";
+        resourceCacheMaxMemoryMB = 64;
+        resourceCacheMaxDiskMB = 512;
 
-        programDatabaseVersion = 4;
+        programDatabaseVersion = 7;
         programDatabasetFileName = "bmmgr.sqlite";
 
         nominalFileArchiveDirName = "FileArchive";
@@ -244,15 +258,39 @@ public:
         nominalFileSandBoxDirName = "FileSandBox";
         sandboxArchiveName = ":sandbox:";
 
+        nominalFileJournalDirName = "FileJournal";
+        fileArchiveCheckpointFileName = "FileArchiveCheck.txt";
+        fileArchiveCheckMaxMBPerRun = 16 * 1024;
+
         mimeTypeBookmarks = "application/x.bookmarkmanager.bookmarks";
     }
     ~Config() { }
 
     //// SETTINGS DEFAULT VALUES
     bool defaultFsTransformUnicode;
+    //Database tuning; see `DatabaseManager::TuneDatabase`.
+    QString defaultDbJournalMode;
+    QString defaultDbSynchronous;
+    int defaultDbMmapSizeMB;
+    int defaultDbCacheSizeKB;
+    bool defaultDbTempStoreInMemory;
+    //Backup retention; see `DatabaseBackupThread::RetentionPolicy`.
+    int defaultBackupKeepLatest;
+    int defaultBackupKeepDaily;
+    int defaultBackupKeepWeekly;
+    //Number of imported bookmarks added per transaction; see `BookmarkImporter::InitializeImport`.
+    int defaultImportBatchSize;
 
     //// CONSTANTS
     int concurrentBookmarkProcessings;
+    //Network requests of all the bookmark processings together; see `PageFetchScheduler`.
+    int maxConcurrentPageFetches;
+    int maxPageFetchesPerHost;
+    //Resources shared by the imported pages; see `ResourceCache`. The directory is in the user's
+    //  cache location.
+    QString resourceCacheDirName;
+    int resourceCacheMaxMemoryMB;
+    int resourceCacheMaxDiskMB;
 
     int programDatabaseVersion;
     QString programDatabasetFileName;
@@ -266,6 +304,13 @@ public:
     QString nominalFileSandBoxDirName;
     QString sandboxArchiveName;
 
+    //Of the files transactions; see `TransactionalFileOperator`. Next to the default archives.
+    QString nominalFileJournalDirName;
+    //Of checking the file archives; see `FileArchiveVerifier`. Bigger archives are checked in
+    //  several runs.
+    QString fileArchiveCheckpointFileName;
+    int fileArchiveCheckMaxMBPerRun;
+
     QString mimeTypeBookmarks;
 };
 
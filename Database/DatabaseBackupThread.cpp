@@ -0,0 +1,334 @@
+#include "DatabaseBackupThread.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QSet>
+#include <QTextStream>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+
+DatabaseBackupThread::DatabaseBackupThread(QObject* parent)
+    : QThread(parent)
+{
+    m_retention.keepLatest = 0;
+    m_retention.keepDaily = 0;
+    m_retention.keepWeekly = 0;
+}
+
+DatabaseBackupThread::~DatabaseBackupThread()
+{
+    requestInterruption();
+    wait();
+}
+
+void DatabaseBackupThread::SetBackupParameters(const QString& databaseFilePath,
+                                               const QString& backupsDirPath,
+                                               const RetentionPolicy& retention)
+{
+    m_databaseFilePath = databaseFilePath;
+    m_backupsDirPath = backupsDirPath;
+    m_retention = retention;
+}
+
+QString DatabaseBackupThread::BackupFileName(const QString& databaseFilePath, const QDateTime& dateTime)
+{
+    QFileInfo fileInfo(databaseFilePath);
+    return fileInfo.baseName()
+            + "-" + QLocale("en-us").toString(dateTime, "yyyy-MM-dd.hh.mm.ss")
+            + "." + fileInfo.completeSuffix() + ".bak";
+}
+
+void DatabaseBackupThread::run()
+{
+    QString fileStats = FileStatsFingerprint();
+    QString lastFileStats, lastChangeCounter, lastContentHash;
+    bool haveLastFingerprint = ReadLastFingerprint(lastFileStats, lastChangeCounter, lastContentHash);
+
+    if (haveLastFingerprint && fileStats == lastFileStats)
+    {
+        qDebug() << "DatabaseBackupThread: Database not modified since the last backup.";
+        return;
+    }
+
+    //Modification time changes e.g by just opening and closing the program, while the content
+    //  may be the same. Only the file header is read for it; hashing a big database every time
+    //  the program starts would be too much, even in the background.
+    QString changeCounter = ChangeCounter();
+    if (haveLastFingerprint && !changeCounter.isEmpty() && changeCounter == lastChangeCounter)
+    {
+        qDebug() << "DatabaseBackupThread: Database content not changed since the last backup.";
+        WriteLastFingerprint(fileStats, changeCounter, lastContentHash);
+        return;
+    }
+
+    if (isInterruptionRequested())
+        return;
+
+    QString backupFilePath = m_backupsDirPath + "/"
+                           + BackupFileName(m_databaseFilePath, QDateTime::currentDateTime());
+    QString errorText;
+    if (!CreateBackup(backupFilePath, errorText))
+    {
+        RemoveBackup(backupFilePath); //Don't leave partial backups behind.
+        if (!isInterruptionRequested())
+            emit BackupFailed("Backup file could not be created:\n" + backupFilePath + "\n\n" + errorText);
+        return;
+    }
+
+    //Without a change counter (i.e in WAL mode) this is the first point where we can tell if the
+    //  content has changed. The backups are compacted copies, so the same content gives the same
+    //  backup file.
+    QString contentHash = ContentHash(backupFilePath);
+    if (isInterruptionRequested())
+    {
+        RemoveBackup(backupFilePath); //Its fingerprint is not written; the next run makes it again.
+        return;
+    }
+    if (haveLastFingerprint && !contentHash.isEmpty() && contentHash == lastContentHash)
+    {
+        qDebug() << "DatabaseBackupThread: Backup is the same as the last backup; removing it.";
+        RemoveBackup(backupFilePath);
+        WriteLastFingerprint(fileStats, changeCounter, contentHash);
+        return;
+    }
+
+    //If the database was modified after taking the fingerprint, the backup is newer than the
+    //  fingerprint and the next run will just make another backup. Not the other way around.
+    WriteLastFingerprint(fileStats, changeCounter, contentHash);
+    ApplyRetentionPolicy();
+}
+
+QString DatabaseBackupThread::FileStatsFingerprint()
+{
+    QFileInfo dbInfo(m_databaseFilePath);
+    QFileInfo walInfo(m_databaseFilePath + "-wal");
+
+    //SQLite (re)creates an empty WAL file whenever the database is opened; that doesn't count
+    //  as a modification.
+    qint64 walSize = walInfo.exists() ? walInfo.size() : 0;
+    qint64 walModified = (walSize > 0 ? walInfo.lastModified().toMSecsSinceEpoch() : 0);
+
+    return QString("%1|%2|%3|%4").arg(dbInfo.size()).arg(dbInfo.lastModified().toMSecsSinceEpoch())
+                                 .arg(walSize).arg(walModified);
+}
+
+QString DatabaseBackupThread::ChangeCounter()
+{
+    //See "Database File Format" on sqlite.org. Bytes 18 and 19 are the write and read versions,
+    //  1 for rollback journal and 2 for WAL; bytes 24-27 are the big-endian file change counter.
+    QFile dbFile(m_databaseFilePath);
+    if (!dbFile.open(QIODevice::ReadOnly))
+        return QString();
+
+    const QByteArray header = dbFile.read(100);
+    if (header.size() < 100 || !header.startsWith(QByteArray("SQLite format 3\0", 16)))
+        return QString();
+
+    //In WAL mode the counter is not incremented on commits, so it can't tell if content changed.
+    if (header[18] != 1 || header[19] != 1)
+        return QString();
+
+    return QString::fromLatin1(header.mid(24, 4).toHex());
+}
+
+bool DatabaseBackupThread::ReadLastFingerprint(QString& fileStats, QString& changeCounter,
+                                               QString& contentHash)
+{
+    QFile fingerprintFile(m_backupsDirPath + "/" + QFileInfo(m_databaseFilePath).fileName()
+                          + ".lastbackup");
+    if (!fingerprintFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&fingerprintFile);
+    fileStats = stream.readLine();
+    changeCounter = stream.readLine();
+    contentHash = stream.readLine();
+    return !fileStats.isEmpty(); //Change counter is empty in WAL mode.
+}
+
+bool DatabaseBackupThread::WriteLastFingerprint(const QString& fileStats, const QString& changeCounter,
+                                                const QString& contentHash)
+{
+    QFile fingerprintFile(m_backupsDirPath + "/" + QFileInfo(m_databaseFilePath).fileName()
+                          + ".lastbackup");
+    if (!fingerprintFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        qDebug() << "DatabaseBackupThread: Could not write" << fingerprintFile.fileName();
+        return false;
+    }
+
+    QTextStream stream(&fingerprintFile);
+    stream << fileStats << "\n" << changeCounter << "\n" << contentHash << "\n";
+    return true;
+}
+
+bool DatabaseBackupThread::CreateBackup(const QString& backupFilePath, QString& errorText)
+{
+    //Connections can only be used in the thread that created them; so this thread has its own.
+    const QString connectionName = "DatabaseBackupThread";
+    bool success = false;
+    {
+        QSqlDatabase backupDb = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        backupDb.setDatabaseName(m_databaseFilePath);
+        backupDb.setConnectOptions("QSQLITE_OPEN_READONLY");
+
+        if (!backupDb.open())
+        {
+            errorText = backupDb.lastError().text();
+        }
+        else
+        {
+            QSqlQuery query(backupDb);
+
+            //Needs SQLite 3.27. Writes a compacted copy of a consistent snapshot of the database,
+            //  and only takes a read lock on it.
+            query.prepare("VACUUM INTO ?");
+            query.addBindValue(QDir::toNativeSeparators(backupFilePath));
+            success = query.exec();
+
+            if (!success)
+            {
+                //Older SQLite: copy the files inside a read transaction. In WAL mode checkpoints
+                //  never write back frames newer than a reader's snapshot, and a torn WAL copy is
+                //  cut at the last complete commit when the backup is opened.
+                qDebug() << "DatabaseBackupThread: VACUUM INTO failed, copying files instead."
+                         << query.lastError().text();
+                QFile::remove(backupFilePath);
+
+                if (isInterruptionRequested())
+                {
+                    errorText = "Interrupted.";
+                }
+                else if (!backupDb.transaction() || !query.exec("SELECT COUNT(*) FROM sqlite_master"))
+                {
+                    errorText = query.lastError().text();
+                }
+                else
+                {
+                    query.finish();
+                    success = CopyFile(m_databaseFilePath, backupFilePath);
+                    if (success && QFileInfo(m_databaseFilePath + "-wal").exists())
+                        success = CopyFile(m_databaseFilePath + "-wal", backupFilePath + "-wal");
+                    if (!success)
+                        errorText = "Could not copy the database file.";
+                    backupDb.rollback();
+                }
+            }
+            else
+            {
+                query.finish();
+            }
+            backupDb.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return success;
+}
+
+bool DatabaseBackupThread::CopyFile(const QString& sourceFilePath, const QString& targetFilePath)
+{
+    QFile sourceFile(sourceFilePath);
+    QFile targetFile(targetFilePath);
+    if (!sourceFile.open(QIODevice::ReadOnly)
+        || !targetFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    while (!sourceFile.atEnd())
+    {
+        if (isInterruptionRequested())
+            return false;
+        const QByteArray chunk = sourceFile.read(1024 * 1024);
+        if (chunk.isEmpty() || targetFile.write(chunk) != chunk.size())
+            return false;
+    }
+    return true;
+}
+
+QString DatabaseBackupThread::ContentHash(const QString& backupFilePath)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QStringList filePaths = QStringList() << backupFilePath;
+    if (QFileInfo(backupFilePath + "-wal").exists())
+        filePaths << backupFilePath + "-wal";
+
+    foreach (const QString& filePath, filePaths)
+    {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly))
+            return QString();
+
+        while (!file.atEnd())
+        {
+            if (isInterruptionRequested())
+                return QString();
+            const QByteArray chunk = file.read(1024 * 1024);
+            if (chunk.isEmpty())
+                return QString();
+            hash.addData(chunk);
+        }
+    }
+
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+void DatabaseBackupThread::RemoveBackup(const QString& backupFilePath)
+{
+    QFile::remove(backupFilePath);
+    QFile::remove(backupFilePath + "-wal");
+}
+
+void DatabaseBackupThread::ApplyRetentionPolicy()
+{
+    QFileInfo dbInfo(m_databaseFilePath);
+    const QString prefix = dbInfo.baseName() + "-";
+    const QString suffix = "." + dbInfo.completeSuffix() + ".bak";
+    const QString dateTimeFormat = "yyyy-MM-dd.hh.mm.ss";
+
+    //The date format sorts lexicographically, so this lists the newest backups first.
+    QDir backupsDir(m_backupsDirPath);
+    QStringList backupFileNames = backupsDir.entryList(QStringList() << prefix + "*" + suffix,
+                                                       QDir::Files, QDir::Name | QDir::Reversed);
+
+    int index = 0;
+    QSet<QDate> keptDays;
+    QSet<int> keptWeeks;
+    foreach (const QString& backupFileName, backupFileNames)
+    {
+        QDateTime backupDateTime = QLocale("en-us").toDateTime(
+                    backupFileName.mid(prefix.length(), dateTimeFormat.length()), dateTimeFormat);
+        if (!backupDateTime.isValid())
+            continue; //Not one of ours; leave it alone.
+
+        bool keep = (index++ < m_retention.keepLatest);
+
+        //The first backup seen of each day or week is the newest one in that day or week.
+        QDate backupDate = backupDateTime.date();
+        if (!keptDays.contains(backupDate) && keptDays.size() < m_retention.keepDaily)
+        {
+            keptDays.insert(backupDate);
+            keep = true;
+        }
+
+        int weekYear;
+        int week = backupDate.weekNumber(&weekYear);
+        if (!keptWeeks.contains(weekYear * 100 + week) && keptWeeks.size() < m_retention.keepWeekly)
+        {
+            keptWeeks.insert(weekYear * 100 + week);
+            keep = true;
+        }
+
+        if (keep)
+            continue;
+
+        if (!backupsDir.remove(backupFileName))
+            qDebug() << "DatabaseBackupThread: Could not remove old backup" << backupFileName;
+        if (backupsDir.exists(backupFileName + "-wal"))
+            backupsDir.remove(backupFileName + "-wal");
+    }
+}
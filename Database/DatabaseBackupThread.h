@@ -0,0 +1,77 @@
+#pragma once
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+/// Backs up the database into the Backups directory without blocking the startup.
+/// - Uses its own connection and `VACUUM INTO`, so the main connection can be used meanwhile and
+///   the backup is a consistent snapshot even in WAL mode, while the database is being written.
+/// - Does not back up if the database has not changed since the last backup. Size and
+///   modification times are checked first, and if those have changed, the change counter in the
+///   database header. The counter is only usable in rollback journal modes; in WAL mode (the
+///   default) the new backup is made and hashed, and removed again if its contents are the same
+///   as the last backup's.
+///   The fingerprint of the last backup is kept in a file next to the backups, not in Settings,
+///   so that this thread never writes to the database.
+/// - Stops when interruption is requested, and removes the backup it was making. A running
+///   `VACUUM INTO` can't be interrupted through Qt's SQLite driver, so it is only checked for
+///   before and after it.
+/// - Applies a retention policy to the older backups; see `RetentionPolicy`.
+class DatabaseBackupThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    /// A backup is kept if it is one of the `keepLatest` newest ones, or the newest one of one of
+    ///   the `keepDaily` newest days, or the newest one of one of the `keepWeekly` newest weeks
+    ///   that have backups.
+    struct RetentionPolicy
+    {
+        int keepLatest;
+        int keepDaily;
+        int keepWeekly;
+    };
+
+private:
+    QString m_databaseFilePath;
+    QString m_backupsDirPath;
+    RetentionPolicy m_retention;
+
+public:
+    explicit DatabaseBackupThread(QObject* parent = 0);
+    ~DatabaseBackupThread();
+
+    /// Must NOT be called while the thread is running.
+    void SetBackupParameters(const QString& databaseFilePath, const QString& backupsDirPath,
+                             const RetentionPolicy& retention);
+
+    /// Name of a backup file taken at `dateTime`. The naming must not change, because
+    ///   `ApplyRetentionPolicy` reads the dates back from the names of older backups.
+    static QString BackupFileName(const QString& databaseFilePath, const QDateTime& dateTime);
+
+signals:
+    /// Emitted from the backup thread; connect with a receiver in the GUI thread to show it.
+    void BackupFailed(const QString& errorText);
+
+protected:
+    void run();
+
+private:
+    /// "dbSize|dbModified|walSize|walModified" of the database files, in this order.
+    QString FileStatsFingerprint();
+    /// Hex file change counter from the database header; empty in WAL mode or if it can't be read.
+    QString ChangeCounter();
+
+    bool ReadLastFingerprint(QString& fileStats, QString& changeCounter, QString& contentHash);
+    bool WriteLastFingerprint(const QString& fileStats, const QString& changeCounter,
+                              const QString& contentHash);
+
+    bool CreateBackup(const QString& backupFilePath, QString& errorText);
+    /// Copies in chunks, so that it can be interrupted.
+    bool CopyFile(const QString& sourceFilePath, const QString& targetFilePath);
+    /// Hex SHA-1 of the backup file (and its WAL file, if any); empty if interrupted or unreadable.
+    QString ContentHash(const QString& backupFilePath);
+    void RemoveBackup(const QString& backupFilePath);
+    void ApplyRetentionPolicy();
+};
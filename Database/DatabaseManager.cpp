@@ -3,6 +3,7 @@
 #include "Config.h"
 
 #include <QDateTime>
+#include <QDebug>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
@@ -15,7 +16,11 @@ DatabaseManager::DatabaseManager(QWidget* dialogParent, Config* conf)
     : IManager(dialogParent, conf)
     , bms(dialogParent, conf), bfs(dialogParent, conf), files(dialogParent, conf)
     , fview(dialogParent, conf), sets(dialogParent, conf), tags(dialogParent, conf)
+    , backupPending(false)
 {
+    //Errors are reported from the backup thread; show them in the GUI thread.
+    QObject::connect(&backupThread, &DatabaseBackupThread::BackupFailed, dialogParent,
+                     [this](const QString& errorText) { Error(errorText); });
 }
 
 DatabaseManager::~DatabaseManager()
@@ -38,30 +43,56 @@ bool DatabaseManager::BackupOpenOrCreate(const QString& fileName)
     sets.setSqlDatabase(db);
     tags.setSqlDatabase(db);
 
-    return success;
+    if (!success)
+        return false;
+
+    if (!bms.InitializeFullTextSearch())
+        return false;
+
+    //The tuning values come from the settings, so load them earlier than the other sub-managers.
+    sets.PopulateModelsAndInternalTables();
+    if (!TuneDatabase(db))
+        return false;
+
+    //Nothing to back up for a new database.
+    if (!backupPending)
+        return true;
+    backupPending = false;
+    return StartBackgroundBackup(fileName);
 }
 
 void DatabaseManager::Close()
 {
+    //The backup thread has its own connection, but must not be left running when the program is
+    //  about to quit. It removes the backup it was making; the next start makes it again.
+    backupThread.requestInterruption();
+    backupThread.wait();
+
+    //Release the prepared statements before closing the connection.
+    bms.ClearQueryCache();
+    bfs.ClearQueryCache();
+    files.ClearQueryCache();
+    fview.ClearQueryCache();
+    sets.ClearQueryCache();
+    tags.ClearQueryCache();
+
     if (db.isOpen())
         db.close();
 }
 
 void DatabaseManager::PopulateModelsAndInternalTables()
 {
+    //Settings were already populated in `BackupOpenOrCreate`, for tuning the database.
     bms.PopulateModelsAndInternalTables();
     bfs.PopulateModelsAndInternalTables();
     files.PopulateModelsAndInternalTables();
     fview.PopulateModelsAndInternalTables();
-    sets.PopulateModelsAndInternalTables();
     tags.PopulateModelsAndInternalTables();
 }
 
 bool DatabaseManager::BackupOpenDatabase(const QString& fileName)
 {
-    if (!BackupDatabase(fileName))
-        return false;
-
+    //The database is backed up in the background after opening it, except before migrations.
     db = QSqlDatabase::addDatabase("QSQLITE");
     db.setDatabaseName(fileName);
     if (!db.open())
@@ -70,16 +101,61 @@ bool DatabaseManager::BackupOpenDatabase(const QString& fileName)
     if (!CheckVersion())
         return false;
 
+    backupPending = true;
+
     //Need to enable this manually.
     //It is IMPORTANT to do this AFTER CheckVersion, which does database migration by dropping and
     //  recreating tables so disables this support in advance.
     if (!SetForeignKeysSupport(true))
         return false;
 
+    //Only diagnostic; doesn't prevent opening the database.
+    CheckIndexes();
+
     return true;
 }
 
-bool DatabaseManager::BackupDatabase(const QString& fileName)
+void DatabaseManager::CheckIndexes()
+{
+    //Make sure the most frequent lookups don't do full table scans, e.g because an index was
+    //  dropped by a migration or the database was edited externally.
+    //Literal values are used instead of bound ones, so that the queries can be exec'ed directly.
+    QStringList accessPaths = QStringList()
+        << "SELECT BID FROM Bookmark WHERE FOID = 0"
+        << "SELECT BID1 AS BID FROM BookmarkLink WHERE BID2 = 0 "
+           "UNION SELECT BID2 AS BID FROM BookmarkLink WHERE BID1 = 0"
+        << "SELECT * FROM BookmarkExtraInfo WHERE BID = 0"
+        << "SELECT * FROM BookmarkExtraInfo WHERE Name = ''"
+        << "SELECT TID FROM Tag WHERE TagName = '' COLLATE NOCASE"
+        << "SELECT DISTINCT BID FROM BookmarkTag WHERE TID IN (0, 1)"
+        << "SELECT * FROM BookmarkTag NATURAL JOIN Tag WHERE BID = 0"
+        << "SELECT * FROM BookmarkFile WHERE BID = 0"
+        << "SELECT * FROM BookmarkFile WHERE FID = 0"
+        << "SELECT COUNT(*) FROM File WHERE ArchiveURL = ''"
+        << "SELECT FOID FROM BookmarkFolder WHERE ParentFOID = 0";
+
+    QSqlQuery query(db);
+    foreach (const QString& accessPath, accessPaths)
+    {
+        if (!query.exec("EXPLAIN QUERY PLAN " + accessPath))
+        {
+            qDebug() << "CheckIndexes: Could not explain query:" << accessPath << query.lastError();
+            continue;
+        }
+
+        //The last column is the human-readable 'detail', e.g 'SEARCH TABLE Bookmark USING
+        //  COVERING INDEX IX_Bookmark_FOID (FOID=?)' vs 'SCAN TABLE Bookmark'.
+        while (query.next())
+        {
+            QString detail = query.value(query.record().count() - 1).toString();
+            if (detail.startsWith("SCAN") && !detail.contains("INDEX"))
+                qDebug() << "CheckIndexes: Full table scan in query:" << accessPath
+                         << "\n    Plan:" << detail;
+        }
+    }
+}
+
+bool DatabaseManager::GetBackupsDir(const QString& fileName, QString& backupsDirPath)
 {
     QString backupsDirName = "Backups";
     QFileInfo fileInfo(fileName);
@@ -96,14 +172,48 @@ bool DatabaseManager::BackupDatabase(const QString& fileName)
         return Error("Backups is not a directory!");
     }
 
-    QString newFileName = fileInfo.baseName()
-            + "-" + QLocale("en-us").toString(QDateTime::currentDateTime(), "yyyy-MM-dd.hh.mm.ss")
-            + "." + fileInfo.completeSuffix() + ".bak";
-    QString newFilePath = backupDirInfo.absoluteFilePath() + "/" + newFileName;
+    backupsDirPath = backupDirInfo.absoluteFilePath();
+    return true;
+}
+
+bool DatabaseManager::StartBackgroundBackup(const QString& fileName)
+{
+    QString backupsDirPath;
+    if (!GetBackupsDir(fileName, backupsDirPath))
+        return false;
+
+    //Keep at least the backup that is being made.
+    DatabaseBackupThread::RetentionPolicy retention;
+    retention.keepLatest = qMax(1, sets.GetSetting("BackupKeepLatest", conf->defaultBackupKeepLatest));
+    retention.keepDaily  = sets.GetSetting("BackupKeepDaily" , conf->defaultBackupKeepDaily );
+    retention.keepWeekly = sets.GetSetting("BackupKeepWeekly", conf->defaultBackupKeepWeekly);
 
+    backupThread.wait(); //In case a database was opened before.
+    backupThread.SetBackupParameters(QFileInfo(fileName).absoluteFilePath(), backupsDirPath, retention);
+    backupThread.start(QThread::LowPriority);
+    return true;
+}
+
+bool DatabaseManager::BackupDatabase(const QString& fileName)
+{
+    //Synchronous full copy; only used right before migrating the database, when the connection
+    //  is open but nothing has been written yet.
+    QString backupsDirPath;
+    if (!GetBackupsDir(fileName, backupsDirPath))
+        return false;
+
+    QString newFilePath = backupsDirPath + "/"
+                        + DatabaseBackupThread::BackupFileName(fileName, QDateTime::currentDateTime());
     if (!QFile::copy(fileName, newFilePath))
         return Error("Backup file could not be created:\n" + newFilePath);
 
+    //In WAL mode, if the program was not closed properly the last transactions may still be in
+    //  the write-ahead log instead of the database file. Back it up as well; SQLite will use it
+    //  when the backup is opened with the same name.
+    if (QFileInfo(fileName + "-wal").exists())
+        if (!QFile::copy(fileName + "-wal", newFilePath + "-wal"))
+            return Error("Backup file could not be created:\n" + newFilePath + "-wal");
+
     return true;
 }
 
@@ -203,6 +313,62 @@ bool DatabaseManager::SetForeignKeysSupport(bool enable)
     }
 }
 
+bool DatabaseManager::TuneDatabase(QSqlDatabase& database)
+{
+    //Defaults favor many small transactions, e.g settings and window sizes being saved on every
+    //  change: in WAL mode with synchronous=NORMAL a commit doesn't fsync; only checkpoints do.
+    //  This can lose the last transactions on power loss, but never corrupts the database.
+    QString journalMode = sets.GetSetting("DbJournalMode", conf->defaultDbJournalMode);
+    QString synchronous = sets.GetSetting("DbSynchronous", conf->defaultDbSynchronous);
+    qint64 mmapSizeMB   = sets.GetSetting("DbMmapSizeMB", conf->defaultDbMmapSizeMB);
+    int cacheSizeKB     = sets.GetSetting("DbCacheSizeKB", conf->defaultDbCacheSizeKB);
+    bool tempStoreInMemory = sets.GetSetting("DbTempStoreInMemory", conf->defaultDbTempStoreInMemory);
+
+    return SetPragmas(database, journalMode, synchronous, mmapSizeMB * 1024 * 1024, cacheSizeKB,
+                      tempStoreInMemory);
+}
+
+bool DatabaseManager::SetPragmas(QSqlDatabase& database, const QString& journalMode,
+                                 const QString& synchronous, qint64 mmapSizeBytes, int cacheSizeKB,
+                                 bool tempStoreInMemory)
+{
+    //Pragma values can't be bound, so only allow the known keywords to get into the queries.
+    QStringList journalModes = QStringList() << "DELETE" << "TRUNCATE" << "PERSIST" << "WAL";
+    QStringList synchronousModes = QStringList() << "OFF" << "NORMAL" << "FULL" << "EXTRA";
+    if (!journalModes.contains(journalMode.toUpper()))
+        return Error("Unknown database journal mode: " + journalMode);
+    if (!synchronousModes.contains(synchronous.toUpper()))
+        return Error("Unknown database synchronous mode: " + synchronous);
+
+    QString pragmaError = "Could not set the database parameters.";
+    QSqlQuery query(database);
+
+    //Changing journal mode fails silently in some cases, e.g WAL is not supported for network
+    //  file systems; SQLite returns the journal mode that is in effect. That is not an error.
+    if (!query.exec("PRAGMA journal_mode = " + journalMode.toUpper()))
+        return Error(pragmaError, query.lastError());
+    if (query.first() && query.value(0).toString().toUpper() != journalMode.toUpper())
+        qDebug() << "Database journal mode is" << query.value(0).toString()
+                 << "instead of" << journalMode;
+    query.finish();
+
+    //Negative cache_size is in KiB instead of pages.
+    QStringList pragmas = QStringList()
+        << "PRAGMA synchronous = " + synchronous.toUpper()
+        << "PRAGMA mmap_size = " + QString::number(mmapSizeBytes)
+        << "PRAGMA cache_size = " + QString::number(-cacheSizeKB)
+        << QString("PRAGMA temp_store = ") + (tempStoreInMemory ? "MEMORY" : "DEFAULT");
+
+    foreach (const QString& pragma, pragmas)
+    {
+        if (!query.exec(pragma))
+            return Error(pragmaError, query.lastError());
+        query.finish(); //mmap_size returns a row.
+    }
+
+    return true;
+}
+
 bool DatabaseManager::CheckVersion()
 {
     QString versionError = "Could not get version information from database file.";
@@ -222,6 +388,10 @@ bool DatabaseManager::CheckVersion()
 
     if (version < conf->programDatabaseVersion)
     {
+        //The background backup could finish after the migration; the old version is needed.
+        if (!BackupDatabase(db.databaseName()))
+            return false;
+
         //Disable foreign keys to stop any triggers from running, if enabled.
         //IMPORTANT: Needs to be done before starting transactions.
         //  http://stackoverflow.com/questions/7359721/sqlite-are-pragma-statements-undone-by-rolling-back-transactions
@@ -230,6 +400,10 @@ bool DatabaseManager::CheckVersion()
         //IMPORTANT: ^^ If we had triggers, indices, etc we had to turn them off, e.g using:
         //  http://stackoverflow.com/questions/2250959/how-to-handle-a-missing-feature-of-sqlite-disable-triggers
         //Fortunately we don't need to delete and recreate them as well, just disabling them is enough.
+        //UPDATE: Since v5 the BookmarkFTS triggers exist on Bookmark and BookmarkExtraInfo. They are
+        //  dropped along with their tables, so migrations re-creating these tables must re-create
+        //  them with `BookmarkManager::CreateFullTextSearchTables`.
+        //  Same for the indexes added in v6; `CheckIndexes` will warn about any forgotten ones.
         //Also sqlite_sequence table seems to remember the sequence and doesn't need modifications later.
 
         if (!db.transaction())
@@ -452,6 +626,41 @@ bool DatabaseManager::UpgradeDatabase(int dbVersion)
             return Error("Migration Error: v4, Updating BookmarkTag", query.lastError());
     }
 
+    if (dbVersion <= 4)
+    {
+        /// New optional BookmarkFTS full-text search table, and triggers that keep it in sync.
+        //Sub-managers get the connection only after opening (and migrating) the database.
+        bms.setSqlDatabase(db);
+        if (!bms.CreateFullTextSearchTables(true))
+            return false; //Has already shown the error.
+    }
+
+    if (dbVersion <= 5)
+    {
+        /// Indexes on foreign-key and filter columns; there were none before.
+        //The same queries as the `CreateTables` functions.
+        QStringList createIndexQueries = QStringList()
+            << BookmarkManager::CreateIndexQueries()
+            << TagManager::CreateIndexQueries()
+            << FileManager::CreateIndexQueries()
+            << BookmarkFolderManager::CreateIndexQueries();
+
+        foreach (const QString& createIndexQuery, createIndexQueries)
+            if (!query.exec(createIndexQuery))
+                return Error("Migration Error: v5, Creating indexes", query.lastError());
+
+        //Let the query planner know about the new indexes.
+        if (!query.exec("ANALYZE"))
+            return Error("Migration Error: v5, Analyzing indexes", query.lastError());
+    }
+
+    if (dbVersion <= 6)
+    {
+        /// Files of the new content-addressed archive layout are counted by their ArchiveURL.
+        if (!query.exec("CREATE INDEX IF NOT EXISTS IX_File_ArchiveURL ON File(ArchiveURL)"))
+            return Error("Migration Error: v6, Creating File index", query.lastError());
+    }
+
     if (!query.exec("UPDATE Info SET Version = " + QString::number(conf->programDatabaseVersion)))
         return Error("Migration Error: Updating database version", query.lastError());
 
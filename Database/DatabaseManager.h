@@ -1,5 +1,6 @@
 #pragma once
 #include "IManager.h"
+#include "DatabaseBackupThread.h"
 #include "Bookmarks/BookmarkManager.h"
 #include "BookmarkFolders/BookmarkFolderManager.h"
 #include "Files/FileManager.h"
@@ -10,6 +11,8 @@
 
 class DatabaseManager : public IManager
 {
+    friend class Benchmarks;
+
 public:
     QSqlDatabase db;
     BookmarkManager bms;
@@ -19,12 +22,17 @@ public:
     SettingsManager sets;
     TagManager tags;
 
+private:
+    DatabaseBackupThread backupThread;
+    bool backupPending;
+
+public:
     DatabaseManager(QWidget* dialogParent, Config* conf);
     ~DatabaseManager();
 
 public:
-    /// If a database exists, opens it and creates a backup, or creates a new database file.
-    /// Returns true on success.
+    /// If a database exists, opens it and starts backing it up in the background, or creates a
+    ///   new database file. Returns true on success.
     bool BackupOpenOrCreate(const QString& fileName);
     void Close();
 
@@ -33,10 +41,21 @@ public:
 
 private:
     bool BackupOpenDatabase(const QString& fileName);
+    /// Creates the Backups directory next to the database file if needed.
+    bool GetBackupsDir(const QString& fileName, QString& backupsDirPath);
+    /// Starts a DatabaseBackupThread with the retention policy from the settings.
+    bool StartBackgroundBackup(const QString& fileName);
     bool BackupDatabase(const QString& fileName);
     bool CreateDatabase(const QString& fileName);
 
     bool SetForeignKeysSupport(bool enable);
+    /// Sets the journal mode, synchronous, mmap_size, cache_size and temp_store pragmas of
+    ///   `database` from the settings. Settings must have been populated before calling this.
+    bool TuneDatabase(QSqlDatabase& database);
+    bool SetPragmas(QSqlDatabase& database, const QString& journalMode, const QString& synchronous,
+                    qint64 mmapSizeBytes, int cacheSizeKB, bool tempStoreInMemory);
+    /// Logs a warning for frequently used queries whose plan is a full table scan.
+    void CheckIndexes();
 
     bool CheckVersion();
     bool UpgradeDatabase(int dbVersion);
@@ -1,6 +1,10 @@
 #pragma once
 #include "IManager.h"
+#include <QHash>
+#include <QStringList>
+#include <QVariantList>
 #include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
 
 class DatabaseManager;
 
@@ -12,6 +16,10 @@ class ISubManager : public IManager
 protected:
     QSqlDatabase db;
 
+private:
+    /// Prepared queries of `CachedQuery`, keyed by their SQL text.
+    QHash<QString, QSqlQuery> preparedQueries;
+
 protected:
     ISubManager(QWidget* dialogParent, Config* conf)
         : IManager(dialogParent, conf)
@@ -23,6 +31,9 @@ protected:
     }
 
     /// Called only upon creating the database.
+    /// Sub-managers whose tables have indexes list them in a static `CreateIndexQueries()`, as
+    ///   `CREATE INDEX IF NOT EXISTS` queries; both `CreateTables` and the database migration that
+    ///   added the indexes run that list.
     virtual void CreateTables() = 0;
 
     /// Execute queries on models and populate them. Called multiple times when refreshing by program.
@@ -32,6 +43,98 @@ protected:
 
     void setSqlDatabase(QSqlDatabase& db_)
     {
+        ClearQueryCache();
         db = db_;
     }
+
+    /// Returns a query that is prepared with `querystr` only the first time, and is reused
+    ///   afterwards; so SQLite doesn't re-parse the same statement on every call. Only for the
+    ///   per-bookmark statements of imports and merges; other functions prepare their own queries.
+    ///   Use it like a freshly prepared query: add the bind values, then `exec()`. If preparing
+    ///   fails, `exec()` fails with the prepare error.
+    /// The returned query shares its statement with the cache, and is reset by the next call for
+    ///   the same SQL text; unless it is a SELECT whose rows are still being read, e.g by a caller
+    ///   up the stack, in which case that call gets a separately prepared query. So call `finish()`
+    ///   after reading only part of the results (e.g with `first()`), or the next calls will not be
+    ///   able to reuse the statement.
+    /// Only use it for static SQL texts; texts built from e.g lists of IDs would fill the cache.
+    QSqlQuery CachedQuery(const QString& querystr)
+    {
+        QHash<QString, QSqlQuery>::iterator it = preparedQueries.find(querystr);
+        if (it != preparedQueries.end())
+        {
+            QSqlQuery& cachedQuery = it.value();
+            bool inUse = (cachedQuery.isActive() && cachedQuery.isSelect() &&
+                          cachedQuery.at() != QSql::AfterLastRow);
+            if (!inUse)
+            {
+                cachedQuery.finish(); //Also for the previous user that has read all rows.
+                return cachedQuery;
+            }
+
+            QSqlQuery separateQuery(db);
+            separateQuery.prepare(querystr);
+            return separateQuery;
+        }
+
+        QSqlQuery query(db);
+        if (!query.prepare(querystr))
+            return query; //Not cached, so that the next call tries preparing again.
+        preparedQueries.insert(querystr, query);
+        return query;
+    }
+
+    /// Inserts `values.size() / columnsCount` rows, whose values are given row after row, with
+    ///   multi-row `INSERT ... VALUES (?, ?), (?, ?), ...` statements instead of one statement per
+    ///   row. `insertHead` is the statement up to `VALUES`. Each statement has as many rows as fit
+    ///   in SQLite's default limit of 999 bound parameters; their texts are the same every time,
+    ///   so they are cached, except for the last partial one.
+    /// If `insertedIDs` is given, the row IDs of the inserted rows are appended to it. A single
+    ///   statement inserts its rows with consecutive IDs when nothing else writes to the table in
+    ///   between, which is the case for INTEGER PRIMARY KEY (AUTOINCREMENT) tables in our
+    ///   transactions.
+    bool MultiRowInsert(const QString& insertHead, int columnsCount, const QVariantList& values,
+                        const QString& errorText, QList<long long>* insertedIDs = NULL)
+    {
+        const int maxBoundParameters = 999;
+        const int maxRowsPerStatement = maxBoundParameters / columnsCount;
+        const int rowsCount = values.size() / columnsCount;
+
+        QString rowPlaceholders = "(?" + QString(", ?").repeated(columnsCount - 1) + ")";
+        for (int firstRow = 0; firstRow < rowsCount; firstRow += maxRowsPerStatement)
+        {
+            const int statementRows = qMin(maxRowsPerStatement, rowsCount - firstRow);
+            QStringList placeholders;
+            for (int r = 0; r < statementRows; r++)
+                placeholders.append(rowPlaceholders);
+            const QString querystr = insertHead + " VALUES " + placeholders.join(", ");
+
+            QSqlQuery partialQuery(db);
+            if (statementRows < maxRowsPerStatement)
+                partialQuery.prepare(querystr);
+            QSqlQuery query = (statementRows < maxRowsPerStatement ? partialQuery : CachedQuery(querystr));
+
+            const int firstValue = firstRow * columnsCount;
+            for (int v = firstValue; v < firstValue + statementRows * columnsCount; v++)
+                query.addBindValue(values[v]);
+
+            if (!query.exec())
+                return Error(errorText, query.lastError());
+
+            if (insertedIDs != NULL)
+            {
+                const long long lastID = query.lastInsertId().toLongLong();
+                for (long long id = lastID - statementRows + 1; id <= lastID; id++)
+                    insertedIDs->append(id);
+            }
+        }
+
+        return true;
+    }
+
+    /// Queries must be destroyed before their database connection is closed.
+    void ClearQueryCache()
+    {
+        preparedQueries.clear();
+    }
 };
@@ -0,0 +1,682 @@
+#include "Benchmarks.h"
+
+#include "BookmarkImporter/BookmarkImporter.h"
+#include "Bookmarks/BookmarkBitmap.h"
+#include "Bookmarks/BookmarksModel.h"
+#include "Database/DatabaseManager.h"
+#include "PageFetchBenchmark.h"
+#include "Util/FileHasher.h"
+#include "Util/MimeEncoder.h"
+#include "Util/TransactionalFileOperator.h"
+#include "Util/Util.h"
+
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSortFilterProxyModel>
+#include <QStorageInfo>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QtSql/QSqlQuery>
+#include <QtSql/QSqlRecord>
+
+bool Benchmarks::DatabaseCommitLatency(DatabaseManager* dbm, QWidget* dialogParent, QString& report)
+{
+    Q_UNUSED(dialogParent);
+    const int transactionsCount = 200;
+    const QString benchmarkError = "Error while benchmarking the database.";
+    report.clear();
+
+    //Next to the open database, so that it is on the same disk; removed with its directory.
+    QTemporaryDir scratchDir(QFileInfo(dbm->db.databaseName()).absolutePath() + "/BenchmarkXXXXXX");
+    if (!scratchDir.isValid())
+    {
+        report = benchmarkError + "\nCould not create a temporary directory.";
+        return false;
+    }
+
+    const QString connectionName = "BenchmarkCommitLatency";
+    QString results;
+    bool success = true;
+    {
+        QSqlDatabase scratchDb = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        scratchDb.setDatabaseName(scratchDir.filePath("Benchmark.sqlite"));
+        QSqlQuery query(scratchDb);
+        QSqlError sqlError;
+
+        //A real table in the database file; a TEMP one wouldn't be journaled and synced.
+        if (!scratchDb.open())
+            sqlError = scratchDb.lastError();
+        else if (!query.exec("CREATE TABLE BenchmarkScratch( ID INTEGER PRIMARY KEY, Value TEXT )"))
+            sqlError = query.lastError();
+        success = !sqlError.isValid();
+
+        //Round 0 is with SQLite defaults (i.e how the database was used before tuning), round 1 is
+        //  with the tuned settings. These show their own errors.
+        QStringList roundNames = QStringList() << "SQLite defaults" << "Tuned settings";
+        for (int round = 0; round < 2 && success; round++)
+        {
+            if (round == 0)
+                success = dbm->SetPragmas(scratchDb, "DELETE", "FULL", 0, 2000, false);
+            else
+                success = dbm->TuneDatabase(scratchDb);
+            if (!success)
+                break;
+
+            QList<qint64> latenciesNSec;
+            QElapsedTimer timer;
+            for (int i = 0; i < transactionsCount; i++)
+            {
+                timer.start();
+                scratchDb.transaction();
+                query.prepare("INSERT INTO BenchmarkScratch(Value) VALUES (?)");
+                query.addBindValue(QString::number(i));
+                if (!query.exec())
+                {
+                    sqlError = query.lastError();
+                    scratchDb.rollback();
+                    success = false;
+                    break;
+                }
+                scratchDb.commit();
+                latenciesNSec.append(timer.nsecsElapsed());
+            }
+            if (!success || latenciesNSec.isEmpty())
+                break;
+
+            qSort(latenciesNSec);
+            qint64 totalNSec = 0;
+            foreach (qint64 latency, latenciesNSec)
+                totalNSec += latency;
+
+            results += QString("%1: %2 commits, mean %3 ms, median %4 ms, max %5 ms\n")
+                    .arg(roundNames[round]).arg(latenciesNSec.size())
+                    .arg(totalNSec / latenciesNSec.size() / 1e6, 0, 'f', 3)
+                    .arg(latenciesNSec[latenciesNSec.size() / 2] / 1e6, 0, 'f', 3)
+                    .arg(latenciesNSec.last() / 1e6, 0, 'f', 3);
+        }
+
+        if (sqlError.isValid())
+            report = benchmarkError + "\n\nSQLite Error:\n" + sqlError.text();
+
+        query.finish();
+        scratchDb.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    if (success)
+        report = results;
+    return success;
+}
+
+bool Benchmarks::ImportAnalysis(DatabaseManager* dbm, QWidget* dialogParent, QString& report)
+{
+    const int bookmarksCount = 500000;
+    report.clear();
+
+    BookmarkImporter bmim(dbm, dialogParent);
+    if (!bmim.Initialize())
+        return false;
+
+    //A Firefox-like synthetic import: a tree of folders under the places root, some empty folder
+    //  chains to prune, and about 10% of the bookmarks being tag-duplicates of others. URLs are on
+    //  a reserved domain, except for every 50th bookmark which takes an existing bookmark's URL
+    //  (exactly, or with an anchor) so that comparing with existing bookmarks is measured too.
+    QMultiHash<long long, QString> bookmarkURLs;
+    if (!dbm->bms.RetrieveAllFullURLs(bookmarkURLs))
+        return false;
+    QStringList existentURLs = bookmarkURLs.values();
+    qSort(existentURLs); //Hash order is not deterministic.
+
+    ImportedEntityList elist;
+    elist.importFOID = 0;
+    elist.importSource = ImportedEntityList::Source_Firefox;
+
+    const int foldersCount = qMax(2, bookmarksCount / 100);
+    const int emptyFoldersStart = foldersCount - foldersCount / 5;
+    quint32 random = 12345; //Deterministic, for comparable runs.
+
+    for (int i = 0; i < foldersCount; i++)
+    {
+        random = random * 1103515245 + 12345;
+        ImportedBookmarkFolder ibf;
+        ibf.intId = i + 1;
+        ibf.intIndex = i;
+        ibf.title = QString("Folder %1").arg(i);
+        if (i == 0)
+        {
+            ibf.parentId = -1;
+            ibf.root = "placesRoot";
+        }
+        else if (i >= emptyFoldersStart + 1)
+        {
+            ibf.parentId = i; //Chain of empty folders.
+        }
+        else
+        {
+            ibf.parentId = 1 + (random >> 8) % i;
+        }
+        elist.ibflist.append(ibf);
+    }
+
+    for (int i = 0; i < bookmarksCount; i++)
+    {
+        random = random * 1103515245 + 12345;
+        const bool duplicate = (i > 0 && (random >> 8) % 10 == 0);
+
+        ImportedBookmark ib;
+        ib.intId = i;
+        ib.intIndex = i;
+        ib.parentId = 2 + (random >> 4) % (emptyFoldersStart - 1);
+        if (duplicate)
+        {
+            ib.uri = QString("http://benchmark.invalid/page/%1").arg((random >> 12) % i);
+        }
+        else if (i % 50 == 0 && !existentURLs.isEmpty())
+        {
+            ib.uri = existentURLs[(i / 50) % existentURLs.size()];
+            if (i % 100 == 0)
+                ib.uri += "#benchmark";
+        }
+        else
+        {
+            ib.uri = QString("http://benchmark.invalid/page/%1").arg(i);
+            ib.title = QString("Bookmark %1 [Description %1]").arg(i);
+        }
+        elist.iblist.append(ib);
+    }
+
+    ImportedEntityList serialElist = elist;
+    QElapsedTimer timer;
+    timer.start();
+    if (!bmim.Analyze(serialElist, false))
+        return false;
+    const qint64 serialMSecs = timer.elapsed();
+
+    timer.restart();
+    if (!bmim.Analyze(elist, true))
+        return false;
+    const qint64 parallelMSecs = timer.elapsed();
+
+    //The parallel analysis must give exactly the same result as the serial one.
+    QString comparison = AnalysisMismatch(serialElist, elist);
+    if (comparison.isEmpty())
+        comparison = "Serial and parallel results are identical.";
+
+    report = QString("Analyzed %1 bookmarks in %2 folders.\n"
+                     "Serial: %3 ms, Parallel (%4 threads): %5 ms.\n"
+                     "%6 bookmarks and %7 folders remained.\n%8")
+            .arg(bookmarksCount).arg(foldersCount).arg(serialMSecs)
+            .arg(QThread::idealThreadCount()).arg(parallelMSecs)
+            .arg(elist.iblist.size()).arg(elist.ibflist.size()).arg(comparison);
+
+    return true;
+}
+
+QString Benchmarks::AnalysisMismatch(const ImportedEntityList& serialElist,
+                                     const ImportedEntityList& parallelElist)
+{
+    if (serialElist.iblist.size() != parallelElist.iblist.size())
+        return QString("MISMATCH between serial and parallel results: %1 and %2 bookmarks remained!")
+                .arg(serialElist.iblist.size()).arg(parallelElist.iblist.size());
+
+    for (int i = 0; i < parallelElist.iblist.size(); i++)
+    {
+        const ImportedBookmark& sib = serialElist.iblist[i];
+        const ImportedBookmark& pib = parallelElist.iblist[i];
+        bool same = (sib.intId == pib.intId && sib.parentId == pib.parentId && sib.uri == pib.uri &&
+                     sib.title == pib.title && sib.description == pib.description &&
+                     sib.Ex_import == pib.Ex_import && sib.Ex_additionalTags == pib.Ex_additionalTags &&
+                     sib.Ex_status == pib.Ex_status);
+        if (same && (pib.Ex_status == ImportedBookmark::S_AnalyzedExactExistent ||
+                     pib.Ex_status == ImportedBookmark::S_AnalyzedSimilarExistent))
+            same = (sib.Ex_AlmostDuplicateExistentBIDs == pib.Ex_AlmostDuplicateExistentBIDs &&
+                    sib.Ex_DuplicateExistentComparedBID == pib.Ex_DuplicateExistentComparedBID);
+        if (!same)
+            return QString("MISMATCH between serial and parallel results at bookmark %1!").arg(i);
+    }
+
+    if (serialElist.ibflist.size() != parallelElist.ibflist.size())
+        return QString("MISMATCH between serial and parallel results: %1 and %2 folders remained!")
+                .arg(serialElist.ibflist.size()).arg(parallelElist.ibflist.size());
+
+    for (int i = 0; i < parallelElist.ibflist.size(); i++)
+    {
+        const ImportedBookmarkFolder& sibf = serialElist.ibflist[i];
+        const ImportedBookmarkFolder& pibf = parallelElist.ibflist[i];
+        bool same = (sibf.intId == pibf.intId && sibf.parentId == pibf.parentId &&
+                     sibf.title == pibf.title && sibf.Ex_importBookmarks == pibf.Ex_importBookmarks &&
+                     sibf.Ex_additionalTags == pibf.Ex_additionalTags);
+        if (!same)
+            return QString("MISMATCH between serial and parallel results at folder %1!").arg(i);
+    }
+
+    return QString();
+}
+
+bool Benchmarks::PageFetching(DatabaseManager* dbm, QWidget* dialogParent, QString& report)
+{
+    Q_UNUSED(dbm);
+    Q_UNUSED(dialogParent);
+    PageFetchBenchmark benchmark;
+    return benchmark.Run(200, report);
+}
+
+static QByteArray SampleMimeText(int size)
+{
+    //Web page-like text: markup, long lines, non-ascii text, '='s, and spaces and tabs before line
+    //  breaks of both kinds.
+    static const char* fragments[] =
+    {
+        "<div class=\"content\" id=\"main\">", "The quick brown fox jumps over the lazy dog. ",
+        "var a = b + c; ", "\t", " \r\n", "\n", "\xD8\xB3\xD9\x84\xD8\xA7\xD9\x85 \xD8\xAF\xD9\x86\xDB\x8C\xD8\xA7 ",
+        "<a href=\"http://example.com/?q=1&amp;r=2\">", "    ", "\t\n", "</div>\r\n",
+        ".menu>li{margin:0 auto;padding:4px 8px;background:url(img/bg.png) no-repeat}"
+    };
+    const int fragmentsCount = sizeof(fragments) / sizeof(fragments[0]);
+
+    QByteArray text;
+    text.reserve(size + 128);
+    unsigned int seed = 12345;
+    while (text.size() < size)
+    {
+        seed = seed * 1103515245u + 12345u;
+        text += fragments[(seed >> 16) % fragmentsCount];
+    }
+    text.truncate(size);
+    return text;
+}
+
+static QByteArray SampleMimeBinary(int size)
+{
+    QByteArray binary;
+    binary.resize(size);
+    unsigned int seed = 54321;
+    for (int i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        binary[i] = (char)(seed >> 16);
+    }
+    return binary;
+}
+
+static QByteArray OldBase64Lines(const QByteArray& data)
+{
+    //What MHTSaver::GenerateMHT used to do.
+    QByteArray base64 = data.toBase64();
+    QByteArray base64lines;
+    for (int i = 0; i <= base64.length() / 76; i++)
+        base64lines += base64.mid(i * 76, ((i+1)*76 > base64.length() ? -1 : 76)) + "\r\n";
+    return base64lines;
+}
+
+bool Benchmarks::MimeEncoders(DatabaseManager* dbm, QWidget* dialogParent, QString& report)
+{
+    Q_UNUSED(dbm);
+    Q_UNUSED(dialogParent);
+    const int maxSizeMB = 50;
+    report.clear();
+    bool allSame = true;
+
+    QList<int> sizesMB;
+    sizesMB << 1 << 10 << maxSizeMB;
+    foreach (int sizeMB, sizesMB)
+    {
+        const int size = sizeMB * 1024 * 1024;
+        QElapsedTimer timer;
+
+        const QByteArray text = SampleMimeText(size);
+        timer.start();
+        const QByteArray oldQP = Util::EncodeQuotedPrintable(text);
+        const qint64 oldQPMSecs = timer.restart();
+        const QByteArray newQP = MimeEncoder::EncodeQuotedPrintable(text);
+        const qint64 newQPMSecs = timer.elapsed();
+
+        const QByteArray binary = SampleMimeBinary(size);
+        timer.start();
+        const QByteArray oldBase64 = OldBase64Lines(binary);
+        const qint64 oldBase64MSecs = timer.restart();
+        const QByteArray newBase64 = MimeEncoder::EncodeBase64Lines(binary);
+        const qint64 newBase64MSecs = timer.elapsed();
+
+        const bool sameQP = (oldQP == newQP);
+        const bool sameBase64 = (oldBase64 == newBase64);
+        allSame = allSame && sameQP && sameBase64;
+
+        report += QString("%1 MB:\n  quoted-printable: %2 ms -> %3 ms%4\n  base64: %5 ms -> %6 ms%7\n")
+                  .arg(sizeMB).arg(oldQPMSecs).arg(newQPMSecs).arg(sameQP ? "" : " (DIFFERENT OUTPUT)")
+                  .arg(oldBase64MSecs).arg(newBase64MSecs).arg(sameBase64 ? "" : " (DIFFERENT OUTPUT)");
+    }
+
+    const QString instructionSet = MimeEncoder::InstructionSet();
+    report += "\nRuns of safe bytes are found "
+            + (instructionSet.isEmpty() ? QString("without SIMD.") : "with " + instructionSet + ".");
+    report += QString("\nSame output as the old encoders: %1").arg(allSame ? "Yes" : "NO");
+
+    return allSame;
+}
+
+bool Benchmarks::FileMoves(DatabaseManager* dbm, QWidget* dialogParent, QString& report)
+{
+    Q_UNUSED(dbm);
+    Q_UNUSED(dialogParent);
+    const int fileSizeMB = 512;
+    report.clear();
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        report = "Could not create a temporary directory.";
+        return false;
+    }
+
+    //The test file is created once; it is back in its place after each rolled back move.
+    QFile testFile(tempDir.path() + "/source.bin");
+    if (!testFile.open(QIODevice::WriteOnly))
+    {
+        report = "Could not create the test file.";
+        return false;
+    }
+    QByteArray chunk(1024 * 1024, 'x');
+    for (int i = 0; i < fileSizeMB; i++)
+        testFile.write(chunk);
+    testFile.close();
+    if (testFile.error() != QFileDevice::NoError)
+    {
+        report = "Could not write the test file.";
+        return false;
+    }
+
+    report += QString("Moving a %1 MB file, then rolling back:\n").arg(fileSizeMB);
+    bool success = true;
+    success &= MoveFileOnce(testFile.fileName(), tempDir.path(), true, "Same volume", report);
+    success &= MoveFileOnce(testFile.fileName(), tempDir.path(), false,
+                                 "Same volume, copying like before", report);
+
+    //Any other writable volume with room for the file, e.g another drive or a usb disk.
+    QStorageInfo tempVolume(tempDir.path());
+    QString otherVolumeRoot;
+    foreach (const QStorageInfo& volume, QStorageInfo::mountedVolumes())
+    {
+        if (volume.isValid() && volume.isReady() && !volume.isReadOnly() &&
+            volume.device() != tempVolume.device() &&
+            volume.bytesAvailable() > fileSizeMB * 2LL * 1024 * 1024)
+        {
+            otherVolumeRoot = volume.rootPath();
+            break;
+        }
+    }
+
+    if (otherVolumeRoot.isEmpty())
+    {
+        report += "Another volume: Skipped, no other writable volume was found.\n";
+    }
+    else
+    {
+        QTemporaryDir otherVolumeDir(otherVolumeRoot + "/BMMoveBenchmark-XXXXXX");
+        if (otherVolumeDir.isValid())
+            success &= MoveFileOnce(testFile.fileName(), otherVolumeDir.path(), true,
+                                         "Another volume (" + otherVolumeRoot + ")", report);
+        else
+            report += "Another volume: Skipped, could not create a directory in " + otherVolumeRoot + "\n";
+    }
+
+    report += QString("\nAll moves and rollbacks succeeded: %1").arg(success ? "Yes" : "NO");
+    return success;
+}
+
+bool Benchmarks::MoveFileOnce(const QString& sourceFilePath, const QString& targetDirPath,
+                              bool allowRename, const QString& caseName, QString& report)
+{
+    const QString targetFilePath = targetDirPath + "/moved.bin";
+    const qint64 size = QFileInfo(sourceFilePath).size();
+
+    TransactionalFileOperator fileOperator;
+    fileOperator.BeginTransaction();
+
+    QElapsedTimer timer;
+    timer.start();
+    bool moved = (allowRename ? fileOperator.MoveFile(sourceFilePath, targetFilePath)
+                              : fileOperator.CopyAndRemoveFile(sourceFilePath, targetFilePath));
+    const qint64 moveMSecs = timer.restart();
+    bool rolledBack = fileOperator.RollBackTransaction();
+    const qint64 rollBackMSecs = timer.elapsed();
+
+    //Only the original must remain, with all of its contents.
+    bool success = moved && rolledBack && QFileInfo(sourceFilePath).size() == size
+                   && !QFile::exists(targetFilePath);
+    report += QString("%1: moving %2 ms, rolling back %3 ms%4\n").arg(caseName).arg(moveMSecs)
+              .arg(rollBackMSecs).arg(success ? "" : " (FAILED)");
+    return success;
+}
+
+bool Benchmarks::FileHashing(DatabaseManager* dbm, QWidget* dialogParent, QString& report)
+{
+    Q_UNUSED(dbm);
+    Q_UNUSED(dialogParent);
+    const int fileSizeMB = 1024;
+    report.clear();
+
+    //Known XXH64 values; and the same hash when the data comes in pieces.
+    QByteArray sampleData(1000, '\0');
+    for (int i = 0; i < sampleData.size(); i++)
+        sampleData[i] = char(i * 7 + i / 13);
+    FileHasher::FastHashState pieceState;
+    FileHasher::FastHashInit(pieceState);
+    FileHasher::FastHashUpdate(pieceState, sampleData.constData(), 5);
+    FileHasher::FastHashUpdate(pieceState, sampleData.constData() + 5, 40);
+    FileHasher::FastHashUpdate(pieceState, sampleData.constData() + 45, sampleData.size() - 45);
+    const bool fastHashCorrect = (FileHasher::FastHash(QByteArray()) == Q_UINT64_C(0xEF46DB3751D8E999) &&
+                                  FileHasher::FastHash("abc") == Q_UINT64_C(0x44BC2CF5AD770999) &&
+                                  FileHasher::FastHashFinal(pieceState) == FileHasher::FastHash(sampleData));
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        report = "Could not create a temporary directory.";
+        return false;
+    }
+
+    //Not compressible or repeating, like most big attachments.
+    const QString filePath = tempDir.path() + "/hashed.bin";
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        report = "Could not create the test file.";
+        return false;
+    }
+    QByteArray block(1024 * 1024, '\0');
+    unsigned int seed = 12345;
+    for (int mb = 0; mb < fileSizeMB; mb++)
+    {
+        for (int i = 0; i < block.size(); i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            block[i] = char(seed >> 16);
+        }
+        file.write(block);
+    }
+    file.close();
+
+    //Read it once, so that all the runs read it from the OS cache.
+    Util::GetMD5HashForFile(filePath);
+
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray oldMD5 = Util::GetMD5HashForFile(filePath);
+    const qint64 oldMSecs = timer.restart();
+    FileHasher::Result md5Result;
+    FileHasher::HashFile(filePath, FileHasher::HT_MD5, md5Result);
+    const qint64 md5MSecs = timer.restart();
+    FileHasher::Result fastResult;
+    FileHasher::HashFile(filePath, FileHasher::HT_Fast, fastResult);
+    const qint64 fastMSecs = timer.restart();
+    FileHasher::Result allResult;
+    FileHasher::HashFile(filePath, FileHasher::HT_All, allResult);
+    const qint64 allMSecs = timer.elapsed();
+
+    QByteArray readStrongHash;
+    if (file.open(QIODevice::ReadOnly))
+    {
+        QCryptographicHash strongHasher(QCryptographicHash::Sha256);
+        strongHasher.addData(&file);
+        readStrongHash = strongHasher.result();
+        file.close();
+    }
+
+    const bool sameHashes = (md5Result.md5 == oldMD5 && allResult.md5 == oldMD5 &&
+                             allResult.fastHash == fastResult.fastHash &&
+                             allResult.strongHash == readStrongHash);
+
+    report = QString("%1 MB file:\n"
+                     "Util::GetMD5HashForFile: %2 ms\n"
+                     "Mapped, MD5: %3 ms\n"
+                     "Mapped, fast hash (XXH64): %4 ms\n"
+                     "Mapped, MD5 + fast + strong (SHA-256) in parallel: %5 ms\n\n"
+                     "Fast hash gives its known values: %6\n"
+                     "Same hashes in all runs: %7")
+             .arg(fileSizeMB).arg(oldMSecs).arg(md5MSecs).arg(fastMSecs).arg(allMSecs)
+             .arg(fastHashCorrect ? "Yes" : "NO").arg(sameHashes ? "Yes" : "NO");
+
+    return (fastHashCorrect && sameHashes);
+}
+
+/// Sorts and filters like BookmarksSortFilterProxyModel, which can't be used without a
+///   DatabaseManager.
+class BenchmarkProxyModel : public QSortFilterProxyModel
+{
+public:
+    const BookmarksModel* model;
+    const BookmarkBitmap* filteredBookmarkIDs;
+
+    BenchmarkProxyModel(const BookmarksModel* model)
+        : model(model), filteredBookmarkIDs(NULL)
+    {
+
+    }
+
+protected:
+    bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const
+    {
+        Q_UNUSED(source_parent);
+        return (filteredBookmarkIDs == NULL || filteredBookmarkIDs->Contains(model->BIDAt(source_row)));
+    }
+
+    bool lessThan(const QModelIndex& source_left, const QModelIndex& source_right) const
+    {
+        const QVector<long long>& sortKeys = model->SortKeys(source_left.column());
+        return sortKeys[source_left.row()] < sortKeys[source_right.row()];
+    }
+};
+
+bool Benchmarks::BookmarksSorting(DatabaseManager* dbm, QWidget* dialogParent, QString& report)
+{
+    Q_UNUSED(dbm);
+    Q_UNUSED(dialogParent);
+    const int bookmarksCount = 200000;
+    report.clear();
+
+    const QString connectionName = "BenchmarkBookmarksModel";
+    bool success = true;
+    {
+        QSqlDatabase scratchDb = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        scratchDb.setDatabaseName(":memory:");
+        if (!scratchDb.open())
+        {
+            report = "Could not create the scratch database: " + scratchDb.lastError().text();
+            success = false;
+        }
+
+        //Same columns as the Bookmark table.
+        QSqlQuery query(scratchDb);
+        if (success && !query.exec("CREATE TABLE Bookmark"
+                                   "( BID INTEGER PRIMARY KEY AUTOINCREMENT, FOID INTEGER, Name TEXT, "
+                                   "  URLs TEXT, Desc TEXT, DefBFID INTEGER, Rating INTEGER, AddDate INTEGER )"))
+        {
+            report = "Could not create the scratch database: " + query.lastError().text();
+            success = false;
+        }
+
+        //Names are a few of a small set of words, so that many names share prefixes, like real
+        //  bookmark titles do. Deterministic, for comparable runs.
+        const QStringList words = QStringList() << "Qt" << "how" << "to" << "Python" << "unicode"
+                << "Documentation" << "SQLite" << "the" << "News" << "blog" << "Wiki" << "video";
+        quint32 random = 12345;
+
+        scratchDb.transaction();
+        query.prepare("INSERT INTO Bookmark (FOID, Name, URLs, Desc, DefBFID, Rating, AddDate) "
+                      "VALUES (?, ?, ?, '', -1, ?, ?)");
+        for (int i = 0; i < bookmarksCount && success; i++)
+        {
+            QStringList nameWords;
+            for (int w = 0; w < 4; w++)
+            {
+                random = random * 1103515245 + 12345;
+                nameWords.append(words[(random >> 8) % words.size()]);
+            }
+            query.addBindValue(1 + (random >> 4) % 500);
+            query.addBindValue(nameWords.join(' ') + QString(" %1").arg(i));
+            query.addBindValue(QString("http://example.com/%1").arg(random));
+            query.addBindValue((random >> 12) % 100);
+            query.addBindValue(Q_INT64_C(1400000000000) + random);
+            if (!query.exec())
+            {
+                report = "Could not fill the scratch database: " + query.lastError().text();
+                success = false;
+            }
+        }
+        scratchDb.commit();
+        query.finish();
+
+        if (success)
+        {
+            QElapsedTimer timer;
+            BookmarksModel model;
+            const QSqlRecord record = scratchDb.record("Bookmark");
+            timer.start();
+            success = model.Populate(scratchDb);
+            const qint64 populateMSecs = timer.elapsed();
+
+            BenchmarkProxyModel proxy(&model);
+            proxy.setSourceModel(&model);
+
+            //Every third bookmark; only the proxy's own work is measured, not making the bitmap.
+            BookmarkBitmap filteredBookmarkIDs;
+            for (int row = 0; row < model.rowCount(); row += 3)
+                filteredBookmarkIDs.Add(model.BIDAt(row));
+
+            //Name is sorted twice: the first one includes computing the sort keys.
+            timer.restart();
+            proxy.sort(record.indexOf("Name"));
+            const qint64 nameFirstMSecs = timer.restart();
+            proxy.sort(record.indexOf("Rating"));
+            const qint64 ratingMSecs = timer.restart();
+            proxy.sort(record.indexOf("Name"));
+            const qint64 nameMSecs = timer.restart();
+            proxy.sort(record.indexOf("AddDate"), Qt::DescendingOrder);
+            const qint64 addDateMSecs = timer.restart();
+            proxy.filteredBookmarkIDs = &filteredBookmarkIDs;
+            proxy.invalidate();
+            const qint64 filterMSecs = timer.restart();
+            proxy.filteredBookmarkIDs = NULL;
+            proxy.invalidate();
+            const qint64 unfilterMSecs = timer.elapsed();
+
+            report = QString("%1 bookmarks:\n"
+                             "Populate: %2 ms\n"
+                             "Sort by Name, first time: %3 ms\n"
+                             "Sort by Rating: %4 ms\n"
+                             "Sort by Name: %5 ms\n"
+                             "Sort by AddDate: %6 ms\n"
+                             "Filter to a third of the bookmarks: %7 ms\n"
+                             "Remove the filter: %8 ms")
+                    .arg(model.rowCount()).arg(populateMSecs).arg(nameFirstMSecs).arg(ratingMSecs)
+                    .arg(nameMSecs).arg(addDateMSecs).arg(filterMSecs).arg(unfilterMSecs);
+        }
+
+        scratchDb.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return success;
+}
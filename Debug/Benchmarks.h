@@ -0,0 +1,53 @@
+#pragma once
+#include <QString>
+
+class DatabaseManager;
+struct ImportedEntityList;
+class QWidget;
+
+/// The benchmarks of the Debug menu. They work on their own scratch data, so the user's bookmarks
+///   and files are not changed, and are kept here to stay out of the classes they measure.
+/// On success they return a report to show to user. On failure they return false with the error
+///   in `report`, or with an empty `report` if the error has already been shown.
+class Benchmarks
+{
+public:
+    typedef bool (*Function)(DatabaseManager* dbm, QWidget* dialogParent, QString& report);
+
+    /// Measures the latency of small single-row write transactions, first with SQLite's defaults
+    ///   (rollback journal, synchronous=FULL) then with the tuned settings. Uses a scratch database
+    ///   next to the open one.
+    static bool DatabaseCommitLatency(DatabaseManager* dbm, QWidget* dialogParent, QString& report);
+
+    /// Analyzes a synthetic Firefox-like import of 500000 bookmarks, both serially and in
+    ///   parallel, reports the times and checks that the results are the same.
+    static bool ImportAnalysis(DatabaseManager* dbm, QWidget* dialogParent, QString& report);
+
+    /// Saves 200 synthetic pages from a local server with several MHTSavers at once; see
+    ///   PageFetchBenchmark.
+    static bool PageFetching(DatabaseManager* dbm, QWidget* dialogParent, QString& report);
+
+    /// Compares MimeEncoder with the old encoders on 1 to 50 MB of text and binary data, and
+    ///   checks that they produce the same output.
+    static bool MimeEncoders(DatabaseManager* dbm, QWidget* dialogParent, QString& report);
+
+    /// Times moving a 512 MB file and rolling it back, on the volume of the temp directory and to
+    ///   another writable volume if there is one, and compares it with copying.
+    static bool FileMoves(DatabaseManager* dbm, QWidget* dialogParent, QString& report);
+
+    /// Compares FileHasher::HashFile with `Util::GetMD5HashForFile` on a 1 GB file, and checks the
+    ///   fast hash implementation against its known values.
+    static bool FileHashing(DatabaseManager* dbm, QWidget* dialogParent, QString& report);
+
+    /// Times populating, sorting and filtering 200000 synthetic bookmarks in a scratch in-memory
+    ///   database, through a proxy model doing what BookmarksSortFilterProxyModel does.
+    static bool BookmarksSorting(DatabaseManager* dbm, QWidget* dialogParent, QString& report);
+
+private:
+    static bool MoveFileOnce(const QString& sourceFilePath, const QString& targetDirPath,
+                             bool allowRename, const QString& caseName, QString& report);
+    /// Describes the first difference between the results of a serial and a parallel `Analyze` of
+    ///   the same list; empty if they are the same.
+    static QString AnalysisMismatch(const ImportedEntityList& serialElist,
+                                    const ImportedEntityList& parallelElist);
+};
@@ -0,0 +1,283 @@
+#include "PageFetchBenchmark.h"
+
+#include "BookmarkImporter/PageFetchScheduler.h"
+#include "BookmarkImporter/ResourceCache.h"
+
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+
+LocalPageServer::LocalPageServer(int resourcesPerPage, int resourceSize, int delayMSecs, QObject* parent)
+    : QTcpServer(parent), m_resourcesPerPage(resourcesPerPage), m_resourceSize(resourceSize)
+    , m_delayMSecs(delayMSecs)
+{
+    resetCounters();
+    m_clock.start();
+
+    m_responseTimer = new QTimer(this);
+    m_responseTimer->setInterval(1);
+    connect(m_responseTimer, SIGNAL(timeout()), this, SLOT(SendDueResponses()));
+    connect(this, SIGNAL(newConnection()), this, SLOT(NewConnection()));
+}
+
+void LocalPageServer::resetCounters()
+{
+    m_counters.connections = 0;
+    m_counters.requests = 0;
+    m_counters.notModifiedResponses = 0;
+    m_counters.maxActiveRequests = 0;
+    m_counters.maxActiveRequestsPerHost = 0;
+}
+
+LocalPageServer::Counters LocalPageServer::counters() const
+{
+    return m_counters;
+}
+
+void LocalPageServer::NewConnection()
+{
+    while (hasPendingConnections())
+    {
+        QTcpSocket* socket = nextPendingConnection();
+        m_counters.connections += 1;
+        m_requestBuffers.insert(socket, QByteArray());
+        connect(socket, SIGNAL(readyRead()), this, SLOT(ReadRequests()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(SocketDisconnected()));
+    }
+}
+
+void LocalPageServer::ReadRequests()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    QByteArray& buffer = m_requestBuffers[socket];
+    buffer += socket->readAll();
+
+    //Our clients only send GET requests, which don't have bodies.
+    int headEnd;
+    while ((headEnd = buffer.indexOf("\r\n\r\n")) != -1)
+    {
+        QByteArray requestHead = buffer.left(headEnd);
+        buffer.remove(0, headEnd + 4);
+
+        PendingResponse pending;
+        pending.socket = socket;
+        pending.host = socket->localAddress().toString();
+        pending.response = Respond(requestHead);
+        pending.dueMSecs = m_clock.elapsed() + m_delayMSecs;
+        m_pendingResponses.append(pending);
+
+        m_counters.requests += 1;
+        m_activeRequestsPerHost[pending.host] += 1;
+        m_counters.maxActiveRequests = qMax(m_counters.maxActiveRequests, m_pendingResponses.size());
+        m_counters.maxActiveRequestsPerHost = qMax(m_counters.maxActiveRequestsPerHost,
+                                                   m_activeRequestsPerHost[pending.host]);
+    }
+
+    if (!m_pendingResponses.isEmpty() && !m_responseTimer->isActive())
+        m_responseTimer->start();
+}
+
+void LocalPageServer::SocketDisconnected()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    m_requestBuffers.remove(socket);
+    socket->deleteLater();
+}
+
+void LocalPageServer::SendDueResponses()
+{
+    qint64 now = m_clock.elapsed();
+    while (!m_pendingResponses.isEmpty() && m_pendingResponses.first().dueMSecs <= now)
+    {
+        PendingResponse pending = m_pendingResponses.takeFirst();
+        m_activeRequestsPerHost[pending.host] -= 1;
+        if (!pending.socket.isNull())
+            pending.socket->write(pending.response);
+    }
+
+    if (m_pendingResponses.isEmpty())
+        m_responseTimer->stop();
+}
+
+QByteArray LocalPageServer::Respond(const QByteArray& requestHead)
+{
+    QList<QByteArray> headLines = requestHead.split('\n');
+    QList<QByteArray> requestLine = headLines[0].trimmed().split(' ');
+    QByteArray path = (requestLine.size() > 1 ? requestLine[1] : QByteArray());
+    QByteArray ifNoneMatch;
+    foreach (const QByteArray& line, headLines)
+        if (line.toLower().startsWith("if-none-match:"))
+            ifNoneMatch = line.mid(line.indexOf(':') + 1).trimmed();
+
+    QByteArray contentType;
+    QByteArray eTagHeader;
+    QByteArray body;
+    QList<QByteArray> pathParts = path.split('/'); //The first part is empty.
+
+    if (pathParts.size() == 3 && pathParts[1] == "page")
+    {
+        contentType = "text/html; charset=utf-8";
+        body = "<html><head><title>Page " + pathParts[2] + "</title></head><body>\n";
+        for (int i = 0; i < m_resourcesPerPage; i++)
+            body += "<img src=\"/res/" + (i < m_resourcesPerPage / 2 ? QByteArray("common") : pathParts[2])
+                    + "/" + QByteArray::number(i) + ".png\">\n";
+        body += "</body></html>\n";
+    }
+    else if (pathParts.size() == 4 && pathParts[1] == "res")
+    {
+        //The contents never change, so the path is as good as an ETag.
+        QByteArray eTag = "\"" + path + "\"";
+        if (ifNoneMatch == eTag)
+        {
+            m_counters.notModifiedResponses += 1;
+            return "HTTP/1.1 304 Not Modified\r\nETag: " + eTag + "\r\nConnection: keep-alive\r\n\r\n";
+        }
+
+        contentType = "image/png";
+        eTagHeader = "ETag: " + eTag + "\r\n";
+        body = QByteArray(m_resourceSize, 'x');
+    }
+    else
+    {
+        return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
+    }
+
+    return "HTTP/1.1 200 OK\r\nContent-Type: " + contentType + "\r\n" + eTagHeader + "Content-Length: "
+           + QByteArray::number(body.size()) + "\r\nConnection: keep-alive\r\n\r\n" + body;
+}
+
+PageFetchBenchmark::PageFetchBenchmark(QObject* parent)
+    : QObject(parent), m_port(0), m_pagesCount(0)
+{
+
+}
+
+bool PageFetchBenchmark::Run(int pagesCount, QString& report)
+{
+    report.clear();
+    LocalPageServer server(ResourcesPerPage, ResourceSize, ResponseDelayMSecs);
+    if (!server.listen(QHostAddress::AnyIPv4))
+    {
+        report = "Could not start the local server: " + server.errorString();
+        return false;
+    }
+
+    m_port = server.serverPort();
+    m_pagesCount = pagesCount;
+    report += QString("%1 pages with %2 resources each on %3 local hosts, %4 pages at a time.\n\n")
+              .arg(pagesCount).arg(ResourcesPerPage).arg(HostsCount).arg(ConcurrentPages);
+
+    QTemporaryDir cacheDir;
+    bool hostLimitKept = true;
+    RunOnce(server, RM_SchedulerPerSaver, QString(), report, hostLimitKept);
+    RunOnce(server, RM_SharedScheduler, QString(), report, hostLimitKept);
+    if (cacheDir.isValid())
+    {
+        RunOnce(server, RM_SharedCache, cacheDir.path(), report, hostLimitKept);
+        RunOnce(server, RM_ReopenedCache, cacheDir.path(), report, hostLimitKept);
+    }
+    report += QString("\nPer-host limit of %1 kept with the shared schedulers: %2")
+              .arg(MaxFetchesPerHost).arg(hostLimitKept ? "Yes" : "NO");
+
+    return true;
+}
+
+void PageFetchBenchmark::RunOnce(LocalPageServer& server, RunMode mode, const QString& cacheDir,
+                                 QString& report, bool& hostLimitKept)
+{
+    static const char* modeNames[] = { "Scheduler per page saver", "Shared scheduler",
+                                       "Shared scheduler and resource cache",
+                                       "Shared scheduler and reopened resource cache" };
+
+    server.resetCounters();
+    m_nextPage = 0;
+    m_donePages = 0;
+    m_failedPages = 0;
+
+    PageFetchScheduler* scheduler = NULL;
+    if (mode != RM_SchedulerPerSaver)
+        scheduler = new PageFetchScheduler(MaxConcurrentFetches, MaxFetchesPerHost, this);
+    ResourceCache* cache = NULL;
+    if (mode == RM_SharedCache || mode == RM_ReopenedCache)
+        cache = new ResourceCache(cacheDir, 64, 512, this);
+
+    QList<MHTSaver*> savers;
+    for (int i = 0; i < ConcurrentPages; i++)
+    {
+        MHTSaver* saver = new MHTSaver(this);
+        if (scheduler != NULL)
+            saver->setFetchScheduler(scheduler);
+        saver->setResourceCache(cache);
+        connect(saver, SIGNAL(MHTDataReady(QByteArray,MHTSaver::Status)),
+                this, SLOT(PageDone(QByteArray,MHTSaver::Status)));
+        savers.append(saver);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < savers.size() && m_nextPage < m_pagesCount; i++)
+        savers[i]->GetMHTData(PageURL(m_nextPage++));
+
+    QEventLoop loop;
+    connect(this, SIGNAL(AllPagesDone()), &loop, SLOT(quit()));
+    QTimer::singleShot(300000, &loop, SLOT(quit())); //Don't wait forever if something is broken.
+    if (m_donePages < m_pagesCount)
+        loop.exec();
+    qint64 elapsedMSecs = timer.elapsed();
+
+    LocalPageServer::Counters counters = server.counters();
+    report += QString("%1:\n%2 ms, %3 requests (%4 not modified) over %5 connections, at most %6 "
+                      "at once and %7 to a single host, %8 pages failed or not finished.\n")
+              .arg(modeNames[mode]).arg(elapsedMSecs).arg(counters.requests)
+              .arg(counters.notModifiedResponses).arg(counters.connections)
+              .arg(counters.maxActiveRequests).arg(counters.maxActiveRequestsPerHost)
+              .arg(m_failedPages + m_pagesCount - m_donePages);
+
+    if (cache != NULL)
+    {
+        ResourceCache::Stats cacheStats = cache->stats();
+        report += QString("Cache: %1 hits, %2 revalidated, %3 stored.\n")
+                  .arg(cacheStats.hits).arg(cacheStats.revalidations).arg(cacheStats.stores);
+    }
+    if (scheduler != NULL)
+    {
+        hostLimitKept = hostLimitKept && (counters.maxActiveRequestsPerHost <= MaxFetchesPerHost);
+        PageFetchScheduler::Stats stats = scheduler->stats();
+        report += QString("Scheduler: %1 fetches, %2 failed, %3 timed out, at most %4 at once.\n")
+                  .arg(stats.finishedFetches).arg(stats.failedFetches).arg(stats.timedOutFetches)
+                  .arg(stats.maxActiveFetches);
+    }
+
+    //Savers first; their fetches must not outlive the scheduler.
+    foreach (MHTSaver* saver, savers)
+        delete saver;
+    delete scheduler;
+    delete cache; //Writes its index for the reopened run.
+}
+
+QString PageFetchBenchmark::PageURL(int page)
+{
+    //127.0.0.x are all the local host, but are different hosts to the schedulers.
+    return QString("http://127.0.0.%1:%2/page/%3").arg(1 + page % HostsCount).arg(m_port).arg(page);
+}
+
+void PageFetchBenchmark::PageDone(const QByteArray& data, const MHTSaver::Status& status)
+{
+    Q_UNUSED(data);
+    m_donePages += 1;
+    if (!status.mainSuccess || status.mainHttpErrorCode != 200 || status.resourceSuccess != status.resourceCount)
+        m_failedPages += 1;
+
+    if (m_nextPage < m_pagesCount)
+    {
+        //Not directly; the saver is still emitting its result.
+        QMetaObject::invokeMethod(sender(), "GetMHTData", Qt::QueuedConnection,
+                                  Q_ARG(QString, PageURL(m_nextPage++)));
+    }
+    else if (m_donePages == m_pagesCount)
+    {
+        emit AllPagesDone();
+    }
+}
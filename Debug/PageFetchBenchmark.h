@@ -0,0 +1,109 @@
+#pragma once
+#include <QObject>
+
+#include "BookmarkImporter/MHTSaver.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QTcpServer>
+
+class QTcpSocket;
+class QTimer;
+
+/// A minimal keep-alive HTTP server that serves synthetic pages and their resources, delaying each
+///     response a bit like a real server would. `/page/N` is an HTML page linking to
+///     `resourcesPerPage` resources; the first half are common to all pages at `/res/common/I.png`
+///     and the rest are at `/res/N/I.png`. Resources have ETags and conditional requests for them
+///     are answered with '304 Not Modified'.
+/// It counts the connections and the most requests it was serving at once, in total and for each
+///     of the local addresses (127.0.0.x) it was reached at, which the benchmark uses as different
+///     hosts.
+class LocalPageServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    struct Counters
+    {
+        int connections;
+        int requests;
+        int notModifiedResponses;
+        int maxActiveRequests;
+        int maxActiveRequestsPerHost;
+    };
+
+private:
+    struct PendingResponse
+    {
+        QPointer<QTcpSocket> socket;
+        QString host;
+        QByteArray response;
+        qint64 dueMSecs;
+    };
+
+    const int m_resourcesPerPage;
+    const int m_resourceSize;
+    const int m_delayMSecs;
+
+    QHash<QTcpSocket*, QByteArray> m_requestBuffers;
+    QList<PendingResponse> m_pendingResponses; //By due time.
+    QHash<QString, int> m_activeRequestsPerHost;
+    Counters m_counters;
+
+    QElapsedTimer m_clock;
+    QTimer* m_responseTimer;
+
+public:
+    LocalPageServer(int resourcesPerPage, int resourceSize, int delayMSecs, QObject* parent = 0);
+
+    void resetCounters();
+    Counters counters() const;
+
+private slots:
+    void NewConnection();
+    void ReadRequests();
+    void SocketDisconnected();
+    void SendDueResponses();
+
+private:
+    QByteArray Respond(const QByteArray& requestHead);
+};
+
+/// Saves synthetic pages from a LocalPageServer with several MHTSavers at once, like the bookmark
+///     importer does, and reports the time, requests, connections and concurrency of each way of
+///     running them: each saver having its own PageFetchScheduler, all of them sharing one, sharing
+///     a ResourceCache too, and again with that cache reopened like in a later import.
+class PageFetchBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    enum RunMode { RM_SchedulerPerSaver, RM_SharedScheduler, RM_SharedCache, RM_ReopenedCache };
+    enum { ConcurrentPages = 10, HostsCount = 8, ResourcesPerPage = 8, ResourceSize = 16 * 1024,
+           ResponseDelayMSecs = 10, MaxConcurrentFetches = 24, MaxFetchesPerHost = 6 };
+
+    quint16 m_port;
+    int m_pagesCount;
+    int m_nextPage;
+    int m_donePages;
+    int m_failedPages;
+
+public:
+    explicit PageFetchBenchmark(QObject* parent = 0);
+
+    bool Run(int pagesCount, QString& report);
+
+private:
+    void RunOnce(LocalPageServer& server, RunMode mode, const QString& cacheDir, QString& report,
+                 bool& hostLimitKept);
+    QString PageURL(int page);
+
+private slots:
+    void PageDone(const QByteArray& data, const MHTSaver::Status& status);
+
+signals:
+    void AllPagesDone();
+};
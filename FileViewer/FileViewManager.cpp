@@ -163,8 +163,10 @@ void FileViewManager::OpenReadOnly(const QString& filePathName, FileManager* fil
 
 void FileViewManager::OpenEditable(const QString& filePathName, FileManager* files)
 {
-    Q_UNUSED(files)
-    GenericOpenFile(filePathName, GetPreferredOpenApplication(filePathName), false, NULL);
+    //Editing a file of a content-addressed archive in place would change it for all the File rows
+    //  that share it, and its contents would no longer match its name.
+    bool sandboxed = (files != NULL && files->IsInContentAddressedArchive(filePathName));
+    GenericOpenFile(filePathName, GetPreferredOpenApplication(filePathName), sandboxed, files);
 }
 
 void FileViewManager::OpenWith(const QString& filePathName, bool allowNonSandbox,
@@ -172,6 +174,10 @@ void FileViewManager::OpenWith(const QString& filePathName, bool allowNonSandbox
 {
     //Note that we do NOT use the dbm's dialogParent; as we need to make the parent of the
     //  OpenWithDialog the previous dialog which was open, NOT the MainWindow.
+    //Like in OpenEditable.
+    if (dbm->files.IsInContentAddressedArchive(filePathName))
+        allowNonSandbox = false;
+
     OpenWithDialog::OutParams outParams;
     OpenWithDialog openWithDlg(dbm, filePathName, allowNonSandbox, &outParams, dialogParent);
 
@@ -2,9 +2,11 @@
 
 #include "Config.h"
 #include "Database/DatabaseManager.h"
+#include "Util/FileHasher.h"
 #include "Util/TransactionalFileOperator.h"
 #include "Util/Util.h"
 
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
@@ -25,6 +27,15 @@ FileArchiveManager::~FileArchiveManager()
 bool FileArchiveManager::AddFileToArchive(const QString& filePathName, bool systemTrashOriginalFile,
                                           const QString& folderHint, const QString& groupHint,
                                           const QString& errorWhileContext, QString& fileArchiveURL)
+{
+    return AddFileToArchive(filePathName, systemTrashOriginalFile, folderHint, groupHint,
+                            QByteArray(), errorWhileContext, fileArchiveURL);
+}
+
+bool FileArchiveManager::AddFileToArchive(const QString& filePathName, bool systemTrashOriginalFile,
+                                          const QString& folderHint, const QString& groupHint,
+                                          const QByteArray& contentHash,
+                                          const QString& errorWhileContext, QString& fileArchiveURL)
 {
     //This is like an assert.
     if (!filesTransaction->isTransactionStarted())
@@ -42,11 +53,108 @@ bool FileArchiveManager::AddFileToArchive(const QString& filePathName, bool syst
                      .arg(errorWhileContext, filePathName));
 
     //Decide where should the file be copied.
-    QString fileRelArchiveURL = CalculateFileArchiveURL(filePathName, folderHint, groupHint);
+    QByteArray fileContentHash = contentHash;
+    if (IsContentAddressed() && fileContentHash.isEmpty() &&
+        !HashFile(filePathName, errorWhileContext, fileContentHash))
+        return false;
+
+    QString targetFilePathName;
+    if (!PrepareTargetFilePath(filePathName, folderHint, groupHint, fileContentHash,
+                               errorWhileContext, targetFilePathName, fileArchiveURL))
+        return false;
+
+    //Copy the file, unless the same contents are already stored.
+    bool stored = false;
+    if (IsContentAddressed() &&
+        !CheckStoredContents(targetFilePathName, fileContentHash, fi.size(), errorWhileContext, stored))
+        return false;
+
+    if (!stored)
+    {
+        bool success = filesTransaction->CopyFile(filePathName, targetFilePathName);
+        if (!success)
+            return Error(QString("Error while %1:\n"
+                                 "Could not copy the source file to destination directory!"
+                                 "\n\nSource File: %2\nDestination File: %3")
+                                 .arg(errorWhileContext, filePathName, targetFilePathName));
+    }
+
+    //Remove the original file.
+    if (systemTrashOriginalFile)
+    {
+        bool Trashsuccess = filesTransaction->SystemTrashFile(filePathName);
+        //We do NOT return FALSE in case of failure.
+        if (!Trashsuccess)
+        {
+            Error(QString("Error while %1:\nCould not delete the original file from your filesystem. "
+                          "You should manually delete it yourself.\n\nFile: %2")
+                  .arg(errorWhileContext, filePathName));
+        }
+    };
+
+    return true;
+}
+
+bool FileArchiveManager::AddDataToArchive(QIODevice* data, const QString& fileName,
+                                          const QString& folderHint, const QString& groupHint,
+                                          const QString& errorWhileContext, QString& fileArchiveURL,
+                                          QByteArray& md5, qint64& size)
+{
+    //This is like an assert.
+    if (!filesTransaction->isTransactionStarted())
+        return Error(QString("Error while %1:\n"
+                             "No file transaction was started before adding files to archive.")
+                     .arg(errorWhileContext));
+
+    //Decide where should the file be written. The content-addressed layout needs to read the data
+    //  once before that; it is then not written at all if the same contents are already stored.
+    QByteArray contentHash;
+    if (IsContentAddressed())
+    {
+        if (data->isSequential() || !HashContents(data, contentHash, &md5, &size) || !data->reset())
+            return Error(QString("Error while %1:\nCould not read the data of \"%2\" to find out "
+                                 "where to store it.").arg(errorWhileContext, fileName));
+    }
+
+    QString targetFilePathName;
+    if (!PrepareTargetFilePath(fileName, folderHint, groupHint, contentHash, errorWhileContext,
+                               targetFilePathName, fileArchiveURL))
+        return false;
+
+    if (IsContentAddressed())
+    {
+        bool stored;
+        if (!CheckStoredContents(targetFilePathName, contentHash, size, errorWhileContext, stored))
+            return false;
+        if (stored)
+            return true; //`md5` and `size` are already set.
+    }
+
+    //Write and hash the data in one pass.
+    QCryptographicHash hasher(QCryptographicHash::Md5);
+    bool success = filesTransaction->WriteFile(data, targetFilePathName, &hasher, size);
+    if (!success)
+        return Error(QString("Error while %1:\n"
+                             "Could not write the file to destination directory!"
+                             "\n\nDestination File: %2")
+                             .arg(errorWhileContext, targetFilePathName));
+
+    md5 = hasher.result();
+    return true;
+}
+
+bool FileArchiveManager::PrepareTargetFilePath(const QString& fileFullPathName,
+                                               const QString& folderHint, const QString& groupHint,
+                                               const QByteArray& contentHash,
+                                               const QString& errorWhileContext,
+                                               QString& targetFilePathName, QString& fileArchiveURL)
+{
+    QString fileRelArchiveURL =
+            CalculateFileArchiveURL(fileFullPathName, folderHint, groupHint, contentHash);
     if (fileRelArchiveURL.isEmpty())
         return false;
 
-    QString targetFilePathName = GetFullArchivePathForRelativeURL(fileRelArchiveURL);
+    targetFilePathName = GetFullArchivePathForRelativeURL(fileRelArchiveURL); //Out param
     fileArchiveURL = m_archiveName + "/" + fileRelArchiveURL; //Out param
 
     //Create its directory if doesn't exist.
@@ -67,27 +175,6 @@ bool FileArchiveManager::AddFileToArchive(const QString& filePathName, bool syst
                      "\n\nDirectory: %2").arg(errorWhileContext, tdi.absoluteFilePath()));
     }
 
-    //Copy the file.
-    bool success = filesTransaction->CopyFile(filePathName, targetFilePathName);
-    if (!success)
-        return Error(QString("Error while %1:\n"
-                             "Could not copy the source file to destination directory!"
-                             "\n\nSource File: %2\nDestination File: %3")
-                             .arg(errorWhileContext, filePathName, targetFilePathName));
-
-    //Remove the original file.
-    if (systemTrashOriginalFile)
-    {
-        bool Trashsuccess = filesTransaction->SystemTrashFile(filePathName);
-        //We do NOT return FALSE in case of failure.
-        if (!Trashsuccess)
-        {
-            Error(QString("Error while %1:\nCould not delete the original file from your filesystem. "
-                          "You should manually delete it yourself.\n\nFile: %2")
-                  .arg(errorWhileContext, filePathName));
-        }
-    };
-
     return true;
 }
 
@@ -118,8 +205,57 @@ bool FileArchiveManager::RemoveFileFromArchive(const QString& fileRelArchiveURL,
     return true;
 }
 
+bool FileArchiveManager::MoveFileToArchive(const QString& filePathName,
+                                           const QString& folderHint, const QString& groupHint,
+                                           const QString& errorWhileContext, QString& fileArchiveURL)
+{
+    //This is like an assert.
+    if (!filesTransaction->isTransactionStarted())
+        return Error(QString("Error while %1:\n"
+                             "No file transaction was started before moving files to archive.")
+                     .arg(errorWhileContext));
+
+    QFileInfo fi(filePathName);
+    if (!fi.isFile())
+        return Error(QString("Error while %1:\nThe path \"%2\" does not point to a valid file!")
+                     .arg(errorWhileContext, filePathName));
+
+    QByteArray contentHash;
+    if (IsContentAddressed() && !HashFile(filePathName, errorWhileContext, contentHash))
+        return false;
+
+    QString targetFilePathName;
+    if (!PrepareTargetFilePath(filePathName, folderHint, groupHint, contentHash, errorWhileContext,
+                               targetFilePathName, fileArchiveURL))
+        return false;
+
+    //If it is the stored file itself, e.g when moving inside this archive, there is nothing to do.
+    if (IsContentAddressed() && QFileInfo(targetFilePathName) == fi)
+        return true;
+
+    bool stored = false;
+    if (IsContentAddressed() &&
+        !CheckStoredContents(targetFilePathName, contentHash, fi.size(), errorWhileContext, stored))
+        return false;
+
+    bool success;
+    if (!stored)
+        success = filesTransaction->MoveFile(filePathName, targetFilePathName);
+    else //The same contents are already stored; only the original is not needed anymore.
+        success = filesTransaction->DeleteFile(filePathName);
+
+    if (!success)
+        return Error(QString("Error while %1:\n"
+                             "Could not move the file to destination directory!"
+                             "\n\nSource File: %2\nDestination File: %3")
+                             .arg(errorWhileContext, filePathName, targetFilePathName));
+
+    return true;
+}
+
 QString FileArchiveManager::CalculateFileArchiveURL(const QString& fileFullPathName,
-                                                    const QString& folderHint, const QString& groupHint)
+                                                    const QString& folderHint, const QString& groupHint,
+                                                    const QByteArray& contentHash)
 {
     bool FsTransformUnicode = dbm->sets.GetSetting("FsTransformUnicode", dbm->conf->defaultFsTransformUnicode);
     QFileInfo fi(fileFullPathName);
@@ -199,12 +335,109 @@ QString FileArchiveManager::CalculateFileArchiveURL(const QString& fileFullPathN
 
         return fileArchiveURL;
     }
+    else if (m_fileLayout == ContentAddressedLayout)
+    {
+        if (contentHash.isEmpty())
+        {
+            Error(QString("The contents of the file were not hashed before adding it to the "
+                          "content-addressed file archive %1.").arg(m_archiveName));
+            return QString();
+        }
+
+        //Put files like 'co/contenthash.ext'. Files with the same contents but different extensions
+        //  are stored separately, as the extension is needed for opening them. It is lower-cased so
+        //  that e.g 'a.PDF' and 'b.pdf' are stored once.
+        QString hexHash = QString::fromLatin1(contentHash.toHex());
+        QString suffix = fi.suffix().toLower();
+        QString fileArchiveURL = hexHash.left(2) + "/" + hexHash;
+        if (!suffix.isEmpty() && suffix.length() <= 16 && Util::IsValidFileName(suffix))
+            fileArchiveURL += "." + suffix;
+
+        return fileArchiveURL;
+    }
 
     Error(QString("Invalid layout for file archive %1: %2.")
           .arg(m_archiveName, QString::number(m_fileLayout)));
     return QString();
 }
 
+bool FileArchiveManager::HashFile(const QString& filePathName, const QString& errorWhileContext,
+                                  QByteArray& contentHash)
+{
+    FileHasher::Result hashResult;
+    if (!FileHasher::HashFile(filePathName, FileHasher::HT_Strong, hashResult))
+        return Error(QString("Error while %1:\nCould not read the file \"%2\" to find out where "
+                             "to store it.").arg(errorWhileContext, filePathName));
+
+    contentHash = hashResult.strongHash;
+    return true;
+}
+
+bool FileArchiveManager::CheckStoredContents(const QString& targetFilePathName,
+                                             const QByteArray& contentHash, qint64 size,
+                                             const QString& errorWhileContext, bool& stored)
+{
+    stored = false; //Do it for caller
+
+    QFileInfo tfi(targetFilePathName);
+    //`exists` returns `false` if symlink exists but its target doesn't.
+    if (!tfi.exists() && !tfi.isSymLink())
+        return true;
+
+    //The size is checked first, as it needs no reading.
+    if (tfi.isFile() && tfi.size() == size)
+    {
+        FileHasher::Result hashResult;
+        if (FileHasher::HashFile(targetFilePathName, FileHasher::HT_Strong, hashResult) &&
+            hashResult.strongHash == contentHash)
+        {
+            stored = true;
+            return true;
+        }
+    }
+
+    //The stored file was changed or damaged in the archive. It is replaced with the new contents,
+    //  which also repairs it for the other File rows that share it.
+    if (!filesTransaction->DeleteFile(targetFilePathName))
+        return Error(QString("Error while %1:\nThe file stored in the archive for the same contents "
+                             "is damaged and could not be replaced.\n\nFile: %2")
+                     .arg(errorWhileContext, targetFilePathName));
+
+    return true;
+}
+
+bool FileArchiveManager::HashContents(QIODevice* device, QByteArray& contentHash,
+                                      QByteArray* md5, qint64* size)
+{
+    //Same chunk size as Util::GetMD5HashForFile.
+    const int CHUNK_SIZE = 65536;
+    char buff[CHUNK_SIZE];
+
+    QCryptographicHash contentHasher(QCryptographicHash::Sha256);
+    QCryptographicHash md5Hasher(QCryptographicHash::Md5);
+    qint64 totalRead = 0;
+    while (!device->atEnd())
+    {
+        qint64 bytesRead = device->read(buff, CHUNK_SIZE);
+        if (bytesRead < 0)
+            return false;
+        if (bytesRead == 0)
+            break;
+
+        contentHasher.addData(buff, bytesRead);
+        if (md5 != NULL)
+            md5Hasher.addData(buff, bytesRead);
+        totalRead += bytesRead;
+    }
+
+    contentHash = contentHasher.result();
+    if (md5 != NULL)
+        *md5 = md5Hasher.result();
+    if (size != NULL)
+        *size = totalRead;
+    return true;
+}
+
 int FileArchiveManager::FileNameHash(const QString& fileNameOnly)
 {
     //For now just calculates the utf-8 sum of all bytes.
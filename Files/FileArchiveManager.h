@@ -2,13 +2,22 @@
 #include "IArchiveManager.h"
 
 /// This class is also known as FAM.
-/// It supports three layouts:
+/// It supports four layouts:
 ///     Layout 0 stores files as :archivepath:/h/hash_of_filename.ext
 ///     Layout 1 stores files as :archivepath:/f/fi/filename.ext
 ///     Layout 2 stores files as :archivepath:/folder/hint/hierarchy/[groupHint/]filename.ext
+///     Layout 3 stores files as :archivepath:/co/content_hash.ext
+/// Layout 3 is content-addressed: content_hash is the hex SHA-256 of the file contents, so files
+///     with the same contents and extension are stored only once, and adding one that is already
+///     there does not copy it again, once the stored one is checked to have them. The stored file
+///     is then shared by several File rows with the same ArchiveURL; FileManager counts them, and
+///     must not move or remove it while any other row uses it. So its files must never be opened
+///     for editing in place.
 class FileArchiveManager : public IArchiveManager
 {
 public:
+    static const int ContentAddressedLayout = 3;
+
     FileArchiveManager(QWidget* dialogParent, DatabaseManager* dbm,
                        const QString& archiveName, const QString& archiveRoot,
                        int fileLayout, TransactionalFileOperator* filesTransaction);
@@ -20,14 +29,40 @@ public:
         return AT_FileArchive;
     }
 
+    bool IsContentAddressed()
+    {
+        return (m_fileLayout == ContentAddressedLayout);
+    }
+
     /// A Files Transaction MUST have been started before calling Add/Remove functions.
     bool AddFileToArchive(const QString& filePathName, bool systemTrashOriginalFile,
                           const QString& folderHint, const QString& groupHint,
                           const QString& errorWhileContext, QString& fileArchiveURL);
+    /// Like the above, but `contentHash` is the already known SHA-256 of the file, so the
+    ///   content-addressed layout does not read it again for finding where to store it.
+    bool AddFileToArchive(const QString& filePathName, bool systemTrashOriginalFile,
+                          const QString& folderHint, const QString& groupHint,
+                          const QByteArray& contentHash,
+                          const QString& errorWhileContext, QString& fileArchiveURL);
+    bool AddDataToArchive(QIODevice* data, const QString& fileName,
+                          const QString& folderHint, const QString& groupHint,
+                          const QString& errorWhileContext, QString& fileArchiveURL,
+                          QByteArray& md5, qint64& size);
     bool RemoveFileFromArchive(const QString& fileRelArchiveURL, bool trash,
                                const QString& errorWhileContext);
+    /// Like AddFileToArchive then deleting the original, but the file is renamed instead of being
+    ///   copied when it is on the same volume as this archive. For moving between FAMs.
+    bool MoveFileToArchive(const QString& filePathName,
+                           const QString& folderHint, const QString& groupHint,
+                           const QString& errorWhileContext, QString& fileArchiveURL);
 
 private:
+    /// Decides where a file named like `fileFullPathName` should be put, and creates its directory.
+    /// `contentHash` is only needed for the content-addressed layout.
+    bool PrepareTargetFilePath(const QString& fileFullPathName,
+                               const QString& folderHint, const QString& groupHint,
+                               const QByteArray& contentHash, const QString& errorWhileContext,
+                               QString& targetFilePathName, QString& fileArchiveURL);
     /// Could be called `CreateFileArchiveURL` too. Return's a URL relative to archive root.
     /// Note: This only happens ONCE, and later if file name in archive, or any other property
     ///       that is used to calculate the hash or anyhting in the FileArchive changes, the file
@@ -35,7 +70,18 @@ private:
     ///       Also, changing the file extension does NOT change the extension that is used with
     ///       the file in the FileArchive.
     QString CalculateFileArchiveURL(const QString& fileFullPathName,
-                                    const QString& folderHint, const QString& groupHint);
+                                    const QString& folderHint, const QString& groupHint,
+                                    const QByteArray& contentHash);
+    /// For the content-addressed layout.
+    bool HashFile(const QString& filePathName, const QString& errorWhileContext,
+                  QByteArray& contentHash);
+    /// Whether the content-addressed `targetFilePathName` already has the contents with `size` and
+    ///   `contentHash`. If a file is there but its contents differ, it is deleted so that the
+    ///   caller stores the contents again.
+    bool CheckStoredContents(const QString& targetFilePathName, const QByteArray& contentHash,
+                             qint64 size, const QString& errorWhileContext, bool& stored);
+    /// Reads `device` to its end. `md5` and `size` can be NULL.
+    static bool HashContents(QIODevice* device, QByteArray& contentHash, QByteArray* md5, qint64* size);
     int FileNameHash(const QString& fileNameOnly);
     ///FolderHierForName returns returns 'f/fi/' for 'fileName'.
     QString FolderHierForName(const QString& name, bool isFileName);
@@ -0,0 +1,422 @@
+#include "FileArchiveVerifier.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QVector>
+
+/// Lists the files under one archive root.
+class FileArchiveVerifier::WalkTask : public QRunnable
+{
+private:
+    QString m_rootPath;
+    FileArchiveVerifier* m_verifier;
+
+public:
+    QHash<QString, DiskEntry> entries;
+
+    WalkTask(const QString& rootPath, FileArchiveVerifier* verifier)
+        : m_rootPath(rootPath), m_verifier(verifier)
+    {
+        setAutoDelete(false);
+    }
+
+    void run()
+    {
+        QDirIterator it(m_rootPath, QDir::Files | QDir::Hidden | QDir::System,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext() && !m_verifier->IsCancelled())
+        {
+            it.next();
+            const QFileInfo fi = it.fileInfo();
+
+            DiskEntry entry;
+            entry.filePath = fi.filePath();
+            entry.size = fi.size();
+            entry.modifiedMSecs = fi.lastModified().toMSecsSinceEpoch();
+            entries.insert(PathKey(entry.filePath), entry);
+        }
+    }
+};
+
+/// Hashes one file into a result slot that the verifier has prepared for it.
+class FileArchiveVerifier::HashTask : public QRunnable
+{
+private:
+    QString m_filePath;
+    /// Of the last verification, if the file was verified with the same MD5 and size before.
+    const Fingerprint* m_verified;
+    FileHasher::Result* m_result;
+    bool* m_done;
+    FileArchiveVerifier* m_verifier;
+
+public:
+    HashTask(const QString& filePath, const Fingerprint* verified, FileHasher::Result* result,
+             bool* done, FileArchiveVerifier* verifier)
+        : m_filePath(filePath), m_verified(verified), m_result(result), m_done(done)
+        , m_verifier(verifier)
+    {
+
+    }
+
+    void run()
+    {
+        //Files that were not finished before cancelling remain for the next run; big ones are
+        //  cancelled in the middle.
+        const QAtomicInt* cancelled = &m_verifier->m_cancelled;
+        if (m_verifier->IsCancelled())
+            return;
+
+        //If the fast hash is still the verified one, the contents are too; the verified MD5 is
+        //  taken as the result. Otherwise MD5 is needed; the fast hash is computed meanwhile, for
+        //  the checkpoint.
+        bool hashed;
+        if (m_verified != NULL &&
+            FileHasher::HashFile(m_filePath, FileHasher::HT_Fast, *m_result, cancelled, m_verifier) &&
+            m_result->fastHash == m_verified->fastHash)
+        {
+            m_result->md5 = m_verified->md5;
+            hashed = true;
+        }
+        else
+        {
+            hashed = FileHasher::HashFile(m_filePath, FileHasher::HT_MD5 | FileHasher::HT_Fast,
+                                          *m_result, cancelled, m_verifier);
+        }
+
+        if (!hashed && m_verifier->IsCancelled())
+            return;
+        *m_done = true;
+    }
+};
+
+FileArchiveVerifier::FileArchiveVerifier(QObject* parent)
+    : QThread(parent), m_startOver(false), m_maxHashBytes(0), m_cancelled(0)
+    , m_totalHashBytes(0), m_doneHashBytes(0), m_lastPercent(-1)
+{
+
+}
+
+FileArchiveVerifier::~FileArchiveVerifier()
+{
+    Cancel();
+    wait();
+}
+
+void FileArchiveVerifier::SetParameters(const QList<Archive>& archives,
+                                        const QList<ArchivedFile>& files,
+                                        const QString& checkpointFilePath, bool startOver,
+                                        qint64 maxHashBytes)
+{
+    m_archives = archives;
+    m_files = files;
+    m_checkpointFilePath = checkpointFilePath;
+    m_startOver = startOver;
+    m_maxHashBytes = maxHashBytes;
+    m_cancelled.storeRelease(0);
+}
+
+FileArchiveVerifier::Report FileArchiveVerifier::GetReport() const
+{
+    return m_report;
+}
+
+bool FileArchiveVerifier::IsCancelled() const
+{
+    return (m_cancelled.loadAcquire() != 0);
+}
+
+QString FileArchiveVerifier::ProblemTypeName(FileArchiveVerifier::ProblemType type)
+{
+    switch (type)
+    {
+    case PT_Missing:
+        return "Missing";
+    case PT_Orphaned:
+        return "Orphaned";
+    case PT_Corrupted:
+        return "Corrupted";
+    }
+    return QString();
+}
+
+void FileArchiveVerifier::Cancel()
+{
+    m_cancelled.storeRelease(1);
+}
+
+void FileArchiveVerifier::run()
+{
+    m_report.filesCount = m_files.size();
+    m_report.hashedFiles = 0;
+    m_report.hashedBytes = 0;
+    m_report.unchangedFiles = 0;
+    m_report.remainingFiles = 0;
+    m_report.problems.clear();
+    m_totalHashBytes = 0;
+    m_doneHashBytes = 0;
+    m_lastPercent = -1;
+
+    //1. Walk all the archive roots at the same time; they are usually on different folders, if not
+    //   on different disks. A nested root is walked twice, but its files are only kept once.
+    QThreadPool walkPool;
+    walkPool.setMaxThreadCount(qMax(1, m_archives.size()));
+    QList<WalkTask*> walkTasks;
+    foreach (const Archive& archive, m_archives)
+    {
+        WalkTask* walkTask = new WalkTask(archive.rootPath, this);
+        walkTasks.append(walkTask);
+        walkPool.start(walkTask);
+    }
+    walkPool.waitForDone();
+
+    QHash<QString, DiskEntry> diskFiles;
+    foreach (WalkTask* walkTask, walkTasks)
+    {
+        //Not `unite`; it would keep the files of a nested root twice, as multiple values.
+        for (QHash<QString, DiskEntry>::const_iterator it = walkTask->entries.constBegin();
+             it != walkTask->entries.constEnd(); ++it)
+            diskFiles.insert(it.key(), it.value());
+        delete walkTask;
+    }
+
+    if (IsCancelled())
+        return;
+
+    //2. Check what can be checked without reading the files, and choose the files to hash.
+    QHash<long long, Fingerprint> fingerprints;
+    if (!m_startOver)
+        ReadCheckpoint(fingerprints);
+
+    QHash<long long, Fingerprint> newFingerprints;
+    QHash<QString, bool> referencedPaths;
+    QList<int> toHashIndexes;
+    QList<Fingerprint> toHashFingerprints;
+    //Pointers into `fingerprints`, which does not change anymore; NULL for the ones not verified.
+    QList<const Fingerprint*> toHashVerified;
+
+    for (int i = 0; i < m_files.size(); i++)
+    {
+        const ArchivedFile& file = m_files[i];
+        Problem problem;
+        problem.FID = file.FID;
+        problem.filePath = (file.filePath.isEmpty() ? file.archiveURL : file.filePath);
+
+        if (file.filePath.isEmpty())
+        {
+            problem.type = PT_Missing;
+            problem.details = "The file archive in its URL does not exist.";
+            m_report.problems.append(problem);
+            continue;
+        }
+
+        const QString key = PathKey(file.filePath);
+        referencedPaths[key] = true;
+        if (!diskFiles.contains(key))
+        {
+            problem.type = PT_Missing;
+            problem.details = "It is not in the file archive.";
+            m_report.problems.append(problem);
+            continue;
+        }
+
+        const DiskEntry& entry = diskFiles[key];
+        if (entry.size != file.size)
+        {
+            problem.type = PT_Corrupted;
+            problem.details = QString("Its size is %1 bytes instead of %2.")
+                              .arg(entry.size).arg(file.size);
+            m_report.problems.append(problem);
+            continue;
+        }
+
+        Fingerprint fingerprint;
+        fingerprint.archiveURL = file.archiveURL;
+        fingerprint.size = entry.size;
+        fingerprint.modifiedMSecs = entry.modifiedMSecs;
+        fingerprint.md5 = file.md5;
+        fingerprint.fastHash = 0; //Set once it is verified.
+
+        //File.ModifyDate is of the original file before attaching it, so the modification time
+        //  in the archive is only known from the checkpoint.
+        const Fingerprint* verified = NULL;
+        QHash<long long, Fingerprint>::const_iterator verifiedIt = fingerprints.constFind(file.FID);
+        if (verifiedIt != fingerprints.constEnd() &&
+            verifiedIt->archiveURL == fingerprint.archiveURL && verifiedIt->size == fingerprint.size &&
+            verifiedIt->md5 == fingerprint.md5)
+        {
+            if (verifiedIt->modifiedMSecs == fingerprint.modifiedMSecs)
+            {
+                fingerprint.fastHash = verifiedIt->fastHash;
+                newFingerprints.insert(file.FID, fingerprint);
+                m_report.unchangedFiles += 1;
+                continue;
+            }
+            verified = &verifiedIt.value();
+        }
+
+        //Always hash at least one file, even if it is larger than the whole slice.
+        if (!toHashIndexes.isEmpty() && m_totalHashBytes + file.size > m_maxHashBytes)
+        {
+            m_report.remainingFiles += 1;
+            continue;
+        }
+
+        toHashIndexes.append(i);
+        toHashFingerprints.append(fingerprint);
+        toHashVerified.append(verified);
+        m_totalHashBytes += file.size;
+    }
+
+    //3. Hash this slice. Results have fixed slots, so the tasks don't need to lock anything.
+    QVector<FileHasher::Result> hashResults(toHashIndexes.size());
+    QVector<bool> hashDone(toHashIndexes.size(), false);
+
+    QThreadPool hashPool;
+    hashPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), MaxParallelHashes));
+    for (int h = 0; h < toHashIndexes.size(); h++)
+        hashPool.start(new HashTask(m_files[toHashIndexes[h]].filePath, toHashVerified[h],
+                                    &hashResults[h], &hashDone[h], this));
+    hashPool.waitForDone();
+
+    for (int h = 0; h < toHashIndexes.size(); h++)
+    {
+        const ArchivedFile& file = m_files[toHashIndexes[h]];
+        if (!hashDone[h])
+        {
+            m_report.remainingFiles += 1;
+            continue;
+        }
+
+        const FileHasher::Result& result = hashResults[h];
+        m_report.hashedFiles += 1;
+        m_report.hashedBytes += result.size;
+
+        Problem problem;
+        problem.type = PT_Corrupted;
+        problem.FID = file.FID;
+        problem.filePath = file.filePath;
+        if (!result.success)
+        {
+            problem.details = "It could not be read.";
+            m_report.problems.append(problem);
+        }
+        //Some files, e.g imported ones that could not be read, were added without an MD5. They are
+        //  only checked for their existence and size.
+        else if (!IsUnknownMD5(file.md5) && result.md5 != file.md5)
+        {
+            problem.details = "Its contents are not the same as when it was attached.";
+            m_report.problems.append(problem);
+        }
+        else
+        {
+            Fingerprint fingerprint = toHashFingerprints[h];
+            fingerprint.fastHash = result.fastHash;
+            newFingerprints.insert(file.FID, fingerprint);
+        }
+    }
+
+    //4. Orphaned files. Not done if cancelled, as the walk lists may be incomplete.
+    if (!IsCancelled())
+    {
+        foreach (const QString& key, diskFiles.keys())
+        {
+            if (referencedPaths.contains(key))
+                continue;
+
+            Problem problem;
+            problem.type = PT_Orphaned;
+            problem.FID = -1;
+            problem.filePath = diskFiles[key].filePath;
+            problem.details = "No attached file refers to it.";
+            m_report.problems.append(problem);
+        }
+    }
+
+    //Files that are no longer verified, e.g corrupted, or removed from the database, are dropped
+    //  from the checkpoint.
+    WriteCheckpoint(newFingerprints);
+}
+
+void FileArchiveVerifier::SliceHashed(qint64 sliceSize)
+{
+    QMutexLocker locker(&m_progressMutex);
+    m_doneHashBytes += sliceSize;
+    //A file whose fast hash did not match is read twice.
+    int percent = (m_totalHashBytes > 0 ?
+                   qMin(100, int(m_doneHashBytes * 100 / m_totalHashBytes)) : 100);
+    if (percent != m_lastPercent)
+    {
+        m_lastPercent = percent;
+        emit Progress(percent);
+    }
+}
+
+QString FileArchiveVerifier::PathKey(const QString& filePath)
+{
+    return QDir::cleanPath(filePath).toLower();
+}
+
+bool FileArchiveVerifier::IsUnknownMD5(const QByteArray& md5)
+{
+    return (md5.isEmpty() || md5.count('\0') == md5.size());
+}
+
+bool FileArchiveVerifier::ReadCheckpoint(QHash<long long, Fingerprint>& fingerprints)
+{
+    fingerprints.clear(); //Do it for caller
+
+    QFile checkpointFile(m_checkpointFilePath);
+    if (!checkpointFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    //Each line: FID, size, modification time in msecs, hex MD5, hex fast hash and ArchiveURL,
+    //  separated by tabs. ArchiveURL is the last one, as it is the only one that could have spaces.
+    QTextStream stream(&checkpointFile);
+    stream.setCodec("UTF-8");
+    while (!stream.atEnd())
+    {
+        const QStringList parts = stream.readLine().split('\t');
+        if (parts.size() != 6)
+            continue;
+
+        bool validFastHash;
+        Fingerprint fingerprint;
+        fingerprint.size = parts[1].toLongLong();
+        fingerprint.modifiedMSecs = parts[2].toLongLong();
+        fingerprint.md5 = QByteArray::fromHex(parts[3].toLatin1());
+        fingerprint.fastHash = parts[4].toULongLong(&validFastHash, 16);
+        fingerprint.archiveURL = parts[5];
+        if (!validFastHash)
+            continue;
+        fingerprints.insert(parts[0].toLongLong(), fingerprint);
+    }
+
+    return true;
+}
+
+bool FileArchiveVerifier::WriteCheckpoint(const QHash<long long, Fingerprint>& fingerprints)
+{
+    //Written to a temporary file first, so an interrupted write does not lose the old checkpoint.
+    QSaveFile checkpointFile(m_checkpointFilePath);
+    if (!checkpointFile.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&checkpointFile);
+    stream.setCodec("UTF-8");
+    QHash<long long, Fingerprint>::const_iterator it;
+    for (it = fingerprints.constBegin(); it != fingerprints.constEnd(); ++it)
+    {
+        stream << it.key() << '\t' << it.value().size << '\t' << it.value().modifiedMSecs << '\t'
+               << QString::fromLatin1(it.value().md5.toHex()) << '\t'
+               << QString::number(it.value().fastHash, 16) << '\t' << it.value().archiveURL << '\n';
+    }
+    stream.flush();
+
+    return checkpointFile.commit();
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QRunnable>
+#include <QString>
+#include <QThread>
+
+#include "Util/FileHasher.h"
+
+/// Checks the files in the file archives against what the File table says about them.
+/// - The archive roots are walked in parallel. Files that are not where their ArchiveURL says, and
+///   files that no File row points to (orphaned), are found from the file system metadata only, so
+///   they are checked completely on every run. So are the sizes.
+/// - The rest are re-hashed in parallel and compared with File.MD5; but only if they were not
+///   verified before, or their size or modification time changed since then. Verified files are
+///   kept in a checkpoint file, with their fast hash (XXH64). If only the modification time of a
+///   verified file changed, e.g the archive was copied to another disk, the fast hash is checked
+///   first, which takes a fraction of the time of MD5.
+/// - At most `maxHashBytes` bytes are hashed per run, in the order of FIDs; the next run goes on
+///   with the files that are not in the checkpoint yet. So a multi-TB archive can be verified in
+///   several slices, and a cancelled run does not lose what it has done.
+/// - It only reports the problems; it changes nothing except the checkpoint file.
+class FileArchiveVerifier : public QThread, private FileHashListener
+{
+    Q_OBJECT
+
+public:
+    struct Archive
+    {
+        QString name;
+        QString rootPath;
+    };
+
+    struct ArchivedFile
+    {
+        long long FID;
+        QString archiveURL;
+        /// Empty if the archive of the URL does not exist.
+        QString filePath;
+        qint64 size;
+        QByteArray md5;
+    };
+
+    enum ProblemType
+    {
+        PT_Missing,
+        PT_Orphaned,
+        PT_Corrupted
+    };
+
+    struct Problem
+    {
+        ProblemType type;
+        long long FID; //-1 for orphaned files.
+        QString filePath;
+        QString details;
+    };
+
+    struct Report
+    {
+        int filesCount;
+        int hashedFiles;
+        qint64 hashedBytes;
+        /// Not hashed because they did not change since they were verified.
+        int unchangedFiles;
+        /// Left for the next runs. If 0, all the files are verified.
+        int remainingFiles;
+        QList<Problem> problems;
+    };
+
+    /// The maximum number of files hashed at the same time.
+    static const int MaxParallelHashes = 4;
+
+private:
+    class WalkTask;
+    class HashTask;
+
+    /// What the checkpoint file keeps about a verified file.
+    struct Fingerprint
+    {
+        QString archiveURL;
+        qint64 size;
+        qint64 modifiedMSecs;
+        QByteArray md5;
+        quint64 fastHash;
+    };
+
+    /// A file found while walking the archives.
+    struct DiskEntry
+    {
+        QString filePath;
+        qint64 size;
+        qint64 modifiedMSecs;
+    };
+
+    QList<Archive> m_archives;
+    QList<ArchivedFile> m_files;
+    QString m_checkpointFilePath;
+    bool m_startOver;
+    qint64 m_maxHashBytes;
+    Report m_report;
+    QAtomicInt m_cancelled;
+
+    //Of the thread's progress
+    QMutex m_progressMutex;
+    qint64 m_totalHashBytes;
+    qint64 m_doneHashBytes;
+    int m_lastPercent;
+
+public:
+    explicit FileArchiveVerifier(QObject* parent = 0);
+    /// Cancels the thread and waits for it.
+    ~FileArchiveVerifier();
+
+    /// Must NOT be called while the thread is running. `files` must be sorted by FID.
+    /// If `startOver`, the files verified before are verified again.
+    void SetParameters(const QList<Archive>& archives, const QList<ArchivedFile>& files,
+                       const QString& checkpointFilePath, bool startOver, qint64 maxHashBytes);
+    /// Valid after the thread finished, even if it was cancelled.
+    Report GetReport() const;
+    bool IsCancelled() const;
+
+    static QString ProblemTypeName(ProblemType type);
+
+public slots:
+    void Cancel();
+
+signals:
+    /// Percent of the bytes to hash in this run; emitted from the verifier's threads when it changes.
+    void Progress(int percent);
+
+protected:
+    void run();
+
+private:
+    //FileHashListener; called from all the hashing threads.
+    void SliceHashed(qint64 sliceSize);
+
+    /// File systems of the archives are case-insensitive on Windows.
+    static QString PathKey(const QString& filePath);
+    static bool IsUnknownMD5(const QByteArray& md5);
+
+    bool ReadCheckpoint(QHash<long long, Fingerprint>& fingerprints);
+    bool WriteCheckpoint(const QHash<long long, Fingerprint>& fingerprints);
+};
@@ -2,9 +2,11 @@
 
 #include "Config.h"
 #include "IArchiveManager.h"
-//#include "FileArchiveManager.h"
+#include "FileArchiveManager.h"
 #include "FileSandBoxManager.h"
 
+#include <QBuffer>
+#include <QDebug>
 #include <QDir>
 #include <QFileInfo>
 
@@ -28,6 +30,7 @@ bool FileManager::InitializeFileArchives(DatabaseManager* dbm)
 {
     //Note: Receiving dbm as an argument in an ISubManager is bad practice. Happens at fview too.
     bool success = true;
+    success &= InitializeFilesJournal();
     success &= PopulateAndRegisterFileArchives(dbm);
     success &= DoFileArchiveInitializations();
     return success;
@@ -144,8 +147,7 @@ bool FileManager::RetrieveBookmarkFiles(long long BID, QList<FileManager::Bookma
     QString retrieveError =
             "Could not get attached files information for the bookmark "
             "from the database.";
-    QSqlQuery query(db);
-    query.prepare(StandardIndexedBookmarkFileByBIDQuery());
+    QSqlQuery query = CachedQuery(StandardIndexedBookmarkFileByBIDQuery());
     query.addBindValue(BID);
 
     if (!query.exec()) //IMPORTANT For the model.
@@ -347,15 +349,31 @@ bool FileManager::CopyFileToSandBoxAndGetAddress(long long FID, QString& fsFileP
     return GetFullArchiveFilePath(fileArchiveURL, "copying file to sandbox", fsFilePath);
 }
 
+bool FileManager::IsInContentAddressedArchive(const QString& filePathName)
+{
+    const QString cleanFilePath = QDir::cleanPath(QFileInfo(filePathName).absoluteFilePath());
+    foreach (IArchiveManager* archive, fileArchives)
+    {
+        FileArchiveManager* fam = dynamic_cast<FileArchiveManager*>(archive);
+        if (fam == NULL || !fam->IsContentAddressed())
+            continue;
+
+        //Case-insensitive like the Windows file systems; at worst a file is sandboxed needlessly.
+        const QString archiveRoot = QDir::cleanPath(
+                QFileInfo(fam->GetFullArchivePathForRelativeURL(QString())).absoluteFilePath());
+        if (cleanFilePath.startsWith(archiveRoot + "/", Qt::CaseInsensitive))
+            return true;
+    }
+    return false;
+}
+
 bool FileManager::AddBookmarkFile(long long BID, long long FID, long long& addedBFID,
                                   const QString& errorWhileContext)
 {
     QString attachError =
             "Error while %1:\n"
             "Could not set attached files information for the bookmark in the database.";
-    QSqlQuery query(db);
-
-    query.prepare("INSERT INTO BookmarkFile(BID, FID) VALUES( ? , ? )");
+    QSqlQuery query = CachedQuery("INSERT INTO BookmarkFile(BID, FID) VALUES( ? , ? )");
     query.addBindValue(BID);
     query.addBindValue(FID);
     if (!query.exec())
@@ -395,10 +413,35 @@ bool FileManager::AddFile(FileManager::BookmarkFile& bf, const QString& fileArch
                           const QString& errorWhileContext)
 {
     //Add file to our FileArchive directory and also set the `bf.ArchiveURL` field.
-    bool addFileToArchiveSuccess =
-            fileArchives[fileArchiveName]->
-            AddFileToArchive(bf.OriginalName, bf.Ex_RemoveAfterAttach, folderHint, groupHint,
-                             errorWhileContext, bf.ArchiveURL);
+    //The content hash from when the file was chosen is only used if the file seems unchanged.
+    bool addFileToArchiveSuccess;
+    FileArchiveManager* fam = dynamic_cast<FileArchiveManager*>(fileArchives[fileArchiveName]);
+    QFileInfo originalFileInfo(bf.OriginalName);
+    if (bf.Ex_FileData.isNull() && fam != NULL && !bf.Ex_ContentHash.isEmpty() &&
+        originalFileInfo.size() == bf.Size && originalFileInfo.lastModified() == bf.ModifyDate)
+    {
+        addFileToArchiveSuccess =
+                fam->AddFileToArchive(bf.OriginalName, bf.Ex_RemoveAfterAttach, folderHint, groupHint,
+                                      bf.Ex_ContentHash, errorWhileContext, bf.ArchiveURL);
+    }
+    else if (bf.Ex_FileData.isNull())
+    {
+        addFileToArchiveSuccess =
+                fileArchives[fileArchiveName]->
+                AddFileToArchive(bf.OriginalName, bf.Ex_RemoveAfterAttach, folderHint, groupHint,
+                                 errorWhileContext, bf.ArchiveURL);
+    }
+    else
+    {
+        QBuffer dataBuffer(&bf.Ex_FileData);
+        dataBuffer.open(QIODevice::ReadOnly);
+        addFileToArchiveSuccess =
+                fileArchives[fileArchiveName]->
+                AddDataToArchive(&dataBuffer, bf.OriginalName, folderHint, groupHint,
+                                 errorWhileContext, bf.ArchiveURL, bf.MD5, bf.Size);
+        dataBuffer.close();
+        bf.Ex_FileData = QByteArray(); //Don't keep another reference to it.
+    }
 
     if (!addFileToArchiveSuccess)
         return false;
@@ -411,11 +454,8 @@ bool FileManager::AddFile(FileManager::BookmarkFile& bf, const QString& fileArch
     bf.OriginalName = QFileInfo(bf.OriginalName).fileName();
 
     QString addFileDBError = "Error while %1:\nUnable to add file information to the database.";
-    QSqlQuery query(db);
-
-    //Get the required file names from the DB.
-    query.prepare("INSERT INTO File (OriginalName, ArchiveURL, ModifyDate, Size, MD5) "
-                  "VALUES ( ? , ? , ? , ? , ? )");
+    QSqlQuery query = CachedQuery("INSERT INTO File (OriginalName, ArchiveURL, ModifyDate, Size, MD5) "
+                                  "VALUES ( ? , ? , ? , ? , ? )");
     query.addBindValue(bf.OriginalName);
     query.addBindValue(bf.ArchiveURL);
     query.addBindValue(bf.ModifyDate);
@@ -524,7 +564,34 @@ bool FileManager::MoveOrCopyAux(long long FID, const QString& destArchiveName, b
     if (!GetFullArchiveFilePath(fileArchiveURL, errorWhileContext, fullArchiveFilePath))
         return false;
 
-    //Add the file to destArchiveName (e.g ':trash:').
+    //In content-addressed archives the file may be shared with other File rows; then it is copied
+    //  and the stored file stays for them.
+    FileArchiveManager* originalFam =
+            dynamic_cast<FileArchiveManager*>(fileArchives[GetArchiveNameOfFile(fileArchiveURL)]);
+    if (removeOriginal && originalFam != NULL && originalFam->IsContentAddressed())
+    {
+        int otherFilesCount;
+        if (!CountOtherFilesWithArchiveURL(fileArchiveURL, FID, errorWhileContext, otherFilesCount))
+            return false;
+        if (otherFilesCount > 0)
+            removeOriginal = false;
+    }
+
+    //Between FAMs (e.g to ':trash:'), the file is renamed when possible. Copying and deleting would
+    //  copy it twice, once more for the backup that deleting keeps for rolling back.
+    IArchiveManager* destArchive = fileArchives[destArchiveName];
+    IArchiveManager* originalArchive = fileArchives[GetArchiveNameOfFile(fileArchiveURL)];
+    if (removeOriginal &&
+        destArchive->GetArchiveType() == IArchiveManager::AT_FileArchive &&
+        originalArchive->GetArchiveType() == IArchiveManager::AT_FileArchive)
+    {
+        //dynamic_cast as an assertion.
+        FileArchiveManager* destFam = dynamic_cast<FileArchiveManager*>(destArchive);
+        return destFam->MoveFileToArchive(fullArchiveFilePath, folderHint, groupHint,
+                                          errorWhileContext, newFileArchiveURL);
+    }
+
+    //Add the file to destArchiveName.
     //Note: We could just set the second parameter of `AddFileToArchive` to true to remove the
     //  original file from the old archive. This is fine with the current implementation as
     //  ArchiveMans don't store extra information about the files. However we do it in two-steps of
@@ -548,6 +615,21 @@ bool FileManager::MoveOrCopyAux(long long FID, const QString& destArchiveName, b
     return true;
 }
 
+bool FileManager::CountOtherFilesWithArchiveURL(const QString& fileArchiveURL, long long FID,
+                                                const QString& errorWhileContext, int& count)
+{
+    QString countError = "Error while %1:\nUnable to find out if the file is shared.";
+    QSqlQuery query(db);
+    query.prepare("SELECT COUNT(*) FROM File WHERE ArchiveURL = ? AND FID <> ?");
+    query.addBindValue(fileArchiveURL);
+    query.addBindValue(FID);
+    if (!query.exec() || !query.first())
+        return Error(countError.arg(errorWhileContext), query.lastError());
+
+    count = query.value(0).toInt();
+    return true;
+}
+
 QString FileManager::StandardIndexedBookmarkFileByBIDQuery() const
 {
     //Returns a query such that the `bfidx` values remain consistent accross different functions
@@ -597,6 +679,57 @@ bool FileManager::GetUserFileArchivesAndPaths(QMap<QString, QString>& faPaths)
     return true;
 }
 
+bool FileManager::GetFilesForVerification(QList<FileArchiveVerifier::Archive>& archives,
+                                          QList<FileArchiveVerifier::ArchivedFile>& files)
+{
+    QString retrieveError = "Could not get file archives information from the database.";
+
+    QSqlQuery query(db);
+    query.prepare("SELECT Name, Path FROM FileArchive WHERE Type <> ?");
+    query.addBindValue((int)IArchiveManager::AT_SandBox);
+    if (!query.exec())
+        return Error(retrieveError, query.lastError());
+
+    archives.clear(); //Do it for caller
+    while (query.next())
+    {
+        FileArchiveVerifier::Archive archive;
+        archive.name = query.value("Name").toString();
+        archive.rootPath = GetAbsoluteFileArchivePath(query.value("Path").toString());
+        archives.append(archive);
+    }
+
+    retrieveError = "Could not get attached files information from the database.";
+    query.prepare("SELECT FID, ArchiveURL, Size, MD5 FROM File ORDER BY FID");
+    if (!query.exec())
+        return Error(retrieveError, query.lastError());
+
+    files.clear(); //Do it for caller
+    while (query.next())
+    {
+        FileArchiveVerifier::ArchivedFile file;
+        file.FID = query.value("FID").toLongLong();
+        file.archiveURL = query.value("ArchiveURL").toString();
+        file.size = query.value("Size").toLongLong();
+        file.md5 = query.value("MD5").toByteArray();
+
+        //Not with GetFullArchiveFilePath, so that a wrong URL is reported instead of showing an
+        //  error for each file.
+        QString archiveName = GetArchiveNameOfFile(file.archiveURL);
+        if (!archiveName.isEmpty() && fileArchives.contains(archiveName))
+            file.filePath = fileArchives[archiveName]->GetFullArchivePathForRelativeURL(
+                                file.archiveURL.mid(archiveName.length() + 1));
+        files.append(file);
+    }
+
+    return true;
+}
+
+QString FileManager::GetVerificationCheckpointFilePath()
+{
+    return GetAbsoluteFileArchivePath("%appdir%/" + conf->fileArchiveCheckpointFileName);
+}
+
 bool FileManager::PopulateAndRegisterFileArchives(DatabaseManager* dbm)
 {
     QString retrieveError = "Could not get file archives information from the database.";
@@ -648,6 +781,30 @@ bool FileManager::DoFileArchiveInitializations()
     return success;
 }
 
+bool FileManager::InitializeFilesJournal()
+{
+    //On the same volume as the default archives, so that deleted files are moved, not copied there.
+    filesTransaction.setJournalDirPath(
+                GetAbsoluteFileArchivePath("%appdir%/" + conf->nominalFileJournalDirName));
+
+    //The database has already rolled back its part of an interrupted transaction when opening.
+    int recoveredCount;
+    if (!filesTransaction.RecoverInterruptedTransactions(recoveredCount))
+        return Error("Could not roll back all the changes made to your file system by an operation "
+                     "that was interrupted the last time. Your files may be in a non-consistent state.");
+
+    if (recoveredCount > 0)
+        qDebug() << "Rolled back" << recoveredCount << "interrupted files transaction(s).";
+    return true;
+}
+
+QStringList FileManager::CreateIndexQueries()
+{
+    return QStringList()
+        << "CREATE INDEX IF NOT EXISTS IX_BookmarkFile_BID ON BookmarkFile(BID, FID)"
+        << "CREATE INDEX IF NOT EXISTS IX_BookmarkFile_FID ON BookmarkFile(FID)";
+}
+
 void FileManager::CreateTables()
 {
     QSqlQuery query(db);
@@ -656,6 +813,9 @@ void FileManager::CreateTables()
                "( FID INTEGER PRIMARY KEY AUTOINCREMENT, OriginalName TEXT, ArchiveURL TEXT, "
                "  ModifyDate INTEGER, Size Integer, MD5 BLOB )");
 
+    //Files of content-addressed archives share their ArchiveURL; it is used for counting them.
+    query.exec("CREATE INDEX IX_File_ArchiveURL ON File(ArchiveURL)");
+
     //Having a separate `FileLayout` field allows for separation of archive's type from how it
     //  stores its files, allowing it to be configurable and update-able in case of new versions.
     query.exec("CREATE TABLE FileArchive"
@@ -668,6 +828,9 @@ void FileManager::CreateTables()
                "( BFID INTEGER PRIMARY KEY AUTOINCREMENT, BID INTEGER, FID INTEGER, "
                "  FOREIGN KEY(BID) REFERENCES Bookmark(BID) ON DELETE RESTRICT,"
                "  FOREIGN KEY(FID) REFERENCES File(FID) ON DELETE RESTRICT )");
+
+    foreach (const QString& createIndexQuery, CreateIndexQueries())
+        query.exec(createIndexQuery);
 }
 
 void FileManager::PopulateModelsAndInternalTables()
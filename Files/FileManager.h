@@ -1,5 +1,6 @@
 #pragma once
 #include "Database/ISubManager.h"
+#include "Files/FileArchiveVerifier.h"
 #include "Util/TransactionalFileOperator.h"
 
 #include <QHash>
@@ -72,6 +73,14 @@ public:
         SharedFileLocationPolicy Ex_SharedFileLocationPolicy;
         bool Ex_IsDefaultFileForEditedBookmark;
         bool Ex_RemoveAfterAttach;
+        /// If not null, a new file is added with these contents instead of being read from the
+        ///     file system; then `OriginalName` is just the file name, and `Size` and `MD5` are
+        ///     set while it is written to the archive. See IArchiveManager::AddDataToArchive.
+        QByteArray Ex_FileData;
+        /// If not empty, the SHA-256 of the file at `OriginalName`, found when it was chosen for
+        ///     attaching; content-addressed archives use it instead of reading the file again. It
+        ///     is not used if the file's size or modification time changed since then.
+        QByteArray Ex_ContentHash;
     };
 
 private:
@@ -155,6 +164,9 @@ public:
     /// The following overload implements sandboxing files in theory using the `CopyFile` function,
     /// but isn't used throughout the code. Details are exactly like its other overload.
     bool CopyFileToSandBoxAndGetAddress(long long FID, QString& fsFilePath);
+    /// Files of content-addressed archives are shared by the File rows with the same contents, so
+    ///   they must only be opened sandboxed. Gets an ABSOLUTE path name like the above.
+    bool IsInContentAddressedArchive(const QString& filePathName);
 
 private:
     //Adding bookmarks
@@ -167,6 +179,8 @@ private:
     bool UpdateFile(long long FID, const BookmarkFile& bf, const QString& errorWhileContext);
     /// Adds the file into the FileArchive folder and Updates the "FID" and "ArchiveURL" fields.
     /// Make sure 'fileArchiveName` exists before calling this function.
+    /// In content-addressed archives (FAM layout 3), if the same contents are already stored they
+    ///     are not copied again; the new File row just gets the same ArchiveURL.
     bool AddFile(BookmarkFile& bf, const QString& fileArchiveName,
                  const QString& folderHint, const QString& groupHint,
                  const QString& errorWhileContext);
@@ -203,6 +217,9 @@ private:
     bool MoveOrCopyAux(long long FID, const QString& destArchiveName, bool removeOriginal,
                        const QString& folderHint, const QString& groupHint,
                        const QString& errorWhileContext, QString& newFileArchiveURL);
+    /// The reference count of a stored file of a content-addressed archive, not counting `FID`.
+    bool CountOtherFilesWithArchiveURL(const QString& fileArchiveURL, long long FID,
+                                       const QString& errorWhileContext, int& count);
 
 private:
     //Standard queries
@@ -217,11 +234,21 @@ private:
 public:
     //Helper functions
     bool GetUserFileArchivesAndPaths(QMap<QString, QString>& faPaths);
+    /// For checking the file archives with FileArchiveVerifier; the files are sorted by FID. The
+    ///   sandbox is not included, as its files are not in the File table.
+    bool GetFilesForVerification(QList<FileArchiveVerifier::Archive>& archives,
+                                 QList<FileArchiveVerifier::ArchivedFile>& files);
+    QString GetVerificationCheckpointFilePath();
 
 private:
     //Initialization
     bool PopulateAndRegisterFileArchives(DatabaseManager* dbm);
     bool DoFileArchiveInitializations();
+    /// Enables the journal of files transactions and recovers the interrupted ones.
+    bool InitializeFilesJournal();
+
+public:
+    static QStringList CreateIndexQueries();
 
 protected:
     // ISubManager interface
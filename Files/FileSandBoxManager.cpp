@@ -3,6 +3,7 @@
 #include "Util/Util.h"
 #include "Util/WinFunctions.h"
 
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
@@ -79,6 +80,7 @@ bool FileSandBoxManager::AddFileToArchive(const QString& filePathName, bool syst
     bool copySuccess = QFile::copy(filePathName, sandBoxFilePathName);
     if (!copySuccess)
     {
+        Util::RemoveDirectoryRecursively(m_archiveRoot + "/" + randomHash);
         return Error(QString("Error while %1:\n"
                              "Could not create a temporary, sandboxed file for read-only opening!\n"
                              "Can not continue\nSource File: %2\nDestination File: %3")
@@ -101,6 +103,43 @@ bool FileSandBoxManager::AddFileToArchive(const QString& filePathName, bool syst
     return true;
 }
 
+bool FileSandBoxManager::AddDataToArchive(QIODevice* data, const QString& fileName,
+                                          const QString& folderHint, const QString& groupHint,
+                                          const QString& errorWhileContext, QString& fileArchiveURL,
+                                          QByteArray& md5, qint64& size)
+{
+    Q_UNUSED(folderHint);
+    Q_UNUSED(groupHint);
+
+    //Same as AddFileToArchive; the random directory is new, so the file doesn't exist.
+    const QString randomHash = Util::NonExistentRandomFileNameInDirectory(m_archiveRoot, 8);
+    const QString sandBoxFileRelPathName = randomHash + "/" + QFileInfo(fileName).fileName();
+    const QString sandBoxFilePathName = GetFullArchivePathForRelativeURL(sandBoxFileRelPathName);
+    fileArchiveURL = m_archiveName + "/" + sandBoxFileRelPathName; //Out param
+
+    if (!QDir(m_archiveRoot).mkdir(randomHash))
+        return Error(QString("Error while %1:\nTemporary sandbox sub-directory could not be created!\n"
+                             "Path: %2").arg(errorWhileContext, m_archiveRoot + "/" + randomHash));
+
+    QFile sandBoxFile(sandBoxFilePathName);
+    QCryptographicHash hasher(QCryptographicHash::Md5);
+    bool writeSuccess = sandBoxFile.open(QIODevice::WriteOnly)
+                        && Util::WriteDeviceToDevice(data, &sandBoxFile, &hasher, size);
+    sandBoxFile.close();
+    if (!writeSuccess || sandBoxFile.error() != QFileDevice::NoError)
+    {
+        //Don't leave the partial file and its random directory behind.
+        Util::RemoveDirectoryRecursively(m_archiveRoot + "/" + randomHash);
+        return Error(QString("Error while %1:\n"
+                             "Could not create a temporary, sandboxed file for read-only opening!\n"
+                             "Can not continue\nDestination File: %2")
+                     .arg(errorWhileContext, sandBoxFilePathName));
+    }
+
+    md5 = hasher.result();
+    return true;
+}
+
 bool FileSandBoxManager::RemoveFileFromArchive(const QString& fileRelArchiveURL, bool trash,
                                                const QString& errorWhileContext)
 {
@@ -22,6 +22,10 @@ public:
     bool AddFileToArchive(const QString& filePathName, bool systemTrashOriginalFile,
                           const QString& folderHint, const QString& groupHint,
                           const QString& errorWhileContext, QString& fileArchiveURL);
+    bool AddDataToArchive(QIODevice* data, const QString& fileName,
+                          const QString& folderHint, const QString& groupHint,
+                          const QString& errorWhileContext, QString& fileArchiveURL,
+                          QByteArray& md5, qint64& size);
     bool RemoveFileFromArchive(const QString& fileRelArchiveURL, bool trash,
                                const QString& errorWhileContext);
 
@@ -4,6 +4,7 @@
 #include <QString>
 
 class DatabaseManager;
+class QIODevice;
 class TransactionalFileOperator;
 
 /// This interface is also known as IAM.
@@ -50,6 +51,15 @@ public:
     virtual bool AddFileToArchive(const QString& filePathName, bool systemTrashOriginalFile,
                                   const QString& folderHint, const QString& groupHint,
                                   const QString& errorWhileContext, QString& fileArchiveURL) = 0;
+    /// Like AddFileToArchive, but the contents are read from `data` (e.g a QBuffer over a
+    ///   downloaded page) and written directly to their place in the archive, instead of being
+    ///   saved to a temporary file and then copied. `fileName` is used like the file name of
+    ///   `filePathName` is in AddFileToArchive. The MD5 hash and size are calculated while
+    ///   writing, so the data is not read again.
+    virtual bool AddDataToArchive(QIODevice* data, const QString& fileName,
+                                  const QString& folderHint, const QString& groupHint,
+                                  const QString& errorWhileContext, QString& fileArchiveURL,
+                                  QByteArray& md5, qint64& size) = 0;
     virtual bool RemoveFileFromArchive(const QString& fileRelArchiveURL, bool trash,
                                        const QString& errorWhileContext) = 0;
 
@@ -8,19 +8,28 @@
 #include "BookmarksBusinessLogic.h"
 
 #include "BookmarkImporter/BookmarkImporter.h"
+#include "BookmarkImporter/ChromiumBookmarksFileParser.h"
 #include "BookmarkImporter/ImportedBookmarksPreviewDialog.h"
 #include "BookmarkImporter/FirefoxBookmarkJSONFileParser.h"
+#include "BookmarkImporter/FirefoxPlacesFileParser.h"
 #include "BookmarkImporter/MHTSaver.h"
 
+#include "Files/FileArchiveVerifier.h"
 #include "Settings/SettingsDialog.h"
+#include "Util/Util.h"
 #include "Util/WindowSizeMemory.h"
 
+#include <QApplication>
 #include <QDebug>
 #include <QDir>
+#include <QEventLoop>
+#include <QFile>
 #include <QFileDialog>
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QPlainTextEdit>
+#include <QProgressDialog>
+#include <QPushButton>
 #include <QResizeEvent>
 #include <QScrollBar>
 #include <QStandardPaths>
@@ -29,6 +38,7 @@
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent), ui(new Ui::MainWindow), conf(), dbm(this, &conf), m_shouldExit(false)
+  , pendingSearchGeneration(0), searchResultValid(false)
 {
     ui->setupUi(this);
 
@@ -44,6 +54,12 @@ MainWindow::MainWindow(QWidget *parent) :
     //  needed before initializing them:
     dbm.PopulateModelsAndInternalTables();
 
+    //Must be started before the first `GetBookmarkFilter`.
+    searchThread.SetDatabaseFilePath(databaseFilePath);
+    connect(&searchThread, SIGNAL(SearchFinished(quint64,QList<long long>,bool,QString)),
+            this, SLOT(searchThreadSearchFinished(quint64,QList<long long>,bool,QString)));
+    searchThread.start();
+
     //After dbm initializing, set up main UI and sizes
     InitializeUIControlsAndPositions();
 
@@ -71,6 +87,7 @@ MainWindow::MainWindow(QWidget *parent) :
     //Search area
     connect(ui->leSearch, SIGNAL(textChanged(QString)), this, SLOT(leSearchTextChanged(QString)));
     connect(ui->chkSearchRegExp, SIGNAL(toggled(bool)), this, SLOT(chkSearchRegExpToggled(bool)));
+    connect(ui->chkSearchFullText, SIGNAL(toggled(bool)), this, SLOT(chkSearchFullTextToggled(bool)));
 
     // Additional sub-parts initialization.
     if (!dbm.files.InitializeFileArchives(&dbm))
@@ -187,9 +204,48 @@ void MainWindow::chkSearchRegExpToggled(bool checked)
                              (UIDDRefreshAction)(RA_SaveSelAndScroll | RA_NoRefreshView));
 }
 
+void MainWindow::chkSearchFullTextToggled(bool checked)
+{
+    //Full text search has its own word-based syntax; RegExp doesn't apply to it.
+    ui->chkSearchRegExp->setEnabled(!checked);
+    if (!ui->leSearch->text().isEmpty()) //Only refresh if there is something to search
+        RefreshUIDataDisplay(false, RA_SaveSelAndFocus, QList<long long>(),
+                             (UIDDRefreshAction)(RA_SaveSelAndScroll | RA_NoRefreshView));
+}
+
+void MainWindow::searchThreadSearchFinished(quint64 generation, const QList<long long>& BIDs,
+                                            bool success, const QString& errorText)
+{
+    if (generation != pendingSearchGeneration)
+        return; //User has continued typing, or bookmarks have changed since the request.
+
+    searchResultKey = pendingSearchKey;
+    searchResultBIDs = BIDs;
+    searchResultValid = true;
+    pendingSearchKey.clear();
+
+    if (!success)
+    {
+        qDebug() << "Search Error\n" << errorText;
+        QMessageBox::critical(this, "Error", "Could not search bookmarks.\n\nSQLite Error:\n" + errorText);
+    }
+
+    //Same as `leSearchTextChanged`; now GetBookmarkFilter will use the results.
+    RefreshUIDataDisplay(false, RA_SaveSel, QList<long long>(),
+                         (UIDDRefreshAction)(RA_SaveSelAndScroll | RA_NoRefreshView));
+}
+
 void MainWindow::on_action_importFirefoxBookmarks_triggered()
 {
-    //TODO [IMPORT]
+    const QString profilesDir = QString::fromLocal8Bit(qgetenv("APPDATA")) + "/Mozilla/Firefox/Profiles";
+    QString placesFilePath = QFileDialog::getOpenFileName(
+                this, "Import Firefox Bookmarks From Profile", profilesDir,
+                "Firefox Bookmarks Database (places.sqlite)");
+
+    if (placesFilePath.isEmpty())
+        return;
+
+    ImportFirefoxPlacesFile(placesFilePath);
 }
 
 void MainWindow::on_actionImportFirefoxBookmarksJSONfile_triggered()
@@ -204,6 +260,19 @@ void MainWindow::on_actionImportFirefoxBookmarksJSONfile_triggered()
     ImportFirefoxJSONFile(jsonFilePath);
 }
 
+void MainWindow::on_actionImportChromiumBookmarks_triggered()
+{
+    const QString userDataDir = QString::fromLocal8Bit(qgetenv("LOCALAPPDATA")) + "/Google/Chrome/User Data";
+    QString bookmarksFilePath = QFileDialog::getOpenFileName(
+                this, "Import Chrome/Chromium Bookmarks From Profile", userDataDir,
+                "Chromium Bookmarks File (Bookmarks)");
+
+    if (bookmarksFilePath.isEmpty())
+        return;
+
+    ImportChromiumBookmarksFile(bookmarksFilePath);
+}
+
 void MainWindow::on_actionImportUrlsAsBookmarks_triggered()
 {
     long long importFOID = ui->tf->GetCurrentFOID();
@@ -251,6 +320,85 @@ void MainWindow::on_actionImportMHTFiles_triggered()
     ImportMHTFiles(mhtFilePaths, importFOID);
 }
 
+void MainWindow::on_actionCheckFileArchives_triggered()
+{
+    QList<FileArchiveVerifier::Archive> archives;
+    QList<FileArchiveVerifier::ArchivedFile> files;
+    if (!dbm.files.GetFilesForVerification(archives, files))
+        return;
+
+    //Files verified in the previous runs are skipped unless they changed; so a check that was too
+    //  big for one run goes on from where it stopped.
+    const QString checkpointFilePath = dbm.files.GetVerificationCheckpointFilePath();
+    bool startOver = false;
+    if (QFile::exists(checkpointFilePath))
+    {
+        QMessageBox askBox(QMessageBox::Question, "Check File Archives",
+                           "Files that were verified in the previous checks are only read again if "
+                           "they have changed since then. Do you want to continue with them, or "
+                           "read all the files again?", QMessageBox::Cancel, this);
+        QPushButton* continueButton = askBox.addButton("Continue", QMessageBox::AcceptRole);
+        QPushButton* startOverButton = askBox.addButton("Read All Again", QMessageBox::AcceptRole);
+        askBox.setDefaultButton(continueButton);
+        askBox.exec();
+
+        if (askBox.clickedButton() == startOverButton)
+            startOver = true;
+        else if (askBox.clickedButton() != continueButton)
+            return;
+    }
+
+    FileArchiveVerifier verifier;
+    verifier.SetParameters(archives, files, checkpointFilePath, startOver,
+                           conf.fileArchiveCheckMaxMBPerRun * 1024LL * 1024LL);
+
+    QProgressDialog progressDialog("Checking the file archives, please wait...", "Cancel",
+                                   0, 100, this);
+    progressDialog.setWindowTitle("Check File Archives");
+    progressDialog.setWindowModality(Qt::WindowModal);
+    connect(&verifier, SIGNAL(Progress(int)), &progressDialog, SLOT(setValue(int)));
+    connect(&progressDialog, SIGNAL(canceled()), &verifier, SLOT(Cancel()));
+
+    //The event loop below would otherwise leave this window usable until the progress dialog
+    //  shows up after its default minimum duration; e.g starting another check that writes the
+    //  same checkpoint file, or closing the window.
+    progressDialog.setMinimumDuration(0);
+    progressDialog.show();
+    ui->actionCheckFileArchives->setEnabled(false);
+
+    QEventLoop waitLoop;
+    connect(&verifier, SIGNAL(finished()), &waitLoop, SLOT(quit()));
+    verifier.start();
+    waitLoop.exec();
+    progressDialog.reset();
+    ui->actionCheckFileArchives->setEnabled(true);
+
+    const FileArchiveVerifier::Report report = verifier.GetReport();
+    QString summary = QString("Attached files: %1\n"
+                              "Read in this check: %2 (%3)\n"
+                              "Unchanged since they were verified: %4\n"
+                              "Left for the next checks: %5\n"
+                              "Problems found: %6")
+                      .arg(report.filesCount).arg(report.hashedFiles)
+                      .arg(Util::UserReadableFileSize(report.hashedBytes))
+                      .arg(report.unchangedFiles).arg(report.remainingFiles)
+                      .arg(report.problems.size());
+    if (verifier.IsCancelled())
+        summary = "The check was cancelled.\n\n" + summary;
+
+    QStringList problemLines;
+    foreach (const FileArchiveVerifier::Problem& problem, report.problems)
+        problemLines.append(QString("%1: %2\n    %3")
+                            .arg(FileArchiveVerifier::ProblemTypeName(problem.type),
+                                 problem.filePath, problem.details));
+
+    QMessageBox resultBox(report.problems.isEmpty() ? QMessageBox::Information : QMessageBox::Warning,
+                          "Check File Archives", summary, QMessageBox::Ok, this);
+    if (!problemLines.isEmpty())
+        resultBox.setDetailedText(problemLines.join("\n"));
+    resultBox.exec();
+}
+
 void MainWindow::on_actionSettings_triggered()
 {
     SettingsDialog setsDlg(&dbm, this);
@@ -270,18 +418,28 @@ void MainWindow::InitializeUIControlsAndPositions()
     ui->splitterFT->setSizes(vsizes);
 
     // Add additional UI controls
-    ui->action_importFirefoxBookmarks->setEnabled(false); //Not implemented yet.
+    ui->chkSearchFullText->setEnabled(dbm.bms.IsFullTextSearchAvailable()); //SQLite may lack FTS5.
     QMenu* menuFile = new QMenu("    &File    ");
     menuFile->addAction(ui->actionImportUrlsAsBookmarks);
     menuFile->addAction(ui->actionImportMHTFiles);
     menuFile->addSeparator();
     menuFile->addAction(ui->action_importFirefoxBookmarks);
     menuFile->addAction(ui->actionImportFirefoxBookmarksJSONfile);
+    menuFile->addAction(ui->actionImportChromiumBookmarks);
+    menuFile->addSeparator();
+    menuFile->addAction(ui->actionCheckFileArchives);
     menuFile->addSeparator();
     menuFile->addAction(ui->actionSettings);
 
     QMenu* menuDebug = new QMenu("    &Debug    ");
     menuDebug->addAction(ui->actionGetMHT);
+    menuDebug->addAction(ui->actionBenchmarkDbCommits);
+    menuDebug->addAction(ui->actionBenchmarkImportAnalysis);
+    menuDebug->addAction(ui->actionBenchmarkPageFetching);
+    menuDebug->addAction(ui->actionBenchmarkMimeEncoders);
+    menuDebug->addAction(ui->actionBenchmarkFileMoves);
+    menuDebug->addAction(ui->actionBenchmarkFileHashing);
+    menuDebug->addAction(ui->actionBenchmarkBookmarksSorting);
 
     QList<QMenu*> menus = QList<QMenu*>() << menuFile << menuDebug;
     foreach (QMenu* menu, menus)
@@ -320,6 +478,14 @@ void MainWindow::RefreshUIDataDisplay(bool rePopulateModels,
     //This is useful for tags, where we want to ensure the selected tag is visible even if new tags
     //  are added, while keeping the previous original scroll position if possible.
 
+    //Search results from the search thread are out of date now; they are still shown until the
+    //  new ones arrive.
+    if (rePopulateModels)
+    {
+        searchResultValid = false;
+        pendingSearchKey.clear();
+    }
+
     //IMPORTANT: First Manage tags, because `MainWindow::GetBookmarkFilter` function called next
     //  RELIES on tags' check state; we make sure whatever tags we wanted are checked first.
     ui->tv->RefreshUIDataDisplay(rePopulateModels, tagsAction, selectTID, newTIDsToCheck);
@@ -356,42 +522,36 @@ void MainWindow::GetBookmarkFilter(BookmarkFilter& bfilter)
     {
         QList<long long> foundBIDs;
         QString searchTerm = ui->leSearch->text();
+        bool useFullText = ui->chkSearchFullText->isChecked();
         bool useRegExp = ui->chkSearchRegExp->isChecked();
-        QRegularExpression re;
-        if (useRegExp)
+
+        if (!useFullText && !useRegExp)
         {
-            re = QRegularExpression(searchTerm, QRegularExpression::CaseInsensitiveOption | QRegularExpression::UseUnicodePropertiesOption);
-            re.optimize();
+            //Plain-text search is served by the bookmarks' in-memory search index.
+            foundBIDs = dbm.bms.SearchBookmarksText(searchTerm);
         }
-
-        const auto& model = dbm.bms.model;
-        int bidIdx = dbm.bms.bidx.BID,
-            nameIdx = dbm.bms.bidx.Name,
-            urlsIdx = dbm.bms.bidx.URLs,
-            descIdx = dbm.bms.bidx.Desc;
-
-        //`model.match(...)` couldn't be used here because it can't search multiple columns,
-        //although it had other options such as RegExp and string-in-the-middle matching.
-        for (int i = 0; i < model.rowCount(); i++)
+        else
         {
-            const QSqlRecord& record = model.record(i);
-            if (useRegExp)
-            {
-                if (re.match(record.value(nameIdx).toString(), 0).hasMatch() ||
-                    re.match(record.value(urlsIdx).toString(), 0).hasMatch() ||
-                    re.match(record.value(descIdx).toString(), 0).hasMatch())
-                    foundBIDs.append(record.value(bidIdx).toLongLong());
-            }
-            else
+            //These have to go through all bookmarks in the database, so they run in the search
+            //  thread. Until its results arrive, the previous results stay shown (e.g those of the
+            //  term before the last keystroke), instead of all the bookmarks flashing in between.
+            //  Before the first results there is nothing to show.
+            BookmarkSearchThread::SearchMode mode = (useFullText ? BookmarkSearchThread::SM_FullText
+                                                                 : BookmarkSearchThread::SM_RegExp);
+            QString searchKey = QString::number(mode) + ":" + searchTerm;
+            if (!searchResultValid || searchKey != searchResultKey)
             {
-                if (record.value(nameIdx).toString().contains(searchTerm, Qt::CaseInsensitive) ||
-                    record.value(urlsIdx).toString().contains(searchTerm, Qt::CaseInsensitive) ||
-                    record.value(descIdx).toString().contains(searchTerm, Qt::CaseInsensitive))
-                    foundBIDs.append(record.value(bidIdx).toLongLong());
+                if (searchKey != pendingSearchKey)
+                {
+                    pendingSearchGeneration = searchThread.RequestSearch(mode, searchTerm);
+                    pendingSearchKey = searchKey;
+                }
             }
+            foundBIDs = searchResultBIDs;
         }
 
-        bfilter.FilterSpecificBookmarkIDs(foundBIDs);
+        //Full text results are ranked; show the best matches first unless user sorts the view.
+        bfilter.FilterSpecificBookmarkIDs(foundBIDs, useFullText);
     }
 }
 
@@ -416,9 +576,12 @@ void MainWindow::RefreshStatusLabels()
         tagFilterString = " tagged <span style=\"color:green;\">" + ui->tv->GetCheckedTagsNames().toHtmlEscaped() + "</span>";
 
     if (!ui->leSearch->text().isEmpty())
-        searchCriteria = QString(" matching %1 <span style=\"color:fuchsia;\">%2</span>")
-                .arg(ui->chkSearchRegExp->isChecked() ? "regular expression" : "text")
-                .arg(ui->leSearch->text().toHtmlEscaped());
+        searchCriteria = QString(" matching %1 <span style=\"color:fuchsia;\">%2</span>%3")
+                .arg(ui->chkSearchFullText->isChecked() ? "full text" :
+                     ui->chkSearchRegExp->isChecked() ? "regular expression" : "text",
+                     ui->leSearch->text().toHtmlEscaped(),
+                     (ui->chkSearchFullText->isChecked() || ui->chkSearchRegExp->isChecked())
+                     && !pendingSearchKey.isEmpty() ? " (searching...)" : "");
 
     ui->lblFilter->setText(QString("Showing %1bookmarks%2%3%4")
         .arg(twoFolderNameLocations[0], twoFolderNameLocations[1], tagFilterString, searchCriteria));
@@ -632,6 +795,34 @@ void MainWindow::ImportFirefoxJSONFile(const QString& jsonFilePath)
     ImportBookmarks(elist);
 }
 
+void MainWindow::ImportFirefoxPlacesFile(const QString& placesFilePath)
+{
+    ImportedEntityList elist;
+    elist.importFOID = 0; //Always import into the '0, Unsorted bookmarks' folder
+    elist.importSource = ImportedEntityList::Source_Firefox;
+    elist.importSourceProfile = QFileInfo(placesFilePath).absoluteDir().dirName();
+
+    FirefoxPlacesFileParser placesParser(this, &conf);
+    if (!placesParser.ParseFile(placesFilePath, elist))
+        return;
+
+    ImportBookmarks(elist);
+}
+
+void MainWindow::ImportChromiumBookmarksFile(const QString& bookmarksFilePath)
+{
+    ImportedEntityList elist;
+    elist.importFOID = 0; //Always import into the '0, Unsorted bookmarks' folder
+    elist.importSource = ImportedEntityList::Source_Chromium;
+    elist.importSourceProfile = QFileInfo(bookmarksFilePath).absoluteDir().dirName();
+
+    ChromiumBookmarksFileParser chromiumParser(this, &conf);
+    if (!chromiumParser.ParseFile(bookmarksFilePath, elist))
+        return;
+
+    ImportBookmarks(elist);
+}
+
 void MainWindow::ImportBookmarks(ImportedEntityList& elist)
 {
     bool success;
@@ -646,11 +837,12 @@ void MainWindow::ImportBookmarks(ImportedEntityList& elist)
         return;
 
     //Note about TRANSACTIONS:
-    //Import function imports each bookmark in its own transaction. This way is both just what we
-    //  did (i.e importing all of them under the same transaction was not more difficult and could
-    //  be done), and also the good point about it is that if it interrupts, we'll have some of our
-    //  bookmarks. So we don't need to start and wrap this in a transaction.
-    success = bmim.InitializeImport();
+    //Import function imports each batch of bookmarks in its own transaction. This way is both fast,
+    //  as each transaction costs a sync to disk, and also the good point about it is that if it
+    //  interrupts, we'll have some of our bookmarks. So we don't need to start and wrap this in a
+    //  transaction.
+    int importBatchSize = dbm.sets.GetSetting("ImportBatchSize", conf.defaultImportBatchSize);
+    success = bmim.InitializeImport(importBatchSize);
     if (!success)
         return;
 
@@ -745,3 +937,57 @@ void MainWindow::on_actionGetMHT_triggered()
     MHTDataReceiver* datarecv = new MHTDataReceiver(this);
     connect(saver, SIGNAL(MHTDataReady(QByteArray,MHTSaver::Status)), datarecv, SLOT(MHTDataReady(QByteArray,MHTSaver::Status)));
 }
+
+void MainWindow::on_actionBenchmarkDbCommits_triggered()
+{
+    RunBenchmark("Database Commit Latency", Benchmarks::DatabaseCommitLatency);
+}
+
+void MainWindow::on_actionBenchmarkImportAnalysis_triggered()
+{
+    RunBenchmark("Import Analysis", Benchmarks::ImportAnalysis);
+}
+
+void MainWindow::on_actionBenchmarkPageFetching_triggered()
+{
+    RunBenchmark("Page Fetching", Benchmarks::PageFetching);
+}
+
+void MainWindow::on_actionBenchmarkMimeEncoders_triggered()
+{
+    RunBenchmark("MHT Encoders", Benchmarks::MimeEncoders);
+}
+
+void MainWindow::on_actionBenchmarkFileMoves_triggered()
+{
+    RunBenchmark("File Moves", Benchmarks::FileMoves);
+}
+
+void MainWindow::on_actionBenchmarkFileHashing_triggered()
+{
+    RunBenchmark("File Hashing", Benchmarks::FileHashing);
+}
+
+void MainWindow::on_actionBenchmarkBookmarksSorting_triggered()
+{
+    RunBenchmark("Bookmarks Sorting and Filtering", Benchmarks::BookmarksSorting);
+}
+
+void MainWindow::RunBenchmark(const QString& title, Benchmarks::Function function)
+{
+    QString report;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool success = function(&dbm, this, report);
+    QApplication::restoreOverrideCursor();
+
+    if (success)
+    {
+        qDebug() << qPrintable(title) << "benchmark:\n" << qPrintable(report);
+        QMessageBox::information(this, title, report);
+    }
+    else if (!report.isEmpty()) //Otherwise the benchmark has shown its error already.
+    {
+        qDebug() << qPrintable(title) << "benchmark error:\n" << qPrintable(report);
+        QMessageBox::critical(this, title, report);
+    }
+}
@@ -2,7 +2,9 @@
 #include <QMainWindow>
 
 #include "Config.h"
+#include "Bookmarks/BookmarkSearchThread.h"
 #include "Database/DatabaseManager.h"
+#include "Debug/Benchmarks.h"
 #include "Files/FileManager.h"
 
 #include <QHash>
@@ -22,6 +24,15 @@ private:
     DatabaseManager dbm;
     bool m_shouldExit;
 
+    /// Full-text and RegExp searches run in this thread. Until the results of the latest request
+    ///   arrive, bookmarks are filtered by the previous results.
+    BookmarkSearchThread searchThread;
+    quint64 pendingSearchGeneration;
+    QString pendingSearchKey;
+    QString searchResultKey;
+    bool searchResultValid;
+    QList<long long> searchResultBIDs;
+
 public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
@@ -42,12 +53,24 @@ private slots:
     void tvTagSelectionChanged();
     void leSearchTextChanged(const QString& text);
     void chkSearchRegExpToggled(bool checked);
+    void chkSearchFullTextToggled(bool checked);
+    void searchThreadSearchFinished(quint64 generation, const QList<long long>& BIDs, bool success,
+                                    const QString& errorText);
 
     void on_action_importFirefoxBookmarks_triggered();
     void on_actionImportFirefoxBookmarksJSONfile_triggered();
+    void on_actionImportChromiumBookmarks_triggered();
     void on_actionImportUrlsAsBookmarks_triggered();
     void on_actionImportMHTFiles_triggered();
     void on_actionGetMHT_triggered();
+    void on_actionBenchmarkDbCommits_triggered();
+    void on_actionBenchmarkImportAnalysis_triggered();
+    void on_actionBenchmarkPageFetching_triggered();
+    void on_actionBenchmarkMimeEncoders_triggered();
+    void on_actionBenchmarkFileMoves_triggered();
+    void on_actionBenchmarkFileHashing_triggered();
+    void on_actionBenchmarkBookmarksSorting_triggered();
+    void on_actionCheckFileArchives_triggered();
     void on_actionSettings_triggered();
 
 private:
@@ -71,5 +94,11 @@ private:
     void ImportURLs(const QStringList& urls, long long importFOID);
     void ImportMHTFiles(const QStringList& filePaths, long long importFOID);
     void ImportFirefoxJSONFile(const QString& jsonFilePath);
+    void ImportFirefoxPlacesFile(const QString& placesFilePath);
+    void ImportChromiumBookmarksFile(const QString& bookmarksFilePath);
     void ImportBookmarks(ImportedEntityList& elist);
+
+    //// Debug menu ///////////////////////////////////////////////////////////////////////////////
+    /// Runs a benchmark with a busy cursor, and logs and shows its report or its error.
+    void RunBenchmark(const QString& title, Benchmarks::Function function);
 };
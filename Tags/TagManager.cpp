@@ -8,13 +8,13 @@
 TagManager::TagManager(QWidget* dialogParent, Config* conf)
     : ISubManager(dialogParent, conf)
 {
+    tagBitmapsValid = false;
 }
 
 bool TagManager::RetrieveBookmarkTags(long long BID, QStringList& tagsList)
 {
     QString retrieveError = "Could not get tag information for bookmark from database.";
-    QSqlQuery query(db);
-    query.prepare("SELECT * FROM BookmarkTag NATURAL JOIN Tag WHERE BID = ?");
+    QSqlQuery query = CachedQuery("SELECT * FROM BookmarkTag NATURAL JOIN Tag WHERE BID = ?");
     query.addBindValue(BID);
 
     if (!query.exec())
@@ -32,23 +32,24 @@ bool TagManager::SetBookmarkTags(long long BID, const QStringList& tagsList,
                                  QList<long long>& associatedTIDs)
 {
     QString setTagsError = "Could not alter tag information for bookmark in the database.";
-    QSqlQuery query(db);
 
     QStringList tagsToAdd = Util::CaseInsensitiveStringListEliminateDuplicatesCopy(tagsList);
     QList<long long> tagsToRemove;
+    QList<long long> TIDsToRemove;
 
     //Empty values might come from anywhere (although we fixed Import bug that generated empty tags)
     tagsToAdd.removeAll(QString());
     tagsToAdd.removeAll(QString(""));
 
     // Remove those that already exist in the database from the tagsToAdd.
-    query.prepare("SELECT * FROM BookmarkTag NATURAL JOIN Tag WHERE BID = ?");
+    QSqlQuery query = CachedQuery("SELECT * FROM BookmarkTag NATURAL JOIN Tag WHERE BID = ?");
     query.addBindValue(BID);
     if (!query.exec())
         return Error(setTagsError, query.lastError());
 
     const QSqlRecord record = query.record();
     const int indexOfBTID = record.indexOf("BTID");
+    const int indexOfTID = record.indexOf("TID");
     const int indexOfTagName = record.indexOf("TagName");
     while (query.next())
     {
@@ -62,16 +63,18 @@ bool TagManager::SetBookmarkTags(long long BID, const QStringList& tagsList,
         {
             //User wants to remove the tag.
             tagsToRemove.append(query.value(indexOfBTID).toLongLong());
+            TIDsToRemove.append(query.value(indexOfTID).toLongLong());
         }
     }
 
     //Remove unwanted tags from DB.
     for (int i = 0; i < tagsToRemove.count(); i++)
     {
-        query.prepare("DELETE FROM BookmarkTag WHERE BTID = ?");
-        query.addBindValue(tagsToRemove[i]);
-        if (!query.exec())
-            return Error(setTagsError, query.lastError());
+        QSqlQuery deleteQuery = CachedQuery("DELETE FROM BookmarkTag WHERE BTID = ?");
+        deleteQuery.addBindValue(tagsToRemove[i]);
+        if (!deleteQuery.exec())
+            return Error(setTagsError, deleteQuery.lastError());
+        tagBitmaps[TIDsToRemove[i]].Remove(BID);
     }
 
     //Add the new tags to DB.
@@ -81,11 +84,12 @@ bool TagManager::SetBookmarkTags(long long BID, const QStringList& tagsList,
         long long TID = MaybeCreateTagAndReturnTID(tagsToAdd[i]);
         associatedTIDs.append(TID);
 
-        query.prepare("INSERT INTO BookmarkTag ( BID , TID ) VALUES ( ? , ? )");
-        query.addBindValue(BID);
-        query.addBindValue(TID);
-        if (!query.exec())
-            return Error(setTagsError, query.lastError());
+        QSqlQuery insertQuery = CachedQuery("INSERT INTO BookmarkTag ( BID , TID ) VALUES ( ? , ? )");
+        insertQuery.addBindValue(BID);
+        insertQuery.addBindValue(TID);
+        if (!insertQuery.exec())
+            return Error(setTagsError, insertQuery.lastError());
+        tagBitmaps[TID].Add(BID);
     }
 
     //Note: An easier alternative to this function was to remove all tags for a bookmark then
@@ -98,6 +102,47 @@ bool TagManager::SetBookmarkTags(long long BID, const QStringList& tagsList,
     return true;
 }
 
+bool TagManager::AddBookmarksTags(const QList<long long>& BIDs, const QList<QStringList>& tagsLists,
+                                  QList<long long>& associatedTIDs)
+{
+    //Do it for caller
+    associatedTIDs.clear();
+
+    //Each distinct tag is looked up or created once, not once per bookmark.
+    QHash<QString, long long> TIDsByLowerName;
+    QVariantList values;
+    for (int i = 0; i < BIDs.size(); i++)
+    {
+        //Same as SetBookmarkTags.
+        QStringList tagsToAdd = Util::CaseInsensitiveStringListEliminateDuplicatesCopy(tagsLists[i]);
+        tagsToAdd.removeAll(QString());
+        tagsToAdd.removeAll(QString(""));
+
+        foreach (const QString& tagName, tagsToAdd)
+        {
+            const QString lowerName = tagName.toLower();
+            QHash<QString, long long>::const_iterator it = TIDsByLowerName.constFind(lowerName);
+            long long TID;
+            if (it != TIDsByLowerName.constEnd())
+            {
+                TID = it.value();
+            }
+            else
+            {
+                TID = MaybeCreateTagAndReturnTID(tagName);
+                TIDsByLowerName.insert(lowerName, TID);
+                associatedTIDs.append(TID);
+            }
+
+            values << BIDs[i] << TID;
+            tagBitmaps[TID].Add(BIDs[i]);
+        }
+    }
+
+    return MultiRowInsert("INSERT INTO BookmarkTag ( BID , TID )", 2, values,
+                          "Could not alter tag information for bookmark in the database.");
+}
+
 bool TagManager::GetBookmarkIDsForTags(const QSet<long long>& TIDs, QSet<long long>& BIDs)
 {
     /// Mostly same as BookmarkManager::RetrieveBookmarksInFolders
@@ -131,25 +176,80 @@ bool TagManager::GetBookmarkIDsForTags(const QSet<long long>& TIDs, QSet<long lo
     return true;
 }
 
+void TagManager::GetBookmarksWithTagsBitmap(const QSet<long long>& TIDs, bool matchAll,
+                                            BookmarkBitmap& BIDs)
+{
+    if (!tagBitmapsValid) //E.g after a rollback, if the models are not re-populated yet.
+        RebuildTagBitmaps();
+
+    BIDs.clear(); //Do it for caller
+    bool first = true;
+    foreach (long long TID, TIDs)
+    {
+        const BookmarkBitmap tagBIDs = tagBitmaps.value(TID); //Empty for unused tags.
+        if (first || !matchAll)
+            BIDs |= tagBIDs;
+        else
+            BIDs &= tagBIDs;
+        first = false;
+    }
+}
+
+void TagManager::InvalidateTagBitmaps()
+{
+    tagBitmapsValid = false;
+}
+
+void TagManager::RebuildTagBitmaps()
+{
+    tagBitmaps.clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    //Uses the covering IX_BookmarkTag_TID index; BIDs come in order for each tag.
+    if (!query.exec("SELECT TID, BID FROM BookmarkTag ORDER BY TID, BID"))
+    {
+        Error("Error while building the tags index.", query.lastError());
+        return;
+    }
+
+    while (query.next())
+        tagBitmaps[query.value(0).toLongLong()].Add(query.value(1).toLongLong());
+    tagBitmapsValid = true;
+}
+
 long long TagManager::MaybeCreateTagAndReturnTID(const QString& tagName)
 {
     QString setTagsError = "Could not alter tag information for bookmark in the database.";
 
-    QSqlQuery query(db);
-    query.prepare("SELECT TID FROM Tag WHERE TagName = ? COLLATE NOCASE"); //Case insensitive.
+    QSqlQuery query = CachedQuery("SELECT TID FROM Tag WHERE TagName = ? COLLATE NOCASE"); //Case insensitive.
     query.addBindValue(tagName);
     if (!query.exec())
         return Error(setTagsError, query.lastError());
 
     if (query.first())
-        return query.record().value("TID").toLongLong();
+    {
+        long long TID = query.record().value("TID").toLongLong();
+        query.finish();
+        return TID;
+    }
 
-    query.prepare("INSERT INTO Tag ( TagName ) VALUES ( ? )");
-    query.addBindValue(tagName);
-    if (!query.exec())
-        return Error(setTagsError, query.lastError());
+    QSqlQuery insertQuery = CachedQuery("INSERT INTO Tag ( TagName ) VALUES ( ? )");
+    insertQuery.addBindValue(tagName);
+    if (!insertQuery.exec())
+        return Error(setTagsError, insertQuery.lastError());
 
-    return query.lastInsertId().toLongLong();
+    return insertQuery.lastInsertId().toLongLong();
+}
+
+QStringList TagManager::CreateIndexQueries()
+{
+    //Tag names are looked up case-insensitively; the index must have the same collation.
+    //Both directions of the many-to-many relationship are covered.
+    return QStringList()
+        << "CREATE INDEX IF NOT EXISTS IX_Tag_TagName ON Tag(TagName COLLATE NOCASE)"
+        << "CREATE INDEX IF NOT EXISTS IX_BookmarkTag_TID ON BookmarkTag(TID, BID)"
+        << "CREATE INDEX IF NOT EXISTS IX_BookmarkTag_BID ON BookmarkTag(BID, TID)";
 }
 
 void TagManager::CreateTables()
@@ -162,6 +262,9 @@ void TagManager::CreateTables()
                "( BTID INTEGER PRIMARY KEY AUTOINCREMENT, BID INTEGER, TID INTEGER, "
                "  FOREIGN KEY(BID) REFERENCES Bookmark(BID) ON DELETE CASCADE, "
                "  FOREIGN KEY(TID) REFERENCES Tag(TID) ON DELETE CASCADE )");
+
+    foreach (const QString& createIndexQuery, CreateIndexQueries())
+        query.exec(createIndexQuery);
 }
 
 void TagManager::PopulateModelsAndInternalTables()
@@ -185,4 +288,7 @@ void TagManager::PopulateModelsAndInternalTables()
 
     //For tags model, we handle the sorting very here!
     model.sort(tidx.TagName);
+
+    if (!tagBitmapsValid)
+        RebuildTagBitmaps();
 }
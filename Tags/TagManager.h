@@ -1,5 +1,7 @@
 #pragma once
 #include "Database/ISubManager.h"
+#include "Bookmarks/BookmarkBitmap.h"
+#include <QHash>
 #include <QStringList>
 #include <QtSql/QSqlQueryModel>
 
@@ -22,6 +24,13 @@ public:
         int TagName;
     } tidx;
 
+private:
+    /// BIDs of the bookmarks having each tag, for filtering. Built at the first populate and
+    ///   kept up-to-date by `SetBookmarkTags`; `InvalidateTagBitmaps` makes the next populate
+    ///   rebuild it. BIDs of deleted bookmarks may stay in it; they are never in the models.
+    QHash<long long, BookmarkBitmap> tagBitmaps;
+    bool tagBitmapsValid;
+
 public:
     TagManager(QWidget* dialogParent, Config* conf);
 
@@ -32,11 +41,25 @@ public:
     /// tags B C D, it just puts D in the associatedTIDs, whether or not a tag called D already
     /// exists or not.
     bool SetBookmarkTags(long long BID, const QStringList& tagsList, QList<long long>& associatedTIDs);
+    /// Tags new bookmarks, which don't have any tags yet, with multi-row inserts; `tagsLists`
+    ///   has the tags of each of `BIDs`. Puts all the tags used in `associatedTIDs`, once each.
+    bool AddBookmarksTags(const QList<long long>& BIDs, const QList<QStringList>& tagsLists,
+                          QList<long long>& associatedTIDs);
 
     bool GetBookmarkIDsForTags(const QSet<long long>& TIDs, QSet<long long>& BIDs);
+    /// Like `GetBookmarkIDsForTags` but from memory and as a bitmap, for filtering. If `matchAll`
+    ///   is true, only bookmarks having ALL of the tags are returned instead of ANY of them.
+    void GetBookmarksWithTagsBitmap(const QSet<long long>& TIDs, bool matchAll, BookmarkBitmap& BIDs);
+    /// Must be called when the database changes without going through this class, e.g when an
+    ///   action transaction is rolled back.
+    void InvalidateTagBitmaps();
 
 private:
     long long MaybeCreateTagAndReturnTID(const QString& tagName);
+    void RebuildTagBitmaps();
+
+public:
+    static QStringList CreateIndexQueries();
 
 protected:
     // ISubManager interface
@@ -0,0 +1,354 @@
+#include "FileHasher.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QThreadPool>
+
+#include <cstring>
+
+/// Adds each slice to one of the cryptographic hashes; reused for all the slices of a file.
+class FileHasher::HashTask : public QRunnable
+{
+private:
+    QCryptographicHash* m_hash;
+    const char* m_data;
+    int m_length;
+
+public:
+    HashTask(QCryptographicHash* hash) : m_hash(hash), m_data(NULL), m_length(0)
+    {
+        setAutoDelete(false);
+    }
+
+    void SetSlice(const char* data, int length)
+    {
+        m_data = data;
+        m_length = length;
+    }
+
+    void run()
+    {
+        m_hash->addData(m_data, m_length);
+    }
+};
+
+FileHasher::FileHasher(QObject* parent)
+    : QThread(parent), m_hashTypes(0), m_cancelled(0), m_totalBytes(0), m_doneBytes(0)
+    , m_lastPercent(-1)
+{
+
+}
+
+FileHasher::~FileHasher()
+{
+    Cancel();
+    wait();
+}
+
+void FileHasher::SetFiles(const QStringList& filePaths, int hashTypes)
+{
+    m_filePaths = filePaths;
+    m_hashTypes = hashTypes;
+    m_results.clear();
+    m_cancelled.storeRelease(0);
+}
+
+QList<FileHasher::Result> FileHasher::Results() const
+{
+    return m_results;
+}
+
+bool FileHasher::IsCancelled() const
+{
+    return (m_cancelled.loadAcquire() != 0);
+}
+
+void FileHasher::Cancel()
+{
+    m_cancelled.storeRelease(1);
+}
+
+void FileHasher::run()
+{
+    m_results.clear();
+    m_totalBytes = 0;
+    m_doneBytes = 0;
+    m_lastPercent = -1;
+    foreach (const QString& filePath, m_filePaths)
+        m_totalBytes += QFileInfo(filePath).size();
+
+    foreach (const QString& filePath, m_filePaths)
+    {
+        Result result;
+        HashFile(filePath, m_hashTypes, result, &m_cancelled, this);
+        //A partly hashed file is not a result.
+        if (IsCancelled())
+            break;
+        m_results.append(result);
+    }
+}
+
+void FileHasher::SliceHashed(qint64 sliceSize)
+{
+    m_doneBytes += sliceSize;
+    int percent = (m_totalBytes > 0 ? int(m_doneBytes * 100 / m_totalBytes) : 100);
+    if (percent != m_lastPercent)
+    {
+        m_lastPercent = percent;
+        emit Progress(percent);
+    }
+}
+
+bool FileHasher::HashFile(const QString& filePath, int hashTypes, Result& result,
+                          const QAtomicInt* cancelled, FileHashListener* listener)
+{
+    //Do it for caller
+    result.filePath = filePath;
+    result.success = false;
+    result.size = 0;
+    result.md5.clear();
+    result.fastHash = 0;
+    result.strongHash.clear();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QCryptographicHash md5Hash(QCryptographicHash::Md5);
+    QCryptographicHash strongHash(QCryptographicHash::Sha256);
+    HashTask md5Task(&md5Hash);
+    HashTask strongTask(&strongHash);
+    FastHashState fastState;
+    FastHashInit(fastState);
+
+    QList<HashTask*> tasks;
+    if (hashTypes & HT_MD5)
+        tasks.append(&md5Task);
+    if (hashTypes & HT_Strong)
+        tasks.append(&strongTask);
+    const bool withFastHash = (hashTypes & HT_Fast);
+    const bool inParallel = (tasks.size() + (withFastHash ? 1 : 0) > 1);
+
+    //The cryptographic hashes run on the pool, and the fast one on this thread meanwhile. Threads
+    //  are kept until all the slices are done.
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, tasks.size()));
+    pool.setExpiryTimeout(-1);
+
+    const qint64 fileSize = file.size();
+    QByteArray readBuffer;
+    bool success = true;
+    for (qint64 windowStart = 0; windowStart < fileSize && success; windowStart += MapWindowSize)
+    {
+        const qint64 windowSize = qMin(MapWindowSize, fileSize - windowStart);
+        uchar* mappedWindow = file.map(windowStart, windowSize);
+
+        for (qint64 sliceStart = 0; sliceStart < windowSize; sliceStart += SliceSize)
+        {
+            if (cancelled != NULL && cancelled->loadAcquire() != 0)
+            {
+                success = false;
+                break;
+            }
+
+            const int sliceSize = int(qMin<qint64>(SliceSize, windowSize - sliceStart));
+            const char* slice;
+            if (mappedWindow != NULL)
+            {
+                slice = (const char*)mappedWindow + sliceStart;
+            }
+            else
+            {
+                //Could not be mapped, e.g on some network drives.
+                readBuffer.resize(SliceSize);
+                if (!file.seek(windowStart + sliceStart) ||
+                    file.read(readBuffer.data(), sliceSize) != sliceSize)
+                {
+                    success = false;
+                    break;
+                }
+                slice = readBuffer.constData();
+            }
+
+            foreach (HashTask* task, tasks)
+            {
+                task->SetSlice(slice, sliceSize);
+                if (inParallel)
+                    pool.start(task);
+                else
+                    task->run();
+            }
+            if (withFastHash)
+                FastHashUpdate(fastState, slice, sliceSize);
+            pool.waitForDone();
+
+            if (listener != NULL)
+                listener->SliceHashed(sliceSize);
+        }
+
+        if (mappedWindow != NULL)
+            file.unmap(mappedWindow);
+    }
+
+    file.close();
+    if (!success)
+        return false;
+
+    result.success = true;
+    result.size = fileSize;
+    if (hashTypes & HT_MD5)
+        result.md5 = md5Hash.result();
+    if (withFastHash)
+        result.fastHash = FastHashFinal(fastState);
+    if (hashTypes & HT_Strong)
+        result.strongHash = strongHash.result();
+    return true;
+}
+
+//// XXH64 ////////////////////////////////////////////////////////////////////
+//From the xxHash specification: https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+
+static const quint64 XXH_PRIME64_1 = Q_UINT64_C(0x9E3779B185EBCA87);
+static const quint64 XXH_PRIME64_2 = Q_UINT64_C(0xC2B2AE3D27D4EB4F);
+static const quint64 XXH_PRIME64_3 = Q_UINT64_C(0x165667B19E3779F9);
+static const quint64 XXH_PRIME64_4 = Q_UINT64_C(0x85EBCA77C2B2AE63);
+static const quint64 XXH_PRIME64_5 = Q_UINT64_C(0x27D4EB2F165667C5);
+
+static inline quint64 XXHRotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline quint64 XXHRead64(const unsigned char* p)
+{
+    //Little-endian, like the x86 and ARM builds of the program.
+    quint64 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline quint32 XXHRead32(const unsigned char* p)
+{
+    quint32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline quint64 XXHRound(quint64 accumulator, quint64 lane)
+{
+    accumulator += lane * XXH_PRIME64_2;
+    accumulator = XXHRotateLeft(accumulator, 31);
+    return accumulator * XXH_PRIME64_1;
+}
+
+static inline quint64 XXHMergeAccumulator(quint64 hash, quint64 accumulator)
+{
+    hash ^= XXHRound(0, accumulator);
+    return hash * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+void FileHasher::FastHashInit(FastHashState& state)
+{
+    state.v[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+    state.v[1] = XXH_PRIME64_2;
+    state.v[2] = 0;
+    state.v[3] = 0 - XXH_PRIME64_1;
+    state.totalLength = 0;
+    state.bufferLength = 0;
+}
+
+void FileHasher::FastHashUpdate(FastHashState& state, const char* data, qint64 length)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* const end = p + length;
+    state.totalLength += length;
+
+    //Complete a stripe that was left from the last call.
+    if (state.bufferLength > 0)
+    {
+        const int needed = 32 - state.bufferLength;
+        if (length < needed)
+        {
+            memcpy(state.buffer + state.bufferLength, p, length);
+            state.bufferLength += int(length);
+            return;
+        }
+        memcpy(state.buffer + state.bufferLength, p, needed);
+        p += needed;
+        for (int lane = 0; lane < 4; lane++)
+            state.v[lane] = XXHRound(state.v[lane], XXHRead64(state.buffer + lane * 8));
+        state.bufferLength = 0;
+    }
+
+    //Stripes of 32 bytes; this is where all the time goes.
+    quint64 v0 = state.v[0], v1 = state.v[1], v2 = state.v[2], v3 = state.v[3];
+    for (; end - p >= 32; p += 32)
+    {
+        v0 = XXHRound(v0, XXHRead64(p));
+        v1 = XXHRound(v1, XXHRead64(p + 8));
+        v2 = XXHRound(v2, XXHRead64(p + 16));
+        v3 = XXHRound(v3, XXHRead64(p + 24));
+    }
+    state.v[0] = v0;
+    state.v[1] = v1;
+    state.v[2] = v2;
+    state.v[3] = v3;
+
+    if (p < end)
+    {
+        memcpy(state.buffer, p, end - p);
+        state.bufferLength = int(end - p);
+    }
+}
+
+quint64 FileHasher::FastHashFinal(const FastHashState& state)
+{
+    quint64 hash;
+    if (state.totalLength >= 32)
+    {
+        hash = XXHRotateLeft(state.v[0], 1) + XXHRotateLeft(state.v[1], 7)
+             + XXHRotateLeft(state.v[2], 12) + XXHRotateLeft(state.v[3], 18);
+        for (int lane = 0; lane < 4; lane++)
+            hash = XXHMergeAccumulator(hash, state.v[lane]);
+    }
+    else
+    {
+        hash = XXH_PRIME64_5;
+    }
+    hash += state.totalLength;
+
+    const unsigned char* p = state.buffer;
+    const unsigned char* const end = p + state.bufferLength;
+    for (; end - p >= 8; p += 8)
+    {
+        hash ^= XXHRound(0, XXHRead64(p));
+        hash = XXHRotateLeft(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+    if (end - p >= 4)
+    {
+        hash ^= quint64(XXHRead32(p)) * XXH_PRIME64_1;
+        hash = XXHRotateLeft(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        hash ^= (*p) * XXH_PRIME64_5;
+        hash = XXHRotateLeft(hash, 11) * XXH_PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+quint64 FileHasher::FastHash(const QByteArray& data)
+{
+    FastHashState state;
+    FastHashInit(state);
+    FastHashUpdate(state, data.constData(), data.size());
+    return FastHashFinal(state);
+}
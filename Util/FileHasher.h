@@ -0,0 +1,112 @@
+#pragma once
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QList>
+#include <QRunnable>
+#include <QStringList>
+#include <QThread>
+
+/// Gets the progress of `FileHasher::HashFile`; called on the hashing thread after each slice.
+class FileHashListener
+{
+public:
+    virtual ~FileHashListener() { }
+    virtual void SliceHashed(qint64 sliceSize) = 0;
+};
+
+/// Hashes files for attaching them, off the GUI thread.
+/// - Files are memory-mapped in windows of `MapWindowSize` bytes, so that big files don't need
+///   a big address space; if mapping fails they are read instead.
+/// - It can compute, in one pass: MD5, which is what the File.MD5 column has; a fast
+///   non-cryptographic hash (XXH64) for change detection; and a strong hash (SHA-256) for telling
+///   if two files have the same contents, which is what FileArchiveManager's content-addressed
+///   layout uses. When more than one of them is requested they run on separate threads, so
+///   getting all of them takes about as long as getting the slowest one.
+/// - As a thread, hashes a list of files, reports progress and can be cancelled. `HashFile` can
+///   also be called directly on any thread, with its own cancel flag and progress listener.
+class FileHasher : public QThread, private FileHashListener
+{
+    Q_OBJECT
+    friend class Benchmarks;
+
+public:
+    enum HashType
+    {
+        HT_MD5 = 1,
+        HT_Fast = 2,
+        HT_Strong = 4,
+        HT_All = HT_MD5 | HT_Fast | HT_Strong
+    };
+
+    struct Result
+    {
+        QString filePath;
+        bool success;
+        qint64 size;
+        QByteArray md5;
+        quint64 fastHash;
+        QByteArray strongHash;
+    };
+
+    static const qint64 MapWindowSize = 64 * 1024 * 1024;
+    /// Progress and cancellation are checked after each slice.
+    static const int SliceSize = 4 * 1024 * 1024;
+
+private:
+    class HashTask;
+
+    QStringList m_filePaths;
+    int m_hashTypes;
+    QList<Result> m_results;
+    QAtomicInt m_cancelled;
+
+    //Of the thread's progress
+    qint64 m_totalBytes;
+    qint64 m_doneBytes;
+    int m_lastPercent;
+
+public:
+    explicit FileHasher(QObject* parent = 0);
+    /// Cancels the thread and waits for it.
+    ~FileHasher();
+
+    /// Must NOT be called while the thread is running. `hashTypes` is an OR of `HashType`s.
+    void SetFiles(const QStringList& filePaths, int hashTypes);
+    /// Valid after the thread finished; in the order of the files. Files after a cancellation are
+    ///   not in it.
+    QList<Result> Results() const;
+    bool IsCancelled() const;
+
+    /// `hashTypes` is an OR of `HashType`s; the others are left empty in `result`.
+    /// Before each slice, hashing stops and returns false if `cancelled` is non-zero. After each
+    ///   slice `listener` is told about it. Both may be NULL.
+    static bool HashFile(const QString& filePath, int hashTypes, Result& result,
+                         const QAtomicInt* cancelled = NULL, FileHashListener* listener = NULL);
+
+public slots:
+    void Cancel();
+
+signals:
+    /// Percent of the bytes of all files; emitted from the hashing thread when it changes.
+    void Progress(int percent);
+
+protected:
+    void run();
+
+private:
+    //FileHashListener
+    void SliceHashed(qint64 sliceSize);
+
+    /// XXH64, with a seed of 0.
+    struct FastHashState
+    {
+        quint64 v[4];
+        quint64 totalLength;
+        unsigned char buffer[32];
+        int bufferLength;
+    };
+    static void FastHashInit(FastHashState& state);
+    static void FastHashUpdate(FastHashState& state, const char* data, qint64 length);
+    static quint64 FastHashFinal(const FastHashState& state);
+    static quint64 FastHash(const QByteArray& data);
+};
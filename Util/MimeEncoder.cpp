@@ -0,0 +1,232 @@
+#include "MimeEncoder.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define MIMEENCODER_AVX2
+    #define MIMEENCODER_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define MIMEENCODER_SSE2
+#endif
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+//Lines are kept under 76 characters so that a soft break can be added to them at any time.
+static const int QPLineMax = 75;
+
+static inline void AddSoftBreak(char*& out, int& lineLen)
+{
+    out[0] = '=';
+    out[1] = '\r';
+    out[2] = '\n';
+    out += 3;
+    lineLen = 0;
+}
+
+#ifdef MIMEENCODER_SSE2
+static inline int FirstUnsetBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, ~mask);
+    return (int)index;
+#else
+    return __builtin_ctz(~mask);
+#endif
+}
+#endif
+
+QByteArray MimeEncoder::EncodeQuotedPrintable(const QByteArray& data)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    const int blockSize = 64 * 1024;
+
+    const char* in = data.constData();
+    const int size = data.size();
+
+    //Mostly ascii text is expected; the buffer grows if it's not.
+    QByteArray encoded;
+    encoded.resize(size + size / 16 + 64);
+    char* out = encoded.data();
+
+    int lineLen = 0;
+    int i = 0;
+    while (i < size)
+    {
+        //Each byte becomes at most 3 characters and there is at most one soft break per 73
+        //  characters, so 4 characters per byte are always enough.
+        const int blockEnd = (size - i > blockSize ? i + blockSize : size);
+        const int needed = (blockEnd - i) * 4 + 8;
+        const int used = out - encoded.data();
+        if (encoded.size() - used < needed)
+        {
+            encoded.resize(qMax(encoded.size() + encoded.size() / 2, used + needed));
+            out = encoded.data() + used;
+        }
+
+        while (i < blockEnd)
+        {
+            int run = SafeRunLength(in + i, blockEnd - i);
+            //A space before a line break must be encoded, so it is left for the code below.
+            if (run > 0 && in[i + run - 1] == ' ' &&
+                (i + run == size || in[i + run] == '\r' || in[i + run] == '\n'))
+                run--;
+            while (run > 0)
+            {
+                if (lineLen == QPLineMax)
+                    AddSoftBreak(out, lineLen);
+                const int count = qMin(run, QPLineMax - lineLen);
+                memcpy(out, in + i, count);
+                out += count;
+                lineLen += count;
+                i += count;
+                run -= count;
+            }
+            if (i >= blockEnd)
+                break;
+
+            //Like in Util::EncodeQuotedPrintable, this must be at the start, not at the end to make
+            //  sure more data comes.
+            if (lineLen == QPLineMax)
+                AddSoftBreak(out, lineLen);
+
+            const unsigned char c = in[i];
+            if (c == '\r' || c == '\n')
+            {
+                if (c == '\r' && i + 1 < size && in[i + 1] == '\n')
+                    i++;
+                //Always encode as CRLF
+                out[0] = '\r';
+                out[1] = '\n';
+                out += 2;
+                lineLen = 0;
+            }
+            else if ((c == ' ' || c == '\t') && i + 1 < size && in[i + 1] != '\r' && in[i + 1] != '\n')
+            {
+                //Only spaces and tabs before real line-breaks must be encoded.
+                *out++ = c;
+                lineLen += 1;
+            }
+            else
+            {
+                if (lineLen > QPLineMax - 3)
+                    AddSoftBreak(out, lineLen);
+                out[0] = '=';
+                out[1] = hexDigits[c >> 4];
+                out[2] = hexDigits[c & 0xF];
+                out += 3;
+                lineLen += 3;
+            }
+            i++;
+        }
+    }
+
+    encoded.resize(out - encoded.data());
+    return encoded;
+}
+
+QByteArray MimeEncoder::EncodeBase64Lines(const QByteArray& data)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const int bytesPerLine = 57; //76 characters
+
+    const unsigned char* in = (const unsigned char*)data.constData();
+    int remaining = data.size();
+    const int encodedLen = (remaining + 2) / 3 * 4;
+    const int linesCount = encodedLen / 76 + 1;
+
+    QByteArray encoded;
+    encoded.resize(encodedLen + 2 * linesCount);
+    char* out = encoded.data();
+
+    for (int line = 0; line < linesCount; line++)
+    {
+        const int lineBytes = qMin(remaining, bytesPerLine);
+        const unsigned char* groupsEnd = in + lineBytes / 3 * 3;
+        for (; in < groupsEnd; in += 3)
+        {
+            const unsigned int group = (in[0] << 16) | (in[1] << 8) | in[2];
+            out[0] = alphabet[group >> 18];
+            out[1] = alphabet[(group >> 12) & 0x3F];
+            out[2] = alphabet[(group >> 6) & 0x3F];
+            out[3] = alphabet[group & 0x3F];
+            out += 4;
+        }
+
+        const int tail = lineBytes % 3;
+        if (tail != 0)
+        {
+            const unsigned int group = (in[0] << 16) | (tail == 2 ? in[1] << 8 : 0);
+            out[0] = alphabet[group >> 18];
+            out[1] = alphabet[(group >> 12) & 0x3F];
+            out[2] = (tail == 2 ? alphabet[(group >> 6) & 0x3F] : '=');
+            out[3] = '=';
+            out += 4;
+            in += tail;
+        }
+
+        remaining -= lineBytes;
+        out[0] = '\r';
+        out[1] = '\n';
+        out += 2;
+    }
+
+    return encoded;
+}
+
+const char* MimeEncoder::InstructionSet()
+{
+#if defined(MIMEENCODER_AVX2)
+    return "AVX2";
+#elif defined(MIMEENCODER_SSE2)
+    return "SSE2";
+#else
+    return "";
+#endif
+}
+
+int MimeEncoder::SafeRunLength(const char* p, int len)
+{
+    //Safe bytes are space and the printable ascii characters except '='. As signed chars, non-ascii
+    //  bytes are negative, so a single signed range check leaves them out.
+    int n = 0;
+#ifdef MIMEENCODER_AVX2
+    const __m256i lowWide = _mm256_set1_epi8(31);
+    const __m256i highWide = _mm256_set1_epi8(127);
+    const __m256i equalsWide = _mm256_set1_epi8('=');
+    for (; n + 32 <= len; n += 32)
+    {
+        const __m256i c = _mm256_loadu_si256((const __m256i*)(p + n));
+        const __m256i inRange = _mm256_and_si256(_mm256_cmpgt_epi8(c, lowWide), _mm256_cmpgt_epi8(highWide, c));
+        const __m256i safe = _mm256_andnot_si256(_mm256_cmpeq_epi8(c, equalsWide), inRange);
+        const unsigned int mask = (unsigned int)_mm256_movemask_epi8(safe);
+        if (mask != 0xFFFFFFFFu)
+            return n + FirstUnsetBit(mask);
+    }
+#endif
+#ifdef MIMEENCODER_SSE2
+    const __m128i low = _mm_set1_epi8(31);
+    const __m128i high = _mm_set1_epi8(127);
+    const __m128i equals = _mm_set1_epi8('=');
+    for (; n + 16 <= len; n += 16)
+    {
+        const __m128i c = _mm_loadu_si128((const __m128i*)(p + n));
+        const __m128i inRange = _mm_and_si128(_mm_cmpgt_epi8(c, low), _mm_cmplt_epi8(c, high));
+        const __m128i safe = _mm_andnot_si128(_mm_cmpeq_epi8(c, equals), inRange);
+        const unsigned int mask = (unsigned int)_mm_movemask_epi8(safe) | 0xFFFF0000u;
+        if (mask != 0xFFFFFFFFu)
+            return n + FirstUnsetBit(mask);
+    }
+#endif
+    for (; n < len; n++)
+    {
+        const unsigned char c = p[n];
+        if (c < 32 || c >= 127 || c == '=')
+            break;
+    }
+    return n;
+}
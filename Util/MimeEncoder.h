@@ -0,0 +1,26 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+
+/// Fast content transfer encoders for the bodies of MIME (i.e mhtml) parts.
+/// Their output is byte-for-byte the same as what MHTSaver produced with the general purpose
+///     `Util::EncodeQuotedPrintable` and `QByteArray::toBase64`, but they write into a single
+///     preallocated buffer instead of appending byte by byte. The quoted-printable encoder finds
+///     runs of bytes that need no encoding 16 (SSE2) or 32 (AVX2) bytes at a time when the compiler
+///     targets those instruction sets, and falls back to a byte loop otherwise.
+/// They are stateless and can be used from several threads at once.
+class MimeEncoder
+{
+public:
+    /// Same as `Util::EncodeQuotedPrintable(data)` with its default options.
+    static QByteArray EncodeQuotedPrintable(const QByteArray& data);
+    /// Base64 in lines of 76 characters, each followed by CRLF, plus a last empty line if the
+    ///   encoded data fills its last line (or is empty).
+    static QByteArray EncodeBase64Lines(const QByteArray& data);
+
+    /// "AVX2" or "SSE2" if runs of safe bytes are found with them, or empty.
+    static const char* InstructionSet();
+
+private:
+    static int SafeRunLength(const char* p, int len);
+};
@@ -3,13 +3,63 @@
 #include "Util.h"
 #include "WinFunctions.h"
 
+#include <QDebug>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QStorageInfo>
+
+const char* const TransactionalFileOperator::JournalFileName = "journal.txt";
 
 TransactionalFileOperator::TransactionalFileOperator()
 {
     fileTransactionStarted = false;
+    journalFile = NULL;
+    journalFailed = false;
+    journalBackUpsCount = 0;
+}
+
+TransactionalFileOperator::~TransactionalFileOperator()
+{
+    //An unfinished transaction stays in the journal to be recovered.
+    delete journalFile;
+}
+
+void TransactionalFileOperator::setJournalDirPath(const QString& dirPath)
+{
+    journalDirPath = dirPath;
+}
+
+bool TransactionalFileOperator::RecoverInterruptedTransactions(int& recoveredCount)
+{
+    recoveredCount = 0;
+    if (journalDirPath.isEmpty() || fileTransactionStarted)
+        return false;
+
+    bool overallResult = true;
+    QDir journalDir(journalDirPath);
+    foreach (const QFileInfo& tdi, journalDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+        //Without a journal file the transaction was committed or rolled back, and only its kept
+        //  files were not removed.
+        bool result = true;
+        QList<FileOp> journaledOps;
+        if (ReadJournal(tdi.filePath() + "/" + JournalFileName, journaledOps))
+        {
+            result = RecoverJournaledOps(journaledOps);
+            recoveredCount += 1;
+        }
+
+        //If some files could not be restored, their copies are kept to be tried again next time.
+        if (result)
+            result = Util::RemoveDirectoryRecursively(tdi.filePath());
+        else
+            qDebug() << "Could not recover all files of the interrupted transaction in" << tdi.filePath();
+
+        overallResult &= result;
+    }
+
+    return overallResult;
 }
 
 bool TransactionalFileOperator::BeginTransaction()
@@ -52,6 +102,7 @@ bool TransactionalFileOperator::RollBackTransaction()
             overallResult &= QFile::rename(fileOp.destFile, fileOp.srcFile);
             break;
         case FileOp::FAT_Copy:
+        case FileOp::FAT_Write:
             overallResult &= QFile::remove(fileOp.destFile);
             break;
         case FileOp::FAT_Move:
@@ -60,16 +111,16 @@ bool TransactionalFileOperator::RollBackTransaction()
             break;
         case FileOp::FAT_SystemTrash:
             //Note: We can't undo our own recycle-bin deleting, so we have to save a backup file
-            //      in temp. This backup file is the destFile.
-            overallResult &= QFile::copy(fileOp.destFile, fileOp.srcFile);
-            break;
+            //      in temp or the journal. This backup file is the destFile.
         case FileOp::FAT_Delete:
-            overallResult &= QFile::copy(fileOp.destFile, fileOp.srcFile);
+            //The backup is not needed anymore, so it is moved back rather than copied.
+            overallResult &= QFile::rename(fileOp.destFile, fileOp.srcFile);
             break;
         }
     }
 
-    EndTransaction();
+    //If rolling back failed, the journal is kept so that it is tried again at next startup.
+    EndTransaction(!overallResult);
     return overallResult;
 }
 
@@ -88,7 +139,7 @@ bool TransactionalFileOperator::MakePath(const QString& basePath, const QString&
 
     if (result)
         //fileOps.append(FileOp(FileOp::FAT_MakePath, baseDir.absoluteFilePath(pathToMake), ""));
-        fileOps.append(FileOp(FileOp::FAT_MakePath, basePath, pathToMake));
+        AddFileOp(FileOp(FileOp::FAT_MakePath, basePath, pathToMake));
 
     return result;
 }
@@ -98,10 +149,16 @@ bool TransactionalFileOperator::RenameFile(const QString& oldName, const QString
     if (!fileTransactionStarted)
         return false;
 
+    //The journal is written first, like in DeleteFile; at recovery, the files tell if it was
+    //  renamed.
+    FileOp fileOp(FileOp::FAT_Rename, oldName, newName);
+    if (!WriteJournalAhead(fileOp))
+        return false;
+
     bool result = QFile::rename(oldName, newName);
 
     if (result)
-        fileOps.append(FileOp(FileOp::FAT_Rename, oldName, newName));
+        fileOps.append(fileOp);
 
     return result;
 }
@@ -114,34 +171,65 @@ bool TransactionalFileOperator::CopyFile(const QString& oldPath, const QString&
     bool result = QFile::copy(oldPath, newPath);
 
     if (result)
-        fileOps.append(FileOp(FileOp::FAT_Copy, oldPath, newPath));
+        AddFileOp(FileOp(FileOp::FAT_Copy, oldPath, newPath));
 
     return result;
 }
 
-bool TransactionalFileOperator::MoveFile(const QString& oldPath, const QString& newPath)
+bool TransactionalFileOperator::WriteFile(QIODevice* source, const QString& newPath,
+                                          QCryptographicHash* hasher, qint64& size)
 {
     if (!fileTransactionStarted)
         return false;
 
-    bool result = QFile::copy(oldPath, newPath);
+    //Like QFile::copy, don't overwrite an existing file.
+    QFile newFile(newPath);
+    if (newFile.exists() || !newFile.open(QIODevice::WriteOnly))
+        return false;
 
+    bool result = Util::WriteDeviceToDevice(source, &newFile, hasher, size);
+    newFile.close();
     if (result)
-        result = QFile::remove(oldPath);
+        result = (newFile.error() == QFileDevice::NoError);
 
-    if (result)
-        fileOps.append(FileOp(FileOp::FAT_Move, oldPath, newPath));
+    //Even if writing failed, the created file must be removed on rollback.
+    AddFileOp(FileOp(FileOp::FAT_Write, "", newPath));
 
     return result;
 }
 
+bool TransactionalFileOperator::MoveFile(const QString& oldPath, const QString& newPath)
+{
+    if (!fileTransactionStarted)
+        return false;
+
+    //Renaming doesn't touch the contents and is atomic. Rolling it back is renaming back.
+    if (IsOnSameVolume(oldPath, QFileInfo(newPath).absolutePath()))
+        return RenameFile(oldPath, newPath);
+
+    return CopyAndRemoveFile(oldPath, newPath);
+}
+
 bool TransactionalFileOperator::SystemTrashFile(const QString& filePath)
 {
     if (!fileTransactionStarted)
         return false;
 
+    bool result;
     QString backUpFilePath;
-    bool result = backupFileInTemp(filePath, backUpFilePath);
+    if (StartJournal())
+    {
+        //The journal is written first; at recovery, the kept file tells if it was trashed. A hard
+        //  link keeps the contents without copying them, and the recycle bin takes the original.
+        backUpFilePath = JournalBackUpFilePath(filePath);
+        FileOp fileOp(FileOp::FAT_SystemTrash, filePath, backUpFilePath);
+        result = WriteJournal(fileOp) && (WinFunctions::MakeHardLink(filePath, backUpFilePath) ||
+                                          QFile::copy(filePath, backUpFilePath));
+    }
+    else
+    {
+        result = backupFileInTemp(filePath, backUpFilePath);
+    }
 
     if (result)
         result = WinFunctions::MoveFileToRecycleBin(filePath);
@@ -157,11 +245,22 @@ bool TransactionalFileOperator::DeleteFile(const QString& filePath)
     if (!fileTransactionStarted)
         return false;
 
+    bool result;
     QString backUpFilePath;
-    bool result = backupFileInTemp(filePath, backUpFilePath);
-
-    if (result)
-        result = QFile::remove(filePath);
+    if (StartJournal())
+    {
+        //Moving the file into the journal both deletes it and keeps it, without copying it if it
+        //  is on the same volume. The journal is written first, like in SystemTrashFile.
+        backUpFilePath = JournalBackUpFilePath(filePath);
+        FileOp fileOp(FileOp::FAT_Delete, filePath, backUpFilePath);
+        result = WriteJournal(fileOp) && QFile::rename(filePath, backUpFilePath);
+    }
+    else
+    {
+        result = backupFileInTemp(filePath, backUpFilePath);
+        if (result)
+            result = QFile::remove(filePath);
+    }
 
     if (result)
         fileOps.append(FileOp(FileOp::FAT_Delete, filePath, backUpFilePath));
@@ -169,12 +268,31 @@ bool TransactionalFileOperator::DeleteFile(const QString& filePath)
     return result;
 }
 
-void TransactionalFileOperator::EndTransaction()
+bool TransactionalFileOperator::IsOnSameVolume(const QString& path1, const QString& path2)
+{
+    //Note: QFile::rename falls back to copying if renaming fails anyway, e.g for two mount points
+    //  of a single device on linux; so a wrong 'true' only makes moving slower, not fail.
+    QStorageInfo volume1(path1);
+    QStorageInfo volume2(path2);
+    if (!volume1.isValid() || !volume2.isValid())
+        return false;
+
+    //`device` is the volume GUID path on Windows, so it is the same even if the volume is mounted
+    //  both as a drive and in a folder.
+    return (volume1.device() == volume2.device());
+}
+
+void TransactionalFileOperator::EndTransaction(bool keepJournal)
 {
     //Note: We try to remove the backup files in temp and don't care about their removal success.
-    foreach (const FileOp& fileOp, fileOps)
-        if (fileOp.action == FileOp::FAT_SystemTrash || fileOp.action == FileOp::FAT_Delete)
-            QFile::remove(fileOp.destFile); //destFile is the backup file.
+    //      In journal mode they are all in the transaction directory, and are removed with it.
+    if (transactionDirPath.isEmpty())
+    {
+        foreach (const FileOp& fileOp, fileOps)
+            if (fileOp.action == FileOp::FAT_SystemTrash || fileOp.action == FileOp::FAT_Delete)
+                QFile::remove(fileOp.destFile); //destFile is the backup file.
+    }
+    EndJournal(keepJournal);
 
     fileOps.clear();
     fileTransactionStarted = false;
@@ -191,3 +309,196 @@ bool TransactionalFileOperator::backupFileInTemp(const QString& filePath, QStrin
     bool result = QFile::copy(filePath, backUpFilePath);
     return result;
 }
+
+void TransactionalFileOperator::AddFileOp(const FileOp& fileOp)
+{
+    fileOps.append(fileOp);
+    //This is after the operation succeeded; if writing fails, it can still be rolled back now.
+    //  These operations only create files, so at worst a crash leaves an extra file behind.
+    if (StartJournal() && !WriteJournal(fileOp))
+        qDebug() << "Could not write the file transaction journal for" << fileOp.destFile;
+}
+
+bool TransactionalFileOperator::WriteJournalAhead(const FileOp& fileOp)
+{
+    if (!StartJournal())
+        return true; //Not in journal mode.
+
+    if (WriteJournal(fileOp))
+        return true;
+
+    qDebug() << "Could not write the file transaction journal for" << fileOp.destFile;
+    return false;
+}
+
+bool TransactionalFileOperator::StartJournal()
+{
+    if (journalFile != NULL)
+        return true;
+    if (journalDirPath.isEmpty() || journalFailed)
+        return false;
+
+    QString transactionDirName = Util::NonExistentRandomFileNameInDirectory(journalDirPath, 8);
+    QString newTransactionDirPath = journalDirPath + "/" + transactionDirName;
+    if (!QDir().mkpath(newTransactionDirPath))
+    {
+        qDebug() << "Could not create the file transaction directory" << newTransactionDirPath;
+        journalFailed = true;
+        return false;
+    }
+
+    journalFile = new QFile(newTransactionDirPath + "/" + JournalFileName);
+    if (!journalFile->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+    {
+        qDebug() << "Could not create the file transaction journal" << journalFile->fileName();
+        delete journalFile;
+        journalFile = NULL;
+        QDir().rmdir(newTransactionDirPath);
+        journalFailed = true;
+        return false;
+    }
+
+    transactionDirPath = newTransactionDirPath;
+    return true;
+}
+
+bool TransactionalFileOperator::WriteJournal(const FileOp& fileOp)
+{
+    //File paths can't have tabs or line breaks. Flushing is enough for surviving a crash of the
+    //  program; it is not synced to the disk.
+    QByteArray line = QString("%1\t%2\t%3\n").arg((int)fileOp.action)
+                      .arg(fileOp.srcFile, fileOp.destFile).toUtf8();
+    return (journalFile->write(line) == line.size() && journalFile->flush());
+}
+
+QString TransactionalFileOperator::JournalBackUpFilePath(const QString& filePath)
+{
+    //Numbered, as the same file name may be in different directories.
+    journalBackUpsCount += 1;
+    return transactionDirPath + "/" + QString::number(journalBackUpsCount) + "_"
+           + QFileInfo(filePath).fileName();
+}
+
+void TransactionalFileOperator::EndJournal(bool keepJournal)
+{
+    if (journalFile != NULL)
+    {
+        journalFile->close();
+        if (!keepJournal)
+        {
+            //This is the point after which the transaction is done for recovery too. An empty
+            //  journal is as good as a removed one.
+            bool journalEnded = journalFile->remove();
+            if (!journalEnded && journalFile->open(QIODevice::WriteOnly | QIODevice::Truncate))
+            {
+                journalFile->close();
+                journalEnded = true;
+            }
+
+            if (journalEnded)
+                Util::RemoveDirectoryRecursively(transactionDirPath);
+            else
+                qDebug() << "Could not end the file transaction journal" << journalFile->fileName();
+        }
+        delete journalFile;
+        journalFile = NULL;
+    }
+
+    transactionDirPath.clear();
+    journalFailed = false;
+    journalBackUpsCount = 0;
+}
+
+bool TransactionalFileOperator::ReadJournal(const QString& journalFilePath, QList<FileOp>& journaledOps)
+{
+    journaledOps.clear(); //Do it for caller
+
+    QFile file(journalFilePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    while (!file.atEnd())
+    {
+        //A last line that was not completely written is ignored; its operation was not done. It
+        //  must not be used, as e.g a cut path could be of another file.
+        QByteArray line = file.readLine();
+        if (!line.endsWith('\n'))
+            break;
+        line.chop(1);
+
+        QStringList fields = QString::fromUtf8(line).split('\t');
+        bool ok;
+        int action = fields[0].toInt(&ok);
+        if (fields.size() != 3 || !ok || action < FileOp::FAT_MakePath || action > FileOp::FAT_Delete)
+            continue;
+        journaledOps.append(FileOp((FileOp::FileActionType)action, fields[1], fields[2]));
+    }
+
+    return true;
+}
+
+bool TransactionalFileOperator::RecoverJournaledOps(const QList<FileOp>& journaledOps)
+{
+    bool overallResult = true;
+    for (int i = journaledOps.size() - 1; i >= 0; i--)
+    {
+        const FileOp& fileOp = journaledOps[i];
+        switch (fileOp.action)
+        {
+        case FileOp::FAT_MakePath:
+            //Fails if something else was put there; that's fine.
+            QDir(fileOp.srcFile).rmpath(fileOp.destFile);
+            break;
+        case FileOp::FAT_Copy:
+        case FileOp::FAT_Write:
+            if (QFile::exists(fileOp.destFile))
+                overallResult &= QFile::remove(fileOp.destFile);
+            break;
+        case FileOp::FAT_Move:
+            //Interrupted between copying and removing the original; the copy is ours, as
+            //  CopyAndRemoveFile doesn't start if the target exists.
+            if (QFile::exists(fileOp.destFile) && QFile::exists(fileOp.srcFile))
+            {
+                overallResult &= QFile::remove(fileOp.destFile);
+                break;
+            }
+            //Fall through
+        case FileOp::FAT_Rename:
+        case FileOp::FAT_SystemTrash:
+        case FileOp::FAT_Delete:
+            //For the last two, destFile is the kept file; if it is not there, the file was not
+            //  deleted at all.
+            if (QFile::exists(fileOp.destFile) && !QFile::exists(fileOp.srcFile))
+                overallResult &= QFile::rename(fileOp.destFile, fileOp.srcFile);
+            break;
+        }
+    }
+    return overallResult;
+}
+
+bool TransactionalFileOperator::CopyAndRemoveFile(const QString& oldPath, const QString& newPath)
+{
+    //QFile::copy would fail anyway; but then recovery must not take an existing file for our copy.
+    if (QFile::exists(newPath))
+        return false;
+
+    //The journal is written first, like in RenameFile.
+    FileOp fileOp(FileOp::FAT_Move, oldPath, newPath);
+    if (!WriteJournalAhead(fileOp))
+        return false;
+
+    bool result = QFile::copy(oldPath, newPath);
+
+    if (result)
+    {
+        result = QFile::remove(oldPath);
+        //E.g the original is in use; don't leave a second copy behind.
+        if (!result)
+            QFile::remove(newPath);
+    }
+
+    if (result)
+        fileOps.append(fileOp);
+
+    return result;
+}
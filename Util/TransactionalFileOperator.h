@@ -2,9 +2,19 @@
 #include <QList>
 #include <QString>
 
+class QCryptographicHash;
+class QFile;
+class QIODevice;
+
 /// Provide transactional file management. Only one transaction can be active at a time.
+/// Journal mode: If a journal directory is set, deleted and trashed files are kept for rolling back
+///     by moving or hard-linking them into a directory of the transaction there, instead of copying
+///     them to temp. All the operations are also written to a journal file in that directory, so
+///     that a transaction that was interrupted e.g by a crash can be rolled back at next startup.
 class TransactionalFileOperator
 {
+    friend class Benchmarks;
+
 private:
     struct FileOp
     {
@@ -13,6 +23,7 @@ private:
             FAT_MakePath,
             FAT_Rename,
             FAT_Copy,
+            FAT_Write,
             FAT_Move,
             FAT_SystemTrash,
             FAT_Delete
@@ -31,8 +42,22 @@ private:
     bool fileTransactionStarted;
     QList<FileOp> fileOps;
 
+    QString journalDirPath;
+    QString transactionDirPath; //Empty until the first operation of a transaction in journal mode
+    QFile* journalFile;
+    bool journalFailed; //Then the transaction goes on like without a journal
+    int journalBackUpsCount;
+
 public:
     TransactionalFileOperator();
+    ~TransactionalFileOperator();
+
+    /// Enables journal mode. `dirPath` should be on the same volume as the files, otherwise the
+    ///   deleted files are copied there. Don't set it during a transaction.
+    void setJournalDirPath(const QString& dirPath);
+    /// Rolls back the transactions whose journals are left in the journal directory, and removes
+    ///   what is left of the committed ones. Call before starting any transactions.
+    bool RecoverInterruptedTransactions(int& recoveredCount);
 
     bool BeginTransaction();
     bool CommitTransaction();
@@ -46,11 +71,41 @@ public:
     /// Rename can be used for BOTH renaming and MOVING AS LONG AS the files are on the same volume.
     bool RenameFile(const QString& oldName, const QString& newName);
     bool CopyFile(const QString& oldPath, const QString& newPath);
+    /// Creates `newPath` with the contents of `source`, which must be open; see
+    ///   `Util::WriteDeviceToDevice` for `hasher` and `size`. Rolling back removes the file.
+    bool WriteFile(QIODevice* source, const QString& newPath, QCryptographicHash* hasher, qint64& size);
+    /// Renames the file if both paths are on the same volume; only copies and removes it otherwise.
     bool MoveFile(const QString& oldPath, const QString& newPath);
     bool SystemTrashFile(const QString& filePath);
     bool DeleteFile(const QString& filePath);
 
+    /// For existing files or directories; false if it can't be found out.
+    static bool IsOnSameVolume(const QString& path1, const QString& path2);
+
 private:
-    void EndTransaction();
+    /// If `keepJournal`, the journal and the kept files are left for recovery.
+    void EndTransaction(bool keepJournal = false);
     bool backupFileInTemp(const QString& filePath, QString& backUpFilePath);
+    /// Keeps the operation for rolling back, and writes it to the journal.
+    void AddFileOp(const FileOp& fileOp);
+
+    //// Journal //////////////////////////////////////////////////////////////
+    /// Creates the transaction directory and journal file on the first call in a transaction.
+    ///   Returns false if not in journal mode or they couldn't be created.
+    bool StartJournal();
+    bool WriteJournal(const FileOp& fileOp);
+    /// For operations that are journaled before being done. Returns false only if in journal mode
+    ///   and writing failed; the operation must not be done then.
+    bool WriteJournalAhead(const FileOp& fileOp);
+    /// A new path in the transaction directory for keeping `filePath`.
+    QString JournalBackUpFilePath(const QString& filePath);
+    /// Removes the journal file then the transaction directory; after removing the journal file the
+    ///   transaction is not rolled back at recovery anymore. If `keepJournal`, nothing is removed.
+    void EndJournal(bool keepJournal);
+    static const char* const JournalFileName;
+    static bool ReadJournal(const QString& journalFilePath, QList<FileOp>& journaledOps);
+    /// Unlike RollBackTransaction, checks the state of each file, as the journal may have been
+    ///   written before its operation, or the operation may have been already rolled back.
+    static bool RecoverJournaledOps(const QList<FileOp>& journaledOps);
+    bool CopyAndRemoveFile(const QString& oldPath, const QString& newPath);
 };
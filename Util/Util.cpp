@@ -599,6 +599,32 @@ QByteArray Util::GetMD5HashForFile(const QString& filePathName)
     }
 }
 
+bool Util::WriteDeviceToDevice(QIODevice* source, QIODevice* target,
+                               QCryptographicHash* hasher, qint64& size)
+{
+    //Same chunk size as GetMD5HashForFile.
+    const int CHUNK_SIZE = 65536;
+    char buff[CHUNK_SIZE];
+
+    size = 0;
+    while (!source->atEnd())
+    {
+        qint64 bytesRead = source->read(buff, CHUNK_SIZE);
+        if (bytesRead < 0)
+            return false;
+        if (bytesRead == 0)
+            break;
+
+        if (target->write(buff, bytesRead) != bytesRead)
+            return false;
+        if (hasher != NULL)
+            hasher->addData(buff, bytesRead);
+        size += bytesRead;
+    }
+
+    return true;
+}
+
 bool Util::IsValidFileName(const QString& fileName)
 {
     /// Intentionally Incomplete.
@@ -689,7 +715,7 @@ QPixmap Util::DeSerializeQPixmap(const QByteArray& data)
     return pixmap;
 }
 
-void Util::FindLineColumnForOffset(const QByteArray& buff, int offset, int& line, int& col)
+void Util::FindLineColumnForOffset(const QByteArray& buff, qint64 offset, int& line, int& col)
 {
     const int size = buff.size();
     const unsigned char* data = (const unsigned char*)buff.data();
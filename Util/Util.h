@@ -5,6 +5,9 @@
 #include <QString>
 #include <QStringList>
 
+class QCryptographicHash;
+class QIODevice;
+
 class Util
 {
 public:
@@ -74,6 +77,11 @@ public:
     // File Properties Handling ///////////////////////////////////////////////////////////////////
     static QString UserReadableFileSize(long long size);
     static QByteArray GetMD5HashForFile(const QString& filePathName);
+    /// Writes all of `source` to `target` in chunks, also hashing it with `hasher` if it is not
+    ///   NULL, so the data is not read again for hashing. Both must be open. `size` is set to the
+    ///   bytes written. Returns false if reading or writing fails.
+    static bool WriteDeviceToDevice(QIODevice* source, QIODevice* target,
+                                    QCryptographicHash* hasher, qint64& size);
     static bool IsValidFileName(const QString& fileName); //See starting comments
 
     // Math ///////////////////////////////////////////////////////////////////////////////////////
@@ -85,7 +93,7 @@ public:
     static QPixmap DeSerializeQPixmap(const QByteArray& data);
 
     // Byte Array /////////////////////////////////////////////////////////////////////////////////
-    static void FindLineColumnForOffset(const QByteArray& buff, int offset, int& line, int& col);
+    static void FindLineColumnForOffset(const QByteArray& buff, qint64 offset, int& line, int& col);
 };
 
 class UtilT
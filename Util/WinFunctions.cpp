@@ -1,5 +1,6 @@
 #include "WinFunctions.h"
 
+#include <QDir>
 #include <QFileInfo>
 #include <QtWinExtras/QtWin>
 
@@ -37,6 +38,27 @@ bool WinFunctions::MoveFileToRecycleBin(const QString& filePathName)
     return (result == 0);
 }
 
+bool WinFunctions::MakeHardLink(const QString& existingFilePathName, const QString& newLinkPathName)
+{
+    const QString nativeExisting = QDir::toNativeSeparators(existingFilePathName);
+    const QString nativeNewLink = QDir::toNativeSeparators(newLinkPathName);
+
+    wchar_t* wsExisting = new wchar_t[nativeExisting.length() + 1];
+    nativeExisting.toWCharArray(wsExisting);
+    wsExisting[nativeExisting.length()] = '\0'; //Qt Doesn't put null-terminator there.
+
+    wchar_t* wsNewLink = new wchar_t[nativeNewLink.length() + 1];
+    nativeNewLink.toWCharArray(wsNewLink);
+    wsNewLink[nativeNewLink.length()] = '\0';
+
+    BOOL result = CreateHardLinkW(wsNewLink, wsExisting, NULL);
+
+    delete[] wsExisting;
+    delete[] wsNewLink;
+
+    return (result != 0);
+}
+
 QString WinFunctions::GetProgramDisplayName(const QString& exePathName)
 {
     int len = exePathName.length();
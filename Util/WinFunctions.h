@@ -9,6 +9,8 @@ class WinFunctions
 {
 public:
     static bool MoveFileToRecycleBin(const QString& filePathName);
+    ///Both must be on the same NTFS volume.
+    static bool MakeHardLink(const QString& existingFilePathName, const QString& newLinkPathName);
 
     ///Gets the display name from the first string it finds, it doesn't search for e.g English name.
     static QString GetProgramDisplayName(const QString& exePathName);